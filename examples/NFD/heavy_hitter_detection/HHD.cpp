@@ -46,100 +46,11 @@
               from IIIS, Tsinghua University, China.
 *************************************************************************************/
 
-#include <errno.h>
-#include <getopt.h>
-#include <inttypes.h>
-#include <stdarg.h>
-#include <stdint.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/queue.h>
-#include <unistd.h>
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-#include <rte_common.h>
-#include <rte_ip.h>
-#include <rte_mbuf.h>
-
-#include "onvm_nflib.h"
-#include "onvm_pkt_helper.h"
-
-#ifdef __cplusplus
-}
-#endif
-
-// NFD ADD
-#include <pcap.h>
-#include <signal.h>
-#include <sys/time.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <cstring>
-#include <iomanip>
-#include <iostream>
-#include <unordered_map>
-#include <unordered_set>
-#include <vector>
-#include "basic_classes.h"
-#include "decode.h"
+#include "nfd_runtime.h"
 
 using namespace std;
 
-#define NF_TAG "HeavyHitterDetection"
-
-/* number of package between each print */
-static uint32_t print_delay = 1000000;
-
-static uint32_t destination;
-
 /*******************************NFD features********************************/
-Flow::Flow(u_char *packet, int totallength) {
-        /*Decoding*/
-        this->pkt = packet;
-        struct ether_header *eth_header;
-        eth_header = (struct ether_header *)packet;
-
-        /* Pointers to start point of various headers */
-        u_char *ip_header;
-        /* Header lengths in bytes */
-        int ethernet_header_length = 14; /* Doesn't change */
-        int ip_header_length;
-        ip_header = packet + ethernet_header_length;
-        ip_header_length = ((*ip_header) & 0x0F);
-        ip_header_length = ip_header_length * 4;
-        int src_addr, des_addr;
-        src_addr = ntohl(*((int *)(ip_header + 12)));
-        des_addr = ntohl(*((int *)(ip_header + 16)));
-        this->field_value["sip"] = new IP(src_addr, 32);
-        this->field_value["dip"] = new IP(des_addr, 32);
-        this->field_value["tag"] = new int(0);
-        this->field_value["iplen"] = new int(totallength);
-        uint8_t protocol = (*(uint8_t *)(ip_header + 9));
-        this->field_value["UDP"] = new int((protocol == IPPROTO_UDP) ? 1 : 0);
-
-        /*TCP layer*/
-        TCPHdr *tcph = (TCPHdr *)(ip_header + ip_header_length);
-        this->field_value["sport"] = new int(ntohs(tcph->th_sport));
-        this->field_value["dport"] = new int(ntohs(tcph->th_dport));
-        /*URG ACK PSH RST SYN FIN*/
-        this->field_value["flag_fin"] = new int(tcph->th_flags        & 0x1);
-        this->field_value["flag_syn"] = new int((tcph->th_flags >> 1) & 0x1);
-        this->field_value["flag_ack"] = new int((tcph->th_flags >> 4) & 0x1);
-}
-void
-Flow::clean() {
-}
-
-int
-process(Flow &f);
-Flow f_glb;
-long int _counter = 0;
-unordered_map<string, int> F_Type::MAP = unordered_map<string, int>();
-unordered_map<string, int> F_Type::MAP2 = unordered_map<string, int>();
 
 int _t1 = 100;
 int _t2 = 1;
@@ -152,208 +63,56 @@ int _t8 = 1;
 int _t9 = 1;
 int _t10 = 1;
 
-struct timeval begin_time;
-struct timeval end_time;
-
-State<unordered_map<IP, int>> hh(*(new unordered_map<IP, int>()));
-State<unordered_map<IP, int>> hh_counter(*(new unordered_map<IP, int>()));
+/* window length in seconds and sliding estimate, set by the model's window statement */
+int _window = 10;
+int _sliding = 0;
+/* hh holds 0/1 flags, an estimate would truncate a set flag to 0, so only the counter slides */
+WindowState<IP, int> hh(0);
+WindowState<IP, int> hh_counter(0, _sliding);
 State<int> threshold(_t1);
 
-void
-_init_() {
-        (new F_Type())->init();
+/* push the model parameters into its state */
+static void
+configure(void) {
+        uint64_t cycles = (uint64_t)_window * rte_get_timer_hz();
+
+        hh.set_window(cycles);
+        hh_counter.set_window(cycles);
+        hh_counter.sliding = _sliding != 0;
+
+        threshold.reset(_t1);
 }
 
 int
 process(Flow &f) {
-        if (((*(int *)f["flag_syn"]) == _t2) &&
-            (hh[f][(*(IP *)f["sip"])] != _t3 && hh_counter[f][(*(IP *)f["sip"])] != threshold[f])) {
-                hh_counter[f][(*(IP *)f["sip"])] = hh_counter[f][(*(IP *)f["sip"])] + _t4;
-        } else if (((*(int *)f["flag_syn"]) == _t5) &&
-                   (hh[f][(*(IP *)f["sip"])] != _t6 && hh_counter[f][(*(IP *)f["sip"])] == threshold[f])) {
-                hh[f][(*(IP *)f["sip"])] = _t7;
-        } else if (((*(int *)f["flag_syn"]) == _t8) && (hh[f][(*(IP *)f["sip"])] == _t9)) {
+        if (((*(int *)f.headers[Syn]) == _t2) &&
+            (hh.get((*(IP *)f.headers[Sip])) != _t3 && hh_counter.get((*(IP *)f.headers[Sip])) != threshold[f])) {
+                increment(hh_counter, f, (*(IP *)f.headers[Sip]), _t4);
+        } else if (((*(int *)f.headers[Syn]) == _t5) &&
+                   (hh.get((*(IP *)f.headers[Sip])) != _t6 && hh_counter.get((*(IP *)f.headers[Sip])) == threshold[f])) {
+                hh.set((*(IP *)f.headers[Sip]), _t7);
+        } else if (((*(int *)f.headers[Syn]) == _t8) && (hh.get((*(IP *)f.headers[Sip])) == _t9)) {
                 return -1;
-        } else if ((*(int *)f["flag_syn"]) != _t10) {
+        } else if ((*(int *)f.headers[Syn]) != _t10) {
         }
         f.clean();
         return 0;
 }
 
 int
-HHD(u_char *pkt, int totallength) {
-        f_glb = Flow(pkt, totallength);
-        return process(f_glb);
-}
-
-void
-stop() {
-        gettimeofday(&end_time, NULL);
-
-        double total = end_time.tv_sec - begin_time.tv_sec + (end_time.tv_usec - begin_time.tv_usec) / 1000000.0;
-
-        printf("\n\n**************************************************\n");
-        printf("%ld packets are processed\n", _counter);
-        printf("NF runs for %f seconds\n", total);
-        printf("**************************************************\n\n");
-}
-
-/**********************************************************************/
+HHD(Flow &f) {
+        uint64_t now = rte_get_tsc_cycles();
 
-/*
- * Print a usage message
- */
-static void
-usage(const char *progname) {
-        printf("Usage: %s [EAL args] -- [NF_LIB args] -- -d <destination> -p <print_delay>\n\n", progname);
+        hh.tick(now);
+        hh_counter.tick(now);
+        return process(f);
 }
 
-/*
- * Parse the application arguments.
- */
-static int
-parse_app_args(int argc, char *argv[], const char *progname) {
-        int c, dst_flag = 0;
-
-        while ((c = getopt(argc, argv, "d:p:")) != -1) {
-                switch (c) {
-                        case 'd':
-                                destination = strtoul(optarg, NULL, 10);
-                                dst_flag = 1;
-                                break;
-                        case 'p':
-                                print_delay = strtoul(optarg, NULL, 10);
-                                break;
-                        case '?':
-                                usage(progname);
-                                if (optopt == 'd')
-                                        RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
-                                else if (optopt == 'p')
-                                        RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
-                                else if (isprint(optopt))
-                                        RTE_LOG(INFO, APP, "Unknown option `-%c'.\n", optopt);
-                                else
-                                        RTE_LOG(INFO, APP, "Unknown option character `\\x%x'.\n", optopt);
-                                return -1;
-                        default:
-                                usage(progname);
-                                return -1;
-                }
-        }
-
-        if (!dst_flag) {
-                RTE_LOG(INFO, APP, "Heavy Hitter Detection NF requires destination flag -d.\n");
-                return -1;
-        }
-
-        return optind;
-}
+static struct nfd_param params[] = {
+        {"threshold", NFD_PARAM_INT, &_t1},
+        {"window", NFD_PARAM_INT, &_window},
+        {"sliding", NFD_PARAM_INT, &_sliding},
+        {NULL, NFD_PARAM_INT, NULL},
+};
 
-/*
- * This function displays stats. It uses ANSI terminal codes to clear
- * screen when called. It is called from a single non-master
- * thread in the server process, when the process is run with more
- * than one lcore enabled.
- */
-static void
-do_stats_display(struct rte_mbuf *pkt) {
-        const char clr[] = {27, '[', '2', 'J', '\0'};
-        const char topLeft[] = {27, '[', '1', ';', '1', 'H', '\0'};
-        static uint64_t pkt_process = 0;
-        struct rte_ipv4_hdr *ip;
-
-        pkt_process += print_delay;
-
-        /* Clear screen and move to top left */
-        printf("%s%s", clr, topLeft);
-
-        printf("PACKETS\n");
-        printf("-----\n");
-        printf("Port : %d\n", pkt->port);
-        printf("Size : %d\n", pkt->pkt_len);
-        printf("N°   : %" PRIu64 "\n", pkt_process);
-        printf("\n\n");
-
-        ip = onvm_pkt_ipv4_hdr(pkt);
-        if (ip != NULL) {
-                onvm_pkt_print(pkt);
-        } else {
-                printf("No IP4 header found\n");
-        }
-}
-
-static int
-packet_handler(struct rte_mbuf *buf, struct onvm_pkt_meta *meta,
-               __attribute__((unused)) struct onvm_nf_local_ctx *nf_local_ctx) {
-        static uint32_t counter = 0;
-        if (++counter == print_delay) {
-                do_stats_display(buf);
-                counter = 0;
-        }
-        ////////add NFD NF process here!////////////////
-        _counter++;
-        u_char * pkt = rte_pktmbuf_mtod(buf, u_char*);
-        int length = (int)buf->pkt_len;
-        int ok;
-
-        ok = HHD(pkt, length);
-
-        if (ok == -1) {
-                meta->action = ONVM_NF_ACTION_DROP;
-        } else {
-                meta->action = ONVM_NF_ACTION_TONF;
-                meta->destination = destination;
-        }
-
-        ////////////////////////////////////////////////
-        return 0;
-}
-
-int
-main(int argc, char *argv[]) {
-        struct onvm_nf_local_ctx *nf_local_ctx;
-        struct onvm_nf_function_table *nf_function_table;
-        int arg_offset;
-
-        const char *progname = argv[0];
-
-        nf_local_ctx = onvm_nflib_init_nf_local_ctx();
-        onvm_nflib_start_signal_handler(nf_local_ctx, NULL);
-
-        nf_function_table = onvm_nflib_init_nf_function_table();
-        nf_function_table->pkt_handler = &packet_handler;
-
-        if ((arg_offset = onvm_nflib_init(argc, argv, NF_TAG, nf_local_ctx, nf_function_table)) < 0) {
-                onvm_nflib_stop(nf_local_ctx);
-                if (arg_offset == ONVM_SIGNAL_TERMINATION) {
-                        printf("Exiting due to user termination\n");
-                        return 0;
-                } else {
-                        rte_exit(EXIT_FAILURE, "Failed ONVM init\n");
-                }
-        }
-
-        argc -= arg_offset;
-        argv += arg_offset;
-
-        // NFD begin
-        _init_();
-        // NFD end
-
-        if (parse_app_args(argc, argv, progname) < 0) {
-                onvm_nflib_stop(nf_local_ctx);
-                rte_exit(EXIT_FAILURE, "Invalid command-line arguments\n");
-        }
-
-        // NFD begin
-        gettimeofday(&begin_time, NULL);
-        // NFD end
-
-        onvm_nflib_run(nf_local_ctx);
-
-        onvm_nflib_stop(nf_local_ctx);
-        stop();
-        printf("If we reach here, program is ending\n");
-
-        return 0;
-}
+NFD_MODEL("HeavyHitterDetection", NULL, &HHD, params, &configure)
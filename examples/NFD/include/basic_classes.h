@@ -13,6 +13,9 @@
               used in NFD NF.
 *************************************************************************************/
 
+#ifndef _NFD_BASIC_CLASSES_H_
+#define _NFD_BASIC_CLASSES_H_
+
 #include <stdarg.h>
 #include <stdint.h>
 #include <iostream>
@@ -28,9 +31,16 @@
 using namespace std;
 class IP;
 typedef unordered_set<IP> ipset;
-enum header { Iplen = 0, Sport = 1, Dport = 2, Tcp = 3, Udp = 4, Sip = 10, Dip = 11, Tag = 20 };
+enum header { Iplen = 0, Sport = 1, Dport = 2, Tcp = 3, Udp = 4, Fin = 5, Syn = 6, Ack = 7, Proto = 8, DnsId = 9, Sip = 10, Dip = 11, Tag = 20 };
+
+/* int headers are below this index, IP headers from Sip up to Tag */
+#define NFD_INT_HEADERS 10
+struct rte_mbuf;
 
 #define ERROR_HANDLE(x) std::cout << "Error Information: " << x << endl;
+
+/* stale WindowState entries reclaimed per update */
+#define NFD_WINDOW_SWEEP 2
 std::vector<std::string>
 split(const std::string& text, char sep);
 
@@ -110,25 +120,6 @@ class F_Type {
         }
 };
 
-class Flow {
-        u_char* pkt;
-        void* q = new string("error");
-        unordered_map<string, void*> field_value;
-        friend struct FlowCmp;
-
-       public:
-        void* headers[30];
-        // Flow(int count, ...);
-        Flow(){};
-        Flow(int* tag);
-        Flow(u_char* pkt, int totallength);
-        void*& operator[](const string& field);
-        int
-        matches(const string& field, const void* p);
-        void
-        clean();
-};
-
 /*IP class for reserving IP*/
 class IP {
        private:
@@ -152,6 +143,37 @@ class IP {
         operator!=(const IP& other);
 };
 
+/* Parse "a.b.c.d" or "a.b.c.d/len" into ip, false if it is not a prefix */
+bool
+parse_prefix(const char* str, IP* ip);
+
+class Flow {
+        u_char* pkt = NULL;
+        void* q = NULL;
+        unordered_map<string, void*> field_value;
+        /* backing store for headers[], filled by the mbuf view without allocating */
+        int ints[NFD_INT_HEADERS];
+        IP ips[2];
+        int tag;
+        friend struct FlowCmp;
+
+       public:
+        void* headers[30];
+        // Flow(int count, ...);
+        Flow(){};
+        Flow(int* tag);
+        /* defined in nfd_onvm.h, headers[] point into the Flow itself */
+        Flow(struct rte_mbuf* m);
+        Flow(const Flow&) = delete;
+        Flow&
+        operator=(const Flow&) = delete;
+        void*& operator[](const string& field);
+        int
+        matches(const string& field, const void* p);
+        void
+        clean();
+};
+
 class Tuple {
        private:
        public:
@@ -245,15 +267,274 @@ class State {
                         auto it = states.find(tp);
                         if (it == states.end()) {
                                 // not exist in keys of map
-                                this->states[tp] = init;
+                                it = this->states.emplace(tp, init).first;
                         }
-                        return this->states[tp];
+                        return it->second;
                 } else {
                         return this->gl_state;
                 }
         }
+
+        /* lookup returns the state of f, or NULL if f has none yet. Never creates an entry */
+        T*
+        lookup(Flow& f) {
+                if (this->global == true)
+                        return &this->gl_state;
+                auto it = states.find(create_tuple(f));
+                if (it == states.end())
+                        return NULL;
+                return &it->second;
+        }
+
+        /* reset changes the initial value, a global state takes it at once */
+        void
+        reset(const T& ini) {
+                this->init = ini;
+                if (this->global == true)
+                        this->gl_state = ini;
+        }
 };
 
+/*
+ * In-place updates of State entries. They change the entry of f directly instead of
+ * building a temporary container and copying it back, so each call is O(1).
+ */
+
+/* s = s | {item} */
+template <typename T>
+void
+insert_into(State<unordered_set<T>>& s, Flow& f, const T& item) {
+        s[f].insert(item);
+}
+
+/* s = s - {item} */
+template <typename T>
+void
+erase_from(State<unordered_set<T>>& s, Flow& f, const T& item) {
+        unordered_set<T>* entry = s.lookup(f);
+        if (entry != NULL)
+                entry->erase(item);
+}
+
+/* m = m - {key} */
+template <typename K, typename V>
+void
+erase_from(State<unordered_map<K, V>>& s, Flow& f, const K& key) {
+        unordered_map<K, V>* entry = s.lookup(f);
+        if (entry != NULL)
+                entry->erase(key);
+}
+
+/* item in s, a flow without state is checked against the initial value */
+template <typename T>
+bool
+contains(State<unordered_set<T>>& s, Flow& f, const T& item) {
+        unordered_set<T>* entry = s.lookup(f);
+        if (entry == NULL)
+                entry = &s.init;
+        return entry->find(item) != entry->end();
+}
+
+/* key in m */
+template <typename K, typename V>
+bool
+contains(State<unordered_map<K, V>>& s, Flow& f, const K& key) {
+        unordered_map<K, V>* entry = s.lookup(f);
+        if (entry == NULL)
+                entry = &s.init;
+        return entry->find(key) != entry->end();
+}
+
+/* m[key] = m[key] + delta, returns the new value */
+template <typename K, typename V>
+V
+increment(State<unordered_map<K, V>>& s, Flow& f, const K& key, V delta) {
+        return s[f][key] += delta;
+}
+
+/* c = c + delta, returns the new value */
+template <typename V>
+V
+increment(State<V>& s, Flow& f, V delta) {
+        return s[f] += delta;
+}
+
+/*
+ * Map of per key state that only lives for a time window, used for "window" models.
+ * Values belong to the epoch they were written in. Starting a new window only bumps
+ * the generation counter, entries of older windows read as init and are reclaimed a
+ * few at a time by later updates, so no map is ever cleared. The value of the window
+ * before is kept per entry, which lets get() approximate a sliding window.
+ * Time comes from the TSC value the NF passes to tick().
+ */
+template <typename K, typename V>
+class WindowState {
+       private:
+        struct Slot {
+                V cur;
+                V prev;
+                uint64_t gen;
+        };
+        unordered_map<K, Slot> slots;
+        typename unordered_map<K, Slot>::iterator sweep;
+        size_t sweep_buckets = 0;
+        uint64_t gen = 1;
+        /* window length in TSC cycles, 0 keeps everything forever */
+        uint64_t window = 0;
+        uint64_t window_start = 0;
+        uint64_t now = 0;
+
+        /* move a slot written in an older window to the current one */
+        void
+        age(Slot& s) {
+                if (s.gen == this->gen)
+                        return;
+                s.prev = (s.gen + 1 == this->gen) ? s.cur : this->init;
+                s.cur = this->init;
+                s.gen = this->gen;
+        }
+
+        /* erase a few entries that were not written in the current or previous window */
+        void
+        reclaim() {
+                /* a rehash invalidates the cursor */
+                if (this->sweep_buckets != this->slots.bucket_count()) {
+                        this->sweep = this->slots.begin();
+                        this->sweep_buckets = this->slots.bucket_count();
+                }
+                for (int i = 0; i < NFD_WINDOW_SWEEP && !this->slots.empty(); i++) {
+                        if (this->sweep == this->slots.end())
+                                this->sweep = this->slots.begin();
+                        if (this->sweep->second.gen + 1 < this->gen)
+                                this->sweep = this->slots.erase(this->sweep);
+                        else
+                                ++this->sweep;
+                }
+        }
+
+       public:
+        V init;
+        bool sliding;
+
+        WindowState(V ini, bool slide = false) {
+                this->init = ini;
+                this->sliding = slide;
+        }
+
+        void
+        set_window(uint64_t window_cycles) {
+                this->window = window_cycles;
+        }
+
+        /* tick advances time to tsc, call it with the TSC before each packet is processed */
+        void
+        tick(uint64_t tsc) {
+                uint64_t passed;
+
+                this->now = tsc;
+                if (this->window == 0)
+                        return;
+                if (this->window_start == 0) {
+                        this->window_start = tsc;
+                        return;
+                }
+                if (tsc - this->window_start < this->window)
+                        return;
+                /* several windows may have passed, then nothing of the previous one is kept */
+                passed = (tsc - this->window_start) / this->window;
+                this->gen += passed;
+                this->window_start += passed * this->window;
+        }
+
+        /* get returns the value of k in the current window, or its sliding window estimate */
+        V
+        get(const K& k) {
+                V cur, prev;
+                auto it = this->slots.find(k);
+
+                if (it == this->slots.end())
+                        return this->init;
+                /* read as if aged, only writes move a slot to the current window */
+                if (it->second.gen == this->gen) {
+                        cur = it->second.cur;
+                        prev = it->second.prev;
+                } else {
+                        cur = this->init;
+                        prev = (it->second.gen + 1 == this->gen) ? it->second.cur : this->init;
+                }
+                if (!this->sliding || this->window == 0)
+                        return cur;
+                /* the previous window counts as much as it still overlaps the sliding one */
+                return cur + (V)((double)prev * (this->window - (this->now - this->window_start)) / this->window);
+        }
+
+        /* ref returns the value of k in the current window, creating it if needed */
+        V&
+        ref(const K& k) {
+                reclaim();
+                auto it = this->slots.find(k);
+                if (it == this->slots.end())
+                        it = this->slots.emplace(k, Slot{this->init, this->init, this->gen}).first;
+                else
+                        age(it->second);
+                return it->second.cur;
+        }
+
+        void
+        set(const K& k, const V& v) {
+                ref(k) = v;
+        }
+
+        V
+        increment(const K& k, V delta) {
+                return ref(k) += delta;
+        }
+
+        /* contains reports whether k was written in the current window */
+        bool
+        contains(const K& k) {
+                auto it = this->slots.find(k);
+                return it != this->slots.end() && it->second.gen == this->gen;
+        }
+
+        void
+        erase(const K& k) {
+                auto it = this->slots.find(k);
+                if (it == this->slots.end())
+                        return;
+                if (it == this->sweep)
+                        this->sweep = this->slots.erase(it);
+                else
+                        this->slots.erase(it);
+        }
+
+        int
+        getSize() {
+                return this->slots.size();
+        }
+
+        uint64_t
+        epoch() {
+                return this->gen;
+        }
+};
+
+/* m[key] = m[key] + delta in the current window */
+template <typename K, typename V>
+V
+increment(WindowState<K, V>& s, Flow& f, const K& key, V delta) {
+        (void)f;
+        return s.increment(key, delta);
+}
+
+/* key in m, for the current window */
+template <typename K, typename V>
+bool
+contains(WindowState<K, V>& s, Flow& f, const K& key) {
+        (void)f;
+        return s.contains(key);
+}
+
 namespace std {
 template <>
 struct hash<IP> {
@@ -350,3 +631,5 @@ struct equal_to<Tuple> {
         }
 };
 }  // namespace std
+
+#endif  // _NFD_BASIC_CLASSES_H_
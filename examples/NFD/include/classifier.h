@@ -0,0 +1,156 @@
+/**********************************************************************************
+                               NFD project
+   A C++ based NF developing framework designed by Wenfei's group
+   from IIIS, Tsinghua University, China.
+******************************************************************************/
+
+/************************************************************************************
+* Filename:   classifier.h
+* Copyright:
+* Disclaimer: This code is presented "as is" without any guarantees.
+* Details:    Packet classifier for stateless NFD rule sets. The rules are compiled
+              once into per field lookup structures, a stride 8 multibit trie for
+              the address prefixes and flat tables for protocol and port, each
+              returning a bit vector of the rules it matches (Lakshman/Stiliadis
+              bit vector scheme). A packet's rule is the first bit set in the
+              intersection of its four vectors.
+*************************************************************************************/
+
+#ifndef _NFD_CLASSIFIER_H_
+#define _NFD_CLASSIFIER_H_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "basic_classes.h"
+
+/* Verdicts a rule can give, the same as a model's return value */
+#define RULE_PASS 0
+#define RULE_DROP -1
+
+/* Wildcard for Rule::proto */
+#define RULE_ANY_PROTO -1
+
+/*
+ * One stateless rule. A prefix with mask 0 matches any address; earlier
+ * rules win over later ones.
+ */
+struct Rule {
+        IP sip;
+        IP dip;
+        int proto = RULE_ANY_PROTO;
+        int dport_lo = 0;
+        int dport_hi = 65535;
+        int verdict = RULE_PASS;
+
+        Rule() {
+                sip.ip = sip.mask = 0;
+                dip.ip = dip.mask = 0;
+        }
+};
+
+/*
+ * Parse a rule. A bare prefix "a.b.c.d/len" passes packets from that source.
+ * The long form is space separated fields followed by the verdict, any field
+ * may be left out:
+ *     sip 10.0.0.0/8 dip 192.168.1.0/24 proto tcp dport 80-443 drop
+ * Returns false if the text is not a rule.
+ */
+bool
+parse_rule(const string& text, Rule* rule);
+
+class Classifier {
+       public:
+        /* fields of one packet, in host byte order */
+        struct Key {
+                uint32_t sip;
+                uint32_t dip;
+                uint8_t proto;
+                uint16_t dport;
+        };
+
+        Classifier() {
+                build(vector<Rule>(), RULE_PASS);
+        }
+
+        /* Compile rules, packets that match none get default_verdict */
+        void
+        build(const vector<Rule>& rules, int default_verdict);
+
+        /* Classify n packets, verdicts[i] is the verdict of keys[i] */
+        void
+        classify_burst(const Key* keys, int n, int* verdicts) const;
+
+        int
+        classify(const Key& key) const {
+                int verdict;
+
+                classify_burst(&key, 1, &verdict);
+                return verdict;
+        }
+
+        int
+        getSize() const {
+                return this->verdicts.size();
+        }
+
+       private:
+        /* a trie slot: the child node, or -1 at a leaf, and the slot's class */
+        struct Slot {
+                int32_t child;
+                uint32_t cls;
+        };
+
+        /*
+         * The distinct rule bit vectors of one field. Each class is stored as
+         * `summary` words, bit w set when word w of the vector is non zero,
+         * followed by the vector itself.
+         */
+        struct Classes {
+                vector<uint64_t> words;
+                map<vector<uint64_t>, uint32_t> ids;
+                /* (class, rule) -> class with that rule added, for building */
+                map<pair<uint32_t, int>, uint32_t> added;
+        };
+
+        enum { SIP = 0, DIP = 1, PROTO = 2, DPORT = 3, FIELDS = 4 };
+
+        vector<int> verdicts;
+        int default_verdict;
+        int nwords;   /* 64 bit words in a rule vector */
+        int nsummary; /* words in its summary */
+        Classes classes[FIELDS];
+        vector<Slot> trie[2];
+        vector<uint32_t> proto_cls;
+        vector<uint32_t> dport_cls;
+
+        uint32_t
+        intern(Classes& c, const vector<uint64_t>& bits);
+        uint32_t
+        add_rule(Classes& c, uint32_t cls, int rule);
+        void
+        insert_prefix(int field, const IP& prefix, int rule);
+        void
+        build_range(int field, vector<uint32_t>& table, const vector<pair<int, int>>& ranges);
+
+        const uint64_t*
+        class_words(int field, uint32_t cls) const {
+                return &this->classes[field].words[(size_t)cls * (this->nsummary + this->nwords)];
+        }
+
+        uint32_t
+        lookup_prefix(int field, uint32_t addr) const {
+                const Slot* slot = &this->trie[field][addr >> 24];
+                int shift = 16;
+
+                while (slot->child >= 0) {
+                        slot = &this->trie[field][((size_t)slot->child << 8) + ((addr >> shift) & 0xff)];
+                        shift -= 8;
+                }
+                return slot->cls;
+        }
+};
+
+#endif  // _NFD_CLASSIFIER_H_
@@ -0,0 +1,180 @@
+/**********************************************************************************
+                               NFD project
+   A C++ based NF developing framework designed by Wenfei's group
+   from IIIS, Tsinghua University, China.
+******************************************************************************/
+
+/************************************************************************************
+* Filename:   conntrack.h
+* Copyright:
+* Disclaimer: This code is presented "as is" without any guarantees.
+* Details:    Connection tracking for stateful NFD models. Connections live in a
+              fixed pool, found through a bucketed index that both directions of
+              a connection hash to, and carry their TCP state and sequence window
+              inline. Idle connections are expired by a timer wheel with one
+              second ticks, so neither memory nor per packet work grows with the
+              number of connections seen.
+*************************************************************************************/
+
+#ifndef _NFD_CONNTRACK_H_
+#define _NFD_CONNTRACK_H_
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+/* index entries per bucket, a bucket fills half a cache line */
+#define CONNTRACK_WAYS 4
+/* wheel slots, one per second, longer timeouts take more than one turn */
+#define CONNTRACK_WHEEL 4096
+#define CONNTRACK_NIL UINT32_MAX
+
+/* The addresses, ports and protocol of a packet, host byte order */
+struct ConnTuple {
+        uint32_t sip;
+        uint32_t dip;
+        uint16_t sport;
+        uint16_t dport;
+        uint8_t proto;
+};
+
+/* What the tracker needs from a packet, ports and TCP fields are 0 for other protocols */
+struct ConnPacket {
+        ConnTuple t;
+        uint8_t tcp_flags;
+        uint32_t seq;
+        uint32_t ack;
+        uint16_t win;
+        /* window scale option of a SYN, -1 if absent */
+        int8_t wscale;
+        /* payload length */
+        uint16_t len;
+};
+
+/* A looked up connection: its pool index, or CONNTRACK_NIL, and the packet's direction */
+struct ConnRef {
+        uint32_t id;
+        uint8_t dir;
+};
+
+class ConnTrack {
+       public:
+        enum State { NONE = 0, NEW, ESTABLISHED, FIN_WAIT, CLOSED, STATES };
+
+        /* what track() made of a packet */
+        enum Result {
+                CT_INVALID = -1, /* out of window or not allowed in the connection's state */
+                CT_UNTRACKED = 0, /* no connection and none created */
+                CT_TRACKED = 1,   /* belongs to a connection */
+        };
+
+        ConnTrack();
+
+        /*
+         * Size the pool for capacity connections and drop all of them. Returns
+         * false, with the table unchanged, if the memory cannot be allocated.
+         */
+        bool
+        init(uint32_t capacity, uint32_t now);
+
+        /* Seconds a TCP (tcp true) or other connection stays in state without traffic */
+        void
+        set_timeout(bool tcp, State state, uint32_t seconds);
+
+        /*
+         * Find the connections of n packets, with the index buckets of the
+         * burst prefetched first. track() looks a packet without a connection
+         * up again once an earlier packet of the burst opened one.
+         */
+        void
+        lookup_burst(const ConnPacket* pkts, int n, ConnRef* refs);
+
+        ConnRef
+        lookup(const ConnTuple& t) const;
+
+        /*
+         * Update the connection of p, or with create set open one when p may
+         * start a connection (a SYN for TCP, any packet otherwise). ref is
+         * updated to the created connection.
+         */
+        Result
+        track(const ConnPacket& p, ConnRef& ref, bool create, uint32_t now);
+
+        State
+        state(const ConnRef& ref) const {
+                return ref.id == CONNTRACK_NIL ? NONE : (State)this->pool[ref.id].state;
+        }
+
+        /* Release connections idle past their timeout, call once per burst */
+        void
+        expire(uint32_t now);
+
+        uint32_t
+        size() const {
+                return this->used;
+        }
+
+        /* connections not opened because the pool was full */
+        uint64_t full = 0;
+        /* unestablished connections dropped to make room for new ones */
+        uint64_t early_drops = 0;
+
+       private:
+        struct Window {
+                uint32_t end;    /* highest sequence sent plus one */
+                uint32_t maxend; /* highest sequence the peer allows */
+                uint32_t maxwin; /* largest window advertised */
+                int8_t wscale;
+        };
+
+        struct Conn {
+                ConnTuple t; /* as sent by the initiator */
+                uint8_t state;
+                uint8_t flags;
+                uint32_t expire;
+                uint32_t timer; /* tick of the wheel slot the connection is linked in */
+                uint32_t prev;
+                uint32_t next;
+                Window dir[2];
+        };
+
+        struct Bucket {
+                uint32_t sig[CONNTRACK_WAYS];
+                uint32_t id[CONNTRACK_WAYS];
+        };
+
+        vector<Conn> pool;
+        vector<Bucket> index;
+        uint32_t mask = 0;
+        uint32_t free_list = CONNTRACK_NIL;
+        uint32_t used = 0;
+        uint32_t wheel[CONNTRACK_WHEEL];
+        uint32_t tick = 0;
+        uint32_t timeouts[2][STATES];
+        /* connections opened since the last lookup_burst */
+        uint32_t opened = 0;
+
+        static uint64_t
+        hash(const ConnTuple& t);
+        ConnRef
+        find(const ConnTuple& t, uint64_t h) const;
+        uint32_t
+        open(const ConnPacket& p, uint32_t now);
+        void
+        drop(uint32_t id);
+        void
+        release(uint32_t id);
+        bool
+        unindex(uint32_t id);
+        void
+        link(uint32_t id, uint32_t timer);
+        void
+        unlink(uint32_t id);
+        void
+        refresh(uint32_t id, uint32_t now);
+        Result
+        track_tcp(Conn& c, int dir, const ConnPacket& p, uint32_t now);
+};
+
+#endif  // _NFD_CONNTRACK_H_
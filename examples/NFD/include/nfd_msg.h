@@ -0,0 +1,64 @@
+/**********************************************************************************
+                               NFD project
+   A C++ based NF developing framework designed by Wenfei's group
+   from IIIS, Tsinghua University, China.
+******************************************************************************/
+
+/************************************************************************************
+* Filename:   nfd_msg.h
+* Copyright:
+* Disclaimer: This code is presented "as is" without any guarantees.
+* Details:    Sender side of NFD config updates. Kept apart from nfd_runtime.h so
+              a tool can send updates without linking an NFD model.
+*************************************************************************************/
+
+#ifndef _NFD_MSG_H_
+#define _NFD_MSG_H_
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <rte_malloc.h>
+
+#include "onvm_nflib.h"
+#include "onvm_sc_common.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * Send a config update to every NFD NF instance with the given service ID,
+ * worker threads included. Each instance frees its own copy of the text.
+ *
+ * Input  : the service ID and the JSON text
+ * Output : the number of instances reached, a negative value if one could not be sent
+ */
+static inline int
+nfd_send_config(uint16_t dest, const char* json) {
+        size_t len = strlen(json) + 1;
+        uint16_t i, count;
+        char* data;
+        int ret;
+
+        count = nf_per_service_count[dest];
+        for (i = 0; i < count; i++) {
+                data = (char*)rte_malloc(NULL, len, 0);
+                if (data == NULL)
+                        return -ENOMEM;
+                memcpy(data, json, len);
+
+                ret = onvm_nflib_send_msg_to_instance(services[dest][i], data);
+                if (ret != 0) {
+                        rte_free(data);
+                        return ret;
+                }
+        }
+        return count;
+}
+
+#endif  // _NFD_MSG_H_
@@ -0,0 +1,283 @@
+/**********************************************************************************
+                               NFD project
+   A C++ based NF developing framework designed by Wenfei's group
+   from IIIS, Tsinghua University, China.
+******************************************************************************/
+
+/************************************************************************************
+* Filename:   nfd_onvm.h
+* Copyright:
+* Disclaimer: This code is presented "as is" without any guarantees.
+* Details:    Adapter between NFD models and onvm_nflib. The Flow is a typed view
+              over the mbuf data, the verdict is written straight to the packet
+              meta and packet counters are kept per lcore.
+*************************************************************************************/
+
+#ifndef _NFD_ONVM_H_
+#define _NFD_ONVM_H_
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <rte_byteorder.h>
+#include <rte_cycles.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
+
+#include "onvm_nflib.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "basic_classes.h"
+#include "classifier.h"
+
+/* Model verdict that drops the packet, anything else forwards it */
+#define NFD_VERDICT_DROP -1
+/* Model verdict for a packet rewritten into a reply, sent back out the port it came in on */
+#define NFD_VERDICT_REPLY -2
+
+enum nfd_param_type {
+        NFD_PARAM_INT,   /* int */
+        NFD_PARAM_IP,    /* IP, "a.b.c.d/len" */
+        NFD_PARAM_RULES, /* vector<Rule>, see parse_rule in classifier.h */
+};
+
+/* A model parameter that can be set without rebuilding the NF */
+struct nfd_param {
+        const char* name;
+        enum nfd_param_type type;
+        void* value;
+};
+
+/* What an NFD NF registers with the runtime, see NFD_MODEL in nfd_runtime.h */
+struct nfd_model {
+        const char* tag;
+        /* fills fields beyond the standard view, may be NULL */
+        void (*decode)(Flow& f, struct rte_mbuf* pkt);
+        /* the model itself, returns NFD_VERDICT_DROP to drop */
+        int (*process)(Flow& f);
+        /* terminated by a NULL name, may be NULL */
+        struct nfd_param* params;
+        /* pushes param values into the model's state, may be NULL */
+        void (*configure)(void);
+        /* classifies a whole burst instead of calling process per packet, may be NULL */
+        void (*burst)(struct rte_mbuf** pkts, uint16_t nb_pkts, int* verdicts);
+};
+
+struct nfd_core_stats {
+        uint64_t rx;
+        uint64_t drop;
+        uint64_t reply;
+} __rte_cache_aligned;
+
+static struct nfd_core_stats nfd_stats[RTE_MAX_LCORE];
+static uint64_t nfd_start_tsc;
+
+/*
+ * The IPv4 header of a packet, behind an optional VLAN tag.
+ */
+static inline struct rte_ipv4_hdr*
+nfd_ipv4_hdr(struct rte_mbuf* m) {
+        struct rte_ether_hdr* eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr*);
+        uint16_t l2_len = sizeof(struct rte_ether_hdr);
+
+        if (eth->ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_VLAN))
+                l2_len += sizeof(struct rte_vlan_hdr);
+        return (struct rte_ipv4_hdr*)((u_char*)eth + l2_len);
+}
+
+/*
+ * The transport header that follows ip.
+ */
+static inline u_char*
+nfd_l4_hdr(struct rte_ipv4_hdr* ip) {
+        return (u_char*)ip + (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) * RTE_IPV4_IHL_MULTIPLIER;
+}
+
+/*
+ * The TCP header of an IPv4 TCP packet, NULL for any other packet or when
+ * the headers do not fit in the first segment.
+ */
+static inline struct rte_tcp_hdr*
+nfd_tcp_hdr(struct rte_mbuf* m) {
+        struct rte_ether_hdr* eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr*);
+        uint16_t ether_type = eth->ether_type;
+        struct rte_ipv4_hdr* ip;
+        u_char* l4;
+
+        if (m->data_len < sizeof(struct rte_ether_hdr) + sizeof(struct rte_vlan_hdr))
+                return NULL;
+        if (ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_VLAN))
+                ether_type = ((struct rte_vlan_hdr*)(eth + 1))->eth_proto;
+        if (ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4))
+                return NULL;
+
+        ip = nfd_ipv4_hdr(m);
+        if ((u_char*)(ip + 1) > (u_char*)eth + m->data_len || ip->next_proto_id != IPPROTO_TCP ||
+            (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) < sizeof(struct rte_ipv4_hdr) / RTE_IPV4_IHL_MULTIPLIER)
+                return NULL;
+        l4 = nfd_l4_hdr(ip);
+        if (l4 + sizeof(struct rte_tcp_hdr) > (u_char*)eth + m->data_len)
+                return NULL;
+        return (struct rte_tcp_hdr*)l4;
+}
+
+/*
+ * Decode the mbuf into the Flow's own header slots. Nothing is copied or
+ * allocated, pkt points at the mbuf data so clean() can write fields back.
+ * UDP ports share the TCP offsets, the flag fields are only meaningful for TCP.
+ */
+inline Flow::Flow(struct rte_mbuf* m) {
+        struct rte_ether_hdr* eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr*);
+        struct rte_ipv4_hdr* ip = nfd_ipv4_hdr(m);
+        struct rte_tcp_hdr* tcp = (struct rte_tcp_hdr*)nfd_l4_hdr(ip);
+        int i;
+
+        this->pkt = (u_char*)eth;
+        this->ips[0] = IP((int)rte_be_to_cpu_32(ip->src_addr), 32);
+        this->ips[1] = IP((int)rte_be_to_cpu_32(ip->dst_addr), 32);
+        this->ints[Iplen] = m->pkt_len;
+        this->ints[Sport] = rte_be_to_cpu_16(tcp->src_port);
+        this->ints[Dport] = rte_be_to_cpu_16(tcp->dst_port);
+        this->ints[Tcp] = ip->next_proto_id == IPPROTO_TCP;
+        this->ints[Udp] = ip->next_proto_id == IPPROTO_UDP;
+        this->ints[Fin] = (tcp->tcp_flags & RTE_TCP_FIN_FLAG) != 0;
+        this->ints[Syn] = (tcp->tcp_flags & RTE_TCP_SYN_FLAG) != 0;
+        this->ints[Ack] = (tcp->tcp_flags & RTE_TCP_ACK_FLAG) != 0;
+        this->ints[Proto] = ip->next_proto_id;
+        this->ints[DnsId] = -1; /* set by decode hooks that parse DNS */
+        this->tag = 0;
+
+        for (i = 0; i < NFD_INT_HEADERS; i++)
+                this->headers[i] = &this->ints[i];
+        this->headers[Sip] = &this->ips[0];
+        this->headers[Dip] = &this->ips[1];
+        this->headers[Tag] = &this->tag;
+}
+
+/*
+ * Apply a model verdict to the packet meta.
+ */
+static inline void
+nfd_apply_verdict(struct rte_mbuf* pkt, int verdict, uint16_t destination) {
+        struct nfd_core_stats* stats = &nfd_stats[rte_lcore_id()];
+        struct onvm_pkt_meta* meta = onvm_get_pkt_meta(pkt);
+
+        stats->rx++;
+        if (verdict == NFD_VERDICT_DROP) {
+                stats->drop++;
+                meta->action = ONVM_NF_ACTION_DROP;
+        } else if (verdict == NFD_VERDICT_REPLY) {
+                stats->reply++;
+                meta->action = ONVM_NF_ACTION_OUT;
+                meta->destination = pkt->port;
+        } else {
+                meta->action = ONVM_NF_ACTION_TONF;
+                meta->destination = destination;
+        }
+}
+
+/*
+ * Turn a TCP packet into a bare segment back to its sender: addresses and
+ * ports are swapped, options and payload are cut off and the checksums are
+ * recomputed. The caller returns NFD_VERDICT_REPLY to send it.
+ *
+ * Input  : the packet, the TCP flags, sequence and ack numbers of the reply
+ * Output : 0 on success, -1 if pkt is not IPv4 TCP, then it is left untouched
+ */
+static inline int
+nfd_tcp_reply(struct rte_mbuf* pkt, uint8_t flags, uint32_t seq, uint32_t ack) {
+        struct rte_ether_hdr* eth = rte_pktmbuf_mtod(pkt, struct rte_ether_hdr*);
+        struct rte_tcp_hdr* tcp = nfd_tcp_hdr(pkt);
+        struct rte_ipv4_hdr* ip = nfd_ipv4_hdr(pkt);
+        struct rte_ether_addr mac;
+        uint32_t addr;
+        uint16_t port, len;
+
+        if (tcp == NULL)
+                return -1;
+
+        rte_ether_addr_copy(&eth->s_addr, &mac);
+        rte_ether_addr_copy(&eth->d_addr, &eth->s_addr);
+        rte_ether_addr_copy(&mac, &eth->d_addr);
+
+        addr = ip->src_addr;
+        ip->src_addr = ip->dst_addr;
+        ip->dst_addr = addr;
+        port = tcp->src_port;
+        tcp->src_port = tcp->dst_port;
+        tcp->dst_port = port;
+
+        tcp->sent_seq = rte_cpu_to_be_32(seq);
+        tcp->recv_ack = rte_cpu_to_be_32(ack);
+        tcp->data_off = (sizeof(struct rte_tcp_hdr) / 4) << 4;
+        tcp->tcp_flags = flags;
+        tcp->tcp_urp = 0;
+
+        len = (u_char*)(tcp + 1) - (u_char*)ip;
+        rte_pktmbuf_trim(pkt, rte_pktmbuf_pkt_len(pkt) - ((u_char*)(tcp + 1) - (u_char*)eth));
+        ip->total_length = rte_cpu_to_be_16(len);
+        ip->time_to_live = 64;
+        ip->hdr_checksum = 0;
+        ip->hdr_checksum = rte_ipv4_cksum(ip);
+        tcp->cksum = 0;
+        tcp->cksum = rte_ipv4_udptcp_cksum(ip, tcp);
+        return 0;
+}
+
+/*
+ * Run an NFD model over one packet and set meta->action from its verdict.
+ *
+ * Input  : the packet, the model and the NF to forward to
+ * Output : always 0, the verdict is carried by the packet meta
+ */
+static inline int
+nfd_handle(struct rte_mbuf* buf, const struct nfd_model* model, uint16_t destination) {
+        Flow f(buf);
+
+        if (model->decode != NULL)
+                model->decode(f, buf);
+        nfd_apply_verdict(buf, model->process(f), destination);
+
+        return 0;
+}
+
+static inline void
+nfd_start(void) {
+        nfd_start_tsc = rte_get_tsc_cycles();
+}
+
+/*
+ * Sum the per lcore counters and print the run summary.
+ */
+static inline void
+nfd_report(void) {
+        uint64_t rx = 0, drop = 0, reply = 0;
+        double total;
+        unsigned i;
+
+        total = (double)(rte_get_tsc_cycles() - nfd_start_tsc) / rte_get_tsc_hz();
+        for (i = 0; i < RTE_MAX_LCORE; i++) {
+                rx += nfd_stats[i].rx;
+                drop += nfd_stats[i].drop;
+                reply += nfd_stats[i].reply;
+        }
+
+        printf("\n\n**************************************************\n");
+        printf("%" PRIu64 " packets are processed, %" PRIu64 " packets are dropped, %" PRIu64 " are answered\n", rx,
+               drop, reply);
+        printf("NF runs for %f seconds\n", total);
+        printf("**************************************************\n\n");
+}
+
+#endif  // _NFD_ONVM_H_
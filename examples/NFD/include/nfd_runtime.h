@@ -0,0 +1,499 @@
+/**********************************************************************************
+                               NFD project
+   A C++ based NF developing framework designed by Wenfei's group
+   from IIIS, Tsinghua University, China.
+******************************************************************************/
+
+/************************************************************************************
+* Filename:   nfd_runtime.h
+* Copyright:
+* Disclaimer: This code is presented "as is" without any guarantees.
+* Details:    Datapath shared by every NFD NF: argument parsing, stats display,
+              burst dispatch and main. An NF defines its model and registers it
+              with NFD_MODEL, which expands to main().
+*************************************************************************************/
+
+#ifndef _NFD_RUNTIME_H_
+#define _NFD_RUNTIME_H_
+
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <rte_malloc.h>
+#include <rte_prefetch.h>
+
+#include "onvm_config_common.h"
+#include "onvm_pkt_helper.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "nfd_msg.h"
+#include "nfd_onvm.h"
+
+/* number of packets between each print */
+#define NFD_PRINT_DELAY 1000000
+
+struct nfd_config;
+
+static struct {
+        const struct nfd_model* model;
+        uint16_t destination;
+        uint32_t print_delay;
+        /* published by the message handler, taken by the datapath */
+        struct nfd_config* pending;
+        /* config generations applied since start up */
+        uint32_t gen;
+} nfd_rt = {NULL, 0, NFD_PRINT_DELAY, NULL, 0};
+
+/* One parameter value of a config generation, typed by param->type */
+struct nfd_value {
+        struct nfd_param* param;
+        int i;
+        IP ip;
+        vector<Rule> rules;
+};
+
+/*
+ * A parsed config. The message handler builds it and publishes it, the
+ * datapath applies it at the next burst boundary.
+ */
+struct nfd_config {
+        vector<nfd_value> values;
+};
+
+static struct nfd_param*
+nfd_find_param(const struct nfd_model* model, const char* name, size_t len) {
+        struct nfd_param* p;
+
+        if (model->params == NULL)
+                return NULL;
+        for (p = model->params; p->name != NULL; p++) {
+                if (strlen(p->name) == len && strncmp(p->name, name, len) == 0)
+                        return p;
+        }
+        return NULL;
+}
+
+/*
+ * Fill v from a string: a number, a prefix, or comma separated rules
+ * for a rule set.
+ */
+static int
+nfd_value_from_string(struct nfd_value* v, const char* str) {
+        char* end;
+        string text;
+        Rule rule;
+
+        switch (v->param->type) {
+                case NFD_PARAM_INT:
+                        v->i = (int)strtol(str, &end, 10);
+                        return (*str == '\0' || *end != '\0') ? -1 : 0;
+                case NFD_PARAM_IP:
+                        return parse_prefix(str, &v->ip) ? 0 : -1;
+                case NFD_PARAM_RULES:
+                        for (const char* c = str;; c++) {
+                                if (*c != ',' && *c != '\0') {
+                                        text += *c;
+                                        continue;
+                                }
+                                if (!parse_rule(text, &rule))
+                                        return -1;
+                                v->rules.push_back(rule);
+                                text.clear();
+                                if (*c == '\0')
+                                        return 0;
+                        }
+        }
+        return -1;
+}
+
+static int
+nfd_value_from_json(struct nfd_value* v, cJSON* item) {
+        cJSON* rule;
+
+        switch (v->param->type) {
+                case NFD_PARAM_INT:
+                        if (!cJSON_IsNumber(item))
+                                return -1;
+                        v->i = item->valueint;
+                        return 0;
+                case NFD_PARAM_IP:
+                        return cJSON_IsString(item) && parse_prefix(item->valuestring, &v->ip) ? 0 : -1;
+                case NFD_PARAM_RULES:
+                        if (!cJSON_IsArray(item))
+                                return -1;
+                        cJSON_ArrayForEach(rule, item) {
+                                Rule r;
+                                if (!cJSON_IsString(rule) || !parse_rule(rule->valuestring, &r))
+                                        return -1;
+                                v->rules.push_back(r);
+                        }
+                        return 0;
+        }
+        return -1;
+}
+
+/*
+ * Build a config from a JSON object mapping parameter names to values,
+ * e.g. {"threshold": 500, "rules": ["10.0.0.0/8", "proto udp dport 53 drop"]}.
+ *
+ * Input  : the model and the parsed JSON
+ * Output : the config, or NULL if a name is unknown or a value has the wrong type
+ */
+static struct nfd_config*
+nfd_config_from_json(const struct nfd_model* model, cJSON* json) {
+        struct nfd_config* cfg;
+        struct nfd_value v;
+        cJSON* item;
+
+        if (!cJSON_IsObject(json))
+                return NULL;
+
+        cfg = new nfd_config();
+        cJSON_ArrayForEach(item, json) {
+                v.param = nfd_find_param(model, item->string, strlen(item->string));
+                v.rules.clear();
+                if (v.param == NULL || nfd_value_from_json(&v, item) < 0) {
+                        RTE_LOG(INFO, APP, "Bad model parameter %s in config\n", item->string);
+                        delete cfg;
+                        return NULL;
+                }
+                cfg->values.push_back(v);
+        }
+        return cfg;
+}
+
+/*
+ * Write a config into the model's parameters. The model sees them after
+ * its configure hook runs. Only called from the datapath thread, between bursts.
+ */
+static void
+nfd_config_store(struct nfd_config* cfg) {
+        for (auto it = cfg->values.begin(); it != cfg->values.end(); it++) {
+                switch (it->param->type) {
+                        case NFD_PARAM_INT:
+                                *(int*)it->param->value = it->i;
+                                break;
+                        case NFD_PARAM_IP:
+                                *(IP*)it->param->value = it->ip;
+                                break;
+                        case NFD_PARAM_RULES:
+                                ((vector<Rule>*)it->param->value)->swap(it->rules);
+                                break;
+                }
+        }
+}
+
+/*
+ * Set one model parameter from a "name=value" argument.
+ *
+ * Input  : the model and the argument
+ * Output : 0 on success, -1 if the name is unknown or the value does not parse
+ */
+static int
+nfd_set_param(const struct nfd_model* model, const char* arg) {
+        const char* eq = strchr(arg, '=');
+        struct nfd_config cfg;
+        struct nfd_value v;
+
+        if (eq == NULL)
+                return -1;
+        v.param = nfd_find_param(model, arg, eq - arg);
+        if (v.param == NULL || nfd_value_from_string(&v, eq + 1) < 0)
+                return -1;
+
+        cfg.values.push_back(v);
+        nfd_config_store(&cfg);
+        return 0;
+}
+
+/*
+ * Load model parameters from a JSON file, see nfd_config_from_json.
+ */
+static int
+nfd_load_config(const struct nfd_model* model, const char* filename) {
+        struct nfd_config* cfg;
+        cJSON* json;
+
+        json = onvm_config_parse_file(filename);
+        if (json == NULL) {
+                RTE_LOG(INFO, APP, "Could not parse config file %s\n", filename);
+                return -1;
+        }
+        cfg = nfd_config_from_json(model, json);
+        cJSON_Delete(json);
+        if (cfg == NULL)
+                return -1;
+
+        nfd_config_store(cfg);
+        delete cfg;
+        return 0;
+}
+
+/*
+ * Take a config generation published by nfd_msg_handler, if any. Called
+ * from the message handler and at the start of a burst, both burst
+ * boundaries, so no packet sees half of an update.
+ */
+static inline void
+nfd_config_take(void) {
+        struct nfd_config* cfg;
+
+        if (likely(__atomic_load_n(&nfd_rt.pending, __ATOMIC_RELAXED) == NULL))
+                return;
+        cfg = __atomic_exchange_n(&nfd_rt.pending, NULL, __ATOMIC_ACQUIRE);
+        if (cfg == NULL)
+                return;
+
+        nfd_config_store(cfg);
+        if (nfd_rt.model->configure != NULL)
+                nfd_rt.model->configure();
+        nfd_rt.gen++;
+        delete cfg;
+        RTE_LOG(INFO, APP, "Applied config generation %u\n", nfd_rt.gen);
+}
+
+/*
+ * Message handler for config updates. msg_data is a NUL terminated JSON
+ * string in rte_malloc memory, see nfd_send_config. Messages are handled
+ * between bursts, so the new generation is applied right away and an idle
+ * NF does not wait for traffic to pick it up.
+ */
+static void
+nfd_msg_handler(void* msg_data, __attribute__((unused)) struct onvm_nf_local_ctx* nf_local_ctx) {
+        struct nfd_config* cfg = NULL;
+        cJSON* json;
+
+        json = cJSON_Parse((const char*)msg_data);
+        rte_free(msg_data);
+        if (json != NULL) {
+                cfg = nfd_config_from_json(nfd_rt.model, json);
+                cJSON_Delete(json);
+        }
+        if (cfg == NULL) {
+                RTE_LOG(INFO, APP, "Ignoring bad config update\n");
+                return;
+        }
+
+        /* a generation the datapath has not taken yet is replaced */
+        cfg = __atomic_exchange_n(&nfd_rt.pending, cfg, __ATOMIC_ACQ_REL);
+        delete cfg;
+        nfd_config_take();
+}
+
+/*
+ * Print a usage message
+ */
+static void
+nfd_usage(const char* progname) {
+        printf("Usage: %s [EAL args] -- [NF_LIB args] -- -d <destination> -p <print_delay> "
+               "[-c <config.json>] [-t <param>=<value> ...]\n\n",
+               progname);
+}
+
+/*
+ * Parse the application arguments.
+ */
+static int
+nfd_parse_app_args(int argc, char* argv[], const char* progname) {
+        int c, dst_flag = 0;
+
+        while ((c = getopt(argc, argv, "c:d:p:t:")) != -1) {
+                switch (c) {
+                        case 'c':
+                                if (nfd_load_config(nfd_rt.model, optarg) < 0)
+                                        return -1;
+                                break;
+                        case 'd':
+                                nfd_rt.destination = strtoul(optarg, NULL, 10);
+                                dst_flag = 1;
+                                break;
+                        case 'p':
+                                nfd_rt.print_delay = strtoul(optarg, NULL, 10);
+                                break;
+                        case 't':
+                                if (nfd_set_param(nfd_rt.model, optarg) < 0) {
+                                        RTE_LOG(INFO, APP, "Unknown model parameter %s\n", optarg);
+                                        return -1;
+                                }
+                                break;
+                        case '?':
+                                nfd_usage(progname);
+                                if (optopt == 'c' || optopt == 'd' || optopt == 'p' || optopt == 't')
+                                        RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
+                                else if (isprint(optopt))
+                                        RTE_LOG(INFO, APP, "Unknown option `-%c'.\n", optopt);
+                                else
+                                        RTE_LOG(INFO, APP, "Unknown option character `\\x%x'.\n", optopt);
+                                return -1;
+                        default:
+                                nfd_usage(progname);
+                                return -1;
+                }
+        }
+
+        if (!dst_flag) {
+                RTE_LOG(INFO, APP, "%s NF requires destination flag -d.\n", nfd_rt.model->tag);
+                return -1;
+        }
+
+        return optind;
+}
+
+/*
+ * This function displays stats. It uses ANSI terminal codes to clear
+ * screen when called. It is called from a single non-master
+ * thread in the server process, when the process is run with more
+ * than one lcore enabled.
+ */
+static void
+nfd_stats_display(struct rte_mbuf* pkt) {
+        const char clr[] = {27, '[', '2', 'J', '\0'};
+        const char topLeft[] = {27, '[', '1', ';', '1', 'H', '\0'};
+        uint64_t rx = 0, drop = 0, reply = 0;
+        unsigned i;
+
+        for (i = 0; i < RTE_MAX_LCORE; i++) {
+                rx += nfd_stats[i].rx;
+                drop += nfd_stats[i].drop;
+                reply += nfd_stats[i].reply;
+        }
+
+        /* Clear screen and move to top left */
+        printf("%s%s", clr, topLeft);
+
+        printf("%s\n", nfd_rt.model->tag);
+        printf("-----\n");
+        printf("Processed : %" PRIu64 "\n", rx);
+        printf("Dropped   : %" PRIu64 "\n", drop);
+        printf("Replied   : %" PRIu64 "\n", reply);
+        printf("Config gen: %" PRIu32 "\n", nfd_rt.gen);
+        printf("\n");
+        printf("PACKETS\n");
+        printf("-----\n");
+        printf("Port : %d\n", pkt->port);
+        printf("Size : %d\n", pkt->pkt_len);
+        printf("\n\n");
+
+        if (onvm_pkt_ipv4_hdr(pkt) != NULL) {
+                onvm_pkt_print(pkt);
+        } else {
+                printf("No IP4 header found\n");
+        }
+}
+
+/*
+ * Run the model over a whole burst. The next packet's headers are
+ * prefetched while the current one is in the model. A model with a burst
+ * hook classifies all packets in one call instead.
+ */
+static void
+nfd_burst_handler(struct rte_mbuf** pkts, uint16_t nb_pkts,
+                  __attribute__((unused)) struct onvm_nf_local_ctx* nf_local_ctx) {
+        static uint32_t counter = 0;
+        int verdicts[PACKET_READ_SIZE];
+        uint16_t i, n, base;
+
+        nfd_config_take();
+        if (nfd_rt.model->burst != NULL) {
+                for (base = 0; base < nb_pkts; base += n) {
+                        n = RTE_MIN((uint16_t)(nb_pkts - base), PACKET_READ_SIZE);
+                        nfd_rt.model->burst(pkts + base, n, verdicts);
+                        for (i = 0; i < n; i++)
+                                nfd_apply_verdict(pkts[base + i], verdicts[i], nfd_rt.destination);
+                }
+        }
+
+        for (i = 0; i < nb_pkts; i++) {
+                if (nfd_rt.model->burst == NULL) {
+                        if (i + 1 < nb_pkts)
+                                rte_prefetch0(rte_pktmbuf_mtod(pkts[i + 1], void*));
+                        nfd_handle(pkts[i], nfd_rt.model, nfd_rt.destination);
+                }
+                if (++counter == nfd_rt.print_delay) {
+                        nfd_stats_display(pkts[i]);
+                        counter = 0;
+                }
+        }
+}
+
+static int
+nfd_main(int argc, char* argv[], const struct nfd_model* model) {
+        struct onvm_nf_local_ctx* nf_local_ctx;
+        struct onvm_nf_function_table* nf_function_table;
+        int arg_offset;
+
+        const char* progname = argv[0];
+
+        nfd_rt.model = model;
+
+        nf_local_ctx = onvm_nflib_init_nf_local_ctx();
+        onvm_nflib_start_signal_handler(nf_local_ctx, NULL);
+
+        nf_function_table = onvm_nflib_init_nf_function_table();
+        nf_function_table->pkt_burst_handler = &nfd_burst_handler;
+        nf_function_table->msg_handler = &nfd_msg_handler;
+
+        if ((arg_offset = onvm_nflib_init(argc, argv, model->tag, nf_local_ctx, nf_function_table)) < 0) {
+                onvm_nflib_stop(nf_local_ctx);
+                if (arg_offset == ONVM_SIGNAL_TERMINATION) {
+                        printf("Exiting due to user termination\n");
+                        return 0;
+                } else {
+                        rte_exit(EXIT_FAILURE, "Failed ONVM init\n");
+                }
+        }
+
+        argc -= arg_offset;
+        argv += arg_offset;
+
+        F_Type::init();
+
+        if (nfd_parse_app_args(argc, argv, progname) < 0) {
+                onvm_nflib_stop(nf_local_ctx);
+                rte_exit(EXIT_FAILURE, "Invalid command-line arguments\n");
+        }
+
+        if (model->configure != NULL)
+                model->configure();
+
+        nfd_start();
+        onvm_nflib_run(nf_local_ctx);
+
+        onvm_nflib_stop(nf_local_ctx);
+        nfd_report();
+        printf("If we reach here, program is ending\n");
+
+        return 0;
+}
+
+/*
+ * Register an NFD model and generate the NF's main(). decode, params and
+ * configure may be NULL.
+ */
+#define NFD_MODEL(tag, decode, process, params, configure)                                        \
+        static const struct nfd_model nfd_model_desc = {tag, decode, process, params, configure, NULL}; \
+        int main(int argc, char* argv[]) {                                                         \
+                return nfd_main(argc, argv, &nfd_model_desc);                                      \
+        }
+
+/*
+ * Register a model that classifies whole bursts, see nfd_model.burst.
+ */
+#define NFD_MODEL_BURST(tag, burst, params, configure)                                          \
+        static const struct nfd_model nfd_model_desc = {tag, NULL, NULL, params, configure, burst}; \
+        int main(int argc, char* argv[]) {                                                       \
+                return nfd_main(argc, argv, &nfd_model_desc);                                    \
+        }
+
+#endif  // _NFD_RUNTIME_H_
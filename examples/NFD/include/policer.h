@@ -0,0 +1,195 @@
+/**********************************************************************************
+                               NFD project
+   A C++ based NF developing framework designed by Wenfei's group
+   from IIIS, Tsinghua University, China.
+******************************************************************************/
+
+/************************************************************************************
+* Filename:   policer.h
+* Copyright:
+* Disclaimer: This code is presented "as is" without any guarantees.
+* Details:    Per key token bucket policer for rate based NFD models. A bucket is
+              kept as the TSC time at which it would be full again, so it refills
+              from the TSC delta when it is touched and needs no timer. Buckets
+              live inline in a fixed set associative table; keys that find their
+              set busy are policed by a Count-Min sketch of buckets instead.
+*************************************************************************************/
+
+#ifndef _NFD_POLICER_H_
+#define _NFD_POLICER_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* buckets per set, a set fills one cache line */
+#define POLICER_WAYS 4
+/* rows of the fallback sketch */
+#define POLICER_SKETCH_ROWS 4
+#define POLICER_MAX_SETS (1U << 24)
+
+class Policer {
+       public:
+        Policer() {
+        }
+        ~Policer() {
+                free(this->sets);
+                free(this->sketch);
+        }
+        Policer(const Policer&) = delete;
+        Policer&
+        operator=(const Policer&) = delete;
+
+        /*
+         * Size the table for capacity keys and the sketch rows for width
+         * buckets each, dropping all state. Returns false, with the policer
+         * unchanged, if the memory cannot be allocated.
+         */
+        bool
+        init(uint32_t capacity, uint32_t width) {
+                uint32_t n = 1, w = 1;
+                void *sets, *sketch;
+
+                while (n * POLICER_WAYS < capacity && n < POLICER_MAX_SETS)
+                        n <<= 1;
+                while (w < width && w < POLICER_MAX_SETS)
+                        w <<= 1;
+                if (posix_memalign(&sets, sizeof(Set), (size_t)n * sizeof(Set)) != 0)
+                        return false;
+                if (posix_memalign(&sketch, 64, (size_t)w * POLICER_SKETCH_ROWS * sizeof(uint64_t)) != 0) {
+                        free(sets);
+                        return false;
+                }
+                memset(sets, 0, (size_t)n * sizeof(Set));
+                memset(sketch, 0, (size_t)w * POLICER_SKETCH_ROWS * sizeof(uint64_t));
+
+                free(this->sets);
+                free(this->sketch);
+                this->sets = (Set*)sets;
+                this->sketch = (uint64_t*)sketch;
+                this->set_mask = n - 1;
+                this->width_mask = w - 1;
+                return true;
+        }
+
+        uint32_t
+        capacity() const {
+                return this->sets == NULL ? 0 : (this->set_mask + 1) * POLICER_WAYS;
+        }
+
+        /*
+         * Allow `rate` packets per `cycles` TSC cycles on average and bursts
+         * of up to `burst` packets.
+         */
+        void
+        set_rate(uint64_t rate, uint64_t cycles, uint64_t burst) {
+                this->interval = rate == 0 ? cycles : cycles / rate;
+                if (this->interval == 0)
+                        this->interval = 1;
+                this->depth = (burst == 0 ? 1 : burst) * this->interval;
+        }
+
+        /*
+         * Take one token from key's bucket. Returns false if the bucket is
+         * empty, the packet is then over the rate and nothing is taken.
+         */
+        bool
+        conform(uint32_t key, uint64_t now) {
+                Set* s = &this->sets[hash(key) & this->set_mask];
+                Bucket* free_bucket = NULL;
+                int i;
+
+                for (i = 0; i < POLICER_WAYS; i++) {
+                        Bucket* b = &s->b[i];
+                        if (b->key == key && b->full != 0)
+                                return take(&b->full, now);
+                        /* a bucket that is full again carries nothing, its way can be reused */
+                        if (free_bucket == NULL && (b->full == 0 || b->full <= now))
+                                free_bucket = b;
+                }
+                if (free_bucket != NULL) {
+                        free_bucket->key = key;
+                        free_bucket->full = now;
+                        return take(&free_bucket->full, now);
+                }
+                this->sketched++;
+                return sketch_conform(key, now);
+        }
+
+        /* packets policed by the sketch because their set was busy */
+        uint64_t sketched = 0;
+
+       private:
+        struct Bucket {
+                uint32_t key;
+                uint32_t pad;
+                /* TSC time at which the bucket is full again, 0 for an unused way */
+                uint64_t full;
+        };
+
+        struct Set {
+                Bucket b[POLICER_WAYS];
+        };
+
+        Set* sets = NULL;
+        uint64_t* sketch = NULL;
+        uint32_t set_mask = 0;
+        uint32_t width_mask = 0;
+        /* cycles one token takes to refill, and cycles an empty bucket takes to fill */
+        uint64_t interval = 1;
+        uint64_t depth = 1;
+
+        /*
+         * A bucket refills by time passing, so its level is depth minus the
+         * time still to go until full. Taking a token pushes that time out
+         * by one interval.
+         */
+        bool
+        take(uint64_t* full, uint64_t now) {
+                uint64_t t = *full > now ? *full : now;
+
+                if (t + this->interval - now > this->depth)
+                        return false;
+                *full = t + this->interval;
+                return true;
+        }
+
+        /*
+         * Count-Min over buckets: every row holds a bucket shared by the keys
+         * that hash to it, so a row can only be emptier than the key's own
+         * traffic would make it. The fullest row is the estimate, and rows
+         * are only pushed up to it (conservative update).
+         */
+        bool
+        sketch_conform(uint32_t key, uint64_t now) {
+                uint64_t* cell[POLICER_SKETCH_ROWS];
+                uint64_t t = now;
+                int r;
+
+                for (r = 0; r < POLICER_SKETCH_ROWS; r++) {
+                        uint32_t h = hash(key ^ (0x9e3779b9U * (r + 1)));
+                        cell[r] = &this->sketch[(size_t)r * (this->width_mask + 1) + (h & this->width_mask)];
+                        if (*cell[r] > t)
+                                t = *cell[r];
+                }
+                if (!take(&t, now))
+                        return false;
+                for (r = 0; r < POLICER_SKETCH_ROWS; r++) {
+                        if (*cell[r] < t)
+                                *cell[r] = t;
+                }
+                return true;
+        }
+
+        static uint32_t
+        hash(uint32_t key) {
+                key ^= key >> 16;
+                key *= 0x7feb352d;
+                key ^= key >> 15;
+                key *= 0x846ca68b;
+                key ^= key >> 16;
+                return key;
+        }
+};
+
+#endif  // _NFD_POLICER_H_
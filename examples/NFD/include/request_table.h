@@ -0,0 +1,174 @@
+/**********************************************************************************
+                               NFD project
+   A C++ based NF developing framework designed by Wenfei's group
+   from IIIS, Tsinghua University, China.
+******************************************************************************/
+
+/************************************************************************************
+* Filename:   request_table.h
+* Copyright:
+* Disclaimer: This code is presented "as is" without any guarantees.
+* Details:    Fixed capacity table of outstanding requests for request/response
+              matching NFs, also used as a bounded admission list. Entries live
+              inline in cache line sized buckets and expire by timestamp, so the
+              table never allocates after init() and a lookup reads one bucket.
+*************************************************************************************/
+
+#ifndef _NFD_REQUEST_TABLE_H_
+#define _NFD_REQUEST_TABLE_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* entries per bucket, a bucket fills one cache line */
+#define REQUEST_TABLE_WAYS 4
+#define REQUEST_TABLE_MAX_BUCKETS (1U << 26)
+
+/* A request as seen from the client: who asked whom, from which port, with which id */
+struct RequestKey {
+        uint32_t client;
+        uint32_t server;
+        uint16_t port;
+        uint16_t id;
+};
+
+class RequestTable {
+       public:
+        RequestTable() {
+        }
+        ~RequestTable() {
+                free(this->buckets);
+        }
+        RequestTable(const RequestTable&) = delete;
+        RequestTable&
+        operator=(const RequestTable&) = delete;
+
+        /*
+         * Size the table for at least capacity requests and drop all entries.
+         * Returns false if the memory cannot be allocated.
+         */
+        bool
+        init(uint32_t capacity) {
+                uint32_t n = 1;
+                void* mem;
+
+                while (n * REQUEST_TABLE_WAYS < capacity && n < REQUEST_TABLE_MAX_BUCKETS)
+                        n <<= 1;
+                if (posix_memalign(&mem, sizeof(Bucket), (size_t)n * sizeof(Bucket)) != 0)
+                        return false;
+                memset(mem, 0, (size_t)n * sizeof(Bucket));
+                free(this->buckets);
+                this->buckets = (Bucket*)mem;
+                this->mask = n - 1;
+                return true;
+        }
+
+        uint32_t
+        capacity() const {
+                return this->buckets == NULL ? 0 : (this->mask + 1) * REQUEST_TABLE_WAYS;
+        }
+
+        /*
+         * Record a request that expires at `expire`. A full bucket gives up the
+         * entry closest to expiry, so a flood can only push out other entries.
+         */
+        void
+        insert(const RequestKey& key, uint32_t now, uint32_t expire) {
+                Bucket* b = &this->buckets[hash(key) & this->mask];
+                Entry* victim = NULL;
+                Entry* oldest = &b->e[0];
+                int i;
+
+                for (i = 0; i < REQUEST_TABLE_WAYS; i++) {
+                        Entry* e = &b->e[i];
+                        if (same(*e, key)) {
+                                victim = e;
+                                break;
+                        }
+                        if (!live(*e, now)) {
+                                if (victim == NULL)
+                                        victim = e;
+                        } else if ((int32_t)(e->expire - oldest->expire) < 0) {
+                                oldest = e;
+                        }
+                }
+                if (victim == NULL) {
+                        victim = oldest;
+                        this->evictions++;
+                }
+
+                victim->key = key;
+                victim->expire = expire == 0 ? 1 : expire;
+        }
+
+        /*
+         * Match a response against its request and remove the request, so one
+         * request admits one response. Returns false if there is none.
+         */
+        bool
+        take(const RequestKey& key, uint32_t now) {
+                Bucket* b = &this->buckets[hash(key) & this->mask];
+                int i;
+
+                for (i = 0; i < REQUEST_TABLE_WAYS; i++) {
+                        Entry* e = &b->e[i];
+                        if (same(*e, key) && live(*e, now)) {
+                                e->expire = 0;
+                                return true;
+                        }
+                }
+                return false;
+        }
+
+        /* Whether a request is recorded and not expired, without removing it */
+        bool
+        contains(const RequestKey& key, uint32_t now) const {
+                const Bucket* b = &this->buckets[hash(key) & this->mask];
+                int i;
+
+                for (i = 0; i < REQUEST_TABLE_WAYS; i++) {
+                        if (same(b->e[i], key) && live(b->e[i], now))
+                                return true;
+                }
+                return false;
+        }
+
+        /* requests pushed out by a full bucket before they expired */
+        uint64_t evictions = 0;
+
+       private:
+        struct Entry {
+                RequestKey key;
+                /* expiry timestamp, 0 marks a free entry */
+                uint32_t expire;
+        };
+
+        struct Bucket {
+                Entry e[REQUEST_TABLE_WAYS];
+        };
+
+        Bucket* buckets = NULL;
+        uint32_t mask = 0;
+
+        static bool
+        live(const Entry& e, uint32_t now) {
+                return e.expire != 0 && (int32_t)(e.expire - now) > 0;
+        }
+
+        static bool
+        same(const Entry& e, const RequestKey& key) {
+                return e.key.client == key.client && e.key.server == key.server && e.key.port == key.port &&
+                       e.key.id == key.id;
+        }
+
+        static uint32_t
+        hash(const RequestKey& key) {
+                uint64_t h = ((uint64_t)key.client << 32 | key.server) * 0x9e3779b97f4a7c15ULL;
+
+                h ^= ((uint64_t)key.port << 16 | key.id) * 0xc2b2ae3d27d4eb4fULL;
+                return (uint32_t)(h >> 32) ^ (uint32_t)h;
+        }
+};
+
+#endif  // _NFD_REQUEST_TABLE_H_
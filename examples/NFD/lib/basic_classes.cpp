@@ -65,6 +65,32 @@ IP::IP(int ip, int raw_mask) {
         return;
 }
 
+bool
+parse_prefix(const char* str, IP* ip) {
+        char addr[INET_ADDRSTRLEN];
+        const char* slash = strchr(str, '/');
+        size_t len = slash == NULL ? strlen(str) : (size_t)(slash - str);
+        struct in_addr in;
+        char* end;
+        long bits = 32;
+
+        if (len >= sizeof(addr))
+                return false;
+        memcpy(addr, str, len);
+        addr[len] = '\0';
+        if (inet_pton(AF_INET, addr, &in) != 1)
+                return false;
+        if (slash != NULL) {
+                bits = strtol(slash + 1, &end, 10);
+                if (*(slash + 1) == '\0' || *end != '\0' || bits < 0 || bits > 32)
+                        return false;
+        }
+
+        ip->ip = ntohl(in.s_addr);
+        ip->mask = bits == 0 ? 0 : UINT32_MAX << (32 - bits);
+        return true;
+}
+
 char*
 IP::showAddr() {
         struct in_addr ip_addr;
@@ -102,11 +128,26 @@ Flow::Flow(int* tag) {
         this->headers[Iplen] = new int(0);
 }
 
+unordered_map<string, int> F_Type::MAP = unordered_map<string, int>();
+unordered_map<string, int> F_Type::MAP2 = unordered_map<string, int>();
+
+/* model field names that live in headers[] */
+static const unordered_map<string, int> FIELD_HEADER = {
+        {"iplen", Iplen},   {"sport", Sport},       {"dport", Dport},       {"TCP", Tcp},
+        {"UDP", Udp},       {"flag_fin", Fin},      {"flag_syn", Syn},      {"flag_ack", Ack},
+        {"proto", Proto},   {"dns_id", DnsId},      {"sip", Sip},           {"dip", Dip},
+        {"tag", Tag}};
+
 void*& Flow::operator[](const string& field) {
+        auto h = FIELD_HEADER.find(field);
+        if (h != FIELD_HEADER.end())
+                return this->headers[h->second];
         unordered_map<string, void*>::iterator it = field_value.find(field);
         if (it == field_value.end()) {
+                if (q == NULL)
+                        q = new string("error");
                 ERROR_HANDLE("field " + field + " not in flow, now create a new entry, its tag is " +
-                             to_string(*((int*)this->field_value["tag"])));
+                             to_string(*((int*)this->headers[Tag])));
                 // void * q = new string("error");
                 Flow::field_value[field] = q;
                 return q;
@@ -114,6 +155,38 @@ void*& Flow::operator[](const string& field) {
         return it->second;
 }
 
+/* clean writes the addresses and ports a model changed back into the packet */
+void
+Flow::clean() {
+        int ethernet_header_length = 14;
+        uint32_t sip, dip;
+        u_short sport, dport;
+
+        if (this->pkt == NULL)
+                return;
+
+        EtherHdr* e_hdr = (EtherHdr*)this->pkt;
+        if (ntohs(e_hdr->ether_type) == 0x8100)
+                ethernet_header_length = 14 + 4;
+        IPHdr* ip_hdr = (IPHdr*)(this->pkt + ethernet_header_length);
+
+        sip = htonl(((IP*)this->headers[Sip])->ip);
+        dip = htonl(((IP*)this->headers[Dip])->ip);
+        if (ip_hdr->ip_src.s_addr != sip)
+                ip_hdr->ip_src.s_addr = sip;
+        if (ip_hdr->ip_dst.s_addr != dip)
+                ip_hdr->ip_dst.s_addr = dip;
+
+        int ip_header_length = (*(this->pkt + ethernet_header_length) & 0x0F) * 4;
+        TCPHdr* tcph = (TCPHdr*)(this->pkt + ethernet_header_length + ip_header_length);
+        sport = htons(u_short(*((int*)this->headers[Sport])));
+        dport = htons(u_short(*((int*)this->headers[Dport])));
+        if (tcph->th_sport != sport)
+                tcph->th_sport = sport;
+        if (tcph->th_dport != dport)
+                tcph->th_dport = dport;
+}
+
 int
 Flow::matches(const string& field, const void* p) {
         if ((*this)[field] != NULL) {
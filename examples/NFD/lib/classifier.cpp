@@ -0,0 +1,335 @@
+/**********************************************************************************
+                           NFD project
+   A C++ based NF developing framework designed by Wenfei's group
+   from IIIS, Tsinghua University, China.
+******************************************************************************/
+
+/************************************************************************************
+* Filename:   classifier.cpp
+* Copyright:
+* Disclaimer: This code is presented "as is" without any guarantees.
+* Details:    Rule parsing and the compiled classifier for stateless NFD models,
+              see classifier.h.
+*************************************************************************************/
+
+#include "classifier.h"
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+
+/* packets classified per pass, bounds the scratch arrays of classify_burst */
+#define CLASSIFY_CHUNK 32
+
+static bool
+parse_port_range(const string& text, int* lo, int* hi) {
+        const char* str = text.c_str();
+        char* end;
+        long a, b;
+
+        a = strtol(str, &end, 10);
+        if (end == str)
+                return false;
+        b = a;
+        if (*end == '-') {
+                str = end + 1;
+                b = strtol(str, &end, 10);
+                if (end == str)
+                        return false;
+        }
+        if (*end != '\0' || a < 0 || b > 65535 || a > b)
+                return false;
+
+        *lo = (int)a;
+        *hi = (int)b;
+        return true;
+}
+
+static bool
+parse_proto(const string& text, int* proto) {
+        char* end;
+        long p;
+
+        if (text == "tcp") {
+                *proto = IPPROTO_TCP;
+        } else if (text == "udp") {
+                *proto = IPPROTO_UDP;
+        } else if (text == "icmp") {
+                *proto = IPPROTO_ICMP;
+        } else {
+                p = strtol(text.c_str(), &end, 10);
+                if (text.empty() || *end != '\0' || p < 0 || p > 255)
+                        return false;
+                *proto = (int)p;
+        }
+        return true;
+}
+
+bool
+parse_rule(const string& text, Rule* rule) {
+        istringstream in(text);
+        vector<string> tokens;
+        string token;
+        size_t i;
+
+        *rule = Rule();
+        while (in >> token)
+                tokens.push_back(token);
+        if (tokens.size() == 1)
+                return parse_prefix(tokens[0].c_str(), &rule->sip);
+        if (tokens.empty())
+                return false;
+
+        for (i = 0; i + 1 < tokens.size(); i += 2) {
+                const string& field = tokens[i];
+                const string& value = tokens[i + 1];
+                bool ok;
+
+                if (field == "sip")
+                        ok = parse_prefix(value.c_str(), &rule->sip);
+                else if (field == "dip")
+                        ok = parse_prefix(value.c_str(), &rule->dip);
+                else if (field == "proto")
+                        ok = parse_proto(value, &rule->proto);
+                else if (field == "dport")
+                        ok = parse_port_range(value, &rule->dport_lo, &rule->dport_hi);
+                else
+                        ok = false;
+                if (!ok)
+                        return false;
+        }
+
+        /* the verdict closes the rule */
+        if (i + 1 != tokens.size())
+                return false;
+        if (tokens[i] == "allow" || tokens[i] == "pass")
+                rule->verdict = RULE_PASS;
+        else if (tokens[i] == "drop")
+                rule->verdict = RULE_DROP;
+        else
+                return false;
+        return true;
+}
+
+uint32_t
+Classifier::intern(Classes& c, const vector<uint64_t>& bits) {
+        auto it = c.ids.find(bits);
+        uint32_t id;
+        int w;
+
+        if (it != c.ids.end())
+                return it->second;
+
+        id = c.ids.size();
+        c.ids[bits] = id;
+        for (w = 0; w < this->nsummary; w++)
+                c.words.push_back(0);
+        for (w = 0; w < this->nwords; w++) {
+                c.words.push_back(bits[w]);
+                if (bits[w] != 0)
+                        c.words[(size_t)id * (this->nsummary + this->nwords) + w / 64] |= 1ULL << (w % 64);
+        }
+        return id;
+}
+
+uint32_t
+Classifier::add_rule(Classes& c, uint32_t cls, int rule) {
+        pair<uint32_t, int> key(cls, rule);
+        auto it = c.added.find(key);
+        vector<uint64_t> bits;
+        const uint64_t* words;
+        uint32_t id;
+
+        if (it != c.added.end())
+                return it->second;
+
+        words = &c.words[(size_t)cls * (this->nsummary + this->nwords) + this->nsummary];
+        bits.assign(words, words + this->nwords);
+        bits[rule / 64] |= 1ULL << (rule % 64);
+        id = intern(c, bits);
+        c.added[key] = id;
+        return id;
+}
+
+/*
+ * Add rule to every leaf the prefix covers, expanding the trie one level
+ * per 8 bits of prefix. Prefixes are inserted shortest first, so a new
+ * node starts from the class of the slot it replaces.
+ */
+void
+Classifier::insert_prefix(int field, const IP& prefix, int rule) {
+        vector<Slot>& t = this->trie[field];
+        int len = __builtin_popcount(prefix.mask);
+        uint32_t addr = prefix.ip & prefix.mask;
+        vector<int32_t> stack;
+        int32_t node = 0;
+        int depth = 0;
+        int first, count, i;
+
+        while (len > 8 * (depth + 1)) {
+                size_t s = ((size_t)node << 8) + ((addr >> (24 - 8 * depth)) & 0xff);
+                if (t[s].child < 0) {
+                        int32_t child = t.size() >> 8;
+                        Slot fill = {-1, t[s].cls};
+                        t.insert(t.end(), 256, fill);
+                        t[s].child = child;
+                }
+                node = t[s].child;
+                depth++;
+        }
+
+        first = (addr >> (24 - 8 * depth)) & 0xff & ~((1 << (8 * (depth + 1) - len)) - 1);
+        count = 1 << (8 * (depth + 1) - len);
+        for (i = first; i < first + count; i++) {
+                size_t s = ((size_t)node << 8) + i;
+                if (t[s].child < 0)
+                        t[s].cls = add_rule(this->classes[field], t[s].cls, rule);
+                else
+                        stack.push_back(t[s].child);
+        }
+        /* longer prefixes already below this one, only when inserted out of order */
+        while (!stack.empty()) {
+                node = stack.back();
+                stack.pop_back();
+                for (i = 0; i < 256; i++) {
+                        size_t s = ((size_t)node << 8) + i;
+                        if (t[s].child < 0)
+                                t[s].cls = add_rule(this->classes[field], t[s].cls, rule);
+                        else
+                                stack.push_back(t[s].child);
+                }
+        }
+}
+
+/*
+ * Fill a value table from one [lo, hi] range per rule. Values between two
+ * range ends match the same rules, so one class is interned per interval.
+ */
+void
+Classifier::build_range(int field, vector<uint32_t>& table, const vector<pair<int, int>>& ranges) {
+        vector<pair<int, int>> events; /* (value, rule + 1 to add or -(rule + 1) to remove) */
+        vector<uint64_t> active(this->nwords, 0);
+        size_t e = 0;
+        int value, next, rule;
+        uint32_t cls;
+
+        for (rule = 0; rule < (int)ranges.size(); rule++) {
+                events.push_back(make_pair(ranges[rule].first, rule + 1));
+                events.push_back(make_pair(ranges[rule].second + 1, -(rule + 1)));
+        }
+        sort(events.begin(), events.end());
+
+        for (value = 0; value < (int)table.size(); value = next) {
+                for (; e < events.size() && events[e].first == value; e++) {
+                        rule = abs(events[e].second) - 1;
+                        if (events[e].second > 0)
+                                active[rule / 64] |= 1ULL << (rule % 64);
+                        else
+                                active[rule / 64] &= ~(1ULL << (rule % 64));
+                }
+                next = e < events.size() ? min(events[e].first, (int)table.size()) : table.size();
+                cls = intern(this->classes[field], active);
+                fill(table.begin() + value, table.begin() + next, cls);
+        }
+}
+
+void
+Classifier::build(const vector<Rule>& rules, int default_verdict) {
+        vector<pair<int, int>> protos, dports;
+        vector<int> order;
+        int f, i;
+
+        this->default_verdict = default_verdict;
+        this->verdicts.clear();
+        this->nwords = rules.empty() ? 1 : (rules.size() + 63) / 64;
+        this->nsummary = (this->nwords + 63) / 64;
+        for (f = 0; f < FIELDS; f++) {
+                this->classes[f] = Classes();
+                intern(this->classes[f], vector<uint64_t>(this->nwords, 0));
+        }
+
+        for (i = 0; i < (int)rules.size(); i++) {
+                this->verdicts.push_back(rules[i].verdict);
+                if (rules[i].proto == RULE_ANY_PROTO)
+                        protos.push_back(make_pair(0, 255));
+                else
+                        protos.push_back(make_pair(rules[i].proto, rules[i].proto));
+                dports.push_back(make_pair(rules[i].dport_lo, rules[i].dport_hi));
+        }
+
+        for (f = SIP; f <= DIP; f++) {
+                Slot empty = {-1, 0};
+                this->trie[f].assign(256, empty);
+                order.clear();
+                for (i = 0; i < (int)rules.size(); i++)
+                        order.push_back(i);
+                stable_sort(order.begin(), order.end(), [&](int a, int b) {
+                        const IP& pa = f == SIP ? rules[a].sip : rules[a].dip;
+                        const IP& pb = f == SIP ? rules[b].sip : rules[b].dip;
+                        return __builtin_popcount(pa.mask) < __builtin_popcount(pb.mask);
+                });
+                for (i = 0; i < (int)order.size(); i++)
+                        insert_prefix(f, f == SIP ? rules[order[i]].sip : rules[order[i]].dip, order[i]);
+        }
+
+        this->proto_cls.assign(256, 0);
+        build_range(PROTO, this->proto_cls, protos);
+        this->dport_cls.assign(65536, 0);
+        build_range(DPORT, this->dport_cls, dports);
+
+        /* the build maps are not needed for lookups */
+        for (f = 0; f < FIELDS; f++) {
+                map<vector<uint64_t>, uint32_t>().swap(this->classes[f].ids);
+                map<pair<uint32_t, int>, uint32_t>().swap(this->classes[f].added);
+        }
+}
+
+/*
+ * Two passes per chunk: first every field lookup, prefetching the class
+ * vectors they return, then the intersections. The summary words are ANDed
+ * first so only vector words that can hold a common rule are read, and the
+ * lowest common bit is the first matching rule.
+ */
+void
+Classifier::classify_burst(const Key* keys, int n, int* verdicts) const {
+        const uint64_t* vec[CLASSIFY_CHUNK][FIELDS];
+        int base, i, f, s;
+
+        for (base = 0; base < n; base += CLASSIFY_CHUNK) {
+                int count = min(n - base, CLASSIFY_CHUNK);
+
+                for (i = 0; i < count; i++) {
+                        const Key& k = keys[base + i];
+                        vec[i][SIP] = class_words(SIP, lookup_prefix(SIP, k.sip));
+                        vec[i][DIP] = class_words(DIP, lookup_prefix(DIP, k.dip));
+                        vec[i][PROTO] = class_words(PROTO, this->proto_cls[k.proto]);
+                        vec[i][DPORT] = class_words(DPORT, this->dport_cls[k.dport]);
+                        for (f = 0; f < FIELDS; f++)
+                                __builtin_prefetch(vec[i][f]);
+                }
+
+                for (i = 0; i < count; i++) {
+                        const uint64_t** v = vec[i];
+                        int verdict = this->default_verdict;
+
+                        for (s = 0; s < this->nsummary; s++) {
+                                uint64_t sum = v[SIP][s] & v[DIP][s] & v[PROTO][s] & v[DPORT][s];
+                                while (sum != 0) {
+                                        int w = this->nsummary + s * 64 + __builtin_ctzll(sum);
+                                        uint64_t hit = v[SIP][w] & v[DIP][w] & v[PROTO][w] & v[DPORT][w];
+                                        if (hit != 0) {
+                                                verdict = this->verdicts[(w - this->nsummary) * 64 +
+                                                                         __builtin_ctzll(hit)];
+                                                goto found;
+                                        }
+                                        sum &= sum - 1;
+                                }
+                        }
+                found:
+                        verdicts[base + i] = verdict;
+                }
+        }
+}
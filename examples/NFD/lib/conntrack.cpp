@@ -0,0 +1,484 @@
+/**********************************************************************************
+                           NFD project
+   A C++ based NF developing framework designed by Wenfei's group
+   from IIIS, Tsinghua University, China.
+******************************************************************************/
+
+/************************************************************************************
+* Filename:   conntrack.cpp
+* Copyright:
+* Disclaimer: This code is presented "as is" without any guarantees.
+* Details:    Connection tracking engine, see conntrack.h. The TCP window checks
+              follow Rooij's "Real stateful TCP packet filtering in IP Filter" as
+              the Linux and BSD trackers do.
+*************************************************************************************/
+
+#include "conntrack.h"
+#include <netinet/in.h>
+#include <new>
+
+using namespace std;
+
+#define TCP_FIN 0x01
+#define TCP_SYN 0x02
+#define TCP_RST 0x04
+#define TCP_ACK 0x10
+
+/* Conn::flags */
+#define CONN_SYNACK 0x01   /* the responder answered the SYN */
+#define CONN_SCALE 0x02    /* both sides sent a window scale option */
+#define CONN_FIN(dir) (0x04 << (dir))
+
+/* packets per pass of lookup_burst */
+#define LOOKUP_CHUNK 32
+
+/* sequence number comparison modulo 2^32 */
+static inline bool
+seq_before(uint32_t a, uint32_t b) {
+        return (int32_t)(a - b) < 0;
+}
+
+ConnTrack::ConnTrack() {
+        int s;
+
+        for (s = 0; s < CONNTRACK_WHEEL; s++)
+                this->wheel[s] = CONNTRACK_NIL;
+        for (s = 0; s < STATES; s++)
+                this->timeouts[0][s] = this->timeouts[1][s] = 0;
+        this->timeouts[1][NEW] = 30;
+        this->timeouts[1][ESTABLISHED] = 3600;
+        this->timeouts[1][FIN_WAIT] = 120;
+        this->timeouts[1][CLOSED] = 10;
+        this->timeouts[0][NEW] = 30;
+        this->timeouts[0][ESTABLISHED] = 180;
+}
+
+bool
+ConnTrack::init(uint32_t capacity, uint32_t now) {
+        uint32_t n = 1, i;
+
+        if (capacity == 0)
+                return false;
+        /* twice as many index entries as connections keeps buckets from filling */
+        while (n * CONNTRACK_WAYS < 2 * capacity)
+                n <<= 1;
+        /* a failed resize keeps the current connections */
+        try {
+                Bucket empty = {};
+                vector<Conn> pool(capacity, Conn());
+                vector<Bucket> index(n, empty);
+                this->pool.swap(pool);
+                this->index.swap(index);
+        } catch (const bad_alloc&) {
+                return false;
+        }
+
+        this->mask = n - 1;
+        for (i = 0; i < capacity; i++) {
+                this->pool[i].state = NONE;
+                this->pool[i].next = i + 1 < capacity ? i + 1 : CONNTRACK_NIL;
+        }
+        this->free_list = 0;
+        this->used = 0;
+        for (i = 0; i < CONNTRACK_WHEEL; i++)
+                this->wheel[i] = CONNTRACK_NIL;
+        this->tick = now;
+        return true;
+}
+
+void
+ConnTrack::set_timeout(bool tcp, State state, uint32_t seconds) {
+        if (seconds == 0)
+                seconds = 1;
+        this->timeouts[tcp][state] = seconds;
+}
+
+/* both directions of a connection hash alike */
+uint64_t
+ConnTrack::hash(const ConnTuple& t) {
+        uint64_t a = (uint64_t)t.sip << 16 | t.sport;
+        uint64_t b = (uint64_t)t.dip << 16 | t.dport;
+        uint64_t h;
+
+        if (a > b) {
+                uint64_t x = a;
+                a = b;
+                b = x;
+        }
+        h = a * 0x9e3779b97f4a7c15ULL ^ b * 0xc2b2ae3d27d4eb4fULL ^ t.proto;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+}
+
+/* whether t is a packet of the connection c in direction dir */
+static inline bool
+in_direction(const ConnTuple& c, const ConnTuple& t, int dir) {
+        if (dir == 0)
+                return c.sip == t.sip && c.dip == t.dip && c.sport == t.sport && c.dport == t.dport && c.proto == t.proto;
+        return c.sip == t.dip && c.dip == t.sip && c.sport == t.dport && c.dport == t.sport && c.proto == t.proto;
+}
+
+static inline uint32_t
+signature(uint64_t h) {
+        return (uint32_t)(h >> 32) | 1;
+}
+
+static inline uint32_t
+other_bucket(uint64_t h) {
+        return (uint32_t)(h >> 44) ^ (uint32_t)h * 0x5bd1e995;
+}
+
+ConnRef
+ConnTrack::find(const ConnTuple& t, uint64_t h) const {
+        uint32_t sig = signature(h);
+        uint32_t b[2] = {(uint32_t)h & this->mask, other_bucket(h) & this->mask};
+        ConnRef ref = {CONNTRACK_NIL, 0};
+        int i, w;
+
+        for (i = 0; i < 2; i++) {
+                const Bucket& bucket = this->index[b[i]];
+                for (w = 0; w < CONNTRACK_WAYS; w++) {
+                        if (bucket.sig[w] != sig)
+                                continue;
+                        const ConnTuple& c = this->pool[bucket.id[w]].t;
+                        if (in_direction(c, t, 0) || in_direction(c, t, 1)) {
+                                ref.id = bucket.id[w];
+                                ref.dir = !in_direction(c, t, 0);
+                                return ref;
+                        }
+                }
+        }
+        return ref;
+}
+
+ConnRef
+ConnTrack::lookup(const ConnTuple& t) const {
+        if (this->pool.empty()) {
+                ConnRef none = {CONNTRACK_NIL, 0};
+                return none;
+        }
+        return find(t, hash(t));
+}
+
+void
+ConnTrack::lookup_burst(const ConnPacket* pkts, int n, ConnRef* refs) {
+        uint64_t h[LOOKUP_CHUNK];
+        int base, i, count;
+
+        this->opened = 0;
+        for (base = 0; base < n; base += LOOKUP_CHUNK) {
+                count = n - base < LOOKUP_CHUNK ? n - base : LOOKUP_CHUNK;
+                if (this->pool.empty()) {
+                        for (i = 0; i < count; i++)
+                                refs[base + i] = lookup(pkts[base + i].t);
+                        continue;
+                }
+                for (i = 0; i < count; i++) {
+                        h[i] = hash(pkts[base + i].t);
+                        __builtin_prefetch(&this->index[(uint32_t)h[i] & this->mask]);
+                        __builtin_prefetch(&this->index[other_bucket(h[i]) & this->mask]);
+                }
+                for (i = 0; i < count; i++)
+                        refs[base + i] = find(pkts[base + i].t, h[i]);
+        }
+}
+
+void
+ConnTrack::link(uint32_t id, uint32_t timer) {
+        Conn& c = this->pool[id];
+        uint32_t* head = &this->wheel[timer % CONNTRACK_WHEEL];
+
+        c.timer = timer;
+        c.prev = CONNTRACK_NIL;
+        c.next = *head;
+        if (*head != CONNTRACK_NIL)
+                this->pool[*head].prev = id;
+        *head = id;
+}
+
+void
+ConnTrack::unlink(uint32_t id) {
+        Conn& c = this->pool[id];
+
+        if (c.prev != CONNTRACK_NIL)
+                this->pool[c.prev].next = c.next;
+        else
+                this->wheel[c.timer % CONNTRACK_WHEEL] = c.next;
+        if (c.next != CONNTRACK_NIL)
+                this->pool[c.next].prev = c.prev;
+}
+
+/*
+ * Push the expiry out by the timeout of the connection's state. The wheel
+ * link only moves when the expiry comes earlier than the slot it is in,
+ * later expiries are picked up when the slot fires.
+ */
+void
+ConnTrack::refresh(uint32_t id, uint32_t now) {
+        Conn& c = this->pool[id];
+
+        c.expire = now + this->timeouts[c.t.proto == IPPROTO_TCP][c.state];
+        if (seq_before(c.expire, c.timer)) {
+                unlink(id);
+                link(id, c.expire);
+        }
+}
+
+bool
+ConnTrack::unindex(uint32_t id) {
+        uint64_t h = hash(this->pool[id].t);
+        uint32_t b[2] = {(uint32_t)h & this->mask, other_bucket(h) & this->mask};
+        int i, w;
+
+        for (i = 0; i < 2; i++) {
+                Bucket& bucket = this->index[b[i]];
+                for (w = 0; w < CONNTRACK_WAYS; w++) {
+                        if (bucket.sig[w] != 0 && bucket.id[w] == id) {
+                                bucket.sig[w] = 0;
+                                return true;
+                        }
+                }
+        }
+        return false;
+}
+
+/* return a connection that is off the wheel to the pool */
+void
+ConnTrack::drop(uint32_t id) {
+        Conn& c = this->pool[id];
+
+        unindex(id);
+        c.state = NONE;
+        c.next = this->free_list;
+        this->free_list = id;
+        this->used--;
+}
+
+void
+ConnTrack::release(uint32_t id) {
+        unlink(id);
+        drop(id);
+}
+
+/*
+ * Take a pool entry and an index slot in one of the tuple's two buckets,
+ * the emptier one. When either runs out, a connection that never got
+ * established is dropped from those buckets to make room.
+ */
+uint32_t
+ConnTrack::open(const ConnPacket& p, uint32_t now) {
+        uint64_t h = hash(p.t);
+        uint32_t b[2] = {(uint32_t)h & this->mask, other_bucket(h) & this->mask};
+        int slot[2] = {-1, -1}, load[2] = {0, 0};
+        uint32_t id;
+        int i, w, pick;
+
+        for (i = 0; i < 2; i++) {
+                for (w = 0; w < CONNTRACK_WAYS; w++) {
+                        if (this->index[b[i]].sig[w] == 0)
+                                slot[i] = w;
+                        else
+                                load[i]++;
+                }
+        }
+
+        if (this->free_list == CONNTRACK_NIL || (slot[0] < 0 && slot[1] < 0)) {
+                /* one release frees both a pool entry and a slot in b[i] */
+                for (i = 0; i < 2; i++) {
+                        Bucket& bucket = this->index[b[i]];
+                        for (w = 0; w < CONNTRACK_WAYS; w++) {
+                                if (bucket.sig[w] != 0 && (this->pool[bucket.id[w]].state == NEW ||
+                                                           this->pool[bucket.id[w]].state == CLOSED))
+                                        break;
+                        }
+                        if (w < CONNTRACK_WAYS) {
+                                release(bucket.id[w]);
+                                this->early_drops++;
+                                slot[i] = w;
+                                load[i]--;
+                                break;
+                        }
+                }
+                if (i == 2) {
+                        this->full++;
+                        return CONNTRACK_NIL;
+                }
+        }
+
+        pick = slot[0] < 0 ? 1 : (slot[1] < 0 ? 0 : (load[1] < load[0] ? 1 : 0));
+        id = this->free_list;
+        this->free_list = this->pool[id].next;
+        this->used++;
+        this->index[b[pick]].sig[slot[pick]] = signature(h);
+        this->index[b[pick]].id[slot[pick]] = id;
+
+        Conn& c = this->pool[id];
+        c = Conn();
+        c.t = p.t;
+        c.state = NEW;
+        c.expire = now + this->timeouts[p.t.proto == IPPROTO_TCP][NEW];
+        link(id, c.expire);
+        return id;
+}
+
+static inline void
+window_init(uint32_t* end, uint32_t* maxend, uint32_t* maxwin, const ConnPacket& p, uint32_t seq_end) {
+        *end = seq_end;
+        *maxend = seq_end;
+        *maxwin = p.win == 0 ? 1 : p.win;
+}
+
+ConnTrack::Result
+ConnTrack::track_tcp(Conn& c, int dir, const ConnPacket& p, uint32_t now) {
+        Window& s = c.dir[dir];
+        Window& r = c.dir[!dir];
+        uint8_t fl = p.tcp_flags;
+        uint32_t end = p.seq + p.len + ((fl & TCP_SYN) ? 1 : 0) + ((fl & TCP_FIN) ? 1 : 0);
+        uint32_t win;
+
+        /* a new SYN on a closed connection reuses it */
+        if (c.state == CLOSED && dir == 0 && (fl & (TCP_SYN | TCP_ACK | TCP_RST)) == TCP_SYN) {
+                c.state = NEW;
+                c.flags = 0;
+                c.dir[1] = Window();
+                window_init(&s.end, &s.maxend, &s.maxwin, p, end);
+                s.wscale = p.wscale;
+                refresh(&c - &this->pool[0], now);
+                return CT_TRACKED;
+        }
+
+        if (c.state == NEW) {
+                if (dir == 1 && (fl & (TCP_SYN | TCP_ACK)) == (TCP_SYN | TCP_ACK) && !(c.flags & CONN_SYNACK)) {
+                        if (p.ack != r.end)
+                                return CT_INVALID;
+                        c.flags |= CONN_SYNACK;
+                        if (p.wscale >= 0 && r.wscale >= 0)
+                                c.flags |= CONN_SCALE;
+                        window_init(&s.end, &s.maxend, &s.maxwin, p, end);
+                        s.wscale = p.wscale;
+                        r.maxend = p.ack + s.maxwin;
+                        return CT_TRACKED;
+                }
+                if (dir == 1 && !(c.flags & CONN_SYNACK) && !(fl & TCP_RST))
+                        return CT_INVALID;
+        } else if ((fl & (TCP_SYN | TCP_ACK)) == TCP_SYN) {
+                return CT_INVALID;
+        }
+
+        /* the window checks need both sides */
+        if (s.maxwin != 0 && r.maxwin != 0) {
+                if (seq_before(s.maxend, p.seq) || seq_before(end, s.end - r.maxwin))
+                        return CT_INVALID;
+                win = p.win;
+                if ((c.flags & CONN_SCALE) && !(fl & TCP_SYN))
+                        win <<= s.wscale;
+                if (seq_before(s.end, end))
+                        s.end = end;
+                if (win > s.maxwin)
+                        s.maxwin = win;
+                if ((fl & TCP_ACK) && seq_before(r.maxend, p.ack + win))
+                        r.maxend = p.ack + win;
+        }
+
+        if (fl & TCP_RST) {
+                release(&c - &this->pool[0]);
+                return CT_TRACKED;
+        }
+
+        switch (c.state) {
+                case NEW:
+                        if (dir == 0 && (fl & TCP_ACK) && (c.flags & CONN_SYNACK))
+                                c.state = ESTABLISHED;
+                        break;
+                case ESTABLISHED:
+                        if (fl & TCP_FIN) {
+                                c.flags |= CONN_FIN(dir);
+                                c.state = FIN_WAIT;
+                        }
+                        break;
+                case FIN_WAIT:
+                        if (fl & TCP_FIN)
+                                c.flags |= CONN_FIN(dir);
+                        else if ((c.flags & CONN_FIN(0)) && (c.flags & CONN_FIN(1)) && (fl & TCP_ACK))
+                                c.state = CLOSED;
+                        break;
+        }
+        refresh(&c - &this->pool[0], now);
+        return CT_TRACKED;
+}
+
+ConnTrack::Result
+ConnTrack::track(const ConnPacket& p, ConnRef& ref, bool create, uint32_t now) {
+        bool tcp = p.t.proto == IPPROTO_TCP;
+        Conn* c;
+
+        if (this->pool.empty())
+                return CT_UNTRACKED;
+
+        /* an earlier packet of the burst may have closed or replaced the connection */
+        if (ref.id != CONNTRACK_NIL) {
+                c = &this->pool[ref.id];
+                if (c->state == NONE || !in_direction(c->t, p.t, ref.dir))
+                        ref = lookup(p.t);
+        }
+        /* refs of the burst predate the connections its earlier packets opened */
+        if (ref.id == CONNTRACK_NIL && this->opened != 0)
+                ref = lookup(p.t);
+
+        if (ref.id == CONNTRACK_NIL) {
+                if (!create || (tcp && (p.tcp_flags & (TCP_SYN | TCP_ACK | TCP_RST)) != TCP_SYN))
+                        return CT_UNTRACKED;
+                ref.id = open(p, now);
+                ref.dir = 0;
+                if (ref.id == CONNTRACK_NIL)
+                        return CT_UNTRACKED;
+                this->opened++;
+                c = &this->pool[ref.id];
+                if (tcp) {
+                        window_init(&c->dir[0].end, &c->dir[0].maxend, &c->dir[0].maxwin, p,
+                                    p.seq + p.len + 1);
+                        c->dir[0].wscale = p.wscale;
+                }
+                return CT_TRACKED;
+        }
+
+        c = &this->pool[ref.id];
+        if (tcp)
+                return track_tcp(*c, ref.dir, p, now);
+
+        if (ref.dir == 1 && c->state == NEW)
+                c->state = ESTABLISHED;
+        refresh(ref.id, now);
+        return CT_TRACKED;
+}
+
+/*
+ * Fire the wheel slots from the last tick up to now, or every slot once
+ * after a pause of a whole turn. A connection whose expiry moved out is
+ * relinked at its new expiry, the rest are released. A relinked
+ * connection may land in a slot still to fire in this call, it is then
+ * relinked once more.
+ */
+void
+ConnTrack::expire(uint32_t now) {
+        uint32_t t, n, id, next;
+
+        if (this->pool.empty() || !seq_before(this->tick, now))
+                return;
+        n = now - this->tick < CONNTRACK_WHEEL ? now - this->tick : CONNTRACK_WHEEL;
+        for (t = now - n + 1; n > 0; t++, n--) {
+                id = this->wheel[t % CONNTRACK_WHEEL];
+                this->wheel[t % CONNTRACK_WHEEL] = CONNTRACK_NIL;
+                for (; id != CONNTRACK_NIL; id = next) {
+                        Conn& c = this->pool[id];
+                        next = c.next;
+                        if (seq_before(now, c.expire))
+                                link(id, c.expire);
+                        else
+                                drop(id);
+                }
+        }
+        this->tick = now;
+}
@@ -0,0 +1 @@
+../go.sh
\ No newline at end of file
@@ -0,0 +1,195 @@
+/*********************************************************************
+ *                     openNetVM
+ *              https://sdnfv.github.io
+ *
+ *   BSD LICENSE
+ *
+ *   Copyright(c)
+ *            2015-2017 George Washington University
+ *            2015-2017 University of California Riverside
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * The name of the author may not be used to endorse or promote
+ *       products derived from this software without specific prior
+ *       written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ********************************************************************/
+
+/************************************************************************************
+* Filename:   nfd_config.cpp
+* Copyright:
+* Disclaimer: This code is presented "as is" without any guarantees.
+* Details:    Sends a JSON config update to a running NFD NF and exits. The file
+              is parsed here first, so a syntax error never reaches the target.
+*************************************************************************************/
+
+#include <ctype.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "onvm_config_common.h"
+#include "onvm_sc_common.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "nfd_msg.h"
+
+#define NF_TAG "nfd_config"
+
+/* service ID of the NFD NF to update */
+static int dest = -1;
+/* JSON file holding the update */
+static const char* config_file = NULL;
+
+/*
+ * Print a usage message
+ */
+static void
+usage(const char* progname) {
+        printf("Usage: %s [EAL args] -- [NF_LIB args] -- -d <destination> -c <config.json>\n\n", progname);
+        printf("Flags:\n");
+        printf(" - `-d <dst>`: service ID of the NFD NF to update\n");
+        printf(" - `-c <file>`: JSON object keyed by parameter name, as taken by the NF's own -c\n");
+}
+
+/*
+ * Parse the application arguments.
+ */
+static int
+parse_app_args(int argc, char* argv[], const char* progname) {
+        int c;
+
+        while ((c = getopt(argc, argv, "d:c:")) != -1) {
+                switch (c) {
+                        case 'd':
+                                dest = strtoul(optarg, NULL, 10);
+                                break;
+                        case 'c':
+                                config_file = optarg;
+                                break;
+                        case '?':
+                                usage(progname);
+                                if (optopt == 'd' || optopt == 'c')
+                                        RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
+                                else if (isprint(optopt))
+                                        RTE_LOG(INFO, APP, "Unknown option `-%c'.\n", optopt);
+                                else
+                                        RTE_LOG(INFO, APP, "Unknown option character `\\x%x'.\n", optopt);
+                                return -1;
+                        default:
+                                usage(progname);
+                                return -1;
+                }
+        }
+
+        if (dest < 0 || dest >= MAX_SERVICES || config_file == NULL) {
+                usage(progname);
+                return -1;
+        }
+        return optind;
+}
+
+/*
+ * Load the update and send it to the target NF.
+ *
+ * Output : 0 on success, -1 otherwise
+ */
+static int
+send_config(void) {
+        cJSON* json;
+        char* text;
+        int ret;
+
+        json = onvm_config_parse_file(config_file);
+        if (json == NULL) {
+                RTE_LOG(INFO, APP, "Could not parse %s\n", config_file);
+                return -1;
+        }
+        text = cJSON_PrintUnformatted(json);
+        cJSON_Delete(json);
+        if (text == NULL)
+                return -1;
+
+        /* the message channel does not check that the service has an NF */
+        if (onvm_sc_service_to_nf_map(dest, NULL) == 0) {
+                RTE_LOG(INFO, APP, "No NF is running with service ID %d\n", dest);
+                free(text);
+                return -1;
+        }
+
+        ret = nfd_send_config(dest, text);
+        free(text);
+        if (ret < 0) {
+                RTE_LOG(INFO, APP, "Could not send the update to service %d: %d\n", dest, ret);
+                return -1;
+        }
+
+        printf("Sent %s to %d instance(s) of service %d\n", config_file, ret, dest);
+        return 0;
+}
+
+int
+main(int argc, char* argv[]) {
+        struct onvm_nf_local_ctx* nf_local_ctx;
+        struct onvm_nf_function_table* nf_function_table;
+        int arg_offset;
+        int ret;
+
+        const char* progname = argv[0];
+
+        nf_local_ctx = onvm_nflib_init_nf_local_ctx();
+        onvm_nflib_start_signal_handler(nf_local_ctx, NULL);
+
+        nf_function_table = onvm_nflib_init_nf_function_table();
+
+        if ((arg_offset = onvm_nflib_init(argc, argv, NF_TAG, nf_local_ctx, nf_function_table)) < 0) {
+                onvm_nflib_stop(nf_local_ctx);
+                if (arg_offset == ONVM_SIGNAL_TERMINATION) {
+                        printf("Exiting due to user termination\n");
+                        return 0;
+                } else {
+                        rte_exit(EXIT_FAILURE, "Failed ONVM init\n");
+                }
+        }
+
+        argc -= arg_offset;
+        argv += arg_offset;
+
+        if (parse_app_args(argc, argv, progname) < 0) {
+                onvm_nflib_stop(nf_local_ctx);
+                rte_exit(EXIT_FAILURE, "Invalid command-line arguments\n");
+        }
+
+        ret = send_config();
+        onvm_nflib_stop(nf_local_ctx);
+
+        return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -46,287 +46,130 @@
               from IIIS, Tsinghua University, China.
 *************************************************************************************/
 
-#include <errno.h>
-#include <getopt.h>
-#include <inttypes.h>
-#include <stdarg.h>
-#include <stdint.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/queue.h>
-#include <unistd.h>
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-#include <rte_common.h>
-#include <rte_ip.h>
-#include <rte_mbuf.h>
-
-#include "onvm_nflib.h"
-#include "onvm_pkt_helper.h"
-
-#ifdef __cplusplus
-}
-#endif
-
-// NFD ADD
-#include <pcap.h>
-#include <signal.h>
-#include <sys/time.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <cstring>
-#include <iomanip>
-#include <iostream>
-#include <unordered_map>
-#include <unordered_set>
-#include <vector>
-#include "basic_classes.h"
-#include "decode.h"
+#include "conntrack.h"
+#include "nfd_runtime.h"
 
 using namespace std;
 
-#define NF_TAG "stateful_firewall"
-
-/* number of package between each print */
-static uint32_t print_delay = 1000000;
-
-static uint32_t destination;
-
 /*******************************NFD features********************************/
-Flow::Flow(u_char *packet, int totallength) {
-        /*Decoding*/
-        this->pkt = packet;
-        int ethernet_header_length = 14;
-        /* Header lengths in bytes */
-        EtherHdr *e_hdr = (EtherHdr *)packet;
-        if (ntohs(e_hdr->ether_type) == 0x8100)
-                ethernet_header_length = 14 + 4; /* For 802.1Q Virtual LAN */
-        else
-                ethernet_header_length = 14; /* For general wired */
-
-        IPHdr *ip_hdr = (IPHdr *)(packet + ethernet_header_length);
-        int src_addr = ntohl(ip_hdr->ip_src.s_addr);
-        this->headers[Sip] = new IP(src_addr, 32);
-        int dst_addr = ntohl(ip_hdr->ip_dst.s_addr);
-        this->headers[Dip] = new IP(dst_addr, 32);
-}
-void
-Flow::clean() {
-        /*Encoding*/
-}
-
-long int _counter = 0;
-long int _drop = 0;
-unordered_map<string, int> F_Type::MAP = unordered_map<string, int>();
-unordered_map<string, int> F_Type::MAP2 = unordered_map<string, int>();
-int
-process(Flow &f);
-Flow f_glb;
-
-/////time////
-struct timeval begin_time;
-struct timeval end_time;
-
-void
-_init_() {
-        (new F_Type())->init();
-}
 
 // this setting was set by the model.txt
 IP _t1("192.168.22.0/24");
 
-State<unordered_set<IP>> seen(*(new unordered_set<IP>()));
-
-int
-process(Flow &f) {
-        if (*((IP *)f.headers[Sip]) <= _t1) {
-                seen[f] = union_set<unordered_set<IP>>(
-                    seen[f], create_set<IP>(*(new unordered_set<IP>()), 1, &((*(IP *)f.headers[Dip]))));
-        } else if ((*((IP *)f.headers[Sip]) != _t1) && (seen[f].find((*(IP *)f.headers[Sip])) != seen[f].end())) {
-        } else if ((*((IP *)f.headers[Sip]) != _t1) && (~(seen[f].find((*(IP *)f.headers[Sip])) != seen[f].end()))) {
-                return -1;
-        }
-
-        f.clean();
-        return 0;
-}
-int
-stateful_firewall(u_char *pkt, int totallength) {
-        f_glb = Flow(pkt, totallength);
-        return process(f_glb);
-}
-
-void
-stop() {
-        gettimeofday(&end_time, NULL);
+/* connections tracked at most, and how long an idle established TCP one is kept, in seconds */
+int capacity = 1 << 16;
+int established_timeout = 3600;
 
-        double total = end_time.tv_sec - begin_time.tv_sec + (end_time.tv_usec - begin_time.tv_usec) / 1000000.0;
+static ConnTrack seen;
+static int seen_capacity;
 
-        printf("\n\n**************************************************\n");
-        printf("%ld packets are processed, %ld packets are dropped\n", _counter, _drop);
-        printf("NF runs for %f seconds\n", total);
-        printf("**************************************************\n\n");
-}
-
-/**********************************************************************/
-
-/*
- * Print a usage message
- */
 static void
-usage(const char *progname) {
-        printf("Usage: %s [EAL args] -- [NF_LIB args] -- -d <destination> -p <print_delay>\n\n", progname);
+configure(void) {
+        seen.set_timeout(true, ConnTrack::ESTABLISHED, established_timeout);
+        if (capacity == seen_capacity)
+                return;
+        if (!seen.init(capacity, rte_get_tsc_cycles() / rte_get_tsc_hz())) {
+                if (seen_capacity == 0)
+                        rte_exit(EXIT_FAILURE, "Cannot allocate connection table\n");
+                RTE_LOG(INFO, APP, "Cannot resize connection table, keeping %d entries\n", seen_capacity);
+                capacity = seen_capacity;
+                return;
+        }
+        seen_capacity = capacity;
 }
 
-/*
- * Parse the application arguments.
- */
-static int
-parse_app_args(int argc, char *argv[], const char *progname) {
-        int c, dst_flag = 0;
-
-        while ((c = getopt(argc, argv, "d:p:")) != -1) {
-                switch (c) {
-                        case 'd':
-                                destination = strtoul(optarg, NULL, 10);
-                                dst_flag = 1;
-                                break;
-                        case 'p':
-                                print_delay = strtoul(optarg, NULL, 10);
-                                break;
-                        case '?':
-                                usage(progname);
-                                if (optopt == 'd')
-                                        RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
-                                else if (optopt == 'p')
-                                        RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
-                                else if (isprint(optopt))
-                                        RTE_LOG(INFO, APP, "Unknown option `-%c'.\n", optopt);
-                                else
-                                        RTE_LOG(INFO, APP, "Unknown option character `\\x%x'.\n", optopt);
-                                return -1;
-                        default:
-                                usage(progname);
-                                return -1;
+/* the window scale option of a SYN, -1 if it has none */
+static int8_t
+wscale(struct rte_tcp_hdr *tcp) {
+        u_char *opt = (u_char *)(tcp + 1);
+        u_char *end = (u_char *)tcp + ((tcp->data_off >> 4) << 2);
+
+        while (opt < end) {
+                if (*opt == 0)
+                        break;
+                if (*opt == 1) {
+                        opt++;
+                        continue;
                 }
+                if (opt + 1 >= end || opt[1] < 2)
+                        break;
+                if (*opt == 3 && opt[1] == 3 && opt + 2 < end)
+                        return opt[2] > 14 ? 14 : opt[2];
+                opt += opt[1];
         }
-
-        if (!dst_flag) {
-                RTE_LOG(INFO, APP, "Stateful Firewall NF requires destination flag -d.\n");
-                return -1;
-        }
-
-        return optind;
+        return -1;
 }
 
-/*
- * This function displays stats. It uses ANSI terminal codes to clear
- * screen when called. It is called from a single non-master
- * thread in the server process, when the process is run with more
- * than one lcore enabled.
- */
 static void
-do_stats_display(struct rte_mbuf *pkt) {
-        const char clr[] = {27, '[', '2', 'J', '\0'};
-        const char topLeft[] = {27, '[', '1', ';', '1', 'H', '\0'};
-        static uint64_t pkt_process = 0;
-        struct rte_ipv4_hdr *ip;
-
-        pkt_process += print_delay;
-
-        /* Clear screen and move to top left */
-        printf("%s%s", clr, topLeft);
-
-        printf("PACKETS\n");
-        printf("-----\n");
-        printf("Port : %d\n", pkt->port);
-        printf("Size : %d\n", pkt->pkt_len);
-        printf("N°   : %" PRIu64 "\n", pkt_process);
-        printf("\n\n");
-
-        ip = onvm_pkt_ipv4_hdr(pkt);
-        if (ip != NULL) {
-                onvm_pkt_print(pkt);
+decode(Flow &f, struct rte_mbuf *pkt, ConnPacket *p) {
+        struct rte_ipv4_hdr *ip = nfd_ipv4_hdr(pkt);
+        struct rte_tcp_hdr *tcp = (struct rte_tcp_hdr *)nfd_l4_hdr(ip);
+        int tcp_hdr_len;
+
+        p->t.sip = ((IP *)f.headers[Sip])->ip;
+        p->t.dip = ((IP *)f.headers[Dip])->ip;
+        p->t.proto = *((int *)f.headers[Proto]);
+        p->tcp_flags = 0;
+        p->seq = p->ack = 0;
+        p->win = p->len = 0;
+        p->wscale = -1;
+        if (*((int *)f.headers[Tcp]) || *((int *)f.headers[Udp])) {
+                p->t.sport = *((int *)f.headers[Sport]);
+                p->t.dport = *((int *)f.headers[Dport]);
         } else {
-                printf("No IP4 header found\n");
+                p->t.sport = p->t.dport = 0;
         }
+        if (!*((int *)f.headers[Tcp]))
+                return;
+
+        tcp_hdr_len = (tcp->data_off >> 4) << 2;
+        p->tcp_flags = tcp->tcp_flags;
+        p->seq = rte_be_to_cpu_32(tcp->sent_seq);
+        p->ack = rte_be_to_cpu_32(tcp->recv_ack);
+        p->win = rte_be_to_cpu_16(tcp->rx_win);
+        p->len = rte_be_to_cpu_16(ip->total_length) - ((u_char *)tcp - (u_char *)ip) - tcp_hdr_len;
+        if (tcp->tcp_flags & RTE_TCP_SYN_FLAG)
+                p->wscale = wscale(tcp);
 }
 
-static int
-packet_handler(struct rte_mbuf *buf, struct onvm_pkt_meta *meta,
-               __attribute__((unused)) struct onvm_nf_local_ctx *nf_local_ctx) {
-        static uint32_t counter = 0;
-        if (++counter == print_delay) {
-                do_stats_display(buf);
-                counter = 0;
+/*
+ * Outgoing packets may open connections, incoming packets pass only as
+ * part of one. Packets the tracker finds out of window or out of order
+ * for the connection state are dropped either way.
+ */
+static void
+burst(struct rte_mbuf **pkts, uint16_t nb_pkts, int *verdicts) {
+        ConnPacket p[PACKET_READ_SIZE];
+        ConnRef refs[PACKET_READ_SIZE];
+        bool outgoing[PACKET_READ_SIZE];
+        uint32_t now = rte_get_tsc_cycles() / rte_get_tsc_hz();
+        ConnTrack::Result r;
+        uint16_t i;
+
+        for (i = 0; i < nb_pkts; i++) {
+                if (i + 1 < nb_pkts)
+                        rte_prefetch0(rte_pktmbuf_mtod(pkts[i + 1], void *));
+                Flow f(pkts[i]);
+                decode(f, pkts[i], &p[i]);
+                outgoing[i] = *((IP *)f.headers[Sip]) <= _t1;
         }
-        ////////add NFD NF process here!////////////////
-        _counter++;
-        u_char * pkt = rte_pktmbuf_mtod(buf, u_char*);
-        int length = (int)buf->pkt_len;
-        int ok;
 
-        ok = stateful_firewall(pkt, length);
-        if (ok == -1) {
-                _drop++;
-                meta->action = ONVM_NF_ACTION_DROP;
-        } else {
-                meta->action = ONVM_NF_ACTION_TONF;
-                meta->destination = destination;
+        seen.expire(now);
+        seen.lookup_burst(p, nb_pkts, refs);
+        for (i = 0; i < nb_pkts; i++) {
+                r = seen.track(p[i], refs[i], outgoing[i], now);
+                if (r == ConnTrack::CT_INVALID || (r == ConnTrack::CT_UNTRACKED && !outgoing[i]))
+                        verdicts[i] = -1;
+                else
+                        verdicts[i] = 0;
         }
-        ////////////////////////////////////////////////
-        return 0;
 }
 
-int
-main(int argc, char *argv[]) {
-        struct onvm_nf_local_ctx *nf_local_ctx;
-        struct onvm_nf_function_table *nf_function_table;
-        int arg_offset;
+static struct nfd_param params[] = {
+        {"internal", NFD_PARAM_IP, &_t1},
+        {"capacity", NFD_PARAM_INT, &capacity},
+        {"established_timeout", NFD_PARAM_INT, &established_timeout},
+        {NULL, NFD_PARAM_INT, NULL},
+};
 
-        const char *progname = argv[0];
-
-        nf_local_ctx = onvm_nflib_init_nf_local_ctx();
-        onvm_nflib_start_signal_handler(nf_local_ctx, NULL);
-
-        nf_function_table = onvm_nflib_init_nf_function_table();
-        nf_function_table->pkt_handler = &packet_handler;
-
-        if ((arg_offset = onvm_nflib_init(argc, argv, NF_TAG, nf_local_ctx, nf_function_table)) < 0) {
-                onvm_nflib_stop(nf_local_ctx);
-                if (arg_offset == ONVM_SIGNAL_TERMINATION) {
-                        printf("Exiting due to user termination\n");
-                        return 0;
-                } else {
-                        rte_exit(EXIT_FAILURE, "Failed ONVM init\n");
-                }
-        }
-
-        argc -= arg_offset;
-        argv += arg_offset;
-
-        // NFD begin
-        _init_();
-        // NFD end
-
-        if (parse_app_args(argc, argv, progname) < 0) {
-                onvm_nflib_stop(nf_local_ctx);
-                rte_exit(EXIT_FAILURE, "Invalid command-line arguments\n");
-        }
-
-        // NFD begin
-        gettimeofday(&begin_time, NULL);
-        // NFD end
-
-        onvm_nflib_run(nf_local_ctx);
-
-        onvm_nflib_stop(nf_local_ctx);
-        stop();
-        printf("If we reach here, program is ending\n");
-
-        return 0;
-}
+NFD_MODEL_BURST("stateful_firewall", &burst, params, &configure)
@@ -46,280 +46,57 @@
               from IIIS, Tsinghua University, China.
 *************************************************************************************/
 
-#include <errno.h>
-#include <getopt.h>
-#include <inttypes.h>
-#include <stdarg.h>
-#include <stdint.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/queue.h>
-#include <unistd.h>
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-#include <rte_common.h>
-#include <rte_ip.h>
-#include <rte_mbuf.h>
-
-#include "onvm_nflib.h"
-#include "onvm_pkt_helper.h"
-
-#ifdef __cplusplus
-}
-#endif
-
-// NFD ADD
-#include <pcap.h>
-#include <signal.h>
-#include <sys/time.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <cstring>
-#include <iomanip>
-#include <iostream>
-#include <unordered_map>
-#include <unordered_set>
-#include <vector>
-#include "basic_classes.h"
-#include "decode.h"
+#include "nfd_runtime.h"
 
 using namespace std;
 
-#define NF_TAG "stateless_firewall"
-
-/* number of package between each print */
-static uint32_t print_delay = 1000000;
-
-static uint32_t destination;
-
 /*******************************NFD features********************************/
-Flow::Flow(u_char *packet, int totallength) {
-        /*Decoding*/
-        this->pkt = packet;
-        int ethernet_header_length = 14;
-        /* Header lengths in bytes */
-        EtherHdr *e_hdr = (EtherHdr *)packet;
-        if (ntohs(e_hdr->ether_type) == 0x8100)
-                ethernet_header_length = 14 + 4; /* For 802.1Q Virtual LAN */
-        else
-                ethernet_header_length = 14; /* For general wired */
-
-        IPHdr *ip_hdr = (IPHdr *)(packet + ethernet_header_length);
-        int src_addr = ntohl(ip_hdr->ip_src.s_addr);
-        this->headers[Sip] = new IP(src_addr, 32);
-        short protocol = (short)(ip_hdr->ip_proto);
-        this->headers[Tcp] = new int((protocol == IPPROTO_TCP) ? 1 : 0);
-}
-void
-Flow::clean() {
-}
-
-long int _counter = 0;
-long int _drop = 0;
-unordered_map<string, int> F_Type::MAP = unordered_map<string, int>();
-unordered_map<string, int> F_Type::MAP2 = unordered_map<string, int>();
-int
-process(Flow &f);
-Flow f_glb;
-
-/////time////
-struct timeval begin_time;
-struct timeval end_time;
 
-IP ip1("192.168.22.0/24");
+static Rule
+allow(const char *prefix) {
+        Rule rule;
 
-void
-_init_() {
-        (new F_Type())->init();
+        parse_prefix(prefix, &rule.sip);
+        return rule;
 }
 
-int
-process(Flow &f) {
-        if (*((IP *)f.headers[Sip]) != ip1) {
-            return -1;
-        }
-        else if (*((IP *)f.headers[Sip]) <= ip1 && *((int *)f.headers[Tcp])) {
-        }
-        f.clean();
-        return 0;
-}
-int
-stateless_firewall(u_char *pkt, int totallength) {
-        f_glb = Flow(pkt, totallength);
-        return process(f_glb);
-}
-
-void
-stop() {
-        gettimeofday(&end_time, NULL);
-
-        double total = end_time.tv_sec - begin_time.tv_sec + (end_time.tv_usec - begin_time.tv_usec) / 1000000.0;
-
-        printf("\n\n**************************************************\n");
-        printf("%ld packets are processed, %ld packets are dropped\n", _counter, _drop);
-        printf("NF runs for %f seconds\n", total);
-        printf("**************************************************\n\n");
-}
+// rule set, replaced at run time by the "rules" parameter
+vector<Rule> rules = {allow("192.168.22.0/24")};
+// verdict of packets no rule matches
+int default_verdict = -1;
 
-/**********************************************************************/
+static Classifier classifier;
 
 /*
- * Print a usage message
+ * Classify the burst in one pass over the compiled rules, so the cost per
+ * packet does not grow with the rule set.
  */
 static void
-usage(const char *progname) {
-        printf("Usage: %s [EAL args] -- [NF_LIB args] -- -d <destination> -p <print_delay>\n\n", progname);
-}
-
-/*
- * Parse the application arguments.
- */
-static int
-parse_app_args(int argc, char *argv[], const char *progname) {
-        int c, dst_flag = 0;
-
-        while ((c = getopt(argc, argv, "d:p:")) != -1) {
-                switch (c) {
-                        case 'd':
-                                destination = strtoul(optarg, NULL, 10);
-                                dst_flag = 1;
-                                break;
-                        case 'p':
-                                print_delay = strtoul(optarg, NULL, 10);
-                                break;
-                        case '?':
-                                usage(progname);
-                                if (optopt == 'd')
-                                        RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
-                                else if (optopt == 'p')
-                                        RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
-                                else if (isprint(optopt))
-                                        RTE_LOG(INFO, APP, "Unknown option `-%c'.\n", optopt);
-                                else
-                                        RTE_LOG(INFO, APP, "Unknown option character `\\x%x'.\n", optopt);
-                                return -1;
-                        default:
-                                usage(progname);
-                                return -1;
-                }
+burst(struct rte_mbuf **pkts, uint16_t nb_pkts, int *verdicts) {
+        Classifier::Key keys[PACKET_READ_SIZE];
+        uint16_t i;
+
+        for (i = 0; i < nb_pkts; i++) {
+                if (i + 1 < nb_pkts)
+                        rte_prefetch0(rte_pktmbuf_mtod(pkts[i + 1], void *));
+                Flow f(pkts[i]);
+                keys[i].sip = ((IP *)f.headers[Sip])->ip;
+                keys[i].dip = ((IP *)f.headers[Dip])->ip;
+                keys[i].proto = *((int *)f.headers[Proto]);
+                keys[i].dport = (*((int *)f.headers[Tcp]) || *((int *)f.headers[Udp])) ? *((int *)f.headers[Dport]) : 0;
         }
-
-        if (!dst_flag) {
-                RTE_LOG(INFO, APP, "Stateless Firewall NF requires destination flag -d.\n");
-                return -1;
-        }
-
-        return optind;
+        classifier.classify_burst(keys, nb_pkts, verdicts);
 }
 
-/*
- * This function displays stats. It uses ANSI terminal codes to clear
- * screen when called. It is called from a single non-master
- * thread in the server process, when the process is run with more
- * than one lcore enabled.
- */
 static void
-do_stats_display(struct rte_mbuf *pkt) {
-        const char clr[] = {27, '[', '2', 'J', '\0'};
-        const char topLeft[] = {27, '[', '1', ';', '1', 'H', '\0'};
-        static uint64_t pkt_process = 0;
-        struct rte_ipv4_hdr *ip;
-
-        pkt_process += print_delay;
-
-        /* Clear screen and move to top left */
-        printf("%s%s", clr, topLeft);
-
-        printf("PACKETS\n");
-        printf("-----\n");
-        printf("Port : %d\n", pkt->port);
-        printf("Size : %d\n", pkt->pkt_len);
-        printf("N°   : %" PRIu64 "\n", pkt_process);
-        printf("\n\n");
-
-        ip = onvm_pkt_ipv4_hdr(pkt);
-        if (ip != NULL) {
-                onvm_pkt_print(pkt);
-        } else {
-                printf("No IP4 header found\n");
-        }
-}
-
-static int
-packet_handler(struct rte_mbuf *buf, struct onvm_pkt_meta *meta,
-               __attribute__((unused)) struct onvm_nf_local_ctx *nf_local_ctx) {
-        static uint32_t counter = 0;
-        if (++counter == print_delay) {
-                do_stats_display(buf);
-                counter = 0;
-        }
-        ////////add NFD NF process here!////////////////
-        _counter++;
-        u_char * pkt = rte_pktmbuf_mtod(buf, u_char*);
-        int length = (int)buf->pkt_len;
-        int ok;
-
-        ok = stateless_firewall(pkt, length);
-        if (ok == -1) {
-                _drop++;
-                meta->action = ONVM_NF_ACTION_DROP;
-        } else {
-                meta->action = ONVM_NF_ACTION_TONF;
-                meta->destination = destination;
-        }
-        ////////////////////////////////////////////////
-        return 0;
+configure(void) {
+        classifier.build(rules, default_verdict);
 }
 
-int
-main(int argc, char *argv[]) {
-        struct onvm_nf_local_ctx *nf_local_ctx;
-        struct onvm_nf_function_table *nf_function_table;
-        int arg_offset;
+static struct nfd_param params[] = {
+        {"rules", NFD_PARAM_RULES, &rules},
+        {"default", NFD_PARAM_INT, &default_verdict},
+        {NULL, NFD_PARAM_INT, NULL},
+};
 
-        const char *progname = argv[0];
-
-        nf_local_ctx = onvm_nflib_init_nf_local_ctx();
-        onvm_nflib_start_signal_handler(nf_local_ctx, NULL);
-
-        nf_function_table = onvm_nflib_init_nf_function_table();
-        nf_function_table->pkt_handler = &packet_handler;
-
-        if ((arg_offset = onvm_nflib_init(argc, argv, NF_TAG, nf_local_ctx, nf_function_table)) < 0) {
-                onvm_nflib_stop(nf_local_ctx);
-                if (arg_offset == ONVM_SIGNAL_TERMINATION) {
-                        printf("Exiting due to user termination\n");
-                        return 0;
-                } else {
-                        rte_exit(EXIT_FAILURE, "Failed ONVM init\n");
-                }
-        }
-
-        argc -= arg_offset;
-        argv += arg_offset;
-
-        // NFD begin
-        _init_();
-        // NFD end
-
-        if (parse_app_args(argc, argv, progname) < 0) {
-                onvm_nflib_stop(nf_local_ctx);
-                rte_exit(EXIT_FAILURE, "Invalid command-line arguments\n");
-        }
-
-        // NFD begin
-        gettimeofday(&begin_time, NULL);
-        // NFD end
-
-        onvm_nflib_run(nf_local_ctx);
-
-        onvm_nflib_stop(nf_local_ctx);
-        stop();
-        printf("If we reach here, program is ending\n");
-
-        return 0;
-}
+NFD_MODEL_BURST("stateless_firewall", &burst, params, &configure)
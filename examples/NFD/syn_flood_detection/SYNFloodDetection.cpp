@@ -46,109 +46,16 @@
               from IIIS, Tsinghua University, China.
 *************************************************************************************/
 
-#include <errno.h>
-#include <getopt.h>
-#include <inttypes.h>
-#include <stdarg.h>
-#include <stdint.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/queue.h>
-#include <unistd.h>
+#include <rte_jhash.h>
+#include <rte_random.h>
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-#include <rte_common.h>
-#include <rte_ip.h>
-#include <rte_mbuf.h>
-
-#include "onvm_nflib.h"
-#include "onvm_pkt_helper.h"
-
-#ifdef __cplusplus
-}
-#endif
-
-// NFD ADD
-#include <pcap.h>
-#include <signal.h>
-#include <sys/time.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <cstring>
-#include <iomanip>
-#include <iostream>
-#include <unordered_map>
-#include <unordered_set>
-#include <vector>
-#include "basic_classes.h"
-#include "decode.h"
+#include "nfd_runtime.h"
+#include "request_table.h"
 
 using namespace std;
 
-#define NF_TAG "SYNFloodDetection"
-
-/* number of package between each print */
-static uint32_t print_delay = 1000000;
-
-static uint32_t destination;
-
 /*******************************NFD features********************************/
-Flow::Flow(u_char *packet, int totallength) {
-        /*Decoding*/
-        this->pkt = packet;
-        struct ether_header *eth_header;
-        eth_header = (struct ether_header *)packet;
-
-        /* Pointers to start point of various headers */
-        u_char *ip_header;
-        /* Header lengths in bytes */
-        int ethernet_header_length = 14; /* Doesn't change */
-        int ip_header_length;
-        ip_header = packet + ethernet_header_length;
-        ip_header_length = ((*ip_header) & 0x0F);
-        ip_header_length = ip_header_length * 4;
-        int src_addr, des_addr;
-        src_addr = ntohl(*((int *)(ip_header + 12)));
-        des_addr = ntohl(*((int *)(ip_header + 16)));
-        this->field_value["sip"] = new IP(src_addr, 32);
-        this->field_value["dip"] = new IP(des_addr, 32);
-        this->field_value["tag"] = new int(0);
-        this->field_value["iplen"] = new int(totallength);
-        uint8_t protocol = (*(uint8_t *)(ip_header + 9));
-        this->field_value["UDP"] = new int((protocol == IPPROTO_UDP) ? 1 : 0);
 
-        /*TCP layer*/
-        TCPHdr *tcph = (TCPHdr *)(ip_header + ip_header_length);
-        this->field_value["sport"] = new int(ntohs(tcph->th_sport));
-        this->field_value["dport"] = new int(ntohs(tcph->th_dport));
-        /*URG ACK PSH RST SYN FIN*/
-        this->field_value["flag_fin"] = new int(tcph->th_flags        & 0x1);
-        this->field_value["flag_syn"] = new int((tcph->th_flags >> 1) & 0x1);
-        this->field_value["flag_ack"] = new int((tcph->th_flags >> 4) & 0x1);
-}
-void
-Flow::clean() {
-}
-
-int
-process(Flow &f);
-Flow f_glb;
-long int _counter = 0;
-long int _drop = 0;
-unordered_map<string, int> F_Type::MAP = unordered_map<string, int>();
-unordered_map<string, int> F_Type::MAP2 = unordered_map<string, int>();
-
-struct timeval begin_time;
-struct timeval end_time;
-
-void
-_init_() {
-        (new F_Type())->init();
-}
 int _t1 = 100;
 int _t2 = 1;
 int _t3 = 1;
@@ -163,21 +70,35 @@ int _t11 = 1;
 int _t12 = 1;
 int _t13 = 1;
 int _t14 = 1;
-State<unordered_map<IP, int>> blist(*(new unordered_map<IP, int>()));
+/* window length in seconds and sliding estimate, set by the model's window statement */
+int _window = 10;
+int _sliding = 0;
+WindowState<IP, int> blist(0, _sliding);
 State<int> threshold(_t1);
 
+/* push the model parameters into its state */
+static void
+configure(void) {
+        uint64_t cycles = (uint64_t)_window * rte_get_timer_hz();
+
+        blist.set_window(cycles);
+        blist.sliding = _sliding != 0;
+
+        threshold.reset(_t1);
+}
+
 int
 process(Flow &f) {
-        if ((*(int *)f["flag_syn"]) == _t2 && (*(int *)f["tag"]) != _t3) {
-                blist[f][(*(IP *)f["sip"])] = blist[f][(*(IP *)f["sip"])] + _t4;
-                (*(int *)f["tag"]) = _t5;
+        if ((*(int *)f.headers[Syn]) == _t2 && (*(int *)f.headers[Tag]) != _t3) {
+                increment(blist, f, (*(IP *)f.headers[Sip]), _t4);
+                (*(int *)f.headers[Tag]) = _t5;
                 return process(f);
-        } else if (((*(int *)f["tag"]) == _t6) && (blist[f][(*(IP *)f["sip"])] >= threshold[f])) {
+        } else if (((*(int *)f.headers[Tag]) == _t6) && (blist.get((*(IP *)f.headers[Sip])) >= threshold[f])) {
                 return -1;
-        } else if (((*(int *)f["tag"]) == _t7) && (blist[f][(*(IP *)f["sip"])] != threshold[f])) {
-        } else if ((*(int *)f["tag"]) != _t8 && (*(int *)f["flag_syn"]) != _t9 && (*(int *)f["flag_ack"]) == _t10) {
-                blist[f][(*(IP *)f["sip"])] = blist[f][(*(IP *)f["sip"])] - _t11;
-        } else if ((*(int *)f["tag"]) != _t12 && (*(int *)f["flag_syn"]) != _t13 && (*(int *)f["flag_ack"]) != _t14) {
+        } else if (((*(int *)f.headers[Tag]) == _t7) && (blist.get((*(IP *)f.headers[Sip])) != threshold[f])) {
+        } else if ((*(int *)f.headers[Tag]) != _t8 && (*(int *)f.headers[Syn]) != _t9 && (*(int *)f.headers[Ack]) == _t10) {
+                increment(blist, f, (*(IP *)f.headers[Sip]), -_t11);
+        } else if ((*(int *)f.headers[Tag]) != _t12 && (*(int *)f.headers[Syn]) != _t13 && (*(int *)f.headers[Ack]) != _t14) {
         }
 
         f.clean();
@@ -185,180 +106,134 @@ process(Flow &f) {
 }
 
 int
-SYNFD(u_char *pkt, int totallength) {
-        f_glb = Flow(pkt, totallength);
-        return process(f_glb);
+SYNFD(Flow &f) {
+        uint64_t now = rte_get_tsc_cycles();
+
+        blist.tick(now);
+        return process(f);
 }
 
-void
-stop() {
-        gettimeofday(&end_time, NULL);
+/***************************SYN cookie mitigation****************************/
 
-        double total = end_time.tv_sec - begin_time.tv_sec + (end_time.tv_usec - begin_time.tv_usec) / 1000000.0;
+/* cookie time slot length, a cookie is valid in its slot and the next */
+#define COOKIE_SLOT_SECONDS 64
 
-        printf("\n\n**************************************************\n");
-        printf("%ld packets are processed\n", _counter);
-        printf("NF runs for %f seconds\n", total);
-        printf("**************************************************\n\n");
-}
+/* 1 answers SYNs of unvalidated sources with cookies instead of counting them */
+int mitigate = 0;
+/* validated (client, server) pairs kept and for how long, in ms */
+int whitelist_size = 1 << 16;
+int whitelist_timeout = 300000;
 
-/**********************************************************************/
+static RequestTable whitelist;
+/* the size whitelist was last sized for, init() rounds it up */
+static int whitelist_capacity;
+static uint32_t cookie_secret;
+static uint64_t cycles_per_ms;
 
-/*
- * Print a usage message
- */
 static void
-usage(const char *progname) {
-        printf("Usage: %s [EAL args] -- [NF_LIB args] -- -d <destination> -p <print_delay>\n\n", progname);
+configure_mitigation(void) {
+        configure();
+        if (cookie_secret == 0)
+                cookie_secret = (uint32_t)rte_rand() | 1;
+        cycles_per_ms = rte_get_tsc_hz() / 1000;
+        if (whitelist_size == whitelist_capacity)
+                return;
+        if (!whitelist.init(whitelist_size)) {
+                if (whitelist_capacity == 0)
+                        rte_exit(EXIT_FAILURE, "Cannot allocate SYN whitelist\n");
+                RTE_LOG(INFO, APP, "Cannot resize SYN whitelist, keeping %d entries\n", whitelist_capacity);
+                whitelist_size = whitelist_capacity;
+                return;
+        }
+        whitelist_capacity = whitelist_size;
 }
 
 /*
- * Parse the application arguments.
+ * The cookie of a connection: the time slot in the top 8 bits and a keyed
+ * hash of the 4-tuple and slot in the rest. Addresses and ports are taken
+ * as the client sent them.
  */
-static int
-parse_app_args(int argc, char *argv[], const char *progname) {
-        int c, dst_flag = 0;
-
-        while ((c = getopt(argc, argv, "d:p:")) != -1) {
-                switch (c) {
-                        case 'd':
-                                destination = strtoul(optarg, NULL, 10);
-                                dst_flag = 1;
-                                break;
-                        case 'p':
-                                print_delay = strtoul(optarg, NULL, 10);
-                                break;
-                        case '?':
-                                usage(progname);
-                                if (optopt == 'd')
-                                        RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
-                                else if (optopt == 'p')
-                                        RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
-                                else if (isprint(optopt))
-                                        RTE_LOG(INFO, APP, "Unknown option `-%c'.\n", optopt);
-                                else
-                                        RTE_LOG(INFO, APP, "Unknown option character `\\x%x'.\n", optopt);
-                                return -1;
-                        default:
-                                usage(progname);
-                                return -1;
-                }
-        }
-
-        if (!dst_flag) {
-                RTE_LOG(INFO, APP, "SYN Flood Detection NF requires destination flag -d.\n");
-                return -1;
-        }
-
-        return optind;
+static uint32_t
+cookie(struct rte_ipv4_hdr *ip, struct rte_tcp_hdr *tcp, uint32_t slot) {
+        uint32_t words[4];
+
+        words[0] = ip->src_addr;
+        words[1] = ip->dst_addr;
+        words[2] = (uint32_t)tcp->src_port << 16 | tcp->dst_port;
+        words[3] = slot;
+        return (slot & 0xff) << 24 | (rte_jhash_32b(words, 4, cookie_secret) & 0xffffff);
 }
 
 /*
- * This function displays stats. It uses ANSI terminal codes to clear
- * screen when called. It is called from a single non-master
- * thread in the server process, when the process is run with more
- * than one lcore enabled.
+ * Mitigation keeps no per flow state. A SYN from a source that is not
+ * validated is answered with a SYN-ACK carrying a cookie as its sequence
+ * number. An ACK that returns a good cookie proves the source address,
+ * so the pair is whitelisted and the client is reset, its retry then
+ * passes to the server. Other packets are left to the server.
  */
-static void
-do_stats_display(struct rte_mbuf *pkt) {
-        const char clr[] = {27, '[', '2', 'J', '\0'};
-        const char topLeft[] = {27, '[', '1', ';', '1', 'H', '\0'};
-        static uint64_t pkt_process = 0;
-        struct rte_ipv4_hdr *ip;
-
-        pkt_process += print_delay;
-
-        /* Clear screen and move to top left */
-        printf("%s%s", clr, topLeft);
-
-        printf("PACKETS\n");
-        printf("-----\n");
-        printf("Port : %d\n", pkt->port);
-        printf("Size : %d\n", pkt->pkt_len);
-        printf("N°   : %" PRIu64 "\n", pkt_process);
-        printf("\n\n");
-
-        ip = onvm_pkt_ipv4_hdr(pkt);
-        if (ip != NULL) {
-                onvm_pkt_print(pkt);
-        } else {
-                printf("No IP4 header found\n");
-        }
-}
-
 static int
-packet_handler(struct rte_mbuf *buf, struct onvm_pkt_meta *meta,
-               __attribute__((unused)) struct onvm_nf_local_ctx *nf_local_ctx) {
-        static uint32_t counter = 0;
-        if (++counter == print_delay) {
-                do_stats_display(buf);
-                counter = 0;
+mitigation(Flow &f, struct rte_mbuf *pkt) {
+        struct rte_ipv4_hdr *ip;
+        struct rte_tcp_hdr *tcp;
+        uint32_t now, slot, c;
+        RequestKey key;
+
+        /* the reply rewrites the headers in place, they must be IPv4 TCP and in the first segment */
+        tcp = nfd_tcp_hdr(pkt);
+        if (tcp == NULL)
+                return 0;
+        ip = nfd_ipv4_hdr(pkt);
+
+        now = rte_get_tsc_cycles() / cycles_per_ms;
+        key.client = ((IP *)f.headers[Sip])->ip;
+        key.server = ((IP *)f.headers[Dip])->ip;
+        key.port = 0;
+        key.id = 0;
+
+        slot = now / (COOKIE_SLOT_SECONDS * 1000);
+
+        if (*((int *)f.headers[Syn]) && !*((int *)f.headers[Ack])) {
+                if (whitelist.contains(key, now))
+                        return 0;
+                if (nfd_tcp_reply(pkt, RTE_TCP_SYN_FLAG | RTE_TCP_ACK_FLAG, cookie(ip, tcp, slot),
+                                  rte_be_to_cpu_32(tcp->sent_seq) + 1) < 0)
+                        return 0;
+                return NFD_VERDICT_REPLY;
         }
-        ////////add NFD NF process here!////////////////
-        _counter++;
-        u_char * pkt = rte_pktmbuf_mtod(buf, u_char*);
-        int length = (int)buf->pkt_len;
-        int ok;
 
-        ok = SYNFD(pkt, length);
-
-        if (ok == -1) {
-                _drop++;
-                meta->action = ONVM_NF_ACTION_DROP;
-        } else {
-                meta->action = ONVM_NF_ACTION_TONF;
-                meta->destination = destination;
+        if (*((int *)f.headers[Ack]) && !*((int *)f.headers[Syn]) && !*((int *)f.headers[Fin])) {
+                c = rte_be_to_cpu_32(tcp->recv_ack) - 1;
+                if ((c >> 24 == (slot & 0xff) && c == cookie(ip, tcp, slot)) ||
+                    (c >> 24 == ((slot - 1) & 0xff) && c == cookie(ip, tcp, slot - 1))) {
+                        whitelist.insert(key, now, now + whitelist_timeout);
+                        if (nfd_tcp_reply(pkt, RTE_TCP_RST_FLAG, c + 1, 0) < 0)
+                                return 0;
+                        return NFD_VERDICT_REPLY;
+                }
         }
-        
-        ////////////////////////////////////////////////
         return 0;
 }
 
-int
-main(int argc, char *argv[]) {
-        struct onvm_nf_local_ctx *nf_local_ctx;
-        struct onvm_nf_function_table *nf_function_table;
-        int arg_offset;
-
-        const char *progname = argv[0];
-
-        nf_local_ctx = onvm_nflib_init_nf_local_ctx();
-        onvm_nflib_start_signal_handler(nf_local_ctx, NULL);
-
-        nf_function_table = onvm_nflib_init_nf_function_table();
-        nf_function_table->pkt_handler = &packet_handler;
-
-        if ((arg_offset = onvm_nflib_init(argc, argv, NF_TAG, nf_local_ctx, nf_function_table)) < 0) {
-                onvm_nflib_stop(nf_local_ctx);
-                if (arg_offset == ONVM_SIGNAL_TERMINATION) {
-                        printf("Exiting due to user termination\n");
-                        return 0;
-                } else {
-                        rte_exit(EXIT_FAILURE, "Failed ONVM init\n");
-                }
-        }
-
-        argc -= arg_offset;
-        argv += arg_offset;
-
-        // NFD begin
-        _init_();
-        // NFD end
-
-        if (parse_app_args(argc, argv, progname) < 0) {
-                onvm_nflib_stop(nf_local_ctx);
-                rte_exit(EXIT_FAILURE, "Invalid command-line arguments\n");
+static void
+burst(struct rte_mbuf **pkts, uint16_t nb_pkts, int *verdicts) {
+        uint16_t i;
+
+        for (i = 0; i < nb_pkts; i++) {
+                if (i + 1 < nb_pkts)
+                        rte_prefetch0(rte_pktmbuf_mtod(pkts[i + 1], void *));
+                Flow f(pkts[i]);
+                verdicts[i] = mitigate ? mitigation(f, pkts[i]) : SYNFD(f);
         }
-
-        // NFD begin
-        gettimeofday(&begin_time, NULL);
-        // NFD end
-
-        onvm_nflib_run(nf_local_ctx);
-
-        onvm_nflib_stop(nf_local_ctx);
-        stop();
-        printf("If we reach here, program is ending\n");
-
-        return 0;
 }
+
+static struct nfd_param params[] = {
+        {"threshold", NFD_PARAM_INT, &_t1},
+        {"window", NFD_PARAM_INT, &_window},
+        {"sliding", NFD_PARAM_INT, &_sliding},
+        {"mitigate", NFD_PARAM_INT, &mitigate},
+        {"whitelist_size", NFD_PARAM_INT, &whitelist_size},
+        {"whitelist_timeout", NFD_PARAM_INT, &whitelist_timeout},
+        {NULL, NFD_PARAM_INT, NULL},
+};
+
+NFD_MODEL_BURST("SYNFloodDetection", &burst, params, &configure_mitigation)
@@ -35,7 +35,8 @@
  *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
  *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
- * arp_response.c - an example using onvm. If it receives an ARP packet, send a response.
+ * arp_response.c - an example using onvm. If it receives an ARP packet, send a response and
+ *                  learn the sender into the neighbor cache L3 NFs read.
  ********************************************************************/
 
 #include <errno.h>
@@ -55,20 +56,21 @@
 #include <rte_ip.h>
 #include <rte_malloc.h>
 #include <rte_mbuf.h>
-#include <rte_mempool.h>
 
+#include "onvm_arp.h"
 #include "onvm_nflib.h"
 #include "onvm_pkt_helper.h"
 
 #define NF_TAG "arp_response"
 
-#define PKTMBUF_POOL_NAME "MProc_pktmbuf_pool"
-
 struct state_info {
-        struct rte_mempool *pktmbuf_pool;
+        struct onvm_arp_cache *arp_cache;
         uint16_t nf_destination;
-        uint32_t *source_ips;
+        /* ports->id[0..num_local_ports) are answered for by this NF */
+        uint16_t num_local_ports;
         int print_flag;
+        uint64_t replies;
+        uint64_t arp_pkts;
 };
 
 struct state_info *state_info;
@@ -100,13 +102,14 @@ get_ip_count(char *input_string, const char *delim) {
         char *token = NULL;
         char *buffer = NULL;
         char *ip_string = NULL;
-        size_t length = sizeof(input_string);
+        size_t length;
 
         if (input_string == NULL || delim == NULL) {
                 return -1;
         }
 
-        ip_string = rte_calloc("Copy of IP String", sizeof(input_string), sizeof(char), 0);
+        length = strlen(input_string) + 1;
+        ip_string = rte_calloc("Copy of IP String", length, sizeof(char), 0);
         if (ip_string == NULL) {
                 RTE_LOG(INFO, APP, "Unable to allocate space for IP string");
                 return -1;
@@ -120,6 +123,7 @@ get_ip_count(char *input_string, const char *delim) {
                 token = strtok_r(NULL, delim, &buffer);
         }
 
+        rte_free(ip_string);
         return ip_count;
 }
 
@@ -132,17 +136,12 @@ parse_app_args(int argc, char *argv[], const char *progname) {
         int num_ips = 0;
         int current_ip = 0;
         int result = 0;
+        uint32_t ip;
         const char delim[2] = ",";
         char *token;
         char *buffer;
         state_info->print_flag = 0;
 
-        state_info->source_ips = rte_calloc("Array of decimal IPs", ports->num_ports, sizeof(uint32_t), 0);
-        if (state_info->source_ips == NULL) {
-                RTE_LOG(INFO, APP, "Unable to initialize source IP array\n");
-                return -1;
-        }
-
         while ((c = getopt(argc, argv, "d:s:p")) != -1) {
                 switch (c) {
                         case 'd':
@@ -164,11 +163,20 @@ parse_app_args(int argc, char *argv[], const char *progname) {
 
                                 token = strtok_r(optarg, delim, &buffer);
                                 while (token != NULL) {
-                                        result = onvm_pkt_parse_ip(token, &state_info->source_ips[current_ip]);
+                                        result = onvm_pkt_parse_ip(token, &ip);
                                         if (result < 0) {
                                                 RTE_LOG(INFO, APP, "Invalid IP entered");
                                                 return -1;
                                         }
+                                        /* an earlier run may have left another address on the port */
+                                        onvm_arp_clear_local(state_info->arp_cache, ports->id[current_ip]);
+                                        state_info->num_local_ports = current_ip + 1;
+                                        /* 0.0.0.0 leaves the port without an address */
+                                        if (ip != 0 && onvm_arp_add_local(state_info->arp_cache, ip,
+                                                                          ports->id[current_ip]) < 0) {
+                                                RTE_LOG(INFO, APP, "Too many local IPs\n");
+                                                return -1;
+                                        }
                                         ++current_ip;
                                         token = strtok_r(NULL, delim, &buffer);
                                 }
@@ -207,106 +215,61 @@ parse_app_args(int argc, char *argv[], const char *progname) {
         return optind;
 }
 
-/* Creates an mbuf ARP reply pkt- fields are set according to info passed in.
- * For RFC about ARP, see https://tools.ietf.org/html/rfc826
- * RETURNS 0 if success, -1 otherwise */
-static int
-send_arp_reply(int port, struct rte_ether_addr *tha, uint32_t tip, struct onvm_nf *nf) {
-        struct rte_mbuf *out_pkt = NULL;
-        struct onvm_pkt_meta *pmeta = NULL;
-        struct rte_ether_hdr *eth_hdr = NULL;
-        struct rte_arp_hdr *out_arp_hdr = NULL;
-
-        size_t pkt_size = 0;
-
-        if (tha == NULL) {
-                return -1;
-        }
-
-        out_pkt = rte_pktmbuf_alloc(state_info->pktmbuf_pool);
-        if (out_pkt == NULL) {
-                rte_free(out_pkt);
-                return -1;
-        }
-
-        pkt_size = sizeof(struct rte_ether_hdr) + sizeof(struct rte_arp_hdr);
-        out_pkt->data_len = pkt_size;
-        out_pkt->pkt_len = pkt_size;
-
-        // SET ETHER HEADER INFO
-        eth_hdr = onvm_pkt_ether_hdr(out_pkt);
-        rte_ether_addr_copy(&ports->mac[port], &eth_hdr->s_addr);
-        eth_hdr->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_ARP);
-        rte_ether_addr_copy(tha, &eth_hdr->d_addr);
-
-        // SET ARP HDR INFO
-        out_arp_hdr = rte_pktmbuf_mtod_offset(out_pkt, struct rte_arp_hdr *, sizeof(struct rte_ether_hdr));
-
-        out_arp_hdr->arp_hardware = rte_cpu_to_be_16(RTE_ARP_HRD_ETHER);
-        out_arp_hdr->arp_protocol = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
-        out_arp_hdr->arp_hlen = 6;
-        out_arp_hdr->arp_plen = sizeof(uint32_t);
-        out_arp_hdr->arp_opcode = rte_cpu_to_be_16(RTE_ARP_OP_REPLY);
+static void
+print_stats(void) {
+        struct onvm_arp_cache *cache = state_info->arp_cache;
 
-        rte_ether_addr_copy(&ports->mac[port], &out_arp_hdr->arp_data.arp_sha);
-        out_arp_hdr->arp_data.arp_sip = rte_cpu_to_be_32(state_info->source_ips[ports->id[port]]);
+        printf("ARP packets: %" PRIu64 ", replies: %" PRIu64 ", neighbors learned: %" PRIu64
+               ", evicted: %" PRIu64 "\n",
+               state_info->arp_pkts, state_info->replies, cache->learned, cache->evicted);
+}
 
-        out_arp_hdr->arp_data.arp_tip = tip;
-        rte_ether_addr_copy(tha, &out_arp_hdr->arp_data.arp_tha);
+/*
+ * Requests for a local IP are answered in their own mbuf and every ARP
+ * sender is learned into the neighbor cache. ARP stops here, other packets
+ * go on to the destination NF.
+ */
+static void
+packet_burst_handler(struct rte_mbuf **pkts, uint16_t nb_pkts,
+                     __attribute__((unused)) struct onvm_nf_local_ctx *nf_local_ctx) {
+        struct rte_ether_hdr *eth_hdr;
+        struct onvm_pkt_meta *meta;
+        uint64_t replied;
+        uint16_t i;
+
+        replied = onvm_arp_reply_burst(state_info->arp_cache, pkts, nb_pkts, ports->mac);
+
+        for (i = 0; i < nb_pkts; i++) {
+                meta = onvm_get_pkt_meta(pkts[i]);
+                if (replied & (1ULL << i)) {
+                        state_info->arp_pkts++;
+                        state_info->replies++;
+                        if (state_info->print_flag) {
+                                printf("ARP Reply From Port %d\n", pkts[i]->port);
+                                print_stats();
+                        }
+                        continue;
+                }
 
-        // SEND PACKET OUT/SET METAINFO
-        pmeta = onvm_get_pkt_meta(out_pkt);
-        pmeta->destination = port;
-        pmeta->action = ONVM_NF_ACTION_OUT;
+                eth_hdr = onvm_pkt_ether_hdr(pkts[i]);
+                if (rte_be_to_cpu_16(eth_hdr->ether_type) == RTE_ETHER_TYPE_ARP) {
+                        state_info->arp_pkts++;
+                        meta->action = ONVM_NF_ACTION_DROP;
+                        continue;
+                }
 
-        return onvm_nflib_return_pkt(nf, out_pkt);
+                meta->destination = state_info->nf_destination;
+                meta->action = ONVM_NF_ACTION_TONF;
+        }
 }
 
-static int
-packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta,
-               __attribute__((unused)) struct onvm_nf_local_ctx *nf_local_ctx) {
-        struct rte_ether_hdr *eth_hdr = onvm_pkt_ether_hdr(pkt);
-        struct rte_arp_hdr *in_arp_hdr = NULL;
-        int result = -1;
-
-        /*
-         * First check if pkt is of type ARP:
-         * Then whether its an ARP REQUEST
-         *      if packet target IP matches machine IP send ARP REPLY
-         * If its an ARP REPLY send to dest
-         * Ignore (fwd to dest) other opcodes
-         */
-        if (rte_cpu_to_be_16(eth_hdr->ether_type) == RTE_ETHER_TYPE_ARP) {
-                in_arp_hdr = rte_pktmbuf_mtod_offset(pkt, struct rte_arp_hdr *, sizeof(struct rte_ether_hdr));
-                switch (rte_cpu_to_be_16(in_arp_hdr->arp_opcode)) {
-                        case RTE_ARP_OP_REQUEST:
-                                if (rte_be_to_cpu_32(in_arp_hdr->arp_data.arp_tip) ==
-                                                state_info->source_ips[ports->id[pkt->port]]) {
-                                        result = send_arp_reply(pkt->port, &eth_hdr->s_addr,
-                                                                in_arp_hdr->arp_data.arp_sip, nf_local_ctx->nf);
-                                        if (state_info->print_flag) {
-                                                printf("ARP Reply From Port %d (ID %d): %d\n", pkt->port,
-                                                       ports->id[pkt->port], result);
-                                        }
-                                        meta->action = ONVM_NF_ACTION_DROP;
-                                        return 0;
-                                }
-                                break;
-                        case RTE_ARP_OP_REPLY:
-                                /* Here we can potentially save the information */
-                                break;
-                        default:
-                                if (state_info->print_flag) {
-                                        printf("ARP with opcode %d, port %d (ID %d) DROPPED\n",
-                                                rte_cpu_to_be_16(in_arp_hdr->arp_opcode),
-                                                pkt->port, ports->id[pkt->port]);
-                                }
-                }
-        }
+/* Stop answering ARP for the addresses this NF set up */
+static void
+clear_local_ips(void) {
+        uint16_t i;
 
-        meta->destination = state_info->nf_destination;
-        meta->action = ONVM_NF_ACTION_TONF;
-        return 0;
+        for (i = 0; i < state_info->num_local_ports; i++)
+                onvm_arp_clear_local(state_info->arp_cache, ports->id[i]);
 }
 
 int
@@ -320,7 +283,7 @@ main(int argc, char *argv[]) {
         onvm_nflib_start_signal_handler(nf_local_ctx, NULL);
 
         nf_function_table = onvm_nflib_init_nf_function_table();
-        nf_function_table->pkt_handler = &packet_handler;
+        nf_function_table->pkt_burst_handler = &packet_burst_handler;
 
         if ((arg_offset = onvm_nflib_init(argc, argv, NF_TAG, nf_local_ctx, nf_function_table)) < 0) {
                 onvm_nflib_stop(nf_local_ctx);
@@ -341,19 +304,17 @@ main(int argc, char *argv[]) {
                 rte_exit(EXIT_FAILURE, "Unable to initialize NF state");
         }
 
-        state_info->pktmbuf_pool = rte_mempool_lookup(PKTMBUF_POOL_NAME);
-        if (state_info->pktmbuf_pool == NULL) {
-                onvm_nflib_stop(nf_local_ctx);
-                rte_exit(EXIT_FAILURE, "Cannot find mbuf pool!\n");
-        }
+        state_info->arp_cache = onvm_arp_nf_init();
 
         if (parse_app_args(argc, argv, progname) < 0) {
+                clear_local_ips();
                 onvm_nflib_stop(nf_local_ctx);
                 rte_exit(EXIT_FAILURE, "Invalid command-line arguments");
         }
 
         onvm_nflib_run(nf_local_ctx);
 
+        clear_local_ips();
         onvm_nflib_stop(nf_local_ctx);
         printf("If we reach here, program is ending\n");
         return 0;
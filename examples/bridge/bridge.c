@@ -35,7 +35,7 @@
  *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
  *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
- * bridge.c - send all packets from one port out the other.
+ * bridge.c - switch packets between ports by learned MAC address.
  ********************************************************************/
 
 #include <errno.h>
@@ -53,13 +53,29 @@
 #include <rte_ip.h>
 #include <rte_mbuf.h>
 
+#include "onvm_fdb.h"
 #include "onvm_nflib.h"
 #include "onvm_pkt_helper.h"
 
 #define NF_TAG "bridge"
 
+/* MAC addresses the bridge learns */
+#define BRIDGE_FDB_ENTRIES 4096
+/* seconds a learned MAC is kept without traffic from it */
+#define BRIDGE_FDB_AGING 300
+
+/* Shared data structure containing host port info. */
+extern struct port_info *ports;
+
 /* number of package between each print */
 static uint32_t print_delay = 1000000;
+static uint32_t aging = BRIDGE_FDB_AGING;
+/* forward port 0 to port 1 and back instead of learning */
+static int fixed_pairing = 0;
+
+static struct onvm_fdb *fdb;
+/* ports a flooded packet goes out of */
+static uint16_t flood_ports[RTE_MAX_ETHPORTS];
 
 /*
  * Print a usage message
@@ -67,10 +83,12 @@ static uint32_t print_delay = 1000000;
 static void
 usage(const char *progname) {
         printf("Usage:\n");
-        printf("%s [EAL args] -- [NF_LIB args] -- -p <print_delay>\n", progname);
+        printf("%s [EAL args] -- [NF_LIB args] -- [-p <print_delay>] [-a <aging>] [-f]\n", progname);
         printf("%s -F <CONFIG_FILE.json> [EAL args] -- [NF_LIB args] -- [NF args]\n\n", progname);
         printf("Flags:\n");
         printf(" - `-p <print_delay>`: number of packets between each print, e.g. `-p 1` prints every packets.\n");
+        printf(" - `-a <aging>`: seconds a learned MAC address is kept without traffic from it, default 300.\n");
+        printf(" - `-f`: forward between ports 0 and 1 without learning.\n");
 }
 
 /*
@@ -80,14 +98,20 @@ static int
 parse_app_args(int argc, char *argv[], const char *progname) {
         int c;
 
-        while ((c = getopt(argc, argv, "p:")) != -1) {
+        while ((c = getopt(argc, argv, "p:a:f")) != -1) {
                 switch (c) {
                         case 'p':
                                 print_delay = strtoul(optarg, NULL, 10);
                                 break;
+                        case 'a':
+                                aging = strtoul(optarg, NULL, 10);
+                                break;
+                        case 'f':
+                                fixed_pairing = 1;
+                                break;
                         case '?':
                                 usage(progname);
-                                if (optopt == 'p')
+                                if (optopt == 'p' || optopt == 'a')
                                         RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
                                 else if (isprint(optopt))
                                         RTE_LOG(INFO, APP, "Unknown option `-%c'.\n", optopt);
@@ -127,6 +151,11 @@ do_stats_display(struct rte_mbuf *pkt) {
         printf("Size : %d\n", pkt->pkt_len);
         printf("Type : %d\n", pkt->packet_type);
         printf("Number of packet processed : %" PRIu64 "\n", pkt_process);
+        if (fdb != NULL) {
+                printf("MAC addresses : %d\n", onvm_fdb_count(fdb));
+                printf("Learned : %" PRIu64 ", moved : %" PRIu64 ", aged : %" PRIu64 ", flooded : %" PRIu64 "\n",
+                       fdb->learned, fdb->moved, fdb->aged, fdb->flooded);
+        }
 
         ip = onvm_pkt_ipv4_hdr(pkt);
         if (ip != NULL) {
@@ -138,27 +167,45 @@ do_stats_display(struct rte_mbuf *pkt) {
         printf("\n\n");
 }
 
-static int
-packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta,
-               __attribute__((unused)) struct onvm_nf_local_ctx *nf_local_ctx) {
+static void
+packet_burst_handler(struct rte_mbuf **pkts, uint16_t nb_pkts, struct onvm_nf_local_ctx *nf_local_ctx) {
         static uint32_t counter = 0;
-        if (counter++ == print_delay) {
-                do_stats_display(pkt);
+        uint16_t dst_ports[PACKET_READ_SIZE];
+        struct onvm_pkt_meta *meta;
+        uint16_t i;
+
+        counter += nb_pkts;
+        if (counter >= print_delay) {
+                do_stats_display(pkts[0]);
                 counter = 0;
         }
 
-        if (pkt->port == 0) {
-                meta->destination = 1;
-        } else {
-                meta->destination = 0;
+        if (fixed_pairing) {
+                for (i = 0; i < nb_pkts; i++) {
+                        meta = onvm_get_pkt_meta(pkts[i]);
+                        meta->destination = pkts[i]->port == 0 ? 1 : 0;
+                        meta->action = ONVM_NF_ACTION_OUT;
+                }
+                return;
+        }
+
+        onvm_fdb_switch_burst(fdb, pkts, nb_pkts, dst_ports);
+        for (i = 0; i < nb_pkts; i++) {
+                meta = onvm_get_pkt_meta(pkts[i]);
+                if (dst_ports[i] == ONVM_FDB_FLOOD) {
+                        onvm_fdb_flood(fdb, nf_local_ctx->nf, pkts[i], flood_ports, ports->num_ports);
+                } else if (dst_ports[i] == ONVM_FDB_DROP) {
+                        meta->action = ONVM_NF_ACTION_DROP;
+                } else {
+                        meta->destination = dst_ports[i];
+                        meta->action = ONVM_NF_ACTION_OUT;
+                }
         }
-        meta->action = ONVM_NF_ACTION_OUT;
-        return 0;
 }
 
 int
 main(int argc, char *argv[]) {
-        int arg_offset;
+        int arg_offset, i;
         struct onvm_nf_local_ctx *nf_local_ctx;
         struct onvm_nf_function_table *nf_function_table;
         const char *progname = argv[0];
@@ -167,7 +214,7 @@ main(int argc, char *argv[]) {
         onvm_nflib_start_signal_handler(nf_local_ctx, NULL);
 
         nf_function_table = onvm_nflib_init_nf_function_table();
-        nf_function_table->pkt_handler = &packet_handler;
+        nf_function_table->pkt_burst_handler = &packet_burst_handler;
 
         if ((arg_offset = onvm_nflib_init(argc, argv, NF_TAG, nf_local_ctx, nf_function_table)) < 0) {
                 onvm_nflib_stop(nf_local_ctx);
@@ -187,9 +234,21 @@ main(int argc, char *argv[]) {
                 rte_exit(EXIT_FAILURE, "Invalid command-line arguments\n");
         }
 
+        if (!fixed_pairing) {
+                fdb = onvm_fdb_create(BRIDGE_FDB_ENTRIES, aging);
+                if (fdb == NULL) {
+                        onvm_nflib_stop(nf_local_ctx);
+                        rte_exit(EXIT_FAILURE, "Unable to create forwarding database\n");
+                }
+                for (i = 0; i < ports->num_ports; i++)
+                        flood_ports[i] = ports->id[i];
+        }
+        RTE_LOG(INFO, APP, "Switching %s\n", fixed_pairing ? "between ports 0 and 1" : "by learned MAC address");
+
         onvm_nflib_run(nf_local_ctx);
 
         onvm_nflib_stop(nf_local_ctx);
+        onvm_fdb_free(fdb);
         printf("If we reach here, program is ending\n");
         return 0;
 }
@@ -226,10 +226,8 @@ tx_loop(struct onvm_nf_local_ctx *nf_local_ctx) {
         int tx_batch_size;
         struct onvm_pkt_meta *meta;
         struct rte_ring *tx_ring;
-        struct rte_ring *msg_q;
         struct onvm_nf *nf;
-        struct onvm_nf_msg *msg;
-        struct rte_mempool *nf_msg_pool;
+        struct onvm_nf_msg msg;
         struct rte_mbuf *pkt;
         struct fairqueue_t *fair_queue;
 
@@ -239,8 +237,6 @@ tx_loop(struct onvm_nf_local_ctx *nf_local_ctx) {
 
         /* Get rings from nflib */
         tx_ring = nf->tx_q;
-        msg_q = nf->msg_q;
-        nf_msg_pool = rte_mempool_lookup(_NF_MSG_POOL_NAME);
 
         printf("Process %d handling packets using advanced rings\n", nf->instance_id);
         if (onvm_threading_core_affinitize(nf->thread_info.core) < 0)
@@ -249,15 +245,12 @@ tx_loop(struct onvm_nf_local_ctx *nf_local_ctx) {
         tx_batch_size = 0;
         while (!rte_atomic16_read(&signal_exit_flag)) {
                 /* Check for a stop message from the manager */
-                if (unlikely(rte_ring_count(msg_q) > 0)) {
-                        msg = NULL;
-                        rte_ring_dequeue(msg_q, (void **)(&msg));
-                        if (msg->msg_type == MSG_STOP) {
+                if (unlikely(onvm_nf_ctrl_dequeue_burst(&nf->ctrl_q, &msg, 1) > 0)) {
+                        if (msg.msg_type == MSG_STOP) {
                                 rte_atomic16_set(&signal_exit_flag, 1);
                         } else {
-                                printf("Received message %d, ignoring", msg->msg_type);
+                                printf("Received message %d, ignoring", msg.msg_type);
                         }
-                        rte_mempool_put(nf_msg_pool, (void *)msg);
                 }
 
                 /* Dequeue packet from the fair queue system */
@@ -287,12 +280,9 @@ rx_loop(struct onvm_nf_local_ctx *nf_local_ctx) {
         struct onvm_pkt_meta *meta;
         uint16_t i, nb_pkts;
         int tx_batch_size;
-        struct rte_ring *rx_ring;
         struct rte_ring *tx_ring;
-        struct rte_ring *msg_q;
         struct onvm_nf *nf;
-        struct onvm_nf_msg *msg;
-        struct rte_mempool *nf_msg_pool;
+        struct onvm_nf_msg msg;
         struct fairqueue_t *fair_queue;
 
         nf = nf_local_ctx->nf;
@@ -300,10 +290,7 @@ rx_loop(struct onvm_nf_local_ctx *nf_local_ctx) {
         onvm_nflib_nf_ready(nf);
 
         /* Get rings from nflib */
-        rx_ring = nf->rx_q;
         tx_ring = nf->tx_q;
-        msg_q = nf->msg_q;
-        nf_msg_pool = rte_mempool_lookup(_NF_MSG_POOL_NAME);
 
         printf("Process %d handling packets using advanced rings\n", nf->instance_id);
         if (onvm_threading_core_affinitize(nf->thread_info.core) < 0)
@@ -312,18 +299,15 @@ rx_loop(struct onvm_nf_local_ctx *nf_local_ctx) {
         tx_batch_size = 0;
         while (!rte_atomic16_read(&signal_exit_flag)) {
                 /* Check for a stop message from the manager */
-                if (unlikely(rte_ring_count(msg_q) > 0)) {
-                        msg = NULL;
-                        rte_ring_dequeue(msg_q, (void **)(&msg));
-                        if (msg->msg_type == MSG_STOP) {
+                if (unlikely(onvm_nf_ctrl_dequeue_burst(&nf->ctrl_q, &msg, 1) > 0)) {
+                        if (msg.msg_type == MSG_STOP) {
                                 rte_atomic16_set(&signal_exit_flag, 1);
                         } else {
-                                printf("Received message %d, ignoring", msg->msg_type);
+                                printf("Received message %d, ignoring", msg.msg_type);
                         }
-                        rte_mempool_put(nf_msg_pool, (void *)msg);
                 }
 
-                nb_pkts = rte_ring_dequeue_burst(rx_ring, pkts, PKT_READ_SIZE, NULL);
+                nb_pkts = onvm_nflib_rx_dequeue_burst(nf, pkts, PKT_READ_SIZE);
 
                 for (i = 0; i < nb_pkts; i++) {
                         if (fairqueue_enqueue(fair_queue, pkts[i]) == -1) {
@@ -55,11 +55,17 @@
 #include <rte_mbuf.h>
 #include <rte_malloc.h>
 
+#include "onvm_fdb.h"
 #include "onvm_nflib.h"
 #include "onvm_pkt_helper.h"
 
 #define NF_TAG "l2switch"
 
+/* MAC addresses learned in learning mode */
+#define L2FWD_FDB_ENTRIES 4096
+/* seconds a learned MAC is kept without traffic from it */
+#define L2FWD_FDB_AGING 300
+
 /* Shared data structure containing host port info. */
 extern struct port_info *ports;
 
@@ -83,6 +89,12 @@ struct state_info {
        int mac_updating;
        /* Print mac address disabled by default */
        int print_mac;
+       /* Switch by learned MAC address instead of port pairs, disabled by default */
+       int learning;
+       uint32_t aging;
+       struct onvm_fdb *fdb;
+       /* Ports a flooded packet goes out of */
+       uint16_t flood_ports[RTE_MAX_ETHPORTS];
 };
 
 /*
@@ -97,6 +109,8 @@ usage(const char *progname) {
         printf(" - `-p <print_delay>`: number of packets between each print, e.g. `-p 1` prints every packets.\n");
         printf(" - `-n : Disables mac updating. \n");
         printf(" - `-m : Enables printing updated mac address. \n");
+        printf(" - `-l : Switches by learned MAC address instead of port pairs, without mac updating. \n");
+        printf(" - `-a <aging>`: seconds a learned MAC address is kept without traffic from it, default 300.\n");
 }
 
 /*
@@ -106,7 +120,7 @@ static int
 parse_app_args(int argc, char *argv[], const char *progname, struct state_info *stats) {
         int c;
 
-        while ((c = getopt(argc, argv, "p:nm")) != -1) {
+        while ((c = getopt(argc, argv, "p:nmla:")) != -1) {
                 switch (c) {
                         case 'p':
                                 stats->print_delay = strtoul(optarg, NULL, 10);
@@ -119,9 +133,16 @@ parse_app_args(int argc, char *argv[], const char *progname, struct state_info *
                                 /* Enable printing of MAC address.*/
                                 stats->print_mac = 1;
                                 break;
+                        case 'l':
+                                /* Switch by learned MAC address. */
+                                stats->learning = 1;
+                                break;
+                        case 'a':
+                                stats->aging = strtoul(optarg, NULL, 10);
+                                break;
                         case '?':
                                 usage(progname);
-                                if (optopt == 'p')
+                                if (optopt == 'p' || optopt == 'a')
                                         RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
                                 else if (isprint(optopt))
                                         RTE_LOG(INFO, APP, "Unknown option `-%c'.\n", optopt);
@@ -163,12 +184,12 @@ print_stats(struct state_info *stats) {
 	for (i = 0; i < ports->num_ports; i++) {
 		printf("\nStatistics for port %u ------------------------------"
 			   "\nPackets sent: %24"PRIu64
-			   "\nPackets received: %20"PRIu64
-			   "\nForwarding to port: %u",
+			   "\nPackets received: %20"PRIu64,
 			   ports->id[i],
 			   stats->port_statistics[ports->id[i]].tx,
-			   stats->port_statistics[ports->id[i]].rx,
-			   stats->l2fwd_dst_ports[ports->id[i]]);
+			   stats->port_statistics[ports->id[i]].rx);
+		if (!stats->learning)
+			printf("\nForwarding to port: %u", stats->l2fwd_dst_ports[ports->id[i]]);
 
 		total_packets_tx += stats->port_statistics[ports->id[i]].tx;
 		total_packets_rx += stats->port_statistics[ports->id[i]].rx;
@@ -178,6 +199,19 @@ print_stats(struct state_info *stats) {
 		   "\nTotal packets received: %14"PRIu64,
 		   total_packets_tx,
 		   total_packets_rx);
+	if (stats->learning) {
+		printf("\nForwarding database ================================"
+			   "\nMAC addresses: %23d"
+			   "\nLearned: %29"PRIu64
+			   "\nMoved: %31"PRIu64
+			   "\nAged: %32"PRIu64
+			   "\nFlooded: %29"PRIu64,
+			   onvm_fdb_count(stats->fdb),
+			   stats->fdb->learned,
+			   stats->fdb->moved,
+			   stats->fdb->aged,
+			   stats->fdb->flooded);
+	}
 	printf("\n====================================================\n");
 }
 /*
@@ -249,23 +283,8 @@ l2fwd_set_dest_ports(struct state_info *stats) {
 
 }
 
-static int
-packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta,
-               __attribute__((unused)) struct onvm_nf_local_ctx *nf_local_ctx) {
-        static uint32_t counter = 0;
-        struct onvm_nf *nf = nf_local_ctx->nf;
-        struct state_info *stats = (struct state_info *)nf->data;
-        if (++counter == stats->print_delay) {
-                print_stats(stats);
-                counter = 0;
-        }
-        if (pkt->port > RTE_MAX_ETHPORTS) {
-                RTE_LOG(INFO, APP, "Packet source port greater than MAX ethernet ports allowed. \n");
-                meta->action = ONVM_NF_ACTION_DROP;
-                return 0;
-        }
-        /* Update stats packet received on port. */
-        stats->port_statistics[pkt->port].rx += 1;
+static void
+packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta, struct state_info *stats) {
         unsigned dst_port = stats->l2fwd_dst_ports[pkt->port];
 
         /* If mac_updating enabled update source and destination mac address of packet. */
@@ -277,13 +296,71 @@ packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta,
         /* Update stats packet sent from source port. */
         stats->port_statistics[dst_port].tx += 1;
         meta->action = ONVM_NF_ACTION_OUT;
-        return 0;
+}
+
+/* Send a packet out of the port its destination MAC was learned on, or out of every other port. */
+static void
+learning_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta, uint16_t dst_port, struct onvm_nf *nf,
+                 struct state_info *stats) {
+        uint16_t i;
+
+        if (dst_port == ONVM_FDB_FLOOD) {
+                onvm_fdb_flood(stats->fdb, nf, pkt, stats->flood_ports, ports->num_ports);
+                for (i = 0; i < ports->num_ports; i++) {
+                        if (ports->id[i] != pkt->port)
+                                stats->port_statistics[ports->id[i]].tx += 1;
+                }
+        } else if (dst_port == ONVM_FDB_DROP) {
+                /* The destination is on the port the packet came from */
+                stats->port_statistics[pkt->port].dropped += 1;
+                meta->action = ONVM_NF_ACTION_DROP;
+        } else {
+                meta->destination = dst_port;
+                stats->port_statistics[dst_port].tx += 1;
+                meta->action = ONVM_NF_ACTION_OUT;
+        }
+}
+
+static void
+packet_burst_handler(struct rte_mbuf **pkts, uint16_t nb_pkts, struct onvm_nf_local_ctx *nf_local_ctx) {
+        static uint32_t counter = 0;
+        struct onvm_nf *nf = nf_local_ctx->nf;
+        struct state_info *stats = (struct state_info *)nf->data;
+        uint16_t dst_ports[PACKET_READ_SIZE];
+        struct onvm_pkt_meta *meta;
+        uint16_t i;
+
+        counter += nb_pkts;
+        if (counter >= stats->print_delay) {
+                print_stats(stats);
+                counter = 0;
+        }
+
+        if (stats->learning)
+                onvm_fdb_switch_burst(stats->fdb, pkts, nb_pkts, dst_ports);
+
+        for (i = 0; i < nb_pkts; i++) {
+                meta = onvm_get_pkt_meta(pkts[i]);
+                if (pkts[i]->port > RTE_MAX_ETHPORTS) {
+                        RTE_LOG(INFO, APP, "Packet source port greater than MAX ethernet ports allowed. \n");
+                        meta->action = ONVM_NF_ACTION_DROP;
+                        continue;
+                }
+                /* Update stats packet received on port. */
+                stats->port_statistics[pkts[i]->port].rx += 1;
+
+                if (stats->learning)
+                        learning_handler(pkts[i], meta, dst_ports[i], nf, stats);
+                else
+                        packet_handler(pkts[i], meta, stats);
+        }
 }
 
 void
 nf_setup(struct onvm_nf_local_ctx *nf_local_ctx) {
         struct onvm_nf *nf = nf_local_ctx->nf;
         struct state_info *stats = (struct state_info *)nf->data;
+        uint16_t i;
 
         /* Initialize port stats. */
         memset(&stats->port_statistics, 0, sizeof(stats->port_statistics));
@@ -291,6 +368,10 @@ nf_setup(struct onvm_nf_local_ctx *nf_local_ctx) {
         /* Set destination port for each port. */
         l2fwd_set_dest_ports(stats);
 
+        /* Every port floods to every other port in learning mode. */
+        for (i = 0; i < ports->num_ports; i++)
+                stats->flood_ports[i] = ports->id[i];
+
         /* Get mac address for each port.  */
         l2fwd_initialize_ports(stats);
 
@@ -301,13 +382,14 @@ main(int argc, char *argv[]) {
         int arg_offset;
         struct onvm_nf_local_ctx *nf_local_ctx;
         struct onvm_nf_function_table *nf_function_table;
+        struct onvm_fdb *fdb;
         const char *progname = argv[0];
 
         nf_local_ctx = onvm_nflib_init_nf_local_ctx();
         onvm_nflib_start_signal_handler(nf_local_ctx, NULL);
 
         nf_function_table = onvm_nflib_init_nf_function_table();
-        nf_function_table->pkt_handler = &packet_handler;
+        nf_function_table->pkt_burst_handler = &packet_burst_handler;
         nf_function_table->setup = &nf_setup;
 
         if ((arg_offset = onvm_nflib_init(argc, argv, NF_TAG, nf_local_ctx, nf_function_table)) < 0) {
@@ -337,17 +419,31 @@ main(int argc, char *argv[]) {
         /* Print mac address disabled by default */
         stats->print_mac = 0;
         stats->print_delay = 1000000;
+        stats->aging = L2FWD_FDB_AGING;
         nf->data = (void *)stats;
 
         if (parse_app_args(argc, argv, progname, stats) < 0) {
                 onvm_nflib_stop(nf_local_ctx);
                 rte_exit(EXIT_FAILURE, "Invalid command-line arguments\n");
         }
+        if (stats->learning) {
+                /* A learning switch forwards frames unchanged, flooded copies share the packet's data */
+                stats->mac_updating = 0;
+                stats->fdb = onvm_fdb_create(L2FWD_FDB_ENTRIES, stats->aging);
+                if (stats->fdb == NULL) {
+                        onvm_nflib_stop(nf_local_ctx);
+                        rte_exit(EXIT_FAILURE, "Unable to create forwarding database\n");
+                }
+        }
+        RTE_LOG(INFO, APP, "MAC learning %s\n", stats->learning ? "enabled" : "disabled");
         RTE_LOG(INFO, APP, "MAC updating %s\n", stats->mac_updating ? "enabled" : "disabled");
 
         onvm_nflib_run(nf_local_ctx);
 
+        /* nf->data goes with the NF, keep the table it points to until the NF flushed its copies */
+        fdb = stats->fdb;
         onvm_nflib_stop(nf_local_ctx);
+        onvm_fdb_free(fdb);
         printf("If we reach here, program is ending\n");
         return 0;
 }
@@ -73,6 +73,7 @@ usage(const char *progname) {
         printf(" -e : Enable exact match. \n");
         printf(" -l : Enable longest prefix match. \n");
         printf(" -h : Specifies the hash entry number in decimal to be setup. Default is 4. \n");
+        printf(" -a <arp_service_id> : Sends ARP packets to the ARP NF with this service ID. \n");
 }
 
 /* Parse the application arguments. */
@@ -80,7 +81,7 @@ static int
 parse_app_args(int argc, char *argv[], const char *progname, struct state_info *stats) {
         int c;
 
-        while ((c = getopt(argc, argv, "h:p:e")) != -1) {
+        while ((c = getopt(argc, argv, "h:p:ea:")) != -1) {
                 switch (c) {
                         case 'h':
                                 stats->hash_entry_number = strtoul(optarg, NULL, 10);
@@ -92,9 +93,12 @@ parse_app_args(int argc, char *argv[], const char *progname, struct state_info *
                                 stats->l3fwd_lpm_on = 0;
                                 stats->l3fwd_em_on = 1;
                                 break;
+                        case 'a':
+                                stats->arp_service = strtoul(optarg, NULL, 10);
+                                break;
                         case '?':
                                 usage(progname);
-                                if (optopt == 'p')
+                                if (optopt == 'p' || optopt == 'a')
                                         RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
                                 else if (isprint(optopt))
                                         RTE_LOG(INFO, APP, "Unknown option `-%c'.\n", optopt);
@@ -137,9 +141,11 @@ print_stats(__attribute__((unused)) struct onvm_nf_local_ctx *nf_local_ctx) {
         }
         printf("\nAggregate statistics ==============================="
                    "\nTotal packets forwarded: %17"PRIu64
-                   "\nPackets dropped: %18"PRIu64,
+                   "\nPackets dropped: %18"PRIu64
+                   "\nNeighbor MACs set: %16"PRIu64,
                    total_packets,
-                   stats->packets_dropped);
+                   stats->packets_dropped,
+                   stats->neighbor_hits);
         printf("\n====================================================\n");
 
         printf("\n\n");
@@ -165,7 +171,8 @@ packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta,
         }
         struct rte_ether_hdr *eth_hdr;
         struct ipv4_hdr *ipv4_hdr;
-        uint16_t dst_port;
+        struct rte_ether_addr neighbor_mac;
+        uint16_t dst_port, neighbor_port;
 
         eth_hdr = rte_pktmbuf_mtod(pkt, struct rte_ether_hdr *);
         if (onvm_pkt_is_ipv4(pkt)) {
@@ -195,8 +202,14 @@ packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta,
                 --(ipv4_hdr->time_to_live);
                 ++(ipv4_hdr->hdr_checksum);
 #endif
-                /* dst addr */
-                *(uint64_t *)&eth_hdr->d_addr = stats->dest_eth_addr[dst_port];
+                /* dst addr, the neighbor's if the ARP NF has learned it behind dst_port */
+                if (onvm_arp_lookup(stats->arp_cache, rte_be_to_cpu_32(ipv4_hdr->dst_addr), &neighbor_mac,
+                                    &neighbor_port) == 0 && neighbor_port == dst_port) {
+                        rte_ether_addr_copy(&neighbor_mac, &eth_hdr->d_addr);
+                        stats->neighbor_hits++;
+                } else {
+                        *(uint64_t *)&eth_hdr->d_addr = stats->dest_eth_addr[dst_port];
+                }
 
                 /* src addr */
                 rte_ether_addr_copy(&stats->ports_eth_addr[dst_port], &eth_hdr->s_addr);
@@ -204,6 +217,11 @@ packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta,
                 meta->destination = dst_port;
                 stats->port_statistics[dst_port]++;
                 meta->action = ONVM_NF_ACTION_OUT;
+        } else if (stats->arp_service >= 0 &&
+                   rte_be_to_cpu_16(eth_hdr->ether_type) == RTE_ETHER_TYPE_ARP) {
+                /* Punt ARP to the ARP NF, it answers for us and keeps the neighbor cache */
+                meta->destination = stats->arp_service;
+                meta->action = ONVM_NF_ACTION_TONF;
         } else {
                 meta->action = ONVM_NF_ACTION_DROP;
                 stats->packets_dropped++;
@@ -262,6 +280,7 @@ nf_setup(struct onvm_nf_local_ctx *nf_local_ctx) {
         struct state_info *stats = (struct state_info *)nf->data;
         l3fwd_initialize_ports(stats);
         l3fwd_initialize_dst(stats);
+        stats->arp_cache = onvm_arp_nf_init();
         /*
          * Hash flags are valid only for exact macth,
          * reset them to default for longest-prefix match.
@@ -327,6 +346,7 @@ main(int argc, char *argv[]) {
         stats->l3fwd_lpm_on = 1;
         stats->l3fwd_em_on = 0;
         stats->hash_entry_number = HASH_ENTRY_NUMBER_DEFAULT;
+        stats->arp_service = -1;
         nf->data = (void *)stats;
 
         /* Parse application arguments. */
@@ -38,6 +38,7 @@
  * l3switch.h - This application performs L3 forwarding.
  ********************************************************************/
 
+#include "onvm_arp.h"
 #include "onvm_flow_table.h"
 
 #ifndef __L3_SWITCH_H_
@@ -65,6 +66,11 @@ struct state_info {
         xmm_t val_eth[RTE_MAX_ETHPORTS];
         uint64_t dest_eth_addr[RTE_MAX_ETHPORTS];
         uint64_t packets_dropped;
+        /* neighbors learned by the ARP NF, and packets addressed with them */
+        struct onvm_arp_cache *arp_cache;
+        uint64_t neighbor_hits;
+        /* service ID ARP packets are punted to, -1 to drop them */
+        int arp_service;
         uint32_t print_delay;
         uint32_t hash_entry_number;
         int8_t l3fwd_lpm_on;
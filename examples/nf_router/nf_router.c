@@ -55,6 +55,7 @@
 #include <rte_malloc.h>
 #include <rte_mbuf.h>
 
+#include "onvm_arp.h"
 #include "onvm_nflib.h"
 #include "onvm_pkt_helper.h"
 
@@ -65,6 +66,12 @@ uint8_t nf_count;
 char *cfg_filename;
 struct forward_nf *fwd_nf;
 
+/* neighbors learned by the ARP NF */
+static struct onvm_arp_cache *arp_cache;
+/* service ID all ARP packets are punted to, -1 to match them against the config */
+static int arp_service = -1;
+static uint64_t neighbor_hits;
+
 struct forward_nf {
         uint32_t ip;
         uint8_t dest;
@@ -84,6 +91,7 @@ usage(const char *progname) {
         printf("Flags:\n");
         printf(" - `-f <router_cfg>`: router configuration, has a list of (IPs, dest) tuples \n");
         printf(" - `-p <print_delay>`: number of packets between each print, e.g. `-p 1` prints every packets.\n");
+        printf(" - `-a <arp_service_id>`: send all ARP packets to the ARP NF with this service ID.\n");
 }
 
 /*
@@ -93,7 +101,7 @@ static int
 parse_app_args(int argc, char *argv[], const char *progname) {
         int c = 0;
 
-        while ((c = getopt(argc, argv, "f:p:")) != -1) {
+        while ((c = getopt(argc, argv, "f:p:a:")) != -1) {
                 switch (c) {
                         case 'f':
                                 cfg_filename = strdup(optarg);
@@ -101,11 +109,14 @@ parse_app_args(int argc, char *argv[], const char *progname) {
                         case 'p':
                                 print_delay = strtoul(optarg, NULL, 10);
                                 break;
+                        case 'a':
+                                arp_service = strtoul(optarg, NULL, 10);
+                                break;
                         case '?':
                                 usage(progname);
                                 if (optopt == 'd')
                                         RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
-                                else if (optopt == 'p')
+                                else if (optopt == 'p' || optopt == 'a')
                                         RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
                                 else if (isprint(optopt))
                                         RTE_LOG(INFO, APP, "Unknown option `-%c'.\n", optopt);
@@ -198,6 +209,7 @@ do_stats_display(struct rte_mbuf *pkt) {
         printf("Port : %d\n", pkt->port);
         printf("Size : %d\n", pkt->pkt_len);
         printf("N°   : %" PRIu64 "\n", pkt_process);
+        printf("Neighbor MACs set : %" PRIu64 "\n", neighbor_hits);
         printf("\n\n");
 
         ip = onvm_pkt_ipv4_hdr(pkt);
@@ -208,6 +220,24 @@ do_stats_display(struct rte_mbuf *pkt) {
         }
 }
 
+/*
+ * Address a routed packet to its destination if the ARP NF has learned it,
+ * so the NF it goes to can send it out as is.
+ */
+static inline void
+set_neighbor_mac(struct rte_mbuf *pkt, uint32_t dst_ip) {
+        struct rte_ether_hdr *eth_hdr;
+        struct rte_ether_addr mac;
+        uint16_t port;
+
+        if (onvm_arp_lookup(arp_cache, dst_ip, &mac, &port) < 0)
+                return;
+        eth_hdr = onvm_pkt_ether_hdr(pkt);
+        rte_ether_addr_copy(&mac, &eth_hdr->d_addr);
+        rte_ether_addr_copy(&ports->mac[port], &eth_hdr->s_addr);
+        neighbor_hits++;
+}
+
 static int
 packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta,
                __attribute__((unused)) struct onvm_nf_local_ctx *nf_local_ctx) {
@@ -222,6 +252,12 @@ packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta,
         /* If the packet doesn't have an IP header check if its an ARP, if so fwd it to the matched NF */
         if (ip == NULL) {
                 eth_hdr = onvm_pkt_ether_hdr(pkt);
+                if (rte_cpu_to_be_16(eth_hdr->ether_type) == RTE_ETHER_TYPE_ARP && arp_service >= 0) {
+                        /* Punt all ARP to the ARP NF, it keeps the neighbor cache */
+                        meta->destination = arp_service;
+                        meta->action = ONVM_NF_ACTION_TONF;
+                        return 0;
+                }
                 if (rte_cpu_to_be_16(eth_hdr->ether_type) == RTE_ETHER_TYPE_ARP) {
                         in_arp_hdr = rte_pktmbuf_mtod_offset(pkt, struct rte_arp_hdr *, sizeof(struct rte_ether_hdr));
                         for (i = 0; i < nf_count; i++) {
@@ -244,6 +280,7 @@ packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta,
 
         for (i = 0; i < nf_count; i++) {
                 if (fwd_nf[i].ip == rte_be_to_cpu_32(ip->dst_addr)) {
+                        set_neighbor_mac(pkt, fwd_nf[i].ip);
                         meta->destination = fwd_nf[i].dest;
                         meta->action = ONVM_NF_ACTION_TONF;
                         return 0;
@@ -287,6 +324,7 @@ main(int argc, char *argv[]) {
                 rte_exit(EXIT_FAILURE, "Invalid command-line arguments\n");
         }
         parse_router_config();
+        arp_cache = onvm_arp_nf_init();
 
         onvm_nflib_run(nf_local_ctx);
 
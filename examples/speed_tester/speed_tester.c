@@ -98,6 +98,10 @@ static uint8_t measure_latency = 0;
 static uint32_t latency_packets = 0;
 static uint64_t total_latency = 0;
 
+/* Core migration benchmark: move between the start core and migrate_core every migrate_interval seconds */
+static int migrate_core = -1;
+static uint32_t migrate_interval = 5;
+
 /*
  * Variables needed to replay a pcap file
  */
@@ -115,7 +119,7 @@ usage(const char *progname) {
         printf(
             "%s [EAL args] -- [NF_LIB args] -- -d <destination> [-p <print_delay>] "
             "[-s <packet_length>] [-m <dest_mac_address>] [-o <pcap_filename>] "
-            "[-c <packet_number>] [-l]\n",
+            "[-c <packet_number>] [-l] [-M <core> [-i <seconds>]]\n",
             progname);
         printf("%s -F <CONFIG_FILE.json> [EAL args] -- [NF_LIB args] -- [NF args]\n\n", progname);
         printf("Flags:\n");
@@ -134,6 +138,10 @@ usage(const char *progname) {
         printf(
             " - `-c PACKET_NUMBER` : Use user specified number of packets in the batch. If not specified then this "
             "defaults to 128.\n");
+        printf(
+            " - `-M CORE` : Benchmark core migration, the NF moves between its start core and CORE while "
+            "sending.\n");
+        printf(" - `-i SECONDS` : Seconds between two moves when `-M` is set. Defaults to 5.\n");
 }
 
 /*
@@ -144,7 +152,7 @@ parse_app_args(int argc, char *argv[], const char *progname) {
         int c, i, count, dst_flag = 0;
         int values[RTE_ETHER_ADDR_LEN];
 
-        while ((c = getopt(argc, argv, "d:p:s:m:o:c:l")) != -1) {
+        while ((c = getopt(argc, argv, "d:p:s:m:o:c:lM:i:")) != -1) {
                 switch (c) {
                         case 'd':
                                 destination = strtoul(optarg, NULL, 10);
@@ -190,6 +198,16 @@ parse_app_args(int argc, char *argv[], const char *progname) {
                         case 'l':
                                 measure_latency = 1;
                                 break;
+                        case 'M':
+                                migrate_core = strtoul(optarg, NULL, 10);
+                                break;
+                        case 'i':
+                                migrate_interval = strtoul(optarg, NULL, 10);
+                                if (migrate_interval == 0) {
+                                        RTE_LOG(INFO, APP, "Migration interval must be at least 1 second\n");
+                                        return -1;
+                                }
+                                break;
                         case '?':
                                 usage(progname);
                                 if (optopt == 'd')
@@ -202,6 +220,10 @@ parse_app_args(int argc, char *argv[], const char *progname) {
                                         RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
                                 else if (optopt == 'c')
                                         RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
+                                else if (optopt == 'M')
+                                        RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
+                                else if (optopt == 'i')
+                                        RTE_LOG(INFO, APP, "Option -%c requires an argument.\n", optopt);
                                 else if (isprint(optopt))
                                         RTE_LOG(INFO, APP, "Unknown option `-%c'.\n", optopt);
                                 else
@@ -228,7 +250,7 @@ parse_app_args(int argc, char *argv[], const char *progname) {
  * than one lcore enabled.
  */
 static void
-do_stats_display(struct rte_mbuf *pkt) {
+do_stats_display(struct rte_mbuf *pkt, struct onvm_nf *nf) {
         static uint64_t last_cycles;
         static uint64_t cur_pkts = 0;
         static uint64_t last_pkts = 0;
@@ -249,6 +271,12 @@ do_stats_display(struct rte_mbuf *pkt) {
                 printf("Avg latency nanoseconds: %6" PRIu64 " \n",
                        total_latency / (latency_packets)*1000000000 / rte_get_timer_hz());
         printf("Initial packets created: %u\n", packet_number);
+        if (migrate_core >= 0) {
+                printf("Core: %u, migrations: %" PRIu64 "\n", nf->thread_info.core, (uint64_t)nf->stats.migrations);
+                printf("Last stall: %" PRIu64 " us, max stall: %" PRIu64 " us\n", (uint64_t)nf->stats.migrate_stall_us,
+                       (uint64_t)nf->stats.migrate_stall_max_us);
+                printf("Packets lost: %" PRIu64 "\n", (uint64_t)(nf->stats.rx_drop + nf->stats.tx_drop));
+        }
 
         total_latency = 0;
         latency_packets = 0;
@@ -260,11 +288,10 @@ do_stats_display(struct rte_mbuf *pkt) {
 }
 
 static int
-packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta,
-               __attribute__((unused)) struct onvm_nf_local_ctx *nf_local_ctx) {
+packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta, struct onvm_nf_local_ctx *nf_local_ctx) {
         static uint32_t counter = 0;
         if (counter++ == print_delay) {
-                do_stats_display(pkt);
+                do_stats_display(pkt, nf_local_ctx->nf);
                 counter = 0;
         }
 
@@ -288,6 +315,35 @@ packet_handler(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta,
         return 0;
 }
 
+/*
+ * Asks the manager to move this NF back and forth between its start core and
+ * migrate_core while packets keep circulating at full rate.
+ */
+static int
+migrate_bench(struct onvm_nf_local_ctx *nf_local_ctx) {
+        static uint64_t last_move = 0;
+        static uint16_t start_core;
+        struct onvm_nf *nf = nf_local_ctx->nf;
+        uint64_t cur_cycles = rte_get_tsc_cycles();
+        uint16_t core;
+
+        if (last_move == 0) {
+                last_move = cur_cycles;
+                start_core = nf->thread_info.core;
+                return 0;
+        }
+
+        if (cur_cycles - last_move < (uint64_t)migrate_interval * rte_get_timer_hz())
+                return 0;
+        last_move = cur_cycles;
+
+        core = (nf->thread_info.core == start_core) ? (uint16_t)migrate_core : start_core;
+        if (onvm_nflib_request_migrate(nf, core) < 0)
+                RTE_LOG(INFO, APP, "Failed to request a move to core %u\n", core);
+
+        return 0;
+}
+
 /*
  * Generates fake packets or loads them from a pcap file
  */
@@ -467,6 +523,9 @@ main(int argc, char *argv[]) {
                 rte_exit(EXIT_FAILURE, "Invalid command-line arguments\n");
         }
 
+        if (migrate_core >= 0)
+                nf_function_table->user_actions = &migrate_bench;
+
         onvm_nflib_run(nf_local_ctx);
 
         onvm_nflib_stop(nf_local_ctx);
@@ -30,6 +30,18 @@ function usage {
         echo -e "\tRuns ONVM the same way as above, but adds a --base-virtaddr dpdk parameter to overwrite default address"
         echo -e "$0 -k 3 -n 0xF0 -m 2,3,4 -r 10 -d 2"
         echo -e "\tRuns ONVM the same way as above, but limits max service IDs to 10 and uses service ID 2 as the default"
+        echo -e "$0 -k 3 -n 0xF0 -m 2,3,4 -s stdout -w /var/run/onvm_flows.snap -i 30"
+        echo -e "\tRuns ONVM the same way as above, but restores the flow director from the snapshot file on start and saves it every 30 seconds and on exit"
+        echo -e "$0 -k 3 -n 0xF0 -m 2,3,4 -s stdout -C chains.json"
+        echo -e "\tRuns ONVM the same way as above, but sends flow director misses to the chains in chains.json instead of only the default service"
+        echo -e "$0 -k 3 -n 0xF0 -m 2,3,4 -s stdout -C chains.json -o"
+        echo -e "\tRuns ONVM the same way as above, but lets the NICs classify the chain rules they support with rte_flow"
+        echo -e "$0 -k 3 -n 0xF0 -m 2,3,4 -s stdout -q head"
+        echo -e "\tRuns ONVM the same way as above, but a full NF or port buffer drops its oldest packet instead of the arriving one"
+        echo -e "$0 -k 3 -n 0xF0 -m 2,3,4 -s stdout -b 8,32"
+        echo -e "\tRuns ONVM the same way as above, but the adaptive RX/TX burst size stays between 8 and 32 packets"
+        echo -e "$0 -k 0 -n 0xF0 -m 2,3,4 -s stdout -x veth0 -x veth1,busy_budget=64"
+        echo -e "\tRuns ONVM over kernel interfaces veth0 and veth1 through the net_af_xdp PMD, passing busy_budget=64 to the veth1 port"
         exit 1
 }
 
@@ -112,7 +124,7 @@ then
     exit 1
 fi
 
-while getopts "a:r:d:s:t:l:p:z:cvm:k:n:j" opt; do
+while getopts "a:r:d:s:t:l:p:z:cvm:k:n:jw:i:C:oq:b:x:" opt; do
     case $opt in
         a) virt_addr="--base-virtaddr=$OPTARG";;
         r) num_srvc="-r $OPTARG";;
@@ -155,6 +167,13 @@ while getopts "a:r:d:s:t:l:p:z:cvm:k:n:j" opt; do
                 nf_cores=$OPTARG
             fi;;
         j) jumbo_frames_flag="-j";;
+        w) ft_snapshot="-w $OPTARG";;
+        i) ft_snapshot_interval="-i $OPTARG";;
+        C) chain_config="-C $OPTARG";;
+        o) chain_offload="-o";;
+        q) overflow_policy="-q $OPTARG";;
+        b) burst_bounds="-b $OPTARG";;
+        x) af_xdp_ports="${af_xdp_ports} -x $OPTARG";;
         \?) echo "Unknown option -$OPTARG" && usage
             ;;
     esac
@@ -280,7 +299,7 @@ sudo rm -rf /mnt/huge/rtemap_*
 
 # watch out for variable expansion
 # shellcheck disable=SC2086
-sudo "$SCRIPTPATH"/onvm_mgr/"$RTE_TARGET"/onvm_mgr -l "$cpu" -n 4 --proc-type=primary ${virt_addr} --socket-mem=${ONVM_DPDK_SOCKET_MEM} -- -p ${ports} -n ${nf_cores} ${num_srvc} ${def_srvc} ${stats} ${stats_sleep_time} ${verbosity_level} ${ttl} ${packet_limit} ${shared_cpu_flag} ${jumbo_frames_flag}
+sudo "$SCRIPTPATH"/onvm_mgr/"$RTE_TARGET"/onvm_mgr -l "$cpu" -n 4 --proc-type=primary ${virt_addr} --socket-mem=${ONVM_DPDK_SOCKET_MEM} -- -p ${ports} -n ${nf_cores} ${num_srvc} ${def_srvc} ${stats} ${stats_sleep_time} ${verbosity_level} ${ttl} ${packet_limit} ${shared_cpu_flag} ${jumbo_frames_flag} ${ft_snapshot} ${ft_snapshot_interval} ${chain_config} ${chain_offload} ${overflow_policy} ${burst_bounds} ${af_xdp_ports}
 
 if [ "${stats}" = "-s web" ]
 then
@@ -7,12 +7,16 @@
  *   This eBPF program is loaded onto the NIC's XDP hook by the
  *   userspace AF_XDP manager. It acts as the "Gatekeeper":
  *
- *     1. For each incoming packet, check if an AF_XDP socket is
- *        bound to this RX queue in the XSKMAP.
- *     2. If yes  → bpf_redirect_map() into the AF_XDP socket
+ *     1. For each incoming IPv4 packet, look up its flow in the
+ *        flow_map. If an NF owns the flow and its socket is bound to
+ *        this RX queue, bpf_redirect_map() straight into the NF's
+ *        own AF_XDP socket (no manager hop).
+ *     2. Otherwise check if the manager's AF_XDP socket is bound to
+ *        this RX queue in the XSKMAP.
+ *     3. If yes  → bpf_redirect_map() into the AF_XDP socket
  *                   (packet goes directly to userspace, bypassing
  *                   the entire Linux kernel network stack).
- *     3. If no   → XDP_PASS (let the kernel handle it normally).
+ *     4. If no   → XDP_PASS (let the kernel handle it normally).
  *
  *   This is the XDP "brain" from the architecture document:
  *     - XDP decides WHICH packets go to the NF manager
@@ -31,6 +35,7 @@
 #include <linux/in.h>
 #include <linux/ip.h>
 #include <linux/tcp.h>
+#include <linux/udp.h>
 
 #ifndef bpf_htons
 #define bpf_htons(x) __builtin_bswap16(x)
@@ -47,25 +52,74 @@
  ****************************************************************************/
 
 /*
- * XSKMAP: Maps RX queue indices → AF_XDP socket file descriptors.
+ * First XSKMAP slot used by NF sockets, and the number of NF slots.
+ * Must match AFXDP_NF_XSK_BASE and AFXDP_MAX_NFS in onvm_afxdp_config.h.
+ */
+#define AFXDP_NF_XSK_BASE       64
+#define AFXDP_MAX_NFS           64
+
+/*
+ * XSKMAP: Maps slots → AF_XDP socket file descriptors.
  *
- * When the userspace manager creates an AF_XDP socket and binds it
- * to RX queue N, it inserts the socket fd into xsks_map[N].
- * This eBPF program then uses bpf_redirect_map() to steer packets
- * arriving on queue N directly into that socket.
+ * Slots 0-63 hold the manager's sockets: when the userspace manager
+ * creates an AF_XDP socket and binds it to RX queue N, it inserts the
+ * socket fd into xsks_map[N]. This eBPF program then uses
+ * bpf_redirect_map() to steer packets arriving on queue N directly
+ * into that socket.
+ *
+ * Slots AFXDP_NF_XSK_BASE + n hold the socket owned by NF n. NF
+ * sockets share the manager's UMEM and are only reached through the
+ * flow_map below.
  *
  * Type:        BPF_MAP_TYPE_XSKMAP
- * Key:         __u32 (RX queue index)
+ * Key:         __u32 (RX queue index, or AFXDP_NF_XSK_BASE + NF id)
  * Value:       __u32 (XSK socket fd, managed by the kernel)
- * Max entries: 64 (one per possible RX queue)
+ * Max entries: 128 (one per possible RX queue, one per NF)
  */
 struct {
         __uint(type, BPF_MAP_TYPE_XSKMAP);
         __type(key, __u32);
         __type(value, __u32);
-        __uint(max_entries, 64);
+        __uint(max_entries, AFXDP_NF_XSK_BASE + AFXDP_MAX_NFS);
 } xsks_map SEC(".maps");
 
+/*
+ * Flow classification key and target.
+ * Must match struct afxdp_flow_key / afxdp_flow_target in
+ * onvm_afxdp_types.h.
+ */
+struct afxdp_flow_key {
+        __u32 dst_ip;                   /* network order, 0 = any address */
+        __u16 dst_port;                 /* network order, 0 if not TCP/UDP */
+        __u8 proto;                     /* IP protocol number */
+        __u8 pad;
+};
+
+struct afxdp_flow_target {
+        __u32 xsk_index;                /* XSKMAP slot of the NF socket */
+        __u32 queue;                    /* RX queue the NF socket is bound to */
+};
+
+/*
+ * Flow map: steers IPv4 flows to the NF that owns them.
+ *
+ * Populated by the userspace manager when an NF registers a flow.
+ * A packet is looked up by (dst_ip, proto, dst_port) first and then by
+ * (any, proto, dst_port), so one rule can cover a service on every
+ * local address. Packets that match nothing go to the manager.
+ *
+ * Type:        BPF_MAP_TYPE_HASH
+ * Key:         struct afxdp_flow_key
+ * Value:       struct afxdp_flow_target
+ * Max entries: 1024 (AFXDP_MAX_FLOW_RULES)
+ */
+struct {
+        __uint(type, BPF_MAP_TYPE_HASH);
+        __type(key, struct afxdp_flow_key);
+        __type(value, struct afxdp_flow_target);
+        __uint(max_entries, 1024);
+} flow_map SEC(".maps");
+
 /*
  * Per-CPU statistics map: Counts packets seen per RX queue.
  *
@@ -85,6 +139,28 @@ struct {
         __uint(max_entries, 64);
 } xdp_stats_map SEC(".maps");
 
+/****************************************************************************
+ *
+ *  FLOW CLASSIFICATION
+ *
+ *  Look up the NF that owns a flow: an exact destination address rule
+ *  wins over a wildcard one. Returns NULL for unclassified traffic.
+ *
+ ****************************************************************************/
+
+static __always_inline struct afxdp_flow_target *
+afxdp_classify(struct afxdp_flow_key *key)
+{
+        struct afxdp_flow_target *target;
+
+        target = bpf_map_lookup_elem(&flow_map, key);
+        if (target)
+                return target;
+
+        key->dst_ip = 0;
+        return bpf_map_lookup_elem(&flow_map, key);
+}
+
 /****************************************************************************
  *
  *  XDP PROGRAM: Ingress Steering
@@ -95,9 +171,11 @@ struct {
  *  Decision logic:
  *    1. Get the RX queue index from the packet context
  *    2. Increment the per-queue packet counter (for monitoring)
- *    3. Check if an AF_XDP socket exists for this queue
- *    4. If yes → redirect into the AF_XDP socket (zero-copy to userspace)
- *    5. If no  → pass to the normal kernel stack
+ *    3. If an NF owns the packet's flow and its socket is bound to
+ *       this queue → redirect into the NF's socket
+ *    4. Else check if the manager's AF_XDP socket exists for this queue
+ *    5. If yes → redirect into the AF_XDP socket (zero-copy to userspace)
+ *    6. If no  → pass to the normal kernel stack
  *
  ****************************************************************************/
 
@@ -107,6 +185,9 @@ int xdp_sock_prog(struct xdp_md *ctx)
         void *data_end = (void *)(long)ctx->data_end;
         void *data = (void *)(long)ctx->data;
         struct ethhdr *eth = data;
+        struct afxdp_flow_key key = {};
+        struct afxdp_flow_target *target;
+        int classify = 0;
 
         /* 1. Boundary check for Ethernet header */
         if ((void *)(eth + 1) > data_end)
@@ -118,17 +199,21 @@ int xdp_sock_prog(struct xdp_md *ctx)
                 return XDP_PASS;
 
         /* 3. Pass SSH traffic directly to the host network stack 
-         *    so your SSH connection is not broken. */
+         *    so your SSH connection is not broken. Build the flow
+         *    key of everything else on the way. */
         if (eth->h_proto == bpf_htons(ETH_P_IP)) {
                 struct iphdr *iph = (struct iphdr *)(eth + 1);
+                void *l4;
 
                 /* Boundary check for IP header */
                 if ((void *)(iph + 1) > data_end)
                         return XDP_PASS;
 
+                /* Jump to L4 header (accounting for possible IP options) */
+                l4 = (__u8 *)iph + (iph->ihl * 4);
+
                 if (iph->protocol == IPPROTO_TCP) {
-                        /* Jump to TCP header (accounting for possible IP options) */
-                        struct tcphdr *tcph = (struct tcphdr *)((__u8 *)iph + (iph->ihl * 4));
+                        struct tcphdr *tcph = l4;
 
                         /* Boundary check for TCP header */
                         if ((void *)(tcph + 1) > data_end)
@@ -137,7 +222,21 @@ int xdp_sock_prog(struct xdp_md *ctx)
                         /* If destination or source port is 22 (SSH) */
                         if (tcph->dest == bpf_htons(22) || tcph->source == bpf_htons(22))
                                 return XDP_PASS;
+
+                        key.dst_port = tcph->dest;
+                } else if (iph->protocol == IPPROTO_UDP) {
+                        struct udphdr *udph = l4;
+
+                        /* Boundary check for UDP header */
+                        if ((void *)(udph + 1) > data_end)
+                                return XDP_PASS;
+
+                        key.dst_port = udph->dest;
                 }
+
+                key.dst_ip = iph->daddr;
+                key.proto = iph->protocol;
+                classify = 1;
         }
 
         /* ----- AF_XDP REDIRECT LOGIC ----- */
@@ -151,6 +250,19 @@ int xdp_sock_prog(struct xdp_md *ctx)
                 (*pkt_count)++;
         }
 
+        /*
+         * Steer classified flows straight to the owning NF's socket.
+         * An XSK only accepts packets from the queue it is bound to, so
+         * packets of the flow arriving on another queue, or after the
+         * NF detached, fall through to the manager.
+         */
+        if (classify) {
+                target = afxdp_classify(&key);
+                if (target && target->queue == (__u32)index &&
+                    bpf_map_lookup_elem(&xsks_map, &target->xsk_index))
+                        return bpf_redirect_map(&xsks_map, target->xsk_index, 0);
+        }
+
         /* Check if an AF_XDP socket exists for this queue */
         if (bpf_map_lookup_elem(&xsks_map, &index))
                 return bpf_redirect_map(&xsks_map, index, 0);
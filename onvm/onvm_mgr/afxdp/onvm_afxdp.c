@@ -43,16 +43,23 @@
 
     Implementation of the AF_XDP-based NF Manager datapath.
 
-    The manager IS the only NF: it receives packets from the NIC via
-    an AF_XDP socket and immediately sends them back out to the NIC.
-    This is the simplest useful datapath — a zero-copy bounce:
+    By default the manager IS the only NF: it receives packets from the
+    NIC via an AF_XDP socket and immediately sends them back out to the
+    NIC. This is the simplest useful datapath — a zero-copy bounce:
 
         NIC RX → XDP redirect → AF_XDP RX ring → TX ring → NIC TX
 
+    NFs may also own their own XSK socket on the shared UMEM. The XDP
+    program steers the flows they registered straight into that socket,
+    so those packets skip the manager's socket and worker loop:
+
+        NIC RX → XDP flow_map → NF's RX ring → NF handler → NF's TX ring
+
     It implements:
       - UMEM allocation and frame management (stack-based free-list)
       - XSK socket creation and ring initialization
       - XDP kernel program loading and XSKMAP population
+      - Per-NF shared-UMEM sockets and flow_map steering rules
       - RX polling loop: receive → bounce to TX → refill Fill ring
       - TX completion handling (reclaim UMEM frames)
       - Statistics display thread
@@ -81,19 +88,26 @@ static int afxdp_preflight_checks(struct afxdp_config *cfg);
 static void afxdp_parse_args(struct afxdp_config *cfg, int argc, char **argv);
 static struct afxdp_umem_info *afxdp_configure_umem(void *buffer, uint64_t size);
 static struct afxdp_socket_info *afxdp_configure_socket(struct afxdp_manager_ctx *ctx);
+static struct afxdp_socket_info *afxdp_configure_nf_socket(struct afxdp_manager_ctx *ctx,
+                                                           uint32_t slot);
+static int afxdp_parse_flow_rule(const char *arg, struct afxdp_flow_rule *rule);
 static void afxdp_complete_tx(struct afxdp_socket_info *xsk);
+static void afxdp_refill_fq(struct afxdp_umem_info *umem);
 static void afxdp_handle_receive(struct afxdp_manager_ctx *ctx);
 static void afxdp_rx_and_process(struct afxdp_manager_ctx *ctx);
+static void afxdp_nf_handle_receive(struct afxdp_nf_info *nf);
+static bool afxdp_nf_bounce(void *pkt, uint32_t *len, void *arg);
 
 /* Worker threads */
 static void *afxdp_rx_thread_main(void *arg);
 static void *afxdp_mgr_thread_main(void *arg);
 static void *afxdp_wakeup_thread_main(void *arg);
+static void *afxdp_nf_thread_main(void *arg);
 
-/* UMEM frame allocator */
-static uint64_t afxdp_alloc_umem_frame(struct afxdp_socket_info *xsk);
-static void afxdp_free_umem_frame(struct afxdp_socket_info *xsk, uint64_t frame);
-static uint64_t afxdp_umem_free_frames(struct afxdp_socket_info *xsk);
+/* UMEM frame allocator (callers hold umem->lock) */
+static uint64_t afxdp_alloc_umem_frame(struct afxdp_umem_info *umem);
+static void afxdp_free_umem_frame(struct afxdp_umem_info *umem, uint64_t frame);
+static uint64_t afxdp_umem_free_frames(struct afxdp_umem_info *umem);
 
 /* Packet processing callback (called for each received packet) */
 static bool afxdp_process_packet(struct afxdp_socket_info *xsk,
@@ -145,6 +159,8 @@ afxdp_print_usage(const char *prog) {
                 "  -v              Verbose output (enable stats)\n"
                 "  -t <seconds>    Time to live (auto-shutdown)\n"
                 "  -l <packets>    Packet limit (auto-shutdown)\n"
+                "  -F <rule>       Steer a flow to an NF socket:\n"
+                "                  <tcp|udp|proto>:<dst_ip|*>:<dst_port>=<nf_id>\n"
                 "  -h              Show this help\n",
                 prog, AFXDP_DEFAULT_QUEUE_ID);
 }
@@ -169,11 +185,12 @@ afxdp_parse_args(struct afxdp_config *cfg, int argc, char **argv) {
         cfg->verbose = false;
         cfg->time_to_live = 0;
         cfg->pkt_limit = 0;
+        cfg->num_flow_rules = 0;
 
         /* Reset getopt for re-entrant parsing (manager already parsed EAL args) */
         optind = 1;
 
-        while ((opt = getopt(argc, argv, "d:Q:SNczpf:P:vt:l:h")) != -1) {
+        while ((opt = getopt(argc, argv, "d:Q:SNczpf:P:vt:l:F:h")) != -1) {
                 switch (opt) {
                 case 'd':
                         strncpy(cfg->ifname, optarg, IF_NAMESIZE - 1);
@@ -214,6 +231,20 @@ afxdp_parse_args(struct afxdp_config *cfg, int argc, char **argv) {
                 case 'l':
                         cfg->pkt_limit = (uint64_t)atoll(optarg);
                         break;
+                case 'F':
+                        if (cfg->num_flow_rules >= AFXDP_MAX_CFG_FLOW_RULES) {
+                                AFXDP_LOG_ERR("Too many flow rules (max %d)",
+                                              AFXDP_MAX_CFG_FLOW_RULES);
+                                exit(EXIT_FAILURE);
+                        }
+                        if (afxdp_parse_flow_rule(optarg,
+                                        &cfg->flow_rules[cfg->num_flow_rules]) < 0) {
+                                AFXDP_LOG_ERR("Invalid flow rule '%s'", optarg);
+                                afxdp_print_usage(argv[0]);
+                                exit(EXIT_FAILURE);
+                        }
+                        cfg->num_flow_rules++;
+                        break;
                 case 'h':
                 default:
                         afxdp_print_usage(argv[0]);
@@ -250,6 +281,52 @@ afxdp_parse_args(struct afxdp_config *cfg, int argc, char **argv) {
                 AFXDP_LOG_INFO("  TTL:         %u seconds", cfg->time_to_live);
         if (cfg->pkt_limit)
                 AFXDP_LOG_INFO("  Pkt Limit:   %lu", cfg->pkt_limit);
+        if (cfg->num_flow_rules)
+                AFXDP_LOG_INFO("  Flow Rules:  %d", cfg->num_flow_rules);
+}
+
+/*
+ * Parse a -F flow rule: <tcp|udp|proto>:<dst_ip|*>:<dst_port>=<nf_id>.
+ * The key is stored in network byte order, as the XDP program sees it.
+ */
+static int
+afxdp_parse_flow_rule(const char *arg, struct afxdp_flow_rule *rule) {
+        char proto[16], addr[INET_ADDRSTRLEN];
+        unsigned int port, nf_id;
+        struct in_addr in;
+        char *end;
+        long num;
+
+        if (sscanf(arg, "%15[^:]:%15[^:]:%u=%u", proto, addr, &port, &nf_id) != 4)
+                return -1;
+        if (port > UINT16_MAX || nf_id >= AFXDP_MAX_NFS)
+                return -1;
+
+        memset(rule, 0, sizeof(*rule));
+        if (strcmp(proto, "tcp") == 0) {
+                rule->key.proto = IPPROTO_TCP;
+        } else if (strcmp(proto, "udp") == 0) {
+                rule->key.proto = IPPROTO_UDP;
+        } else {
+                num = strtol(proto, &end, 10);
+                if (*end != '\0' || num < 0 || num > UINT8_MAX)
+                        return -1;
+                rule->key.proto = (uint8_t)num;
+        }
+
+        /* Only TCP and UDP flows carry a port in the kernel key */
+        if (port && rule->key.proto != IPPROTO_TCP &&
+            rule->key.proto != IPPROTO_UDP)
+                return -1;
+
+        if (strcmp(addr, "*") != 0) {
+                if (inet_pton(AF_INET, addr, &in) != 1)
+                        return -1;
+                rule->key.dst_ip = in.s_addr;
+        }
+        rule->key.dst_port = htons((uint16_t)port);
+        rule->nf_id = (uint16_t)nf_id;
+        return 0;
 }
 
 /****************************************************************************
@@ -708,7 +785,9 @@ afxdp_preflight_checks(struct afxdp_config *cfg) {
  *     Completion Ring: kernel tells user  "these TX frames are done"
  *
  *   We manage a stack-based free-list of frame addresses for fast
- *   alloc/free without any locking (single-threaded access).
+ *   alloc/free. The free-list and both rings are shared by every socket
+ *   on the UMEM (the manager's and the NFs'), so they are guarded by a
+ *   spinlock taken once per batch, never per packet.
  *
  ****************************************************************************/
 
@@ -716,6 +795,7 @@ static struct afxdp_umem_info *
 afxdp_configure_umem(void *buffer, uint64_t size) {
         struct afxdp_umem_info *umem;
         struct xsk_umem_config umem_cfg;
+        uint32_t i;
         int ret;
 
         umem = calloc(1, sizeof(*umem));
@@ -739,6 +819,12 @@ afxdp_configure_umem(void *buffer, uint64_t size) {
                 return NULL;
         }
 
+        /* Initialize UMEM frame allocator: all frames start as free */
+        for (i = 0; i < AFXDP_NUM_FRAMES; i++)
+                umem->frame_addr[i] = i * AFXDP_FRAME_SIZE;
+        umem->frame_free = AFXDP_NUM_FRAMES;
+
+        pthread_spin_init(&umem->lock, PTHREAD_PROCESS_PRIVATE);
         umem->buffer = buffer;
         return umem;
 }
@@ -748,14 +834,14 @@ afxdp_configure_umem(void *buffer, uint64_t size) {
  * Returns AFXDP_INVALID_UMEM_FRAME if pool is exhausted.
  */
 static uint64_t
-afxdp_alloc_umem_frame(struct afxdp_socket_info *xsk) {
+afxdp_alloc_umem_frame(struct afxdp_umem_info *umem) {
         uint64_t frame;
 
-        if (xsk->umem_frame_free == 0)
+        if (umem->frame_free == 0)
                 return AFXDP_INVALID_UMEM_FRAME;
 
-        frame = xsk->umem_frame_addr[--xsk->umem_frame_free];
-        xsk->umem_frame_addr[xsk->umem_frame_free] = AFXDP_INVALID_UMEM_FRAME;
+        frame = umem->frame_addr[--umem->frame_free];
+        umem->frame_addr[umem->frame_free] = AFXDP_INVALID_UMEM_FRAME;
         return frame;
 }
 
@@ -763,17 +849,17 @@ afxdp_alloc_umem_frame(struct afxdp_socket_info *xsk) {
  * Return a UMEM frame to the free-list.
  */
 static void
-afxdp_free_umem_frame(struct afxdp_socket_info *xsk, uint64_t frame) {
-        assert(xsk->umem_frame_free < AFXDP_NUM_FRAMES);
-        xsk->umem_frame_addr[xsk->umem_frame_free++] = frame;
+afxdp_free_umem_frame(struct afxdp_umem_info *umem, uint64_t frame) {
+        assert(umem->frame_free < AFXDP_NUM_FRAMES);
+        umem->frame_addr[umem->frame_free++] = frame;
 }
 
 /*
  * Return the number of free UMEM frames available.
  */
 static uint64_t
-afxdp_umem_free_frames(struct afxdp_socket_info *xsk) {
-        return xsk->umem_frame_free;
+afxdp_umem_free_frames(struct afxdp_umem_info *umem) {
+        return umem->frame_free;
 }
 
 /****************************************************************************
@@ -850,14 +936,10 @@ afxdp_configure_socket(struct afxdp_manager_ctx *ctx) {
                 AFXDP_LOG_INFO("Socket inserted into XSKMAP (fd=%d)", ctx->xsk_map_fd);
         }
 
-        /* Initialize UMEM frame allocator: all frames start as free */
-        for (i = 0; i < AFXDP_NUM_FRAMES; i++)
-                xsk_info->umem_frame_addr[i] = i * AFXDP_FRAME_SIZE;
-        xsk_info->umem_frame_free = AFXDP_NUM_FRAMES;
-
         /*
          * Pre-populate the Fill Ring with empty buffers so the kernel
-         * has frames to receive packets into immediately.
+         * has frames to receive packets into immediately. No NF socket
+         * exists yet, so the UMEM lock is not needed.
          */
         ret = xsk_ring_prod__reserve(&xsk_info->umem->fq,
                                      AFXDP_FILL_RING_SIZE, &idx);
@@ -871,7 +953,7 @@ afxdp_configure_socket(struct afxdp_manager_ctx *ctx) {
 
         for (i = 0; i < AFXDP_FILL_RING_SIZE; i++) {
                 *xsk_ring_prod__fill_addr(&xsk_info->umem->fq, idx++) =
-                        afxdp_alloc_umem_frame(xsk_info);
+                        afxdp_alloc_umem_frame(xsk_info->umem);
         }
         xsk_ring_prod__submit(&xsk_info->umem->fq, AFXDP_FILL_RING_SIZE);
 
@@ -887,6 +969,60 @@ afxdp_configure_socket(struct afxdp_manager_ctx *ctx) {
         return xsk_info;
 }
 
+/*
+ * Create the XSK socket of an NF on the manager's UMEM and queue, and
+ * insert it into xsks_map[slot].
+ *
+ * Sockets sharing a UMEM on the same (interface, queue) pair also share
+ * its Fill and Completion rings, so the NF socket adds no frames of its
+ * own: it draws from, and returns to, the manager's pool.
+ */
+static struct afxdp_socket_info *
+afxdp_configure_nf_socket(struct afxdp_manager_ctx *ctx, uint32_t slot) {
+        struct xsk_socket_config xsk_cfg;
+        struct afxdp_socket_info *xsk_info;
+        struct afxdp_config *cfg = &ctx->cfg;
+        int fd, ret;
+
+        xsk_info = calloc(1, sizeof(*xsk_info));
+        if (!xsk_info) {
+                AFXDP_LOG_ERR("Failed to allocate xsk_socket_info");
+                return NULL;
+        }
+
+        xsk_info->umem = ctx->umem;
+
+        xsk_cfg.rx_size = AFXDP_RX_RING_SIZE;
+        xsk_cfg.tx_size = AFXDP_TX_RING_SIZE;
+        xsk_cfg.xdp_flags = cfg->xdp_flags;
+        xsk_cfg.bind_flags = cfg->xsk_bind_flags;
+        xsk_cfg.libbpf_flags = XSK_LIBBPF_FLAGS__INHIBIT_PROG_LOAD;
+
+        ret = xsk_socket__create_shared(&xsk_info->xsk, cfg->ifname,
+                                        cfg->xsk_if_queue, ctx->umem->umem,
+                                        &xsk_info->rx, &xsk_info->tx,
+                                        &ctx->umem->fq, &ctx->umem->cq,
+                                        &xsk_cfg);
+        if (ret) {
+                AFXDP_LOG_ERR("xsk_socket__create_shared failed: %s",
+                              strerror(-ret));
+                free(xsk_info);
+                return NULL;
+        }
+
+        fd = xsk_socket__fd(xsk_info->xsk);
+        ret = bpf_map_update_elem(ctx->xsk_map_fd, &slot, &fd, BPF_ANY);
+        if (ret) {
+                AFXDP_LOG_ERR("Failed to insert NF socket into XSKMAP slot %u: %s",
+                              slot, strerror(errno));
+                xsk_socket__delete(xsk_info->xsk);
+                free(xsk_info);
+                return NULL;
+        }
+
+        return xsk_info;
+}
+
 /****************************************************************************
  *
  *                      TX COMPLETION HANDLING
@@ -896,35 +1032,75 @@ afxdp_configure_socket(struct afxdp_manager_ctx *ctx) {
  *   consumed descriptors on the Completion Ring. We must drain the
  *   Completion Ring to reclaim those UMEM frames for reuse.
  *
+ *   The Completion Ring is shared by all sockets on the UMEM, so any
+ *   socket's thread may reclaim frames another socket transmitted.
+ *
  ****************************************************************************/
 
 static void
 afxdp_complete_tx(struct afxdp_socket_info *xsk) {
+        struct afxdp_umem_info *umem = xsk->umem;
         unsigned int completed;
         uint32_t idx_cq;
 
-        if (!xsk->outstanding_tx)
-                return;
-
         /*
-         * Kick the kernel to process our TX ring.
+         * Kick the kernel to process our TX ring while it still holds
+         * descriptors the kernel has not consumed.
          * MSG_DONTWAIT ensures we don't block if kernel is busy.
          */
-        sendto(xsk_socket__fd(xsk->xsk), NULL, 0, MSG_DONTWAIT, NULL, 0);
+        if (xsk_prod_nb_free(&xsk->tx, AFXDP_TX_RING_SIZE) < AFXDP_TX_RING_SIZE)
+                sendto(xsk_socket__fd(xsk->xsk), NULL, 0, MSG_DONTWAIT, NULL, 0);
+
+        if (!__atomic_load_n(&umem->outstanding_tx, __ATOMIC_RELAXED))
+                return;
 
         /* Drain the Completion Ring: reclaim UMEM frames */
-        completed = xsk_ring_cons__peek(&xsk->umem->cq,
+        pthread_spin_lock(&umem->lock);
+        completed = xsk_ring_cons__peek(&umem->cq,
                                         AFXDP_COMP_RING_SIZE, &idx_cq);
         if (completed > 0) {
                 for (unsigned int i = 0; i < completed; i++) {
                         afxdp_free_umem_frame(
-                                xsk,
-                                *xsk_ring_cons__comp_addr(&xsk->umem->cq, idx_cq++));
+                                umem,
+                                *xsk_ring_cons__comp_addr(&umem->cq, idx_cq++));
                 }
-                xsk_ring_cons__release(&xsk->umem->cq, completed);
-                xsk->outstanding_tx -= (completed < xsk->outstanding_tx)
-                        ? completed : xsk->outstanding_tx;
+                xsk_ring_cons__release(&umem->cq, completed);
+                __atomic_sub_fetch(&umem->outstanding_tx, completed,
+                                   __ATOMIC_RELAXED);
         }
+        pthread_spin_unlock(&umem->lock);
+}
+
+/*
+ * Refill the Fill Ring with as many free frames as it has room for, so
+ * the kernel has buffers for the next batch. The Fill Ring is shared,
+ * so whichever socket consumed frames refills it.
+ */
+static void
+afxdp_refill_fq(struct afxdp_umem_info *umem) {
+        unsigned int stock_frames, free_frames, i;
+        uint32_t idx_fq = 0;
+        int ret;
+
+        pthread_spin_lock(&umem->lock);
+        free_frames = afxdp_umem_free_frames(umem);
+        stock_frames = xsk_prod_nb_free(&umem->fq, free_frames);
+        /* nb_free may report more room than we asked for */
+        if (stock_frames > free_frames)
+                stock_frames = free_frames;
+        if (stock_frames > 0) {
+                ret = xsk_ring_prod__reserve(&umem->fq, stock_frames, &idx_fq);
+                /* Retry until we get all the slots we asked for */
+                while (ret != (int)stock_frames)
+                        ret = xsk_ring_prod__reserve(&umem->fq, stock_frames,
+                                                     &idx_fq);
+                for (i = 0; i < stock_frames; i++) {
+                        *xsk_ring_prod__fill_addr(&umem->fq, idx_fq++) =
+                                afxdp_alloc_umem_frame(umem);
+                }
+                xsk_ring_prod__submit(&umem->fq, stock_frames);
+        }
+        pthread_spin_unlock(&umem->lock);
 }
 
 /****************************************************************************
@@ -971,7 +1147,7 @@ afxdp_process_packet(struct afxdp_socket_info *xsk,
 
         /* Submit the descriptor to the kernel for transmission */
         xsk_ring_prod__submit(&xsk->tx, 1);
-        xsk->outstanding_tx++;
+        __atomic_add_fetch(&xsk->umem->outstanding_tx, 1, __ATOMIC_RELAXED);
 
         /* Update TX stats */
         xsk->stats.tx_bytes += len;
@@ -997,9 +1173,8 @@ afxdp_process_packet(struct afxdp_socket_info *xsk,
 static void
 afxdp_handle_receive(struct afxdp_manager_ctx *ctx) {
         struct afxdp_socket_info *xsk = ctx->xsk_socket;
-        unsigned int rcvd, stock_frames, i;
-        uint32_t idx_rx = 0, idx_fq = 0, idx_tx = 0;
-        int ret;
+        unsigned int rcvd, i;
+        uint32_t idx_rx = 0, idx_tx = 0;
 
         /*
          * Step 1: Drain TX completions FIRST.
@@ -1020,22 +1195,7 @@ afxdp_handle_receive(struct afxdp_manager_ctx *ctx) {
          * next batch of incoming packets into. We push as many free
          * frames as we have available.
          */
-        stock_frames = xsk_prod_nb_free(&xsk->umem->fq,
-                                        afxdp_umem_free_frames(xsk));
-        if (stock_frames > 0) {
-                ret = xsk_ring_prod__reserve(&xsk->umem->fq,
-                                             stock_frames, &idx_fq);
-                /* Retry until we get all the slots we asked for */
-                while (ret != (int)stock_frames) {
-                        ret = xsk_ring_prod__reserve(&xsk->umem->fq,
-                                                     stock_frames, &idx_fq);
-                }
-                for (i = 0; i < stock_frames; i++) {
-                        *xsk_ring_prod__fill_addr(&xsk->umem->fq, idx_fq++) =
-                                afxdp_alloc_umem_frame(xsk);
-                }
-                xsk_ring_prod__submit(&xsk->umem->fq, stock_frames);
-        }
+        afxdp_refill_fq(xsk->umem);
 
         /*
          * Step 4: Batch TX.
@@ -1050,8 +1210,8 @@ afxdp_handle_receive(struct afxdp_manager_ctx *ctx) {
         unsigned int to_tx = (tx_avail < rcvd) ? tx_avail : rcvd;
 
         if (to_tx > 0) {
-                ret = xsk_ring_prod__reserve(&xsk->tx, to_tx, &idx_tx);
-                /* ret is guaranteed == to_tx since we checked availability */
+                xsk_ring_prod__reserve(&xsk->tx, to_tx, &idx_tx);
+                /* reserve is guaranteed to return to_tx since we checked availability */
 
                 for (i = 0; i < to_tx; i++) {
                         uint64_t addr = xsk_ring_cons__rx_desc(&xsk->rx, idx_rx)->addr;
@@ -1067,15 +1227,20 @@ afxdp_handle_receive(struct afxdp_manager_ctx *ctx) {
 
                 /* Submit the entire batch to the kernel in one shot */
                 xsk_ring_prod__submit(&xsk->tx, to_tx);
-                xsk->outstanding_tx += to_tx;
+                __atomic_add_fetch(&xsk->umem->outstanding_tx, to_tx,
+                                   __ATOMIC_RELAXED);
         }
 
         /* Free frames for any RX packets we could not TX */
-        for (i = to_tx; i < rcvd; i++) {
-                uint64_t addr = xsk_ring_cons__rx_desc(&xsk->rx, idx_rx)->addr;
-                uint32_t len  = xsk_ring_cons__rx_desc(&xsk->rx, idx_rx++)->len;
-                afxdp_free_umem_frame(xsk, addr);
-                xsk->stats.rx_bytes += len;
+        if (to_tx < rcvd) {
+                pthread_spin_lock(&xsk->umem->lock);
+                for (i = to_tx; i < rcvd; i++) {
+                        uint64_t addr = xsk_ring_cons__rx_desc(&xsk->rx, idx_rx)->addr;
+                        uint32_t len  = xsk_ring_cons__rx_desc(&xsk->rx, idx_rx++)->len;
+                        afxdp_free_umem_frame(xsk->umem, addr);
+                        xsk->stats.rx_bytes += len;
+                }
+                pthread_spin_unlock(&xsk->umem->lock);
         }
 
         /* Step 5: Release consumed RX entries back to the kernel */
@@ -1116,6 +1281,95 @@ afxdp_rx_and_process(struct afxdp_manager_ctx *ctx) {
         }
 }
 
+/****************************************************************************
+ *
+ *                      NF SOCKET RECEIVE LOOP
+ *
+ *   Each attached NF polls its own XSK socket. The XDP program already
+ *   decided the packets on its RX ring belong to the NF, so the NF's
+ *   handler runs on them directly and the packets it keeps go out on
+ *   the NF's own TX ring:
+ *     1. Reclaim completed TX frames, read the RX batch
+ *     2. Refill the shared Fill Ring
+ *     3. Run the NF handler on each packet in place
+ *     4. Submit the kept packets as one TX batch, free the rest
+ *
+ ****************************************************************************/
+
+static void
+afxdp_nf_handle_receive(struct afxdp_nf_info *nf) {
+        struct afxdp_socket_info *xsk = nf->xsk;
+        uint64_t tx_addr[AFXDP_RX_BATCH_SIZE];
+        uint32_t tx_len[AFXDP_RX_BATCH_SIZE];
+        uint64_t drop_addr[AFXDP_RX_BATCH_SIZE];
+        unsigned int rcvd, nb_tx = 0, nb_drop = 0, to_tx, i;
+        uint32_t idx_rx = 0, idx_tx = 0;
+
+        afxdp_complete_tx(xsk);
+
+        rcvd = xsk_ring_cons__peek(&xsk->rx, AFXDP_RX_BATCH_SIZE, &idx_rx);
+        if (!rcvd)
+                return;
+
+        afxdp_refill_fq(xsk->umem);
+
+        for (i = 0; i < rcvd; i++) {
+                const struct xdp_desc *desc = xsk_ring_cons__rx_desc(&xsk->rx, idx_rx++);
+                uint64_t addr = desc->addr;
+                uint32_t len = desc->len;
+
+                xsk->stats.rx_bytes += len;
+                if (nf->handler(xsk_umem__get_data(xsk->umem->buffer, addr),
+                                &len, nf->arg)) {
+                        tx_addr[nb_tx] = addr;
+                        tx_len[nb_tx++] = len;
+                } else {
+                        drop_addr[nb_drop++] = addr;
+                }
+        }
+        xsk_ring_cons__release(&xsk->rx, rcvd);
+        xsk->stats.rx_packets += rcvd;
+
+        /* Only reserve what the TX ring has room for, drop the rest */
+        to_tx = xsk_prod_nb_free(&xsk->tx, nb_tx);
+        if (to_tx > nb_tx)
+                to_tx = nb_tx;
+        if (to_tx > 0) {
+                xsk_ring_prod__reserve(&xsk->tx, to_tx, &idx_tx);
+                for (i = 0; i < to_tx; i++) {
+                        xsk_ring_prod__tx_desc(&xsk->tx, idx_tx)->addr = tx_addr[i];
+                        xsk_ring_prod__tx_desc(&xsk->tx, idx_tx++)->len = tx_len[i];
+                        xsk->stats.tx_bytes += tx_len[i];
+                }
+                xsk_ring_prod__submit(&xsk->tx, to_tx);
+                __atomic_add_fetch(&xsk->umem->outstanding_tx, to_tx,
+                                   __ATOMIC_RELAXED);
+                xsk->stats.tx_packets += to_tx;
+        }
+        for (i = to_tx; i < nb_tx; i++)
+                drop_addr[nb_drop++] = tx_addr[i];
+
+        if (nb_drop > 0) {
+                pthread_spin_lock(&xsk->umem->lock);
+                for (i = 0; i < nb_drop; i++)
+                        afxdp_free_umem_frame(xsk->umem, drop_addr[i]);
+                pthread_spin_unlock(&xsk->umem->lock);
+                xsk->stats.rx_dropped += nb_drop;
+        }
+}
+
+/*
+ * Handler of NFs attached from the command line (-F): send every
+ * packet straight back out, like the manager does.
+ */
+static bool
+afxdp_nf_bounce(void *pkt, uint32_t *len, void *arg) {
+        (void)pkt;
+        (void)len;
+        (void)arg;
+        return true;
+}
+
 /****************************************************************************
  *
  *                        WORKER THREADS
@@ -1196,6 +1450,15 @@ afxdp_mgr_thread_main(void *arg) {
                         xsk->stats.timestamp = afxdp_gettime();
                         afxdp_stats_print(&xsk->stats, &previous);
                         previous = xsk->stats;
+                        for (int n = 0; n < AFXDP_MAX_NFS; n++) {
+                                if (!ctx->nfs[n])
+                                        continue;
+                                printf("  NF %-3d RX: %'11lu pkts  TX: %'11lu pkts"
+                                       "  dropped: %'lu\n", n,
+                                       ctx->nfs[n]->xsk->stats.rx_packets,
+                                       ctx->nfs[n]->xsk->stats.tx_packets,
+                                       ctx->nfs[n]->xsk->stats.rx_dropped);
+                        }
                 }
 
                 if (ctx->cfg.time_to_live) {
@@ -1218,6 +1481,28 @@ afxdp_mgr_thread_main(void *arg) {
         return NULL;
 }
 
+static void *
+afxdp_nf_thread_main(void *arg) {
+        struct afxdp_nf_info *nf = (struct afxdp_nf_info *)arg;
+        struct afxdp_manager_ctx *ctx = nf->mgr;
+        struct pollfd fds[1];
+        int ret;
+
+        memset(fds, 0, sizeof(fds));
+        fds[0].fd = xsk_socket__fd(nf->xsk->xsk);
+        fds[0].events = POLLIN;
+
+        while (!ctx->global_exit) {
+                if (ctx->cfg.xsk_poll_mode) {
+                        ret = poll(fds, 1, 1000);
+                        if (ret <= 0)
+                                continue;
+                }
+                afxdp_nf_handle_receive(nf);
+        }
+        return NULL;
+}
+
 static void *
 afxdp_wakeup_thread_main(void *arg) {
         struct afxdp_manager_ctx *ctx = (struct afxdp_manager_ctx *)arg;
@@ -1306,6 +1591,13 @@ afxdp_init(struct afxdp_manager_ctx *ctx, int argc, char **argv) {
                         return -ENOENT;
                 }
                 AFXDP_LOG_INFO("Found xsks_map (fd=%d)", ctx->xsk_map_fd);
+
+                /* Custom programs without NF steering have no flow_map */
+                map = bpf_object__find_map_by_name(
+                        xdp_program__bpf_obj(ctx->xdp_prog), "flow_map");
+                ctx->flow_map_fd = map ? bpf_map__fd(map) : -1;
+                if (ctx->flow_map_fd >= 0)
+                        AFXDP_LOG_INFO("Found flow_map (fd=%d)", ctx->flow_map_fd);
         }
 
         /* ---- Step 5: Raise RLIMIT_MEMLOCK ---- */
@@ -1363,13 +1655,29 @@ afxdp_init(struct afxdp_manager_ctx *ctx, int argc, char **argv) {
         if (!ctx->xsk_socket) {
                 AFXDP_LOG_ERR("AF_XDP socket creation failed");
                 xsk_umem__delete(ctx->umem->umem);
+                pthread_spin_destroy(&ctx->umem->lock);
                 free(ctx->umem);
                 ctx->umem = NULL;
                 /* Buffer freed by caller via afxdp_cleanup(ctx, true) */
                 return -ENODEV;
         }
 
-        /* ---- Step 9: Print hugepage status report ---- */
+        /* ---- Step 9: Attach NF sockets for command-line flow rules ---- */
+        for (int r = 0; r < ctx->cfg.num_flow_rules; r++) {
+                struct afxdp_flow_rule *rule = &ctx->cfg.flow_rules[r];
+
+                if (!ctx->nfs[rule->nf_id]) {
+                        err = afxdp_nf_attach(ctx, rule->nf_id,
+                                              afxdp_nf_bounce, NULL);
+                        if (err)
+                                return err;
+                }
+                err = afxdp_flow_add(ctx, &rule->key, rule->nf_id);
+                if (err)
+                        return err;
+        }
+
+        /* ---- Step 10: Print hugepage status report ---- */
         afxdp_print_hugepage_status(ctx);
 
         /* Worker threads are launched in afxdp_run(). */
@@ -1389,12 +1697,17 @@ afxdp_run(struct afxdp_manager_ctx *ctx) {
         pthread_t rx_threads[AFXDP_NUM_RX_THREADS];
         pthread_t mgr_threads[AFXDP_NUM_MGR_AUX_THREADS];
         pthread_t wakeup_threads[AFXDP_NUM_WAKEUP_THREADS];
-        int i, err;
+        bool nf_running[AFXDP_MAX_NFS] = { false };
+        int i, err, num_nfs = 0;
+
+        for (i = 0; i < AFXDP_MAX_NFS; i++)
+                num_nfs += ctx->nfs[i] != NULL;
 
         AFXDP_LOG_INFO("Launching worker threads: "
-                       "RX=%d  TX=%d  Mgr=%d  Wakeup=%d",
+                       "RX=%d  TX=%d  Mgr=%d  Wakeup=%d  NF=%d",
                        AFXDP_NUM_RX_THREADS, AFXDP_NUM_TX_THREADS,
-                       AFXDP_NUM_MGR_AUX_THREADS, AFXDP_NUM_WAKEUP_THREADS);
+                       AFXDP_NUM_MGR_AUX_THREADS, AFXDP_NUM_WAKEUP_THREADS,
+                       num_nfs);
 
         for (i = 0; i < AFXDP_NUM_RX_THREADS; i++) {
                 err = pthread_create(&rx_threads[i], NULL,
@@ -1407,6 +1720,20 @@ afxdp_run(struct afxdp_manager_ctx *ctx) {
                 }
         }
 
+        for (i = 0; i < AFXDP_MAX_NFS; i++) {
+                if (!ctx->nfs[i])
+                        continue;
+                err = pthread_create(&ctx->nfs[i]->thread, NULL,
+                                     afxdp_nf_thread_main, ctx->nfs[i]);
+                if (err) {
+                        AFXDP_LOG_ERR("Failed to create NF %d thread: %s",
+                                      i, strerror(err));
+                        ctx->global_exit = true;
+                        break;
+                }
+                nf_running[i] = true;
+        }
+
         for (i = 0; i < AFXDP_NUM_MGR_AUX_THREADS; i++) {
                 err = pthread_create(&mgr_threads[i], NULL,
                                      afxdp_mgr_thread_main, ctx);
@@ -1431,6 +1758,9 @@ afxdp_run(struct afxdp_manager_ctx *ctx) {
 
         for (i = 0; i < AFXDP_NUM_RX_THREADS; i++)
                 pthread_join(rx_threads[i], NULL);
+        for (i = 0; i < AFXDP_MAX_NFS; i++)
+                if (nf_running[i])
+                        pthread_join(ctx->nfs[i]->thread, NULL);
         for (i = 0; i < AFXDP_NUM_MGR_AUX_THREADS; i++)
                 pthread_join(mgr_threads[i], NULL);
         for (i = 0; i < AFXDP_NUM_WAKEUP_THREADS; i++)
@@ -1466,6 +1796,15 @@ afxdp_cleanup(struct afxdp_manager_ctx *ctx, bool final_cleanup) {
                        ctx->xsk_socket->stats.tx_packets,
                        ctx->xsk_socket->stats.tx_bytes);
         }
+        for (int n = 0; n < AFXDP_MAX_NFS; n++) {
+                if (!ctx->nfs[n])
+                        continue;
+                printf("NF %d: RX %lu packets, TX %lu packets, dropped %lu\n", n,
+                       ctx->nfs[n]->xsk->stats.rx_packets,
+                       ctx->nfs[n]->xsk->stats.tx_packets,
+                       ctx->nfs[n]->xsk->stats.rx_dropped);
+                afxdp_nf_detach(ctx, (uint16_t)n);
+        }
 
         /* Detach and unload XDP program from the interface */
         if (ctx->xdp_prog) {
@@ -1490,6 +1829,7 @@ afxdp_cleanup(struct afxdp_manager_ctx *ctx, bool final_cleanup) {
         /* Delete UMEM */
         if (ctx->umem) {
                 xsk_umem__delete(ctx->umem->umem);
+                pthread_spin_destroy(&ctx->umem->lock);
                 free(ctx->umem);
                 ctx->umem = NULL;
         }
@@ -1508,3 +1848,99 @@ afxdp_cleanup(struct afxdp_manager_ctx *ctx, bool final_cleanup) {
 
         AFXDP_LOG_INFO("Cleanup complete");
 }
+
+/*
+ * afxdp_nf_attach() — Give an NF its own XSK socket on the shared UMEM.
+ */
+int
+afxdp_nf_attach(struct afxdp_manager_ctx *ctx, uint16_t nf_id,
+                afxdp_nf_handler_t handler, void *arg) {
+        struct afxdp_nf_info *nf;
+
+        if (nf_id >= AFXDP_MAX_NFS || !handler || !ctx->umem)
+                return -EINVAL;
+        if (ctx->nfs[nf_id])
+                return -EEXIST;
+
+        nf = calloc(1, sizeof(*nf));
+        if (!nf) {
+                AFXDP_LOG_ERR("Failed to allocate NF %u info", nf_id);
+                return -ENOMEM;
+        }
+
+        nf->xsk = afxdp_configure_nf_socket(ctx, AFXDP_NF_XSK_BASE + nf_id);
+        if (!nf->xsk) {
+                free(nf);
+                return -ENODEV;
+        }
+        nf->mgr = ctx;
+        nf->handler = handler;
+        nf->arg = arg;
+        nf->nf_id = nf_id;
+        ctx->nfs[nf_id] = nf;
+
+        AFXDP_LOG_INFO("NF %u socket attached on %s queue %d (XSKMAP slot %u)",
+                       nf_id, ctx->cfg.ifname, ctx->cfg.xsk_if_queue,
+                       AFXDP_NF_XSK_BASE + nf_id);
+        return 0;
+}
+
+/*
+ * afxdp_nf_detach() — Remove an NF's socket from the XSKMAP and delete it.
+ */
+void
+afxdp_nf_detach(struct afxdp_manager_ctx *ctx, uint16_t nf_id) {
+        struct afxdp_nf_info *nf;
+        uint32_t slot = AFXDP_NF_XSK_BASE + nf_id;
+
+        if (nf_id >= AFXDP_MAX_NFS || !ctx->nfs[nf_id])
+                return;
+        nf = ctx->nfs[nf_id];
+
+        /* The XDP program sends the NF's flows to the manager from now on */
+        if (bpf_map_delete_elem(ctx->xsk_map_fd, &slot))
+                AFXDP_LOG_WARN("Failed to remove NF %u from XSKMAP: %s",
+                               nf_id, strerror(errno));
+
+        xsk_socket__delete(nf->xsk->xsk);
+        free(nf->xsk);
+        free(nf);
+        ctx->nfs[nf_id] = NULL;
+}
+
+/*
+ * afxdp_flow_add() — Steer a flow straight to an NF's socket.
+ */
+int
+afxdp_flow_add(struct afxdp_manager_ctx *ctx, const struct afxdp_flow_key *key,
+               uint16_t nf_id) {
+        struct afxdp_flow_target target;
+
+        if (ctx->flow_map_fd < 0) {
+                AFXDP_LOG_ERR("XDP program has no flow_map, cannot steer flows");
+                return -ENOTSUP;
+        }
+        if (nf_id >= AFXDP_MAX_NFS || !ctx->nfs[nf_id])
+                return -ENOENT;
+
+        target.xsk_index = AFXDP_NF_XSK_BASE + nf_id;
+        target.queue = (uint32_t)ctx->cfg.xsk_if_queue;
+        if (bpf_map_update_elem(ctx->flow_map_fd, key, &target, BPF_ANY)) {
+                AFXDP_LOG_ERR("Failed to add flow rule for NF %u: %s",
+                              nf_id, strerror(errno));
+                return -errno;
+        }
+        return 0;
+}
+
+/*
+ * afxdp_flow_del() — Return a flow to the manager.
+ */
+int
+afxdp_flow_del(struct afxdp_manager_ctx *ctx, const struct afxdp_flow_key *key) {
+        if (ctx->flow_map_fd < 0)
+                return -ENOTSUP;
+        if (bpf_map_delete_elem(ctx->flow_map_fd, key))
+                return -errno;
+        return 0;
+}
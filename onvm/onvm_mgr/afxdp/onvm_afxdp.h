@@ -43,9 +43,11 @@
 
     Public API for the AF_XDP-based NF Manager datapath.
 
-    The manager acts as the only NF: it receives packets from the NIC
-    via AF_XDP and immediately bounces them back out to the NIC
-    (zero-copy through the same UMEM).
+    By default the manager acts as the only NF: it receives packets from
+    the NIC via AF_XDP and immediately bounces them back out to the NIC
+    (zero-copy through the same UMEM). NFs may attach their own XSK
+    socket on that UMEM and register flows; the XDP program then steers
+    those flows straight to the NF, and the manager keeps the rest.
 
     This header exposes three functions that replace the entire DPDK
     manager pipeline when compiled with -DUSE_AFXDP:
@@ -159,4 +161,79 @@ int afxdp_run(struct afxdp_manager_ctx *ctx);
  */
 void afxdp_cleanup(struct afxdp_manager_ctx *ctx, bool final_cleanup);
 
+/**
+ * Give an NF its own AF_XDP socket.
+ *
+ * The socket is created on the manager's UMEM, interface and queue
+ * (sharing its Fill and Completion rings) and inserted into
+ * xsks_map[AFXDP_NF_XSK_BASE + nf_id]. afxdp_run() polls it from a
+ * dedicated thread that passes each packet to handler. Packets only
+ * reach the socket once flows are steered to it with afxdp_flow_add().
+ *
+ * Call after afxdp_init() and before afxdp_run().
+ *
+ * @param ctx
+ *   Pointer to an initialized manager context.
+ * @param nf_id
+ *   NF id, below AFXDP_MAX_NFS.
+ * @param handler
+ *   Called for every packet steered to the NF. Returns true to send the
+ *   packet out of the NIC, false to drop it.
+ * @param arg
+ *   Opaque argument passed to handler.
+ * @return
+ *   0 on success, -EEXIST if the NF is already attached, negative errno
+ *   on other failures.
+ */
+int afxdp_nf_attach(struct afxdp_manager_ctx *ctx, uint16_t nf_id,
+                    afxdp_nf_handler_t handler, void *arg);
+
+/**
+ * Remove an NF's socket from the XSKMAP and delete it.
+ *
+ * Flows still steered to the NF fall back to the manager's socket.
+ * Called for every attached NF by afxdp_cleanup(); call it directly only
+ * once afxdp_run() has returned.
+ *
+ * @param ctx
+ *   Pointer to the manager context.
+ * @param nf_id
+ *   NF id given to afxdp_nf_attach().
+ */
+void afxdp_nf_detach(struct afxdp_manager_ctx *ctx, uint16_t nf_id);
+
+/**
+ * Steer a flow straight to an attached NF's socket.
+ *
+ * Adds or replaces the flow_map entry for key, so the XDP program
+ * redirects matching packets arriving on the manager's queue into the
+ * NF's socket instead of the manager's.
+ *
+ * @param ctx
+ *   Pointer to an initialized manager context.
+ * @param key
+ *   IPv4 destination of the flow in network byte order. dst_ip 0
+ *   matches any address; dst_port must be 0 unless proto is TCP or UDP.
+ * @param nf_id
+ *   NF to steer the flow to.
+ * @return
+ *   0 on success, -ENOENT if the NF is not attached, -ENOTSUP if the XDP
+ *   program has no flow_map, negative errno on other failures.
+ */
+int afxdp_flow_add(struct afxdp_manager_ctx *ctx,
+                   const struct afxdp_flow_key *key, uint16_t nf_id);
+
+/**
+ * Return a flow to the manager by deleting its flow_map entry.
+ *
+ * @param ctx
+ *   Pointer to an initialized manager context.
+ * @param key
+ *   Key given to afxdp_flow_add().
+ * @return
+ *   0 on success, negative errno on failure.
+ */
+int afxdp_flow_del(struct afxdp_manager_ctx *ctx,
+                   const struct afxdp_flow_key *key);
+
 #endif /* _ONVM_AFXDP_H_ */
@@ -117,10 +117,14 @@
 
 /**********************XSKMAP Configuration***********************************/
 
-/* Maximum number of AF_XDP sockets in the XSKMAP (one per RX queue).
- * This must match the max_entries in the kernel-side BPF map definition. */
+/* Maximum number of manager AF_XDP sockets in the XSKMAP (one per RX queue).
+ * This must match AFXDP_NF_XSK_BASE in the kernel-side BPF program. */
 #define AFXDP_MAX_SOCKETS        64
 
+/* First XSKMAP slot holding an NF socket: NF n lives in slot
+ * AFXDP_NF_XSK_BASE + n, above the per-queue manager sockets. */
+#define AFXDP_NF_XSK_BASE        AFXDP_MAX_SOCKETS
+
 /**********************XDP Attachment Defaults*********************************/
 
 /* Default network interface name if none is specified */
@@ -159,6 +163,13 @@
  * Each NF gets its own XSK socket in the XSKMAP. */
 #define AFXDP_MAX_NFS            64
 
+/* Maximum number of flow rules steering traffic to NF sockets.
+ * This must match the max_entries of flow_map in the BPF program. */
+#define AFXDP_MAX_FLOW_RULES     1024
+
+/* Maximum number of flow rules that can be given on the command line. */
+#define AFXDP_MAX_CFG_FLOW_RULES 64
+
 /**********************Logging Macros*****************************************/
 
 #define AFXDP_LOG_INFO(fmt, ...)  fprintf(stdout, "[AFXDP INFO] " fmt "\n", ##__VA_ARGS__)
@@ -98,12 +98,31 @@
  * The Fill Ring (fq) and Completion Ring (cq) manage buffer ownership:
  *   - Fill Ring:       userspace → kernel  ("here are empty frames to fill")
  *   - Completion Ring: kernel → userspace  ("these TX frames are done, reuse them")
+ *
+ * The manager socket and every NF socket are bound to the same queue, so
+ * they share one Fill Ring, one Completion Ring and one pool of frames:
+ * a frame the manager puts on the Fill Ring may come back on an NF's RX
+ * ring. The rings and the free-list are guarded by lock.
+ *
+ * Frame allocator:
+ *   frame_addr[] is a simple stack-based free list of UMEM offsets.
+ *   frame_free tracks how many free frames remain.
  */
 struct afxdp_umem_info {
         struct xsk_ring_prod fq;      /* Fill ring (producer: userspace) */
         struct xsk_ring_cons cq;      /* Completion ring (consumer: userspace) */
         struct xsk_umem *umem;        /* libxdp UMEM handle */
         void *buffer;                 /* Raw pointer to the mmap'd UMEM region */
+
+        /* Guards fq, cq and the frame free-list */
+        pthread_spinlock_t lock;
+
+        /* UMEM frame free-list (stack-based allocator) */
+        uint64_t frame_addr[AFXDP_NUM_FRAMES];
+        uint32_t frame_free;
+
+        /* TX descriptors of all sockets not yet completed (atomic) */
+        uint32_t outstanding_tx;
 };
 
 /**************************** Socket Stats ************************************/
@@ -126,15 +145,11 @@ struct afxdp_stats_record {
  * Complete state for a single AF_XDP socket.
  *
  * Each socket is bound to one (interface, queue_id) pair and manages
- * its own RX/TX descriptor rings plus a pool of UMEM frame addresses.
+ * its own RX/TX descriptor rings. Frames come from the shared UMEM.
  *
  * Ring layout:
  *   RX ring (consumer): kernel places received packet descriptors here
  *   TX ring (producer): userspace places outgoing packet descriptors here
- *
- * Frame allocator:
- *   umem_frame_addr[] is a simple stack-based free list of UMEM offsets.
- *   umem_frame_free tracks how many free frames remain.
  */
 struct afxdp_socket_info {
         /* Descriptor rings */
@@ -147,13 +162,6 @@ struct afxdp_socket_info {
         /* libxdp socket handle */
         struct xsk_socket *xsk;
 
-        /* UMEM frame free-list (stack-based allocator) */
-        uint64_t umem_frame_addr[AFXDP_NUM_FRAMES];
-        uint32_t umem_frame_free;
-
-        /* Outstanding TX descriptors not yet completed by the kernel */
-        uint32_t outstanding_tx;
-
         /* Live statistics (updated inline during packet processing) */
         struct afxdp_stats_record stats;
 
@@ -161,6 +169,66 @@ struct afxdp_socket_info {
         struct afxdp_stats_record prev_stats;
 };
 
+/**************************** Flow Steering ***********************************/
+
+/*
+ * Key of the kernel flow_map: the IPv4 destination of a flow, in network
+ * byte order. dst_ip 0 matches any address, dst_port is 0 for protocols
+ * other than TCP and UDP. Must match the layout in af_xdp_kern.c.
+ */
+struct afxdp_flow_key {
+        uint32_t dst_ip;
+        uint16_t dst_port;
+        uint8_t proto;
+        uint8_t pad;
+};
+
+/*
+ * Value of the kernel flow_map: the XSKMAP slot of the NF socket that
+ * owns the flow and the RX queue it is bound to.
+ */
+struct afxdp_flow_target {
+        uint32_t xsk_index;
+        uint32_t queue;
+};
+
+/*
+ * A flow rule given on the command line (-F).
+ */
+struct afxdp_flow_rule {
+        struct afxdp_flow_key key;
+        uint16_t nf_id;
+};
+
+/**************************** NF Sockets **************************************/
+
+struct afxdp_manager_ctx;
+
+/*
+ * Packet handler of an NF that owns its own XSK socket. Called for every
+ * packet the XDP program steered to the NF, with the packet data in the
+ * UMEM frame. The handler may rewrite the packet in place and update
+ * *len (without growing past the frame). Return true to transmit the
+ * packet out of the NIC, false to drop it.
+ */
+typedef bool (*afxdp_nf_handler_t)(void *pkt, uint32_t *len, void *arg);
+
+/*
+ * State of one NF attached to the AF_XDP datapath.
+ *
+ * The NF's socket shares the manager's UMEM and queue, and sits in
+ * xsks_map[AFXDP_NF_XSK_BASE + nf_id]. A dedicated thread polls it, so
+ * packets of the NF's flows never pass through the manager's socket.
+ */
+struct afxdp_nf_info {
+        struct afxdp_socket_info *xsk;
+        struct afxdp_manager_ctx *mgr;
+        afxdp_nf_handler_t handler;
+        void *arg;
+        pthread_t thread;
+        uint16_t nf_id;
+};
+
 /**************************** Runtime Config **********************************/
 
 /*
@@ -183,6 +251,10 @@ struct afxdp_config {
 
         __u16 xsk_bind_flags;                 /* Copy-mode vs zero-copy flags */
 
+        /* Flow rules steering traffic to NF sockets (-F) */
+        struct afxdp_flow_rule flow_rules[AFXDP_MAX_CFG_FLOW_RULES];
+        int num_flow_rules;
+
         bool xsk_poll_mode;                   /* Use poll() instead of busy-wait */
         bool custom_xdp_prog;                 /* true if user supplied a custom .o */
         bool verbose;                         /* Enable verbose logging */
@@ -207,6 +279,10 @@ struct afxdp_manager_ctx {
         pthread_t stats_thread;
 
         int xsk_map_fd;                       /* fd of the XSKMAP in the kernel */
+        int flow_map_fd;                      /* fd of the flow_map in the kernel */
+
+        /* NFs owning their own XSK socket, indexed by NF id */
+        struct afxdp_nf_info *nfs[AFXDP_MAX_NFS];
 
         volatile bool global_exit;
         bool use_hugepages;                   /* true → munmap; false → free()    */
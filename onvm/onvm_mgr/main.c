@@ -48,6 +48,7 @@
 ******************************************************************************/
 
 #include <signal.h>
+#include <unistd.h>
 
 /*
  * AF_XDP header is always included so that afxdp_preallocate_hugepages()
@@ -86,10 +87,14 @@ static uint8_t worker_keep_running = 1;
 static void
 handle_signal(int sig);
 
+static void
+onvm_main_snapshot_flows(void);
+
 /*******************************Worker threads********************************/
 
 /*
- * Stats thread periodically prints per-port and per-NF stats.
+ * Master thread handles NF control messages as they arrive and
+ * periodically prints per-port and per-NF stats.
  */
 static void
 master_thread_main(void) {
@@ -100,7 +105,11 @@ master_thread_main(void) {
         const uint32_t time_to_live = global_time_to_live;
         const uint32_t pkt_limit = global_pkt_limit;
         const uint64_t start_time = rte_get_tsc_cycles();
+        const uint64_t stats_period = (uint64_t)sleeptime * rte_get_timer_hz();
         uint64_t total_rx_pkts;
+        uint64_t last_snapshot = start_time;
+        uint64_t last_stats = start_time;
+        uint64_t now;
 
         RTE_LOG(INFO, APP, "Socket %d, Core %d: Running master thread\n", rte_socket_id(), rte_lcore_id());
 
@@ -118,9 +127,16 @@ master_thread_main(void) {
         sleep(5);
 
         onvm_stats_init(verbosity_level);
-        /* Loop forever: sleep always returns 0 or <= param */
-        while (main_keep_running && sleep(sleeptime) <= sleeptime) {
-                onvm_nf_check_status();
+        while (main_keep_running) {
+                /* Keep handling message batches while NFs send them, only idle once the queue is empty */
+                if (onvm_nf_check_status() == 0)
+                        usleep(ONVM_MSG_POLL_US);
+
+                now = rte_get_tsc_cycles();
+                if (now - last_stats < stats_period)
+                        continue;
+                last_stats = now;
+
                 if (stats_destination != ONVM_STATS_NONE)
                         onvm_stats_display_all(sleeptime, verbosity_level);
 
@@ -130,6 +146,12 @@ master_thread_main(void) {
                         main_keep_running = 0;
                 }
 
+                if (global_ft_snapshot_file && global_ft_snapshot_interval &&
+                    (rte_get_tsc_cycles() - last_snapshot) / rte_get_timer_hz() >= global_ft_snapshot_interval) {
+                        onvm_main_snapshot_flows();
+                        last_snapshot = rte_get_tsc_cycles();
+                }
+
                 if (pkt_limit) {
                         total_rx_pkts = 0;
                         for (i = 0; i < ports->num_ports; i++)
@@ -171,7 +193,8 @@ master_thread_main(void) {
 
         /* Wait to process all exits */
         for (shutdown_iter_count = 0; shutdown_iter_count < MAX_SHUTDOWN_ITERS && num_nfs > 0; shutdown_iter_count++) {
-                onvm_nf_check_status();
+                while (onvm_nf_check_status() > 0)
+                        ;
                 RTE_LOG(INFO, APP, "Socket %d, Core %d: Waiting for %" PRIu16 " NFs to exit\n", rte_socket_id(), rte_lcore_id(), num_nfs);
                 sleep(sleeptime);
         }
@@ -181,6 +204,10 @@ master_thread_main(void) {
                         rte_socket_id(), rte_lcore_id(), num_nfs);
         }
 
+        /* Save the flow director so the next manager instance can warm restart */
+        if (global_ft_snapshot_file)
+                onvm_main_snapshot_flows();
+
         /* Clean up the shared memory */
         if (ONVM_NF_SHARE_CORES) {
                 for (i = 0; i < MAX_NFS; i++) {
@@ -200,17 +227,23 @@ static int
 rx_thread_main(void *arg) {
         uint16_t i, rx_count, cur_lcore;
         struct rte_mbuf *pkts[PACKET_READ_SIZE];
+        struct onvm_burst burst[RTE_MAX_ETHPORTS];
         struct queue_mgr *rx_mgr = (struct queue_mgr *)arg;
         cur_lcore = rte_lcore_id();
 
+        for (i = 0; i < ports->num_ports; i++)
+                onvm_burst_init(&burst[i], global_burst_min, global_burst_max);
+
         onvm_stats_gen_event_info("Rx Start", ONVM_EVENT_WITH_CORE, &cur_lcore);
         RTE_LOG(INFO, APP, "Socket %d, Core %d: Running RX thread for RX queue %d\n", rte_socket_id(), cur_lcore, rx_mgr->id);
 
         for (; worker_keep_running;) {
                 /* Read ports */
                 for (i = 0; i < ports->num_ports; i++) {
-                        rx_count = rte_eth_rx_burst(ports->id[i], rx_mgr->id, pkts, PACKET_READ_SIZE);
+                        rx_count = rte_eth_rx_burst(ports->id[i], rx_mgr->id, pkts, burst[i].size);
                         ports->rx_stats.rx[ports->id[i]] += rx_count;
+                        onvm_burst_update(&burst[i], rx_count);
+                        ports->rx_stats.burst[ports->id[i]] = burst[i].size;
 
                         /* Now process the NIC packets read */
                         if (likely(rx_count > 0)) {
@@ -218,10 +251,14 @@ rx_thread_main(void *arg) {
                                 if (!num_nfs) {
                                         onvm_pkt_drop_batch(pkts, rx_count);
                                 } else {
+                                        onvm_pkt_prefetch_burst(pkts, rx_count);
                                         onvm_pkt_process_rx_batch(rx_mgr, pkts, rx_count);
                                 }
                         }
                 }
+
+                /* Send a burst to every NF, this also retries what full rings left over while the ports are idle */
+                onvm_pkt_flush_all_nfs(rx_mgr, NULL);
         }
 
         RTE_LOG(INFO, APP, "Socket %d, Core %d: RX thread done\n", rte_socket_id(), rte_lcore_id());
@@ -233,9 +270,13 @@ tx_thread_main(void *arg) {
         struct onvm_nf *nf;
         unsigned i, tx_count, cur_lcore;
         struct rte_mbuf *pkts[PACKET_READ_SIZE];
+        struct onvm_burst burst[MAX_NFS];
         struct queue_mgr *tx_mgr = (struct queue_mgr *)arg;
         cur_lcore = rte_lcore_id();
 
+        for (i = 0; i < MAX_NFS; i++)
+                onvm_burst_init(&burst[i], global_burst_min, global_burst_max);
+
         onvm_stats_gen_event_info("Tx Start", ONVM_EVENT_WITH_CORE, &cur_lcore);
         if (tx_mgr->tx_thread_info->first_nf == tx_mgr->tx_thread_info->last_nf - 1) {
                 RTE_LOG(INFO, APP, "Socket %d, Core %d: Running TX thread for NF %d\n", rte_socket_id(), cur_lcore,
@@ -252,11 +293,14 @@ tx_thread_main(void *arg) {
                         if (!onvm_nf_is_valid(nf))
                                 continue;
 
-                        /* Dequeue all packets in ring up to max possible. */
-                        tx_count = rte_ring_dequeue_burst(nf->tx_q, (void **)pkts, PACKET_READ_SIZE, NULL);
+                        /* Dequeue packets in ring up to the adaptive burst size. */
+                        tx_count = rte_ring_dequeue_burst(nf->tx_q, (void **)pkts, burst[i].size, NULL);
+                        onvm_burst_update(&burst[i], tx_count);
+                        nf->stats.tx_burst = burst[i].size;
 
                         /* Now process the Client packets read */
                         if (likely(tx_count > 0)) {
+                                onvm_pkt_prefetch_burst(pkts, tx_count);
                                 onvm_pkt_process_tx_batch(tx_mgr, pkts, tx_count, nf);
                         }
                 }
@@ -279,6 +323,22 @@ handle_signal(int sig) {
         }
 }
 
+/*
+ * Save the flow director to the snapshot file given with -w.
+ */
+static void
+onvm_main_snapshot_flows(void) {
+        int ret;
+
+        ret = onvm_flow_dir_snapshot(global_ft_snapshot_file);
+        if (ret < 0) {
+                RTE_LOG(INFO, APP, "Failed to save flow snapshot to %s: %s\n", global_ft_snapshot_file,
+                        strerror(-ret));
+                return;
+        }
+        RTE_LOG(INFO, APP, "Saved %d flows to %s\n", ret, global_ft_snapshot_file);
+}
+
 static inline void
 wakeup_client(struct nf_wakeup_info *nf_wakeup_info) {
         nf_wakeup_info->num_wakeups++;
@@ -478,7 +538,8 @@ main(int argc, char *argv[]) {
                 if (tx_mgr[i]->tx_thread_info->port_tx_bufs == NULL) {
                         goto onvm_free;
                 }
-                tx_mgr[i]->nf_rx_bufs = rte_calloc(NULL, MAX_NFS, sizeof(struct packet_buf), RTE_CACHE_LINE_SIZE);
+                tx_mgr[i]->nf_rx_bufs =
+                    rte_calloc(NULL, MAX_NFS * ONVM_NUM_PRIO, sizeof(struct packet_buf), RTE_CACHE_LINE_SIZE);
                 if (tx_mgr[i]->nf_rx_bufs == NULL) {
                         goto onvm_free;
                 }
@@ -502,7 +563,8 @@ main(int argc, char *argv[]) {
                 rx_mgr[i]->mgr_type_t = MGR;
                 rx_mgr[i]->id = i;
                 rx_mgr[i]->tx_thread_info = NULL;
-                rx_mgr[i]->nf_rx_bufs = rte_calloc(NULL, MAX_NFS, sizeof(struct packet_buf), RTE_CACHE_LINE_SIZE);
+                rx_mgr[i]->nf_rx_bufs =
+                    rte_calloc(NULL, MAX_NFS * ONVM_NUM_PRIO, sizeof(struct packet_buf), RTE_CACHE_LINE_SIZE);
                 if (rx_mgr[i] -> nf_rx_bufs == NULL) {
                         goto onvm_free;
                 }
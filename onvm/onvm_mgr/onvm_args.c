@@ -82,6 +82,22 @@ uint8_t ONVM_NF_SHARE_CORES = 0;
 /* global flag for jumbo frames - extern in init.h */
 uint8_t ONVM_USE_JUMBO_FRAMES = 0;
 
+/* global var for the flow director snapshot file used for warm restarts - extern in init.h */
+const char *global_ft_snapshot_file = NULL;
+
+/* global var for how often the flow director is snapshotted, 0 for shutdown only - extern in init.h */
+uint32_t global_ft_snapshot_interval = 0;
+
+/* global var for the JSON file holding the chain table - extern in init.h */
+const char *global_chain_config_file = NULL;
+
+/* global var to install the chain table rules on the NICs with rte_flow - extern in init.h */
+uint8_t global_chain_offload = 0;
+
+/* global vars for the bounds of the adaptive RX/TX burst size - extern in init.h */
+uint16_t global_burst_min = ONVM_BURST_MIN;
+uint16_t global_burst_max = PACKET_READ_SIZE;
+
 /* global var for program name */
 static const char *progname;
 
@@ -117,6 +133,18 @@ parse_stats_sleep_time(const char *sleeptime);
 static int
 parse_verbosity_level(const char *verbosity_level);
 
+static int
+parse_ft_snapshot_interval(const char *interval);
+
+static int
+parse_overflow_policy(const char *policy);
+
+static int
+parse_burst_bounds(const char *bounds);
+
+static int
+parse_af_xdp_port(const char *spec);
+
 /*********************************Interfaces**********************************/
 
 int
@@ -130,11 +158,14 @@ parse_app_args(uint8_t max_ports, int argc, char *argv[]) {
             {"stats-out", no_argument, NULL, 's'},       {"stats-sleep-time", no_argument, NULL, 'z'},
             {"time_to_live", no_argument, NULL, 't'},    {"packet_limit", no_argument, NULL, 'l'},
             {"verbocity-level", no_argument, NULL, 'v'}, {"enable_shared_cpu", no_argument, NULL, 'c'},
-            {"jumbo_frames", no_argument, NULL, 'j'}};
+            {"jumbo_frames", no_argument, NULL, 'j'},    {"ft-snapshot", required_argument, NULL, 'w'},
+            {"ft-snapshot-interval", required_argument, NULL, 'i'}, {"chain-config", required_argument, NULL, 'C'},
+            {"chain-offload", no_argument, NULL, 'o'},  {"overflow-policy", required_argument, NULL, 'q'},
+            {"burst", required_argument, NULL, 'b'},     {"af-xdp", required_argument, NULL, 'x'}};
 
         progname = argv[0];
 
-        while ((opt = getopt_long(argc, argvopt, "p:r:n:d:s:t:l:z:v:cj", lgopts, &option_index)) != EOF) {
+        while ((opt = getopt_long(argc, argvopt, "p:r:n:d:s:t:l:z:v:cjw:i:C:oq:b:x:", lgopts, &option_index)) != EOF) {
                 switch (opt) {
                         case 'p':
                                 if (parse_portmask(max_ports, optarg) != 0) {
@@ -199,6 +230,39 @@ parse_app_args(uint8_t max_ports, int argc, char *argv[]) {
                         case 'j':
                                 ONVM_USE_JUMBO_FRAMES = 1;
                                 break;
+                        case 'w':
+                                global_ft_snapshot_file = optarg;
+                                break;
+                        case 'i':
+                                if (parse_ft_snapshot_interval(optarg) != 0) {
+                                        usage();
+                                        return -1;
+                                }
+                                break;
+                        case 'C':
+                                global_chain_config_file = optarg;
+                                break;
+                        case 'o':
+                                global_chain_offload = 1;
+                                break;
+                        case 'q':
+                                if (parse_overflow_policy(optarg) != 0) {
+                                        usage();
+                                        return -1;
+                                }
+                                break;
+                        case 'b':
+                                if (parse_burst_bounds(optarg) != 0) {
+                                        usage();
+                                        return -1;
+                                }
+                                break;
+                        case 'x':
+                                if (parse_af_xdp_port(optarg) != 0) {
+                                        usage();
+                                        return -1;
+                                }
+                                break;
                         default:
                                 printf("ERROR: Unknown option '%c'\n", opt);
                                 usage();
@@ -224,7 +288,15 @@ usage(void) {
             "\t-l PACKET_LIMIT: how many millions of packets to recieve before exiting (optional)\n"
             "\t-v VERBOCITY_LEVEL: verbocity level of the stats output (optional)\n"
             "\t-c ENABLE_SHARED_CORE: allow the NFs to share a core based on mutex sleep/wakeups (optional)\n"
-            "\t-j JUMBO_FRAMES: allow the ports to send and receive jumbo frames (optional)\n",
+            "\t-j JUMBO_FRAMES: allow the ports to send and receive jumbo frames (optional)\n"
+            "\t-w FT_SNAPSHOT_FILE: restore the flow director from this file on start and save it on exit (optional)\n"
+            "\t-i FT_SNAPSHOT_INTERVAL: also save the flow director snapshot every N seconds (optional)\n"
+            "\t-C CHAIN_CONFIG: JSON file with chains selected by port, VLAN or IPv4 rule (optional)\n"
+            "\t-o CHAIN_OFFLOAD: classify chain table rules on the NIC with rte_flow where supported (optional)\n"
+            "\t-q OVERFLOW_POLICY: what a full NF or port buffer drops, tail (the new packet, default) or head (the oldest) (optional)\n"
+            "\t-b MIN,MAX: bounds of the adaptive RX/TX burst size, MIN at least 4 and MAX at most 32. defaults to 4,32 (optional)\n"
+            "\t-x IFACE[,DEVARGS]: also use kernel interface IFACE through the net_af_xdp PMD, DEVARGS such as\n"
+            "\t   start_queue, queue_count, shared_umem, busy_budget or xdp_prog go to the PMD, may be repeated (optional)\n",
             progname);
 }
 
@@ -414,3 +486,112 @@ parse_verbosity_level(const char *verbosity_level) {
         global_verbosity_level = (uint16_t)temp;
         return 0;
 }
+
+static int
+parse_ft_snapshot_interval(const char *interval) {
+        char *end = NULL;
+        unsigned long temp;
+
+        temp = strtoul(interval, &end, 10);
+        if (end == NULL || *end != '\0' || temp == 0)
+                return -1;
+
+        global_ft_snapshot_interval = (uint32_t)temp;
+        return 0;
+}
+
+static int
+parse_overflow_policy(const char *policy) {
+        if (strcmp(policy, "tail") == 0)
+                onvm_config->flags.ONVM_OVERFLOW_POLICY = ONVM_OVERFLOW_DROP_TAIL;
+        else if (strcmp(policy, "head") == 0)
+                onvm_config->flags.ONVM_OVERFLOW_POLICY = ONVM_OVERFLOW_DROP_HEAD;
+        else
+                return -1;
+
+        return 0;
+}
+
+static int
+parse_burst_bounds(const char *bounds) {
+        char *end = NULL;
+        unsigned long min, max;
+
+        min = strtoul(bounds, &end, 10);
+        if (end == NULL || *end != ',')
+                return -1;
+        max = strtoul(end + 1, &end, 10);
+        if (end == NULL || *end != '\0' || min == 0 || max > PACKET_READ_SIZE)
+                return -1;
+        /* min is not 0 here, so rounding up also reaches ONVM_BURST_MIN */
+        if (min % ONVM_BURST_MIN != 0) {
+                printf("Raising the minimum burst size from %lu to %lu for vector RX\n", min,
+                       RTE_ALIGN_CEIL(min, ONVM_BURST_MIN));
+                min = RTE_ALIGN_CEIL(min, ONVM_BURST_MIN);
+        }
+        if (max % ONVM_BURST_MIN != 0) {
+                printf("Lowering the maximum burst size from %lu to %lu for vector RX\n", max,
+                       RTE_ALIGN_FLOOR(max, ONVM_BURST_MIN));
+                max = RTE_ALIGN_FLOOR(max, ONVM_BURST_MIN);
+        }
+        if (min > max)
+                return -1;
+
+        global_burst_min = (uint16_t)min;
+        global_burst_max = (uint16_t)max;
+        return 0;
+}
+
+/*
+ * Create a net_af_xdp port on a kernel interface and add it to the ports
+ * the manager uses, next to the ones in the port mask. spec is the
+ * interface name followed by PMD devargs, which are passed on as they are.
+ * queue_count defaults to the number of RX or TX queues init_port sets up,
+ * whichever is larger, so every manager thread gets a socket.
+ */
+static int
+parse_af_xdp_port(const char *spec) {
+        static unsigned af_xdp_ports = 0;
+        char name[RTE_ETH_NAME_MAX_LEN];
+        char devargs[ONVM_AF_XDP_DEVARGS_MAX];
+        const char *opts;
+        uint16_t port_id;
+        int tx_threads, queues, len;
+
+        if (spec == NULL || *spec == '\0' || *spec == ',')
+                return -1;
+        if (ports->num_ports >= RTE_MAX_ETHPORTS) {
+                printf("ERROR: no room for AF_XDP port on %s\n", spec);
+                return -1;
+        }
+
+        /* The same queue counts init_port uses */
+        tx_threads = (int)rte_lcore_count() - ONVM_NUM_RX_THREADS - ONVM_NUM_MGR_AUX_THREADS;
+        queues = RTE_MAX(ONVM_NUM_RX_THREADS, tx_threads);
+
+        opts = strchr(spec, ',');
+        if (opts != NULL && strstr(opts, "queue_count=") != NULL)
+                len = snprintf(devargs, sizeof(devargs), "iface=%s", spec);
+        else
+                len = snprintf(devargs, sizeof(devargs), "iface=%s,queue_count=%d", spec, queues);
+        if (len < 0 || len >= (int)sizeof(devargs)) {
+                printf("ERROR: AF_XDP arguments for %s are too long\n", spec);
+                return -1;
+        }
+
+        snprintf(name, sizeof(name), "net_af_xdp%u", af_xdp_ports);
+        if (rte_vdev_init(name, devargs) != 0) {
+                printf("ERROR: cannot create AF_XDP port %s with %s\n", name, devargs);
+                return -1;
+        }
+        if (rte_eth_dev_get_port_by_name(name, &port_id) != 0) {
+                rte_vdev_uninit(name);
+                return -1;
+        }
+        af_xdp_ports++;
+
+        ports->id[ports->num_ports++] = port_id;
+        printf("AF_XDP port %u: %s\n", (unsigned)port_id, devargs);
+
+        return 0;
+}
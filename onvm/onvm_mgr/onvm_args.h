@@ -52,11 +52,16 @@
 
 #include "getopt.h"
 
+#include <rte_bus_vdev.h>
+
 #include "onvm_includes.h"
 #include "onvm_mgr/onvm_init.h"
 
 #define DEFAULT_SERVICE_ID 1
 
+/* Longest devargs string of an AF_XDP port */
+#define ONVM_AF_XDP_DEVARGS_MAX 256
+
 int
 parse_app_args(uint8_t max_ports, int argc, char *argv[]);
 
@@ -0,0 +1,404 @@
+/*********************************************************************
+ *                     openNetVM
+ *              https://sdnfv.github.io
+ *
+ *   BSD LICENSE
+ *
+ *   Copyright(c)
+ *            2015-2019 George Washington University
+ *            2015-2019 University of California Riverside
+ *            2010-2019 Intel Corporation. All rights reserved.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * The name of the author may not be used to endorse or promote
+ *       products derived from this software without specific prior
+ *       written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+
+/******************************************************************************
+
+                              onvm_chain_table.c
+
+
+     Chain table shared with NFs and the classifier selecting a chain for
+     packets that miss in the flow director.
+
+
+******************************************************************************/
+
+#include <rte_flow.h>
+#include <rte_prefetch.h>
+
+#include "onvm_mgr.h"
+
+#include "onvm_chain_table.h"
+
+/****************************Internal Declarations****************************/
+
+struct onvm_chain_table *chain_table;
+
+static struct onvm_chain_rule chain_rules[ONVM_MAX_CHAIN_RULES];
+static uint16_t num_chain_rules;
+/* Set when any rule needs the IPv4 header, lets port/VLAN only setups skip parsing it */
+static uint8_t chain_rules_match_l3;
+
+static inline uint8_t
+onvm_chain_table_classify(struct rte_mbuf *pkt);
+
+static int
+onvm_chain_rules_disjoint(const struct onvm_chain_rule *a, const struct onvm_chain_rule *b);
+
+static int
+onvm_chain_table_offload_rule(uint16_t port_id, struct onvm_chain_rule *rule, const struct rte_flow_action_rss *rss);
+
+/*********************************Interfaces**********************************/
+
+int
+onvm_chain_table_init(void) {
+        const struct rte_memzone *mz_chain_table;
+
+        mz_chain_table = rte_memzone_reserve(MZ_CHAIN_TABLE, sizeof(struct onvm_chain_table), rte_socket_id(),
+                                             NO_FLAGS);
+        if (mz_chain_table == NULL)
+                return -1;
+        memset(mz_chain_table->addr, 0, sizeof(struct onvm_chain_table));
+        chain_table = mz_chain_table->addr;
+        /* id 0 is the default chain */
+        chain_table->num_chains = 1;
+        num_chain_rules = 0;
+        chain_rules_match_l3 = 0;
+
+        return 0;
+}
+
+int
+onvm_chain_table_load(const char *filename) {
+        cJSON *config;
+        struct onvm_config_chain *chains = NULL;
+        struct onvm_config_chain *cfg;
+        struct onvm_chain_rule *rule;
+        struct onvm_service_chain *sc;
+        int num_chains = 0;
+        int i, j;
+
+        config = onvm_config_parse_file(filename);
+        if (config == NULL) {
+                printf("Could not parse chain config file %s\n", filename);
+                return -1;
+        }
+
+        if (onvm_config_extract_chains(config, &chains, &num_chains, ONVM_MAX_CHAIN_LENGTH) < 0) {
+                printf("Invalid chains section in %s\n", filename);
+                cJSON_Delete(config);
+                return -1;
+        }
+        cJSON_Delete(config);
+
+        if (num_chains > ONVM_MAX_CHAIN_RULES) {
+                printf("Too many chains in %s, at most %d are supported\n", filename, ONVM_MAX_CHAIN_RULES);
+                onvm_config_free_chains(chains, num_chains);
+                return -1;
+        }
+
+        /* The RX thread can mirror to NFs but only hand packets to an NF, so that must be the first real hop */
+        for (i = 0; i < num_chains; i++) {
+                cfg = &chains[i];
+                for (j = 0; j < cfg->num_hops && cfg->hops[j].action == ONVM_NF_ACTION_MIRROR; j++)
+                        ;
+                if (j == cfg->num_hops || cfg->hops[j].action != ONVM_NF_ACTION_TONF) {
+                        printf("Chain %d in %s must start with a tonf hop (after any mirror hops)\n", i + 1,
+                               filename);
+                        onvm_config_free_chains(chains, num_chains);
+                        return -1;
+                }
+        }
+
+        for (i = 0; i < num_chains; i++) {
+                cfg = &chains[i];
+                sc = &chain_table->chains[i + 1];
+                memset(sc, 0, sizeof(*sc));
+                for (j = 0; j < cfg->num_hops; j++)
+                        onvm_sc_append_entry(sc, cfg->hops[j].action, cfg->hops[j].destination);
+
+                rule = &chain_rules[i];
+                rule->port = cfg->port == ONVM_CONFIG_MATCH_ANY ? ONVM_CHAIN_MATCH_ANY : (uint16_t)cfg->port;
+                rule->vlan = cfg->vlan == ONVM_CONFIG_MATCH_ANY ? ONVM_CHAIN_MATCH_ANY : (uint16_t)cfg->vlan;
+                rule->proto = cfg->proto == ONVM_CONFIG_MATCH_ANY ? ONVM_CHAIN_MATCH_ANY : (uint16_t)cfg->proto;
+                rule->dst_port =
+                    cfg->dst_port == ONVM_CONFIG_MATCH_ANY ? ONVM_CHAIN_MATCH_ANY : (uint16_t)cfg->dst_port;
+                rule->src_ip = cfg->src_ip;
+                rule->src_mask = cfg->src_mask;
+                rule->dst_ip = cfg->dst_ip;
+                rule->dst_mask = cfg->dst_mask;
+                rule->match_l3 = rule->proto != ONVM_CHAIN_MATCH_ANY || rule->dst_port != ONVM_CHAIN_MATCH_ANY ||
+                                 rule->src_mask != 0 || rule->dst_mask != 0;
+                rule->chain_id = i + 1;
+                chain_rules_match_l3 |= rule->match_l3;
+
+                printf("Chain %d: port %d vlan %d\n", i + 1, cfg->port, cfg->vlan);
+                onvm_sc_print(sc);
+        }
+        num_chain_rules = num_chains;
+        chain_table->num_chains = num_chains + 1;
+
+        onvm_config_free_chains(chains, num_chains);
+        return num_chains;
+}
+
+void
+onvm_chain_table_classify_burst(struct rte_mbuf *pkts[], uint16_t count, uint8_t chain_ids[]) {
+        uint16_t i;
+
+        if (num_chain_rules == 0) {
+                memset(chain_ids, 0, count * sizeof(uint8_t));
+                return;
+        }
+
+        /* Pull in all headers first so classification does not stall on each packet */
+        for (i = 0; i < count; i++)
+                rte_prefetch0(rte_pktmbuf_mtod(pkts[i], void *));
+
+        for (i = 0; i < count; i++)
+                chain_ids[i] = onvm_chain_table_classify(pkts[i]);
+}
+
+int
+onvm_chain_table_offload(uint16_t port_id) {
+        struct rte_flow_error error;
+        struct onvm_chain_rule *rule;
+        struct rte_eth_rss_conf rss_conf = {.rss_key = NULL};
+        uint16_t queues[ONVM_NUM_RX_THREADS];
+        struct rte_flow_action_rss rss = {
+                .func = RTE_ETH_HASH_FUNCTION_DEFAULT,
+                .key_len = RTE_DIM(rss_symmetric_key),
+                .queue_num = ONVM_NUM_RX_THREADS,
+                .key = rss_symmetric_key,
+                .queue = queues,
+        };
+        uint16_t i, j;
+        int offloaded = 0;
+
+        if (num_chain_rules == 0)
+                return 0;
+
+        /* Marked packets are spread like the rest, with the port's own RSS hash */
+        for (i = 0; i < ONVM_NUM_RX_THREADS; i++)
+                queues[i] = i;
+        if (rte_eth_dev_rss_hash_conf_get(port_id, &rss_conf) == 0)
+                rss.types = rss_conf.rss_hf;
+
+        /* Start from an empty rule set, drivers without rte_flow support fail here already */
+        if (rte_flow_flush(port_id, &error) != 0) {
+                RTE_LOG(INFO, APP, "Port %u: no rte_flow support, chain rules are classified in software\n",
+                        port_id);
+                return 0;
+        }
+
+        for (i = 0; i < num_chain_rules; i++) {
+                rule = &chain_rules[i];
+                if (rule->port != ONVM_CHAIN_MATCH_ANY && rule->port != port_id)
+                        continue;
+                /*
+                 * All rules share one priority, as many NICs offer only a few,
+                 * so the NIC's order among overlapping rules is undefined.
+                 */
+                for (j = 0; j < i; j++) {
+                        if ((chain_rules[j].port == ONVM_CHAIN_MATCH_ANY || chain_rules[j].port == port_id) &&
+                            chain_rules[j].chain_id != rule->chain_id &&
+                            !onvm_chain_rules_disjoint(&chain_rules[j], rule))
+                                break;
+                }
+                if (j < i || onvm_chain_table_offload_rule(port_id, rule, &rss) < 0) {
+                        RTE_LOG(INFO, APP, "Port %u: chain rule %u and later are classified in software\n",
+                                port_id, i + 1);
+                        break;
+                }
+                offloaded++;
+        }
+
+        return offloaded;
+}
+
+/******************************Internal functions*****************************/
+
+/*
+ * Returns 1 if no packet matches both rules on a port both apply to.
+ * Addresses are stored masked, see onvm_chain_table_classify.
+ */
+static int
+onvm_chain_rules_disjoint(const struct onvm_chain_rule *a, const struct onvm_chain_rule *b) {
+        if (a->vlan != ONVM_CHAIN_MATCH_ANY && b->vlan != ONVM_CHAIN_MATCH_ANY && a->vlan != b->vlan)
+                return 1;
+        /* a rule without L3 fields also matches packets that are not IPv4 */
+        if (!a->match_l3 || !b->match_l3)
+                return 0;
+        if ((a->src_ip ^ b->src_ip) & a->src_mask & b->src_mask)
+                return 1;
+        if ((a->dst_ip ^ b->dst_ip) & a->dst_mask & b->dst_mask)
+                return 1;
+        if (a->proto != ONVM_CHAIN_MATCH_ANY && b->proto != ONVM_CHAIN_MATCH_ANY && a->proto != b->proto)
+                return 1;
+        if (a->dst_port != ONVM_CHAIN_MATCH_ANY && b->dst_port != ONVM_CHAIN_MATCH_ANY && a->dst_port != b->dst_port)
+                return 1;
+        return 0;
+}
+
+/*
+ * Translate one rule into ETH [/ VLAN] [/ IPV4 [/ TCP|UDP]] -> MARK / RSS.
+ * Untagged-only (VLAN 0) rules and port matches without a protocol cannot
+ * be expressed and are left to software.
+ */
+static int
+onvm_chain_table_offload_rule(uint16_t port_id, struct onvm_chain_rule *rule, const struct rte_flow_action_rss *rss) {
+        struct rte_flow_attr attr = {.priority = 0, .ingress = 1};
+        struct rte_flow_item pattern[5];
+        struct rte_flow_action actions[3];
+        struct rte_flow_item_vlan vlan_spec = {0}, vlan_mask = {0};
+        struct rte_flow_item_ipv4 ipv4_spec = {0}, ipv4_mask = {0};
+        struct rte_flow_item_tcp tcp_spec = {0}, tcp_mask = {0};
+        struct rte_flow_item_udp udp_spec = {0}, udp_mask = {0};
+        struct rte_flow_action_mark mark = {.id = rule->chain_id};
+        struct rte_flow_error error;
+        int n = 0;
+
+        if (rule->vlan == 0)
+                return -ENOTSUP;
+        if (rule->dst_port != ONVM_CHAIN_MATCH_ANY && rule->proto != IP_PROTOCOL_TCP &&
+            rule->proto != IP_PROTOCOL_UDP)
+                return -ENOTSUP;
+
+        memset(pattern, 0, sizeof(pattern));
+        memset(actions, 0, sizeof(actions));
+
+        pattern[n++].type = RTE_FLOW_ITEM_TYPE_ETH;
+        if (rule->vlan != ONVM_CHAIN_MATCH_ANY) {
+                vlan_spec.tci = rte_cpu_to_be_16(rule->vlan);
+                vlan_mask.tci = rte_cpu_to_be_16(0x0FFF);
+                pattern[n].type = RTE_FLOW_ITEM_TYPE_VLAN;
+                pattern[n].spec = &vlan_spec;
+                pattern[n++].mask = &vlan_mask;
+        }
+        if (rule->match_l3) {
+                ipv4_spec.hdr.src_addr = rte_cpu_to_be_32(rule->src_ip);
+                ipv4_mask.hdr.src_addr = rte_cpu_to_be_32(rule->src_mask);
+                ipv4_spec.hdr.dst_addr = rte_cpu_to_be_32(rule->dst_ip);
+                ipv4_mask.hdr.dst_addr = rte_cpu_to_be_32(rule->dst_mask);
+                if (rule->proto != ONVM_CHAIN_MATCH_ANY) {
+                        ipv4_spec.hdr.next_proto_id = rule->proto;
+                        ipv4_mask.hdr.next_proto_id = 0xFF;
+                }
+                pattern[n].type = RTE_FLOW_ITEM_TYPE_IPV4;
+                pattern[n].spec = &ipv4_spec;
+                pattern[n++].mask = &ipv4_mask;
+
+                if (rule->proto == IP_PROTOCOL_TCP && rule->dst_port != ONVM_CHAIN_MATCH_ANY) {
+                        tcp_spec.hdr.dst_port = rte_cpu_to_be_16(rule->dst_port);
+                        tcp_mask.hdr.dst_port = 0xFFFF;
+                        pattern[n].type = RTE_FLOW_ITEM_TYPE_TCP;
+                        pattern[n].spec = &tcp_spec;
+                        pattern[n++].mask = &tcp_mask;
+                } else if (rule->proto == IP_PROTOCOL_UDP && rule->dst_port != ONVM_CHAIN_MATCH_ANY) {
+                        udp_spec.hdr.dst_port = rte_cpu_to_be_16(rule->dst_port);
+                        udp_mask.hdr.dst_port = 0xFFFF;
+                        pattern[n].type = RTE_FLOW_ITEM_TYPE_UDP;
+                        pattern[n].spec = &udp_spec;
+                        pattern[n++].mask = &udp_mask;
+                }
+        }
+        pattern[n].type = RTE_FLOW_ITEM_TYPE_END;
+
+        actions[0].type = RTE_FLOW_ACTION_TYPE_MARK;
+        actions[0].conf = &mark;
+        actions[1].type = RTE_FLOW_ACTION_TYPE_RSS;
+        actions[1].conf = rss;
+        actions[2].type = RTE_FLOW_ACTION_TYPE_END;
+
+        if (rte_flow_validate(port_id, &attr, pattern, actions, &error) != 0)
+                return -ENOTSUP;
+        if (rte_flow_create(port_id, &attr, pattern, actions, &error) == NULL) {
+                RTE_LOG(INFO, APP, "Port %u: rte_flow_create failed: %s\n", port_id,
+                        error.message ? error.message : "unknown");
+                return -ENOTSUP;
+        }
+
+        return 0;
+}
+
+static inline uint8_t
+onvm_chain_table_classify(struct rte_mbuf *pkt) {
+        struct rte_ether_hdr *eth = rte_pktmbuf_mtod(pkt, struct rte_ether_hdr *);
+        struct rte_vlan_hdr *vlan_hdr;
+        struct rte_ipv4_hdr *ipv4 = NULL;
+        struct onvm_chain_rule *rule;
+        uint16_t ether_type = eth->ether_type;
+        uint16_t vlan = 0;
+        uint32_t src_ip = 0, dst_ip = 0;
+        uint16_t proto = 0, dst_port = 0;
+        void *l3 = eth + 1;
+        uint8_t *l4;
+        uint16_t i;
+
+        if (pkt->ol_flags & PKT_RX_VLAN_STRIPPED) {
+                vlan = pkt->vlan_tci & 0xFFF;
+        } else if (ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_VLAN)) {
+                vlan_hdr = (struct rte_vlan_hdr *)l3;
+                vlan = rte_be_to_cpu_16(vlan_hdr->vlan_tci) & 0xFFF;
+                ether_type = vlan_hdr->eth_proto;
+                l3 = vlan_hdr + 1;
+        }
+
+        if (chain_rules_match_l3 && ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4)) {
+                ipv4 = (struct rte_ipv4_hdr *)l3;
+                src_ip = rte_be_to_cpu_32(ipv4->src_addr);
+                dst_ip = rte_be_to_cpu_32(ipv4->dst_addr);
+                proto = ipv4->next_proto_id;
+                if (proto == IP_PROTOCOL_TCP || proto == IP_PROTOCOL_UDP) {
+                        /* TCP and UDP both start with the source and destination ports */
+                        l4 = (uint8_t *)ipv4 + (ipv4->version_ihl & RTE_IPV4_HDR_IHL_MASK) * RTE_IPV4_IHL_MULTIPLIER;
+                        dst_port = rte_be_to_cpu_16(((struct rte_udp_hdr *)l4)->dst_port);
+                }
+        }
+
+        for (i = 0; i < num_chain_rules; i++) {
+                rule = &chain_rules[i];
+                if (rule->port != ONVM_CHAIN_MATCH_ANY && rule->port != pkt->port)
+                        continue;
+                if (rule->vlan != ONVM_CHAIN_MATCH_ANY && rule->vlan != vlan)
+                        continue;
+                if (rule->match_l3) {
+                        if (ipv4 == NULL)
+                                continue;
+                        if ((src_ip & rule->src_mask) != rule->src_ip || (dst_ip & rule->dst_mask) != rule->dst_ip)
+                                continue;
+                        if (rule->proto != ONVM_CHAIN_MATCH_ANY && rule->proto != proto)
+                                continue;
+                        if (rule->dst_port != ONVM_CHAIN_MATCH_ANY && rule->dst_port != dst_port)
+                                continue;
+                }
+                return rule->chain_id;
+        }
+
+        return 0;
+}
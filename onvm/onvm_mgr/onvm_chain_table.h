@@ -0,0 +1,130 @@
+/*********************************************************************
+ *                     openNetVM
+ *              https://sdnfv.github.io
+ *
+ *   BSD LICENSE
+ *
+ *   Copyright(c)
+ *            2015-2019 George Washington University
+ *            2015-2019 University of California Riverside
+ *            2010-2019 Intel Corporation. All rights reserved.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * The name of the author may not be used to endorse or promote
+ *       products derived from this software without specific prior
+ *       written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+
+/******************************************************************************
+
+                              onvm_chain_table.h
+
+
+     Header file for the chain table: service chains selected per RX port,
+     VLAN or IPv4 classifier rule, for packets without a flow director
+     entry.
+
+
+******************************************************************************/
+
+#ifndef _ONVM_CHAIN_TABLE_H_
+#define _ONVM_CHAIN_TABLE_H_
+
+#include "onvm_common.h"
+
+/***********************************Macros************************************/
+
+#define ONVM_MAX_CHAIN_RULES (ONVM_MAX_CHAINS - 1)
+/* Rule field value that matches anything */
+#define ONVM_CHAIN_MATCH_ANY 0xFFFF
+
+/********************************Data structures******************************/
+
+/*
+ * A classifier rule. Rules are checked in configuration order and the
+ * first match selects the chain. Addresses are in host byte order, a
+ * zero mask matches any address. VLAN 0 matches untagged packets.
+ */
+struct onvm_chain_rule {
+        uint16_t port;
+        uint16_t vlan;
+        uint16_t proto;
+        uint16_t dst_port;
+        uint32_t src_ip;
+        uint32_t src_mask;
+        uint32_t dst_ip;
+        uint32_t dst_mask;
+        uint8_t match_l3;
+        uint8_t chain_id;
+};
+
+/**********************************Functions**********************************/
+
+/*
+ * Reserve the chain table shared with NFs. Chain id 0 always refers to
+ * the default chain.
+ *
+ * Output : 0 on success, a negative value otherwise
+ *
+ */
+int
+onvm_chain_table_init(void);
+
+/*
+ * Load rules and chains from the "chains" section of a JSON config file.
+ *
+ * Input  : the config file name
+ * Output : the number of chains loaded, or a negative value on error
+ *
+ */
+int
+onvm_chain_table_load(const char *filename);
+
+/*
+ * Classify a burst of packets against the rules.
+ *
+ * Input  : an array of packets
+ *          the size of the array
+ *          an array to hold the chain id of each packet, 0 if no rule matched
+ *
+ */
+void
+onvm_chain_table_classify_burst(struct rte_mbuf *pkts[], uint16_t count, uint8_t chain_ids[]);
+
+/*
+ * Install the rules that apply to a port as rte_flow rules that MARK
+ * packets with their chain id and leave them to RSS. Rules are offloaded in
+ * order at one priority. The first one the port cannot express, or that
+ * overlaps an earlier rule of another chain, stops the offload, so the
+ * rules after it stay in software and first match semantics are kept.
+ *
+ * Input  : the port id
+ * Output : the number of rules offloaded, 0 when the port has no rte_flow support
+ *
+ */
+int
+onvm_chain_table_offload(uint16_t port_id);
+
+#endif  // _ONVM_CHAIN_TABLE_H_
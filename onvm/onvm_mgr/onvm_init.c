@@ -58,6 +58,7 @@ struct onvm_configuration *onvm_config = NULL;
 struct nf_wakeup_info *nf_wakeup_infos = NULL;
 
 struct rte_mempool *pktmbuf_pool;
+struct rte_mempool *mirror_pool;
 struct rte_mempool *nf_init_cfg_pool;
 struct rte_mempool *nf_msg_pool;
 struct rte_ring *incoming_msg_queue;
@@ -195,7 +196,7 @@ init(int argc, char *argv[]) {
         nf_per_service_count = mz_nf_per_service->addr;
 
         /* set up custom flags */
-        mz_onvm_config = rte_memzone_reserve(MZ_ONVM_CONFIG, sizeof(uint16_t), rte_socket_id(), NO_FLAGS);
+        mz_onvm_config = rte_memzone_reserve(MZ_ONVM_CONFIG, sizeof(struct onvm_configuration), rte_socket_id(), NO_FLAGS);
         if (mz_onvm_config == NULL) {
                 rte_exit(EXIT_FAILURE, "Cannot reserve memory zone for ONVM custom flags.\n");
         }
@@ -262,8 +263,38 @@ init(int argc, char *argv[]) {
         *default_sc_p = default_chain;
         onvm_sc_print(default_chain);
 
+        /* set up the chain table shared to NFs, chains other than the default one come from the config file */
+        if (onvm_chain_table_init() < 0)
+                rte_exit(EXIT_FAILURE, "Cannot reserve memory zone for chain table\n");
+        if (global_chain_config_file != NULL) {
+                retval = onvm_chain_table_load(global_chain_config_file);
+                if (retval < 0)
+                        rte_exit(EXIT_FAILURE, "Cannot load chains from %s\n", global_chain_config_file);
+                printf("Loaded %d chains from %s\n", retval, global_chain_config_file);
+        }
+        if (global_chain_offload) {
+                for (i = 0; i < ports->num_ports; i++) {
+                        retval = onvm_chain_table_offload(ports->id[i]);
+                        printf("Port %u: %d chain rules offloaded\n", (unsigned)ports->id[i], retval);
+                }
+        }
+
         onvm_flow_dir_init();
 
+        /* neighbor cache the ARP and L3 NFs share */
+        onvm_arp_init();
+
+        /* warm restart: reload the flows the previous manager instance saved */
+        if (global_ft_snapshot_file != NULL) {
+                retval = onvm_flow_dir_restore(global_ft_snapshot_file);
+                if (retval >= 0)
+                        printf("Restored %d flows from %s\n", retval, global_ft_snapshot_file);
+                else if (retval == -ENOENT)
+                        printf("No flow snapshot at %s, starting with an empty flow table\n", global_ft_snapshot_file);
+                else
+                        printf("Failed to restore flows from %s: %s\n", global_ft_snapshot_file, strerror(-retval));
+        }
+
         return 0;
 }
 
@@ -275,6 +306,7 @@ init(int argc, char *argv[]) {
 static void
 set_default_config(struct onvm_configuration *config) {
         config->flags.ONVM_NF_SHARE_CORES = ONVM_NF_SHARE_CORES_DEFAULT;
+        config->flags.ONVM_OVERFLOW_POLICY = ONVM_OVERFLOW_POLICY_DEFAULT;
 }
 
 /**
@@ -297,7 +329,16 @@ init_mbuf_pools(void) {
                                           sizeof(struct rte_pktmbuf_pool_private), rte_pktmbuf_pool_init, NULL,
                                           rte_pktmbuf_init, NULL, rte_socket_id(), NO_FLAGS);
 
-        return (pktmbuf_pool == NULL); /* 0  on success */
+        if (pktmbuf_pool == NULL)
+                return -1;
+
+        /* Mirror copies are indirect mbufs that only point at the data of a packet from the pool above */
+        printf("Creating mbuf pool '%s' [%u mbufs] ...\n", MIRROR_POOL_NAME, NUM_MBUFS);
+        mirror_pool = rte_mempool_create(MIRROR_POOL_NAME, NUM_MBUFS, sizeof(struct rte_mbuf), MBUF_CACHE_SIZE,
+                                         sizeof(struct rte_pktmbuf_pool_private), rte_pktmbuf_pool_init, NULL,
+                                         rte_pktmbuf_init, NULL, rte_socket_id(), NO_FLAGS);
+
+        return (mirror_pool == NULL); /* 0  on success */
 }
 
 /**
@@ -360,6 +401,19 @@ init_port(uint8_t port_num) {
         /* Standard DPDK port initialisation - config port, then set up
          * rx and tx rings */
         rte_eth_dev_info_get(port_num, &dev_info);
+        printf("Port %u driver %s ... \n", (unsigned)port_num, dev_info.driver_name);
+
+        /*
+         * Every manager RX and TX thread uses its own queue. A net_af_xdp
+         * port has one queue per socket it opened, see the -x option.
+         */
+        if (rx_rings > dev_info.max_rx_queues || tx_rings > dev_info.max_tx_queues) {
+                printf("Port %u has %u RX and %u TX queues, the manager needs %u and %u\n", (unsigned)port_num,
+                       (unsigned)dev_info.max_rx_queues, (unsigned)dev_info.max_tx_queues, (unsigned)rx_rings,
+                       (unsigned)tx_rings);
+                return -EINVAL;
+        }
+
         if (dev_info.tx_offload_capa & DEV_TX_OFFLOAD_MBUF_FAST_FREE)
                 local_port_conf.txmode.offloads |= DEV_TX_OFFLOAD_MBUF_FAST_FREE;
         local_port_conf.rx_adv_conf.rss_conf.rss_hf &= dev_info.flow_type_rss_offloads;
@@ -369,6 +423,21 @@ init_port(uint8_t port_num) {
                     "requested:%#" PRIx64 " configured:%#" PRIx64 "\n",
                     port_num, port_conf.rx_adv_conf.rss_conf.rss_hf, local_port_conf.rx_adv_conf.rss_conf.rss_hf);
         }
+        if (local_port_conf.rx_adv_conf.rss_conf.rss_hf == 0)
+                local_port_conf.rxmode.mq_mode = ETH_MQ_RX_NONE;
+
+        /*
+         * Software ports such as net_af_xdp offload no checksums, ethdev
+         * rejects a configuration that asks for them. NFs fill checksums in
+         * software for ports without the offload, see onvm_pkt_set_checksums.
+         */
+        local_port_conf.rxmode.offloads &= dev_info.rx_offload_capa;
+        local_port_conf.txmode.offloads &= dev_info.tx_offload_capa;
+        if (local_port_conf.rxmode.offloads != port_conf.rxmode.offloads ||
+            (local_port_conf.txmode.offloads & ~DEV_TX_OFFLOAD_MBUF_FAST_FREE) != port_conf.txmode.offloads) {
+                printf("Port %u modified offloads based on hardware support, rx:%#" PRIx64 " tx:%#" PRIx64 "\n",
+                       port_num, local_port_conf.rxmode.offloads, local_port_conf.txmode.offloads);
+        }
 
         if (ONVM_USE_JUMBO_FRAMES) {
                 local_port_conf.rxmode.max_rx_pkt_len = 9600 + RTE_ETHER_CRC_LEN + RTE_ETHER_HDR_LEN;
@@ -395,7 +464,7 @@ init_port(uint8_t port_num) {
         }
 
         txq_conf = dev_info.default_txconf;
-        txq_conf.offloads = port_conf.txmode.offloads;
+        txq_conf.offloads = local_port_conf.txmode.offloads;
         for (q = 0; q < tx_rings; q++) {
                 retval = rte_eth_tx_queue_setup(port_num, q, tx_ring_size, rte_eth_dev_socket_id(port_num), &txq_conf);
                 if (retval < 0)
@@ -65,11 +65,13 @@
 
 /*****************************Internal library********************************/
 
+#include "onvm_arp.h"
 #include "onvm_common.h"
 #include "onvm_flow_dir.h"
 #include "onvm_flow_table.h"
 #include "onvm_includes.h"
 #include "onvm_mgr/onvm_args.h"
+#include "onvm_mgr/onvm_chain_table.h"
 #include "onvm_mgr/onvm_stats.h"
 #include "onvm_sc_common.h"
 #include "onvm_sc_mgr.h"
@@ -88,6 +90,7 @@
 #define RTE_MP_RX_DESC_DEFAULT 512
 #define RTE_MP_TX_DESC_DEFAULT 512
 #define NF_MSG_QUEUE_SIZE 128
+#define MGR_MSG_BURST_SIZE 32  // NF -> manager messages handled per event loop pass
 
 #define NO_FLAGS 0
 
@@ -96,6 +99,10 @@
 #define ONVM_NUM_MGR_AUX_THREADS 1
 #define ONVM_NUM_WAKEUP_THREADS 1  // Enabled when using shared core mode
 
+/* Smallest burst the RX and TX threads ask for and the step of every burst size, see -b.
+ * Vector RX paths round bursts down to 4 packets, smaller ones get nothing. */
+#define ONVM_BURST_MIN 4
+
 /*************************External global variables***************************/
 
 /* NF to Manager data flow */
@@ -106,6 +113,7 @@ extern struct port_info *ports;
 extern struct core_status *cores;
 
 extern struct rte_mempool *pktmbuf_pool;
+extern struct rte_mempool *mirror_pool;
 extern struct rte_mempool *nf_msg_pool;
 extern uint16_t num_nfs;
 extern uint16_t num_services;
@@ -120,6 +128,12 @@ extern uint16_t global_stats_sleep_time;
 extern uint32_t global_time_to_live;
 extern uint32_t global_pkt_limit;
 extern uint8_t global_verbosity_level;
+extern const char *global_ft_snapshot_file;
+extern uint32_t global_ft_snapshot_interval;
+extern const char *global_chain_config_file;
+extern uint8_t global_chain_offload;
+extern uint16_t global_burst_min;
+extern uint16_t global_burst_max;
 
 /* Custom flags for onvm */
 extern struct onvm_configuration *onvm_config;
@@ -63,6 +63,7 @@
 #include <rte_fbk_hash.h>
 #include <rte_malloc.h>
 #include <rte_memcpy.h>
+#include <rte_prefetch.h>
 
 /******************************Internal headers*******************************/
 
@@ -98,6 +98,27 @@ onvm_nf_stop(struct onvm_nf *nf);
 inline int
 onvm_nf_relocate_nf(uint16_t nf, uint16_t new_core);
 
+/*
+ * Function that checks an NF's request to change core and sends it the
+ * MSG_CHANGE_CORE message if the core can take it
+ *
+ * Input  : the address of a migrate_request struct
+ * Output : 0 if the NF was told to move, -1 otherwise
+ *
+ */
+static int
+onvm_nf_migrate(struct migrate_request *req);
+
+/*
+ * Function that undoes the core accounting of a move the NF could not
+ * make, the NF stays on the core its thread_info still names
+ *
+ * Input  : the address of a migrate_request struct naming the failed core
+ *
+ */
+static void
+onvm_nf_migrate_failed(struct migrate_request *req);
+
 /*
  * Function that initializes an LPM object
  *
@@ -174,23 +195,22 @@ onvm_nf_next_instance_id(void) {
         return MAX_NFS;
 }
 
-void
+int
 onvm_nf_check_status(void) {
         int i;
-        void *msgs[MAX_NFS];
+        void *msgs[MGR_MSG_BURST_SIZE];
         struct onvm_nf *nf;
         struct onvm_nf_msg *msg;
         struct onvm_nf_init_cfg *nf_init_cfg;
         struct lpm_request *req_lpm;
         struct ft_request *ft;
+        struct migrate_request *req_migrate;
         uint16_t stop_nf_id;
-        int num_msgs = rte_ring_count(incoming_msg_queue);
+        int num_msgs;
 
+        num_msgs = rte_ring_dequeue_burst(incoming_msg_queue, msgs, MGR_MSG_BURST_SIZE, NULL);
         if (num_msgs == 0)
-                return;
-
-        if (rte_ring_dequeue_bulk(incoming_msg_queue, msgs, num_msgs, NULL) == 0)
-                return;
+                return 0;
 
         for (i = 0; i < num_msgs; i++) {
                 msg = (struct onvm_nf_msg *)msgs[i];
@@ -205,6 +225,18 @@ onvm_nf_check_status(void) {
                                 ft = (struct ft_request *)msg->msg_data;
                                 onvm_nf_init_ft(ft);
                                 break;
+                        case MSG_REQUEST_MIGRATE:
+                                req_migrate = (struct migrate_request *)msg->msg_data;
+                                if (onvm_nf_migrate(req_migrate) != 0)
+                                        RTE_LOG(INFO, APP, "NF %u can't be moved to core %u\n",
+                                                req_migrate->instance_id, req_migrate->core);
+                                rte_free(req_migrate);
+                                break;
+                        case MSG_MIGRATE_FAILED:
+                                req_migrate = (struct migrate_request *)msg->msg_data;
+                                onvm_nf_migrate_failed(req_migrate);
+                                rte_free(req_migrate);
+                                break;
                         case MSG_NF_STARTING:
                                 nf_init_cfg = (struct onvm_nf_init_cfg *)msg->msg_data;
                                 if (onvm_nf_start(nf_init_cfg) == 0) {
@@ -232,23 +264,19 @@ onvm_nf_check_status(void) {
 
                 rte_mempool_put(nf_msg_pool, (void *)msg);
         }
+
+        return num_msgs;
 }
 
 int
 onvm_nf_send_msg(uint16_t dest, uint8_t msg_type, void *msg_data) {
         int ret;
-        struct onvm_nf_msg *msg;
-
-        ret = rte_mempool_get(nf_msg_pool, (void **)(&msg));
-        if (ret != 0) {
-                RTE_LOG(INFO, APP, "Oh the huge manatee! Unable to allocate msg from pool :(\n");
-                return ret;
-        }
 
-        msg->msg_type = msg_type;
-        msg->msg_data = msg_data;
+        ret = onvm_nf_ctrl_enqueue(&nfs[dest].ctrl_q, msg_type, msg_data);
+        if (ret != 0)
+                RTE_LOG(INFO, APP, "Oh the huge manatee! Control ring of NF %u is full :(\n", dest);
 
-        return rte_ring_enqueue(nfs[dest].msg_q, (void *)msg);
+        return ret;
 }
 
 /******************************Internal functions*****************************/
@@ -335,6 +363,7 @@ onvm_nf_stop(struct onvm_nf *nf) {
         uint16_t nf_status;
         uint16_t service_id;
         uint16_t nb_pkts, i;
+        int prio;
         struct onvm_nf_msg *msg;
         struct rte_mempool *nf_info_mp;
         struct rte_mbuf *pkts[PACKET_READ_SIZE];
@@ -371,9 +400,12 @@ onvm_nf_stop(struct onvm_nf *nf) {
         cores[nf->thread_info.core].is_dedicated_core = 0;
 
         /* Clean up possible left over objects in rings */
-        while ((nb_pkts = rte_ring_dequeue_burst(nfs[nf_id].rx_q, (void **)pkts, PACKET_READ_SIZE, NULL)) > 0) {
-                for (i = 0; i < nb_pkts; i++)
-                        rte_pktmbuf_free(pkts[i]);
+        for (prio = 0; prio < ONVM_NUM_PRIO; prio++) {
+                while ((nb_pkts = rte_ring_dequeue_burst(nfs[nf_id].rx_prio_q[prio], (void **)pkts, PACKET_READ_SIZE,
+                                                         NULL)) > 0) {
+                        for (i = 0; i < nb_pkts; i++)
+                                rte_pktmbuf_free(pkts[i]);
+                }
         }
         while ((nb_pkts = rte_ring_dequeue_burst(nfs[nf_id].tx_q, (void **)pkts, PACKET_READ_SIZE, NULL)) > 0) {
                 for (i = 0; i < nb_pkts; i++)
@@ -383,6 +415,7 @@ onvm_nf_stop(struct onvm_nf *nf) {
         while (rte_ring_dequeue(nfs[nf_id].msg_q, (void **)(&msg)) == 0) {
                 rte_mempool_put(nf_msg_pool, (void *)msg);
         }
+        onvm_nf_ctrl_reset(&nfs[nf_id].ctrl_q);
 
         /* Free info struct */
         /* Lookup mempool for nf struct */
@@ -487,8 +520,60 @@ onvm_nf_relocate_nf(uint16_t dest, uint16_t new_core) {
         return 0;
 }
 
+static int
+onvm_nf_migrate(struct migrate_request *req) {
+        uint16_t old_core;
+
+        if (req->instance_id >= MAX_NFS || !onvm_nf_is_valid(&nfs[req->instance_id]))
+                return -1;
+
+        old_core = nfs[req->instance_id].thread_info.core;
+        if (req->core == old_core)
+                return 0;
+
+        if (req->core >= onvm_threading_get_num_cores() || !cores[req->core].enabled ||
+            cores[req->core].is_dedicated_core)
+                return -1;
+
+        /* An NF on a dedicated core takes the dedication with it */
+        if (cores[old_core].is_dedicated_core) {
+                if (cores[req->core].nf_count != 0)
+                        return -1;
+                cores[old_core].is_dedicated_core = 0;
+                cores[req->core].is_dedicated_core = 1;
+        }
+
+        return onvm_nf_relocate_nf(req->instance_id, req->core);
+}
+
+static void
+onvm_nf_migrate_failed(struct migrate_request *req) {
+        uint16_t core;
+
+        if (req->instance_id >= MAX_NFS || req->core >= onvm_threading_get_num_cores())
+                return;
+
+        core = nfs[req->instance_id].thread_info.core;
+        RTE_LOG(INFO, APP, "NF %u could not move to core %u, it stays on core %u\n", req->instance_id, req->core,
+                core);
+        if (core == req->core || cores[req->core].nf_count == 0)
+                return;
+
+        cores[req->core].nf_count--;
+        cores[core].nf_count++;
+        /* Only a dedication the move took along leaves the failed core empty */
+        if (cores[req->core].is_dedicated_core && cores[req->core].nf_count == 0) {
+                cores[req->core].is_dedicated_core = 0;
+                cores[core].is_dedicated_core = 1;
+        }
+}
+
 static void
 onvm_nf_clear_rings(struct onvm_nf *nf) {
+        int prio;
+
+        for (prio = 1; prio < ONVM_NUM_PRIO; prio++)
+                rte_ring_free(nf->rx_prio_q[prio]);
         rte_ring_free(nf->rx_q);
         rte_ring_free(nf->tx_q);
         rte_ring_free(nf->msg_q);
@@ -503,6 +588,8 @@ onvm_nf_init_rings(struct onvm_nf *nf) {
         const char *msg_q_name;
         const unsigned ringsize = NF_QUEUE_RINGSIZE;
         const unsigned msgringsize = NF_MSG_QUEUE_SIZE;
+        const unsigned prioringsize = NF_PRIO_QUEUE_RINGSIZE;
+        unsigned prio;
 
         instance_id = nf->instance_id;
         socket_id = rte_socket_id();
@@ -513,6 +600,15 @@ onvm_nf_init_rings(struct onvm_nf *nf) {
         nf->rx_q = rte_ring_create(rq_name, ringsize, socket_id, RING_F_SC_DEQ); /* multi prod, single cons */
         if (nf->rx_q == NULL)
                 rte_exit(EXIT_FAILURE, "Cannot create rx ring queue for NF %u\n", instance_id);
+        nf->rx_prio_q[0] = nf->rx_q;
+
+        for (prio = 1; prio < ONVM_NUM_PRIO; prio++) {
+                nf->rx_prio_q[prio] = rte_ring_create(get_rx_prio_queue_name(instance_id, prio), prioringsize,
+                                                      socket_id, RING_F_SC_DEQ); /* multi prod, single cons */
+                if (nf->rx_prio_q[prio] == NULL)
+                        rte_exit(EXIT_FAILURE, "Cannot create rx priority %u ring queue for NF %u\n", prio,
+                                 instance_id);
+        }
 
         nf->tx_q = rte_ring_create(tq_name, ringsize, socket_id, RING_F_SC_DEQ); /* multi prod, single cons */
         if (nf->tx_q == NULL)
@@ -521,4 +617,7 @@ onvm_nf_init_rings(struct onvm_nf *nf) {
         nf->msg_q = rte_ring_create(msg_q_name, msgringsize, socket_id, RING_F_SC_DEQ); /* multi prod, single cons */
         if (nf->msg_q == NULL)
                 rte_exit(EXIT_FAILURE, "Cannot create msg queue for NF %u\n", instance_id);
+
+        /* The manager is the only producer and the NF the only consumer */
+        onvm_nf_ctrl_reset(&nf->ctrl_q);
 }
@@ -64,10 +64,12 @@ uint16_t
 onvm_nf_next_instance_id(void);
 
 /*
- * Interface looking through all registered NFs if one needs to start or stop.
+ * Interface handling one batch of messages NFs sent to the manager, so
+ * NFs get started, readied or stopped.
  *
+ * Output : the number of messages handled, 0 if the queue was empty
  */
-void
+int
 onvm_nf_check_status(void);
 
 /*
@@ -77,7 +79,8 @@ onvm_nf_check_status(void);
  *          (see onvm_nflib/onvm_msg_common.h), and a pointer to a data argument.
  *          The data argument should be allocated in the hugepage region (so it can
  *          be shared), i.e. using rte_malloc
- * Output : 0 if the message was successfully sent, -1 otherwise
+ *          The message is copied inline onto the NF's control ring.
+ * Output : 0 if the message was successfully sent, a negative value if the ring is full
  */
 int
 onvm_nf_send_msg(uint16_t dest, uint8_t msg_type, void *msg_data);
@@ -55,34 +55,72 @@
 
 void
 onvm_pkt_process_rx_batch(struct queue_mgr *rx_mgr, struct rte_mbuf *pkts[], uint16_t rx_count) {
-        uint16_t i;
+        uint16_t i, miss_count = 0;
         struct onvm_pkt_meta *meta;
+        struct rte_mbuf *miss_pkts[PACKET_READ_SIZE];
+        uint8_t chain_ids[PACKET_READ_SIZE];
 #ifdef FLOW_LOOKUP
         struct onvm_flow_entry *flow_entry;
-        struct onvm_service_chain *sc;
-        int ret;
+        int ret, flow_dir_empty;
 #endif
+        int fdir_marked;
 
         if (rx_mgr == NULL || pkts == NULL)
                 return;
 
+#ifdef FLOW_LOOKUP
+        /* Per flow entries win over chain rules, so a NIC mark can only skip the lookup while there are none */
+        flow_dir_empty = onvm_ft_is_empty(sdn_ft) && onvm_ft_is_empty(sdn_ft6);
+#endif
+
         for (i = 0; i < rx_count; i++) {
+                if (i + ONVM_PREFETCH_OFFSET < rx_count)
+                        rte_prefetch0(rte_pktmbuf_mtod(pkts[i + ONVM_PREFETCH_OFFSET], void *));
                 meta = (struct onvm_pkt_meta *)&(((struct rte_mbuf *)pkts[i])->udata64);
                 meta->src = 0;
                 meta->chain_index = 0;
+                meta->chain_id = 0;
+                /* ARP answers must not queue behind bulk data, everything else starts as bulk */
+                onvm_set_pkt_prio(meta, onvm_pkt_is_arp(pkts[i]) ? ONVM_NUM_PRIO - 1 : 0);
+                /* Only rules installed with -o mark packets, other FDIR ids are not chain ids */
+                fdir_marked = global_chain_offload && (pkts[i]->ol_flags & PKT_RX_FDIR_ID);
 #ifdef FLOW_LOOKUP
-                ret = onvm_flow_dir_get_pkt(pkts[i], &flow_entry);
-                if (ret >= 0) {
-                        sc = flow_entry->sc;
-                        meta->action = onvm_sc_next_action(sc, pkts[i]);
-                        meta->destination = onvm_sc_next_destination(sc, pkts[i]);
-                } else {
-#endif
-                        meta->action = onvm_sc_next_action(default_chain, pkts[i]);
-                        meta->destination = onvm_sc_next_destination(default_chain, pkts[i]);
-#ifdef FLOW_LOOKUP
+                if (!flow_dir_empty || !fdir_marked) {
+                        ret = onvm_flow_dir_get_pkt(pkts[i], &flow_entry);
+                        if (ret >= 0) {
+                                if (flow_entry->prio != 0)
+                                        onvm_set_pkt_prio(meta, flow_entry->prio);
+                                onvm_pkt_next_hop(rx_mgr, pkts[i], flow_entry->sc, NULL);
+                                continue;
+                        }
                 }
 #endif
+                /* The NIC already matched a chain rule offloaded by onvm_chain_table_offload */
+                if (fdir_marked) {
+                        meta->chain_id = (uint8_t)pkts[i]->hash.fdir.hi;
+                        onvm_pkt_next_hop(rx_mgr, pkts[i], onvm_sc_get_chain(meta->chain_id), NULL);
+                        continue;
+                }
+                miss_pkts[miss_count++] = pkts[i];
+        }
+
+        /* Everything without a flow entry or NIC mark is classified against the chain table as one burst */
+        onvm_chain_table_classify_burst(miss_pkts, miss_count, chain_ids);
+        for (i = 0; i < miss_count; i++) {
+                meta = onvm_get_pkt_meta(miss_pkts[i]);
+                meta->chain_id = chain_ids[i];
+                onvm_pkt_next_hop(rx_mgr, miss_pkts[i], onvm_sc_get_chain(chain_ids[i]), NULL);
+        }
+
+        for (i = 0; i < rx_count; i++) {
+                meta = onvm_get_pkt_meta(pkts[i]);
+                /* A flow entry may start with drop or out and the RX thread owns no port TX queue, those end here */
+                if (unlikely(meta->action != ONVM_NF_ACTION_TONF)) {
+                        ports->rx_stats.rx_hop_drop[pkts[i]->port]++;
+                        rte_pktmbuf_free(pkts[i]);
+                        continue;
+                }
+
                 /* PERF: this might hurt performance since it will cause cache
                  * invalidations. Ideally the data modified by the NF manager
                  * would be a different line than that modified/read by NFs.
@@ -92,8 +130,6 @@ onvm_pkt_process_rx_batch(struct queue_mgr *rx_mgr, struct rte_mbuf *pkts[], uin
                 (meta->chain_index)++;
                 onvm_pkt_enqueue_nf(rx_mgr, meta->destination, pkts[i], NULL);
         }
-
-        onvm_pkt_flush_all_nfs(rx_mgr, NULL);
 }
 
 void
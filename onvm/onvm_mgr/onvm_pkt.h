@@ -51,6 +51,55 @@
 #ifndef _ONVM_PKT_H_
 #define _ONVM_PKT_H_
 
+#define ONVM_BURST_EWMA_SHIFT 3     // weight of the newest sample in the average is 1/8
+#define ONVM_BURST_FRAC_BITS 4      // fixed point fraction bits of the average
+#define ONVM_PREFETCH_OFFSET 4      // packets to prefetch ahead while processing a burst
+
+/*
+ * Burst size of one RX queue or NF TX ring, following an EWMA of how many
+ * packets recent calls returned. The size is kept at twice the average and
+ * doubles whenever a call comes back full, within [min, max]. Sizes are
+ * rounded up to a multiple of ONVM_BURST_MIN, as vector RX paths need.
+ */
+struct onvm_burst {
+        uint32_t avg; /* packets per call, ONVM_BURST_FRAC_BITS fixed point */
+        uint16_t size;
+        uint16_t min;
+        uint16_t max;
+};
+
+static inline void
+onvm_burst_init(struct onvm_burst *burst, uint16_t min, uint16_t max) {
+        burst->avg = (uint32_t)min << ONVM_BURST_FRAC_BITS;
+        burst->size = min;
+        burst->min = min;
+        burst->max = max;
+}
+
+static inline void
+onvm_burst_update(struct onvm_burst *burst, uint16_t count) {
+        uint32_t size;
+
+        burst->avg += (int32_t)(((uint32_t)count << ONVM_BURST_FRAC_BITS) - burst->avg) >> ONVM_BURST_EWMA_SHIFT;
+        if (count == burst->size)
+                size = (uint32_t)burst->size << 1;
+        else
+                size = RTE_ALIGN_CEIL((burst->avg >> (ONVM_BURST_FRAC_BITS - 1)) + 1, ONVM_BURST_MIN);
+        burst->size = RTE_MAX(RTE_MIN(size, (uint32_t)burst->max), (uint32_t)burst->min);
+}
+
+/*
+ * Prefetch the headers of the first packets of a burst, processing loops
+ * then stay ONVM_PREFETCH_OFFSET packets ahead.
+ */
+static inline void
+onvm_pkt_prefetch_burst(struct rte_mbuf *pkts[], uint16_t count) {
+        uint16_t i;
+
+        for (i = 0; i < count && i < ONVM_PREFETCH_OFFSET; i++)
+                rte_prefetch0(rte_pktmbuf_mtod(pkts[i], void *));
+}
+
 /*********************************Interfaces**********************************/
 
 /*
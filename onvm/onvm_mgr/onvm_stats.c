@@ -228,6 +228,7 @@ onvm_stats_clear_all_nfs(void) {
 void
 onvm_stats_clear_nf(uint16_t id) {
         nfs[id].stats.rx = nfs[id].stats.rx_drop = 0;
+        nfs[id].stats.rx_drop_partial = nfs[id].stats.rx_drop_full = 0;
         nfs[id].stats.tx = nfs[id].stats.tx_drop = 0;
         nfs[id].stats.act_drop = nfs[id].stats.act_tonf = 0;
         nfs[id].stats.act_next = nfs[id].stats.act_out = 0;
@@ -354,7 +355,9 @@ onvm_stats_display_ports(unsigned difftime, uint8_t verbosity_level) {
 
                 } else {
                         fprintf(stats_out, ONVM_STATS_REG_PORTS,
-                                (unsigned)ports->id[i], nic_rx_pkts, nic_rx_pps, nic_tx_pkts, nic_tx_pps);
+                                (unsigned)ports->id[i], nic_rx_pkts, nic_rx_pps, nic_tx_pkts, nic_tx_pps,
+                                (unsigned)ports->rx_stats.burst[ports->id[i]],
+                                ports->rx_stats.rx_hop_drop[ports->id[i]]);
                 }
 
                 /* Only print this information out if we haven't already printed it to the console above */
@@ -366,6 +369,14 @@ onvm_stats_display_ports(unsigned difftime, uint8_t verbosity_level) {
                         cJSON_AddStringToObject(onvm_json_port_stats[i], "Label", port_label);
                         cJSON_AddNumberToObject(onvm_json_port_stats[i], "RX", nic_rx_pps);
                         cJSON_AddNumberToObject(onvm_json_port_stats[i], "TX", nic_tx_pps);
+                        cJSON_AddNumberToObject(onvm_json_port_stats[i], "RX_Burst",
+                                                ports->rx_stats.burst[ports->id[i]]);
+                        cJSON_AddNumberToObject(onvm_json_port_stats[i], "RX_Hop_Drop",
+                                                ports->rx_stats.rx_hop_drop[ports->id[i]]);
+                        cJSON_AddNumberToObject(onvm_json_port_stats[i], "TX_Drop_Partial",
+                                                ports->tx_stats.tx_drop_partial[ports->id[i]]);
+                        cJSON_AddNumberToObject(onvm_json_port_stats[i], "TX_Drop_Full",
+                                                ports->tx_stats.tx_drop_full[ports->id[i]]);
 
                         free(port_label);
                         port_label = NULL;
@@ -524,6 +535,9 @@ onvm_stats_display_nfs(unsigned difftime, uint8_t verbosity_level) {
                                 rx_pps, tx_pps, rx, tx, act_out, act_tonf, act_drop,
                                 nfs[i].thread_info.parent, state, rte_atomic16_read(&nfs[i].thread_info.children_cnt),
                                 rx_drop_rate, tx_drop_rate, rx_drop, tx_drop, act_next, act_buffer, act_returned);
+                        fprintf(stats_out, ONVM_STATS_BURST_CONTENT, (uint64_t)nfs[i].stats.tx_burst,
+                                (uint64_t)nfs[i].stats.migrations, (uint64_t)nfs[i].stats.migrate_stall_us,
+                                (uint64_t)nfs[i].stats.migrate_stall_max_us);
                         if (ONVM_NF_SHARE_CORES)
                                 fprintf(stats_out, ONVM_STATS_SHARED_CORE_CONTENT, num_wakeups, wakeup_rate);
                         fprintf(stats_out, "\n");
@@ -544,6 +558,12 @@ onvm_stats_display_nfs(unsigned difftime, uint8_t verbosity_level) {
                         cJSON_AddNumberToObject(onvm_json_nf_stats[i], "TX", tx_pps);
                         cJSON_AddNumberToObject(onvm_json_nf_stats[i], "TX_Drop_Rate", tx_drop_rate);
                         cJSON_AddNumberToObject(onvm_json_nf_stats[i], "RX_Drop_Rate", rx_drop_rate);
+                        cJSON_AddNumberToObject(onvm_json_nf_stats[i], "RX_Drop_Partial", nfs[i].stats.rx_drop_partial);
+                        cJSON_AddNumberToObject(onvm_json_nf_stats[i], "RX_Drop_Full", nfs[i].stats.rx_drop_full);
+                        cJSON_AddNumberToObject(onvm_json_nf_stats[i], "TX_Burst", nfs[i].stats.tx_burst);
+                        cJSON_AddNumberToObject(onvm_json_nf_stats[i], "Migrations", nfs[i].stats.migrations);
+                        cJSON_AddNumberToObject(onvm_json_nf_stats[i], "Migrate_Stall_Max_us",
+                                                nfs[i].stats.migrate_stall_max_us);
                         cJSON_AddNumberToObject(onvm_json_nf_stats[i], "service_id", (int16_t)nfs[i].service_id);
                         cJSON_AddNumberToObject(onvm_json_nf_stats[i], "instance_id",
                                                 (int16_t)nfs[i].instance_id);
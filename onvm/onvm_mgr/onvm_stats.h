@@ -84,12 +84,16 @@ extern const char *NF_MSG[3];
         " / %-11" PRIu64 "  %11" PRIu64 " / %-11" PRIu64 " / %-11" PRIu64 "\n"
 #define ONVM_STATS_REG_PORTS \
         "Port %u - rx: %9" PRIu64 "  (%9" PRIu64 " pps)\t"\
-        "tx: %9" PRIu64 "  (%9" PRIu64 " pps)\n"
+        "tx: %9" PRIu64 "  (%9" PRIu64 " pps)\t"\
+        "rx burst: %2u\trx hop drop: %9" PRIu64 "\n"
 #define ONVM_STATS_ADV_CONTENT \
         "%-14s %2u  /  %-2u / %2u    %9" PRIu64 " / %-9" PRIu64 "   %11" PRIu64 " / %-11" PRIu64\
         "  %11" PRIu64 " / %-11" PRIu64 " / %-11" PRIu64\
         "\n            %5" PRId16 "  /  %c  /  %u    %9" PRIu64 " / %-9" PRIu64 "   %11" PRIu64 " / %-11" PRIu64\
         "  %11" PRIu64 " / %-11" PRIu64 " / %-11" PRIu64 "\n"
+#define ONVM_STATS_BURST_CONTENT \
+        "                            mgr tx burst: %2" PRIu64 \
+        "   migrations: %" PRIu64 " (stall %" PRIu64 " us, max %" PRIu64 " us)\n"
 #define ONVM_STATS_SHARED_CORE_CONTENT \
         "                               %11" PRIu64 " / %-11" PRIu64"\n"
 #define ONVM_STATS_ADV_TOTALS \
@@ -0,0 +1,310 @@
+/*********************************************************************
+ *                     openNetVM
+ *              https://sdnfv.github.io
+ *
+ *   BSD LICENSE
+ *
+ *   Copyright(c)
+ *            2015-2019 George Washington University
+ *            2015-2019 University of California Riverside
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * The name of the author may not be used to endorse or promote
+ *       products derived from this software without specific prior
+ *       written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * onvm_arp.c - ARP handling and a neighbor cache shared by all NFs
+ ********************************************************************/
+
+#include <errno.h>
+#include <string.h>
+
+#include <rte_arp.h>
+#include <rte_byteorder.h>
+#include <rte_debug.h>
+#include <rte_jhash.h>
+#include <rte_lcore.h>
+#include <rte_memzone.h>
+#include <rte_prefetch.h>
+
+#include "onvm_arp.h"
+
+#define NO_FLAGS 0
+/* Most packets onvm_arp_reply_burst handles, one bit each in its result */
+#define ONVM_ARP_BURST_MAX 64
+
+static inline uint32_t
+onvm_arp_bucket(uint32_t ip) {
+        return rte_jhash_1word(ip, 0) & (ONVM_ARP_BUCKETS - 1);
+}
+
+int
+onvm_arp_init(void) {
+        const struct rte_memzone *mz_arp;
+        struct onvm_arp_cache *cache;
+
+        /* a lookup reads its ways and the sequence count from one line */
+        RTE_BUILD_BUG_ON(sizeof(struct onvm_arp_bucket) != RTE_CACHE_LINE_SIZE);
+
+        mz_arp = rte_memzone_reserve(MZ_ARP_CACHE, sizeof(struct onvm_arp_cache), rte_socket_id(), NO_FLAGS);
+        if (mz_arp == NULL)
+                rte_exit(EXIT_FAILURE, "Cannot reserve memory zone for ARP cache\n");
+        cache = mz_arp->addr;
+        memset(cache, 0, sizeof(struct onvm_arp_cache));
+        rte_spinlock_init(&cache->lock);
+        cache->timeout = ONVM_ARP_TIMEOUT;
+        cache->tsc_hz = rte_get_tsc_hz();
+
+        return 0;
+}
+
+struct onvm_arp_cache *
+onvm_arp_nf_init(void) {
+        const struct rte_memzone *mz_arp;
+
+        mz_arp = rte_memzone_lookup(MZ_ARP_CACHE);
+        if (mz_arp == NULL)
+                rte_exit(EXIT_FAILURE, "Cannot get ARP cache\n");
+
+        return mz_arp->addr;
+}
+
+int
+onvm_arp_add_local(struct onvm_arp_cache *cache, uint32_t ip, uint16_t port) {
+        struct onvm_arp_local *l, *free_slot = NULL;
+        uint32_t slot, i;
+
+        slot = rte_jhash_2words(ip, port, 0);
+        rte_spinlock_lock(&cache->lock);
+        for (i = 0; i < ONVM_ARP_LOCAL_IPS; i++) {
+                l = &cache->local[(slot + i) & (ONVM_ARP_LOCAL_IPS - 1)];
+                if (l->used == ONVM_ARP_LOCAL_USED && l->ip == ip && l->port == port) {
+                        rte_spinlock_unlock(&cache->lock);
+                        return 0;
+                }
+                /* the first deleted slot is reused, but the address may still be further on */
+                if (l->used != ONVM_ARP_LOCAL_USED && free_slot == NULL)
+                        free_slot = l;
+                if (l->used == ONVM_ARP_LOCAL_FREE)
+                        break;
+        }
+        if (free_slot != NULL) {
+                free_slot->ip = ip;
+                free_slot->port = port;
+                /* readers take no lock, the address must be there before the slot is */
+                rte_smp_wmb();
+                free_slot->used = ONVM_ARP_LOCAL_USED;
+        }
+        rte_spinlock_unlock(&cache->lock);
+
+        return free_slot != NULL ? 0 : -ENOSPC;
+}
+
+void
+onvm_arp_clear_local(struct onvm_arp_cache *cache, uint16_t port) {
+        struct onvm_arp_local *l;
+        uint32_t i, j;
+
+        rte_spinlock_lock(&cache->lock);
+        for (i = 0; i < ONVM_ARP_LOCAL_IPS; i++) {
+                l = &cache->local[i];
+                if (l->used == ONVM_ARP_LOCAL_USED && l->port == port)
+                        l->used = ONVM_ARP_LOCAL_DELETED;
+        }
+        /* No probe crosses a free slot, so the deleted ones just before it can be freed */
+        for (i = 0; i < ONVM_ARP_LOCAL_IPS; i++) {
+                if (cache->local[i].used != ONVM_ARP_LOCAL_FREE)
+                        continue;
+                for (j = (i - 1) & (ONVM_ARP_LOCAL_IPS - 1); cache->local[j].used == ONVM_ARP_LOCAL_DELETED;
+                     j = (j - 1) & (ONVM_ARP_LOCAL_IPS - 1))
+                        cache->local[j].used = ONVM_ARP_LOCAL_FREE;
+        }
+        rte_spinlock_unlock(&cache->lock);
+}
+
+int
+onvm_arp_is_local(const struct onvm_arp_cache *cache, uint32_t ip, uint16_t port) {
+        const struct onvm_arp_local *l;
+        uint32_t slot, i;
+
+        slot = rte_jhash_2words(ip, port, 0);
+        for (i = 0; i < ONVM_ARP_LOCAL_IPS; i++) {
+                l = &cache->local[(slot + i) & (ONVM_ARP_LOCAL_IPS - 1)];
+                if (l->used == ONVM_ARP_LOCAL_FREE)
+                        return 0;
+                if (l->used == ONVM_ARP_LOCAL_USED && l->ip == ip && l->port == port)
+                        return 1;
+        }
+
+        return 0;
+}
+
+int
+onvm_arp_learn(struct onvm_arp_cache *cache, uint32_t ip, const struct rte_ether_addr *mac, uint16_t port,
+               int create) {
+        struct onvm_arp_bucket *b;
+        struct onvm_arp_entry *e = NULL;
+        uint32_t now;
+        int i, ret = 0;
+
+        /* 0.0.0.0 is the sender of address probes, and marks a free way */
+        if (ip == 0)
+                return 0;
+
+        b = &cache->buckets[onvm_arp_bucket(ip)];
+        now = onvm_arp_now(cache);
+
+        rte_spinlock_lock(&cache->lock);
+        for (i = 0; i < ONVM_ARP_WAYS; i++) {
+                if (b->e[i].ip == ip) {
+                        e = &b->e[i];
+                        break;
+                }
+        }
+        if (e == NULL) {
+                if (!create)
+                        goto out;
+                /* A free way, or else the least recently seen one */
+                e = &b->e[0];
+                for (i = 0; i < ONVM_ARP_WAYS; i++) {
+                        if (b->e[i].ip == 0) {
+                                e = &b->e[i];
+                                break;
+                        }
+                        if (b->e[i].seen < e->seen)
+                                e = &b->e[i];
+                }
+                if (e->ip != 0)
+                        cache->evicted++;
+                cache->learned++;
+                ret = 1;
+        } else if (e->port != port || !rte_is_same_ether_addr(&e->mac, mac)) {
+                ret = 1;
+        } else if (e->seen == now) {
+                /* Nothing changed, leave the bucket to the readers */
+                goto out;
+        }
+
+        b->seq++;
+        rte_smp_wmb();
+        e->ip = ip;
+        e->seen = now;
+        rte_ether_addr_copy(mac, &e->mac);
+        e->port = port;
+        rte_smp_wmb();
+        b->seq++;
+out:
+        rte_spinlock_unlock(&cache->lock);
+
+        return ret;
+}
+
+int
+onvm_arp_lookup(const struct onvm_arp_cache *cache, uint32_t ip, struct rte_ether_addr *mac, uint16_t *port) {
+        const struct onvm_arp_bucket *b;
+        struct onvm_arp_entry e;
+        uint32_t seq;
+        int i, found;
+
+        if (ip == 0)
+                return -ENOENT;
+
+        memset(&e, 0, sizeof(e));
+        b = &cache->buckets[onvm_arp_bucket(ip)];
+        do {
+                seq = b->seq;
+                rte_smp_rmb();
+                found = 0;
+                for (i = 0; i < ONVM_ARP_WAYS; i++) {
+                        if (b->e[i].ip == ip) {
+                                e = b->e[i];
+                                found = 1;
+                                break;
+                        }
+                }
+                rte_smp_rmb();
+        } while ((seq & 1) || seq != b->seq);
+
+        if (!found || onvm_arp_now(cache) - e.seen > cache->timeout)
+                return -ENOENT;
+
+        rte_ether_addr_copy(&e.mac, mac);
+        *port = e.port;
+
+        return 0;
+}
+
+uint64_t
+onvm_arp_reply_burst(struct onvm_arp_cache *cache, struct rte_mbuf **pkts, uint16_t nb_pkts,
+                     const struct rte_ether_addr *port_macs) {
+        struct rte_ether_hdr *eth_hdr;
+        struct rte_arp_hdr *arp_hdr;
+        struct onvm_pkt_meta *meta;
+        uint64_t replied = 0;
+        uint32_t tip;
+        uint16_t i, port;
+        int local;
+
+        if (nb_pkts > ONVM_ARP_BURST_MAX)
+                nb_pkts = ONVM_ARP_BURST_MAX;
+
+        for (i = 0; i < nb_pkts; i++)
+                rte_prefetch0(rte_pktmbuf_mtod(pkts[i], void *));
+
+        for (i = 0; i < nb_pkts; i++) {
+                eth_hdr = rte_pktmbuf_mtod(pkts[i], struct rte_ether_hdr *);
+                if (eth_hdr->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_ARP) ||
+                    rte_pktmbuf_data_len(pkts[i]) < sizeof(struct rte_ether_hdr) + sizeof(struct rte_arp_hdr))
+                        continue;
+                arp_hdr = rte_pktmbuf_mtod_offset(pkts[i], struct rte_arp_hdr *, sizeof(struct rte_ether_hdr));
+                if (arp_hdr->arp_hardware != rte_cpu_to_be_16(RTE_ARP_HRD_ETHER) ||
+                    arp_hdr->arp_protocol != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4))
+                        continue;
+
+                port = pkts[i]->port;
+                tip = rte_be_to_cpu_32(arp_hdr->arp_data.arp_tip);
+                local = onvm_arp_is_local(cache, tip, port);
+                /* ARP for a local address adds its sender, any other ARP only refreshes a known one */
+                onvm_arp_learn(cache, rte_be_to_cpu_32(arp_hdr->arp_data.arp_sip), &arp_hdr->arp_data.arp_sha, port,
+                               local);
+                if (!local || arp_hdr->arp_opcode != rte_cpu_to_be_16(RTE_ARP_OP_REQUEST))
+                        continue;
+
+                /* The request's own mbuf becomes the reply, see RFC 826 */
+                arp_hdr->arp_opcode = rte_cpu_to_be_16(RTE_ARP_OP_REPLY);
+                rte_ether_addr_copy(&arp_hdr->arp_data.arp_sha, &arp_hdr->arp_data.arp_tha);
+                arp_hdr->arp_data.arp_tip = arp_hdr->arp_data.arp_sip;
+                rte_ether_addr_copy(&port_macs[port], &arp_hdr->arp_data.arp_sha);
+                arp_hdr->arp_data.arp_sip = rte_cpu_to_be_32(tip);
+                rte_ether_addr_copy(&eth_hdr->s_addr, &eth_hdr->d_addr);
+                rte_ether_addr_copy(&port_macs[port], &eth_hdr->s_addr);
+
+                meta = onvm_get_pkt_meta(pkts[i]);
+                meta->destination = port;
+                meta->action = ONVM_NF_ACTION_OUT;
+                replied |= 1ULL << i;
+        }
+
+        return replied;
+}
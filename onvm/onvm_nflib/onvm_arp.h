@@ -0,0 +1,165 @@
+/*********************************************************************
+ *                     openNetVM
+ *              https://sdnfv.github.io
+ *
+ *   BSD LICENSE
+ *
+ *   Copyright(c)
+ *            2015-2019 George Washington University
+ *            2015-2019 University of California Riverside
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * The name of the author may not be used to endorse or promote
+ *       products derived from this software without specific prior
+ *       written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * onvm_arp.h - ARP handling and a neighbor cache shared by all NFs
+ ********************************************************************/
+
+#ifndef _ONVM_ARP_H_
+#define _ONVM_ARP_H_
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_ether.h>
+#include <rte_mbuf.h>
+#include <rte_spinlock.h>
+#include "onvm_common.h"
+
+/* Buckets of the neighbor cache, a power of two */
+#define ONVM_ARP_BUCKETS 2048
+/* Neighbors per bucket, three 16 byte entries and the sequence count fill one cache line */
+#define ONVM_ARP_WAYS 3
+/* Addresses ARP is answered for, a power of two */
+#define ONVM_ARP_LOCAL_IPS 256
+/* Seconds a neighbor is used without an ARP packet from it */
+#define ONVM_ARP_TIMEOUT 300
+
+/* A neighbor: IPv4 address in host byte order, 0 for a free way */
+struct onvm_arp_entry {
+        uint32_t ip;
+        /* second of the last ARP packet from ip, see onvm_arp_now */
+        uint32_t seen;
+        struct rte_ether_addr mac;
+        uint16_t port;
+};
+
+/*
+ * Readers retry while seq is odd or changes under them, so lookups take no
+ * lock and never stall the writer.
+ */
+struct onvm_arp_bucket {
+        struct onvm_arp_entry e[ONVM_ARP_WAYS];
+        volatile uint32_t seq;
+} __rte_cache_aligned;
+
+/* onvm_arp_local.used: a free slot ends a probe, a deleted one does not */
+#define ONVM_ARP_LOCAL_FREE 0
+#define ONVM_ARP_LOCAL_USED 1
+#define ONVM_ARP_LOCAL_DELETED 2
+
+struct onvm_arp_local {
+        uint32_t ip;
+        uint16_t port;
+        uint16_t used;
+};
+
+/*
+ * The neighbor cache, reserved by the manager in a memzone. NFs that handle
+ * ARP learn into it and L3 NFs read it to rewrite MAC addresses. Writers
+ * serialize on lock, readers go through the bucket sequence counts.
+ */
+struct onvm_arp_cache {
+        rte_spinlock_t lock;
+        uint32_t timeout;
+        uint64_t tsc_hz;
+        uint64_t learned;
+        /* neighbors dropped from a full bucket */
+        uint64_t evicted;
+        /* open addressed set of local IPs and their ports */
+        struct onvm_arp_local local[ONVM_ARP_LOCAL_IPS];
+        struct onvm_arp_bucket buckets[ONVM_ARP_BUCKETS];
+};
+
+/*
+ * Reserve the cache memzone. Called by the manager, NFs attach with
+ * onvm_arp_nf_init.
+ */
+int
+onvm_arp_init(void);
+
+/* Find the cache the manager reserved, exits if there is none */
+struct onvm_arp_cache *
+onvm_arp_nf_init(void);
+
+/* Current second on the cache's clock, for onvm_arp_entry.seen */
+static inline uint32_t
+onvm_arp_now(const struct onvm_arp_cache *cache) {
+        return (uint32_t)(rte_get_tsc_cycles() / cache->tsc_hz);
+}
+
+/*
+ * Answer ARP requests for ip on port. ip is in host byte order.
+ * Returns 0, or -ENOSPC if the local set is full.
+ */
+int
+onvm_arp_add_local(struct onvm_arp_cache *cache, uint32_t ip, uint16_t port);
+
+/* Stop answering ARP requests for every local address on port */
+void
+onvm_arp_clear_local(struct onvm_arp_cache *cache, uint16_t port);
+
+/* Returns 1 if ip is a local address on port, 0 otherwise */
+int
+onvm_arp_is_local(const struct onvm_arp_cache *cache, uint32_t ip, uint16_t port);
+
+/*
+ * Record that ip is at mac behind port. With create unset only a neighbor
+ * already in the cache is updated, as RFC 826 does for ARP packets not
+ * addressed to us. A full bucket gives up its least recently seen way.
+ * Returns 1 if the neighbor was added or changed, 0 otherwise.
+ */
+int
+onvm_arp_learn(struct onvm_arp_cache *cache, uint32_t ip, const struct rte_ether_addr *mac, uint16_t port,
+               int create);
+
+/*
+ * Look up the MAC address and port of neighbor ip, host byte order.
+ * Returns 0, or -ENOENT if ip is unknown or has timed out.
+ */
+int
+onvm_arp_lookup(const struct onvm_arp_cache *cache, uint32_t ip, struct rte_ether_addr *mac, uint16_t *port);
+
+/*
+ * Handle the ARP packets of a burst of at most 64 packets: learn their
+ * senders, and turn requests for a local address into replies in place,
+ * using port_macs indexed by port ID as the local MAC. A reply's meta is
+ * set to go out of the port the request came in on.
+ * Returns a mask with bit i set if pkts[i] was turned into a reply.
+ */
+uint64_t
+onvm_arp_reply_burst(struct onvm_arp_cache *cache, struct rte_mbuf **pkts, uint16_t nb_pkts,
+                     const struct rte_ether_addr *port_macs);
+
+#endif  // _ONVM_ARP_H_
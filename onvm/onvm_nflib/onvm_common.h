@@ -42,6 +42,7 @@
 #ifndef _ONVM_COMMON_H_
 #define _ONVM_COMMON_H_
 
+#include <errno.h>
 #include <stdint.h>
 
 /* Std C library includes for shared core */
@@ -62,22 +63,45 @@
 #define ONVM_NF_HANDLE_TX 1                   // should be true if NFs primarily pass packets to each other
 #define ONVM_NF_SHUTDOWN_CORE_REASSIGNMENT 0  // should be true if on NF shutdown onvm_mgr tries to reallocate cores
 
-#define ONVM_MAX_CHAIN_LENGTH 4  // the maximum chain length
+#ifndef ONVM_MAX_CHAIN_LENGTH
+#define ONVM_MAX_CHAIN_LENGTH 4  // the maximum chain length, override at build time (manager and NFs must agree)
+#endif
+#define ONVM_MAX_CHAINS 64       // number of chains in the chain table, id 0 is the default chain
 #define MAX_NFS 128              // total number of concurrent NFs allowed (-1 because ID 0 is reserved)
 #define MAX_SERVICES 32          // total number of unique services allowed
 #define MAX_NFS_PER_SERVICE 32   // max number of NFs per service.
 
 #define NUM_MBUFS 32767          // total number of mbufs (2^15 - 1)
 #define NF_QUEUE_RINGSIZE 16384  // size of queue for NFs
+#define NF_PRIO_QUEUE_RINGSIZE 1024  // size of each priority queue for NFs
+
+#ifndef ONVM_NUM_PRIO
+#define ONVM_NUM_PRIO 2  // RX priority classes per NF (at most 4), class 0 is bulk traffic in rx_q
+#endif
+#define ONVM_PKT_PRIO_SHIFT 0  // the priority class is kept in the low bits of onvm_pkt_meta flags, NFs use high ones
+#define ONVM_PKT_PRIO_MASK (0x3 << ONVM_PKT_PRIO_SHIFT)
 
 #define PACKET_READ_SIZE ((uint16_t)32)
 
+#ifndef ONVM_FLUSH_MAX_RETRIES
+#define ONVM_FLUSH_MAX_RETRIES 4  // flushes a packet left in a full ring's buffer survives before it is dropped
+#endif
+#if ONVM_FLUSH_MAX_RETRIES > 254
+#error "ONVM_FLUSH_MAX_RETRIES must fit packet_buf.tries"
+#endif
+
+#define ONVM_OVERFLOW_DROP_TAIL 0  // a full destination buffer drops the arriving packet
+#define ONVM_OVERFLOW_DROP_HEAD 1  // a full destination buffer drops its oldest packet
+#define ONVM_OVERFLOW_POLICY_DEFAULT ONVM_OVERFLOW_DROP_TAIL
+
 #define ONVM_NF_SHARE_CORES_DEFAULT 0  // default value for shared core logic, if true NFs sleep while waiting for packets
 
 #define ONVM_NF_ACTION_DROP 0  // drop packet
 #define ONVM_NF_ACTION_NEXT 1  // to whatever the next action is configured by the SDN controller in the flow table
 #define ONVM_NF_ACTION_TONF 2  // send to the NF specified in the argument field (assume it is on the same host)
 #define ONVM_NF_ACTION_OUT  3  // send the packet out the NIC port set in the argument field
+#define ONVM_NF_ACTION_MIRROR 4      // give a read-only copy to the NF in the argument field, then act as NEXT
+#define ONVM_NF_ACTION_MIRROR_OUT 5  // send a copy out the NIC port in the argument field, then act as NEXT
 
 #define PKT_WAKEUP_THRESHOLD 1 // for shared core mode, how many packets are required to wake up the NF
 #define MSG_WAKEUP_THRESHOLD 1 // for shared core mode, how many messages on an NF's ring are required to wake up the NF
@@ -94,7 +118,7 @@
 // flag operations that should be used on onvm_pkt_meta
 #define ONVM_CHECK_BIT(flags, n) !!((flags) & (1 << (n)))
 #define ONVM_SET_BIT(flags, n) ((flags) | (1 << (n)))
-#define ONVM_CLEAR_BIT(flags, n) ((flags) & (0 << (n)))
+#define ONVM_CLEAR_BIT(flags, n) ((flags) & ~(1 << (n)))
 
 /* Measured in millions of packets */
 #define PKT_TTL_MULTIPLIER 1000000
@@ -107,12 +131,22 @@
 /* If a lot of children spawned this might need to be increased */
 #define NF_TERM_STOP_ITER_TIMES 10
 
+/* Flush passes a moving NF makes to empty its buffers before changing core */
+#define NF_MIGRATE_DRAIN_ITERS 64
+
+/* Manager -> NF control ring, must be a power of 2 */
+#define NF_CTRL_RING_SIZE 64
+/* How long the manager and NF handshakes idle between message polls, in us */
+#define ONVM_MSG_POLL_US 100
+
 struct onvm_pkt_meta {
         uint8_t action;       /* Action to be performed */
+        uint8_t chain_id;     /* chain table entry the packet was classified to, 0 for the default chain */
         uint16_t destination; /* where to go next */
         uint16_t src;         /* who processed the packet last */
         uint8_t chain_index;  /*index of the current step in the service chain*/
-        uint8_t flags;        /* bits for custom NF data. Use with caution to prevent collisions from different NFs. */
+        uint8_t flags;        /* bits for custom NF data. Use with caution to prevent collisions from different NFs.
+                                 The low 2 bits hold the RX priority class, see onvm_set_pkt_prio. */
 };
 
 static inline struct onvm_pkt_meta *
@@ -120,6 +154,21 @@ onvm_get_pkt_meta(struct rte_mbuf *pkt) {
         return (struct onvm_pkt_meta *)&pkt->udata64;
 }
 
+/*
+ * RX priority class of a packet, higher classes are dequeued first by the NF.
+ */
+static inline uint8_t
+onvm_get_pkt_prio(struct onvm_pkt_meta *meta) {
+        uint8_t prio = (meta->flags & ONVM_PKT_PRIO_MASK) >> ONVM_PKT_PRIO_SHIFT;
+
+        return prio < ONVM_NUM_PRIO ? prio : ONVM_NUM_PRIO - 1;
+}
+
+static inline void
+onvm_set_pkt_prio(struct onvm_pkt_meta *meta, uint8_t prio) {
+        meta->flags = (meta->flags & ~ONVM_PKT_PRIO_MASK) | ((prio << ONVM_PKT_PRIO_SHIFT) & ONVM_PKT_PRIO_MASK);
+}
+
 static inline uint8_t
 onvm_get_pkt_chain_index(struct rte_mbuf *pkt) {
         struct onvm_pkt_meta* pkt_meta = (struct onvm_pkt_meta*) &pkt->udata64;
@@ -157,6 +206,9 @@ struct tx_thread_info {
 struct packet_buf {
         struct rte_mbuf *buffer[PACKET_READ_SIZE];
         uint16_t count;
+        /* buffer[0..retained) were left over by earlier flushes, tries[i] times each */
+        uint16_t retained;
+        uint8_t tries[PACKET_READ_SIZE];
 };
 
 /*
@@ -170,6 +222,7 @@ struct queue_mgr {
                 struct tx_thread_info *tx_thread_info;
                 struct packet_buf *to_tx_buf;
         };
+        /* MAX_NFS * ONVM_NUM_PRIO buffers, one per NF and RX priority class */
         struct packet_buf *nf_rx_bufs;
 };
 
@@ -190,11 +243,18 @@ struct nf_wakeup_info {
 
 struct rx_stats {
         uint64_t rx[RTE_MAX_ETHPORTS];
+        /* burst size the RX thread currently asks the port for */
+        uint16_t burst[RTE_MAX_ETHPORTS];
+        /* packets whose first hop was not tonf, the RX thread can only hand packets to NFs */
+        uint64_t rx_hop_drop[RTE_MAX_ETHPORTS];
 };
 
 struct tx_stats {
         uint64_t tx[RTE_MAX_ETHPORTS];
         uint64_t tx_drop[RTE_MAX_ETHPORTS];
+        /* drops after a burst the port only partly took, and after one it took none of */
+        uint64_t tx_drop_partial[RTE_MAX_ETHPORTS];
+        uint64_t tx_drop_full[RTE_MAX_ETHPORTS];
 };
 
 struct port_info {
@@ -209,6 +269,7 @@ struct port_info {
 struct onvm_configuration {
         struct {
                 uint8_t ONVM_NF_SHARE_CORES;
+                uint8_t ONVM_OVERFLOW_POLICY;
         } flags;
 };
 
@@ -223,6 +284,9 @@ struct onvm_nf;
 /* Function prototype for NF packet handlers */
 typedef int (*nf_pkt_handler_fn)(struct rte_mbuf *pkt, struct onvm_pkt_meta *meta,
                                  __attribute__((unused)) struct onvm_nf_local_ctx *nf_local_ctx);
+/* Function prototype for NF burst handlers, every packet in the burst is returned */
+typedef void (*nf_pkt_burst_handler_fn)(struct rte_mbuf **pkts, uint16_t nb_pkts,
+                                        struct onvm_nf_local_ctx *nf_local_ctx);
 /* Function prototype for NF the callback */
 typedef int (*nf_user_actions_fn)(__attribute__((unused)) struct onvm_nf_local_ctx *nf_local_ctx);
 /* Function prototype for NFs that want extra initalization/setup before running */
@@ -238,6 +302,8 @@ struct onvm_nf_function_table {
         nf_msg_handler_fn  msg_handler;
         nf_user_actions_fn user_actions;
         nf_pkt_handler_fn  pkt_handler;
+        /* Used instead of pkt_handler when set */
+        nf_pkt_burst_handler_fn pkt_burst_handler;
 };
 
 /* Information needed to initialize a new NF child thread */
@@ -255,6 +321,19 @@ struct onvm_nf_local_ctx {
         rte_atomic16_t nf_stopped;
 };
 
+/*
+ * Single producer, single consumer ring of inline control messages from the
+ * manager master thread to one NF. Messages are copied in and out, so no
+ * mempool is involved. head and tail run freely and are masked on access.
+ */
+struct onvm_nf_ctrl_ring {
+        /* Only written by the manager */
+        volatile uint32_t head __rte_cache_aligned;
+        /* Only written by the NF */
+        volatile uint32_t tail __rte_cache_aligned;
+        struct onvm_nf_msg msgs[NF_CTRL_RING_SIZE] __rte_cache_aligned;
+};
+
 /*
  * Define a NF structure with all needed info, including:
  *      thread information, function callbacks, flags, stats and shared core info.
@@ -263,8 +342,15 @@ struct onvm_nf_local_ctx {
  */
 struct onvm_nf {
         struct rte_ring *rx_q;
+        /* rx_prio_q[0] is rx_q, higher classes have their own smaller rings */
+        struct rte_ring *rx_prio_q[ONVM_NUM_PRIO];
+        /* packets a class may take from one dequeue burst, 0 for strict priority */
+        uint16_t rx_prio_weight[ONVM_NUM_PRIO];
         struct rte_ring *tx_q;
+        /* NF to NF messages, pool allocated */
         struct rte_ring *msg_q;
+        /* Manager to NF control messages */
+        struct onvm_nf_ctrl_ring ctrl_q;
         /* Struct for NF to NF communication (NF tx) */
         struct queue_mgr *nf_tx_mgr;
         uint16_t instance_id;
@@ -303,6 +389,9 @@ struct onvm_nf {
         struct {
                 volatile uint64_t rx;
                 volatile uint64_t rx_drop;
+                /* split of rx_drop: the ring took part of the burst, or none of it */
+                volatile uint64_t rx_drop_partial;
+                volatile uint64_t rx_drop_full;
                 volatile uint64_t tx;
                 volatile uint64_t tx_drop;
                 volatile uint64_t tx_buffer;
@@ -312,6 +401,12 @@ struct onvm_nf {
                 volatile uint64_t act_drop;
                 volatile uint64_t act_next;
                 volatile uint64_t act_buffer;
+                /* burst size the manager TX thread currently dequeues from tx_q */
+                volatile uint64_t tx_burst;
+                /* core changes, and how long the last and longest one stopped the NF */
+                volatile uint64_t migrations;
+                volatile uint64_t migrate_stall_us;
+                volatile uint64_t migrate_stall_max_us;
         } stats;
 
         struct {
@@ -351,11 +446,21 @@ struct onvm_service_chain_entry {
 };
 
 struct onvm_service_chain {
-        struct onvm_service_chain_entry sc[ONVM_MAX_CHAIN_LENGTH];
+        /* entry 0 is reserved, hops are stored in 1..chain_length */
+        struct onvm_service_chain_entry sc[ONVM_MAX_CHAIN_LENGTH + 1];
         uint8_t chain_length;
         int ref_cnt;
 };
 
+/*
+ * Chains configured on the manager, shared with NFs so that a packet's
+ * chain_id can be resolved when an NF asks for the next action.
+ */
+struct onvm_chain_table {
+        uint16_t num_chains;
+        struct onvm_service_chain chains[ONVM_MAX_CHAINS];
+};
+
 struct lpm_request {
         char name[64];
         uint32_t max_num_rules;
@@ -372,11 +477,22 @@ struct ft_request {
         int status;
 };
 
+/*
+ * NF asking the manager to move it to another core, answered with MSG_CHANGE_CORE.
+ * Also sent back as MSG_MIGRATE_FAILED with the core the NF could not move to.
+ */
+struct migrate_request {
+        uint16_t instance_id;
+        uint16_t core;
+};
+
 /* define common names for structures shared between server and NF */
 #define MP_NF_RXQ_NAME "MProc_Client_%u_RX"
+#define MP_NF_RXQ_PRIO_NAME "MProc_Client_%u_RX_P%u"
 #define MP_NF_TXQ_NAME "MProc_Client_%u_TX"
 #define MP_CLIENT_SEM_NAME "MProc_Client_%u_SEM"
 #define PKTMBUF_POOL_NAME "MProc_pktmbuf_pool"
+#define MIRROR_POOL_NAME "MProc_mirror_pool"
 #define MZ_PORT_INFO "MProc_port_info"
 #define MZ_CORES_STATUS "MProc_cores_info"
 #define MZ_NF_INFO "MProc_nf_init_cfg"
@@ -385,6 +501,8 @@ struct ft_request {
 #define MZ_ONVM_CONFIG "MProc_onvm_config"
 #define MZ_SCP_INFO "MProc_scp_info"
 #define MZ_FTP_INFO "MProc_ftp_info"
+#define MZ_CHAIN_TABLE "MProc_chain_table"
+#define MZ_ARP_CACHE "MProc_arp_cache"
 
 #define _MGR_MSG_QUEUE_NAME "MSG_MSG_QUEUE"
 #define _NF_MSG_QUEUE_NAME "NF_%u_MSG_QUEUE"
@@ -427,6 +545,32 @@ get_rx_queue_name(unsigned id) {
         return buffer;
 }
 
+/*
+ * Given the priority rx queue name template above, get the queue name
+ */
+static inline const char *
+get_rx_prio_queue_name(unsigned id, unsigned prio) {
+        /* buffer for return value. Size calculated by the two %u being replaced
+         * by maximum 3 and 1 digits (plus an extra byte for safety) */
+        static char buffer[sizeof(MP_NF_RXQ_PRIO_NAME) + 2];
+
+        snprintf(buffer, sizeof(buffer) - 1, MP_NF_RXQ_PRIO_NAME, id, prio);
+        return buffer;
+}
+
+/*
+ * Number of packets waiting in all RX priority rings of an NF
+ */
+static inline unsigned
+onvm_nf_rx_count(struct onvm_nf *nf) {
+        unsigned count = rte_ring_count(nf->rx_q);
+        int prio;
+
+        for (prio = 1; prio < ONVM_NUM_PRIO; prio++)
+                count += rte_ring_count(nf->rx_prio_q[prio]);
+        return count;
+}
+
 /*
  * Given the tx queue name template above, get the queue name
  */
@@ -453,6 +597,69 @@ get_msg_queue_name(unsigned id) {
         return buffer;
 }
 
+/*
+ * Number of control messages waiting for an NF
+ */
+static inline unsigned
+onvm_nf_ctrl_count(const struct onvm_nf_ctrl_ring *ring) {
+        return ring->head - ring->tail;
+}
+
+/*
+ * Put a control message on an NF's ring. Only the manager master thread may call this.
+ * Returns 0 on success, -ENOBUFS if the NF has not drained the ring.
+ */
+static inline int
+onvm_nf_ctrl_enqueue(struct onvm_nf_ctrl_ring *ring, uint8_t msg_type, void *msg_data) {
+        uint32_t head = ring->head;
+        struct onvm_nf_msg *msg;
+
+        if (head - ring->tail >= NF_CTRL_RING_SIZE)
+                return -ENOBUFS;
+
+        msg = &ring->msgs[head & (NF_CTRL_RING_SIZE - 1)];
+        msg->msg_type = msg_type;
+        msg->msg_data = msg_data;
+        /* Message must be visible before the NF sees the new head */
+        rte_smp_wmb();
+        ring->head = head + 1;
+        return 0;
+}
+
+/*
+ * Copy up to max control messages off an NF's ring. Only the NF may call this.
+ * Returns the number of messages copied.
+ */
+static inline unsigned
+onvm_nf_ctrl_dequeue_burst(struct onvm_nf_ctrl_ring *ring, struct onvm_nf_msg *msgs, unsigned max) {
+        uint32_t tail = ring->tail;
+        unsigned count = ring->head - tail;
+        unsigned i;
+
+        if (count > max)
+                count = max;
+        if (count == 0)
+                return 0;
+
+        /* Read the messages only after the head that published them */
+        rte_smp_rmb();
+        for (i = 0; i < count; i++)
+                msgs[i] = ring->msgs[(tail + i) & (NF_CTRL_RING_SIZE - 1)];
+        /* Slots must be read before the manager may reuse them */
+        rte_smp_mb();
+        ring->tail = tail + count;
+        return count;
+}
+
+/*
+ * Drop anything left on an NF's control ring. Only safe while the NF is not running.
+ */
+static inline void
+onvm_nf_ctrl_reset(struct onvm_nf_ctrl_ring *ring) {
+        ring->tail = 0;
+        ring->head = 0;
+}
+
 /*
  * Interface checking if a given NF is "valid", meaning if it's running.
  */
@@ -484,7 +691,8 @@ get_sem_name(unsigned id) {
 
 static inline int
 whether_wakeup_client(struct onvm_nf *nf, struct nf_wakeup_info *nf_wakeup_info) {
-        if (rte_ring_count(nf->rx_q) < PKT_WAKEUP_THRESHOLD && rte_ring_count(nf->msg_q) < MSG_WAKEUP_THRESHOLD)
+        if (onvm_nf_rx_count(nf) < PKT_WAKEUP_THRESHOLD &&
+            rte_ring_count(nf->msg_q) + onvm_nf_ctrl_count(&nf->ctrl_q) < MSG_WAKEUP_THRESHOLD)
                 return 0;
 
         /* Check if its already woken up */
@@ -39,12 +39,15 @@
  * to load an NF from a config file
  ********************************************************************/
 
+#include <errno.h>
+#include <arpa/inet.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <rte_memcpy.h>
 
 #include "cJSON.h"
+#include "onvm_common.h"
 #include "onvm_config_common.h"
 
 #define IS_NULL_OR_EMPTY_STRING(s) ((s) == NULL || strncmp(s, "", 1) == 0 ? 1 : 0)
@@ -227,6 +230,21 @@ onvm_config_extract_instance_id(cJSON* onvm_config, int* instance_id) {
         return 0;
 }
 
+int
+onvm_config_extract_workers(cJSON* onvm_config, int* workers) {
+        if (onvm_config == NULL || workers == NULL) {
+                return -1;
+        }
+
+        if (cJSON_GetObjectItem(onvm_config, "workers") == NULL) {
+                return -1;
+        }
+
+        *workers = cJSON_GetObjectItem(onvm_config, "workers")->valueint;
+
+        return 0;
+}
+
 int
 onvm_config_get_item_count(cJSON* config) {
         int arg_count = 0;
@@ -391,8 +409,12 @@ int
 onvm_config_create_onvm_args(cJSON* onvm_config, int* onvm_argc, char** onvm_argv[]) {
         char* service_id_string = NULL;
         char* instance_id_string = NULL;
+        char* workers_string = NULL;
         int service_id = 0;
         int instance_id = 0;
+        int has_instance_id = 0;
+        int workers = 0;
+        int has_workers = 0;
 
         /* An NF has 2 required ONVM args */
         *onvm_argc = 2;
@@ -409,6 +431,13 @@ onvm_config_create_onvm_args(cJSON* onvm_config, int* onvm_argc, char** onvm_arg
         if (onvm_config_extract_instance_id(onvm_config, &instance_id) > -1) {
                 /* Need to account for instance id args, so add 2 */
                 *onvm_argc += 2;
+                has_instance_id = 1;
+        }
+
+        if (onvm_config_extract_workers(onvm_config, &workers) > -1) {
+                /* Worker thread args go last */
+                *onvm_argc += 2;
+                has_workers = 1;
         }
 
         *onvm_argv = (char**)malloc(sizeof(char*) * (*onvm_argc));
@@ -438,7 +467,7 @@ onvm_config_create_onvm_args(cJSON* onvm_config, int* onvm_argc, char** onvm_arg
         snprintf(service_id_string, sizeof(char) * MAX_SERVICE_ID_SIZE, "%d", service_id);
         (*onvm_argv)[1] = service_id_string;
 
-        if (*onvm_argc > 2) {
+        if (has_instance_id) {
                 instance_id_string = (char*)malloc(sizeof(char) * MAX_SERVICE_ID_SIZE);
                 if (instance_id_string == NULL) {
                         printf("Unable to allocate space for onvm_instance_id_string\n");
@@ -462,6 +491,27 @@ onvm_config_create_onvm_args(cJSON* onvm_config, int* onvm_argc, char** onvm_arg
                 (*onvm_argv)[3] = instance_id_string;
         }
 
+        if (has_workers) {
+                workers_string = (char*)malloc(sizeof(char) * MAX_SERVICE_ID_SIZE);
+                (*onvm_argv)[*onvm_argc - 2] = malloc(sizeof(char) * strlenn(FLAG_W));
+                if (workers_string == NULL || (*onvm_argv)[*onvm_argc - 2] == NULL) {
+                        printf("Could not allocate space for workers in argv\n");
+                        free(workers_string);
+                        free((*onvm_argv)[*onvm_argc - 2]);
+                        if (has_instance_id) {
+                                free((*onvm_argv)[2]);
+                                free(instance_id_string);
+                        }
+                        free((*onvm_argv)[0]);
+                        free(service_id_string);
+                        free(*onvm_argv);
+                        return -1;
+                }
+                memcpy((*onvm_argv)[*onvm_argc - 2], FLAG_W, strlenn(FLAG_W));
+                snprintf(workers_string, sizeof(char) * MAX_SERVICE_ID_SIZE, "%d", workers);
+                (*onvm_argv)[*onvm_argc - 1] = workers_string;
+        }
+
         return 0;
 }
 
@@ -565,3 +615,201 @@ onvm_config_create_dpdk_args(cJSON* dpdk_config, int* dpdk_argc, char** dpdk_arg
 
         return 0;
 }
+
+/* Parses "a.b.c.d" or "a.b.c.d/len" into a host order address and mask */
+static int
+onvm_config_parse_prefix(const char* str, uint32_t* addr, uint32_t* mask) {
+        char buf[INET_ADDRSTRLEN + 4];
+        char* slash;
+        char* end;
+        struct in_addr in;
+        long len = 32;
+
+        if (str == NULL || strlen(str) >= sizeof(buf)) {
+                return -1;
+        }
+        strcpy(buf, str);
+
+        slash = strchr(buf, '/');
+        if (slash != NULL) {
+                *slash = '\0';
+                errno = 0;
+                len = strtol(slash + 1, &end, 10);
+                if (end == slash + 1 || *end != '\0' || errno != 0 || len < 0 || len > 32) {
+                        return -1;
+                }
+        }
+        if (inet_pton(AF_INET, buf, &in) != 1) {
+                return -1;
+        }
+
+        *mask = len == 0 ? 0 : ~0U << (32 - len);
+        *addr = ntohl(in.s_addr) & *mask;
+        return 0;
+}
+
+static int
+onvm_config_parse_action(const char* str, uint8_t* action) {
+        if (str == NULL) {
+                return -1;
+        }
+
+        if (!strcmp(str, "drop")) {
+                *action = ONVM_NF_ACTION_DROP;
+        } else if (!strcmp(str, "next")) {
+                *action = ONVM_NF_ACTION_NEXT;
+        } else if (!strcmp(str, "tonf")) {
+                *action = ONVM_NF_ACTION_TONF;
+        } else if (!strcmp(str, "out")) {
+                *action = ONVM_NF_ACTION_OUT;
+        } else if (!strcmp(str, "mirror")) {
+                *action = ONVM_NF_ACTION_MIRROR;
+        } else if (!strcmp(str, "mirror_out")) {
+                *action = ONVM_NF_ACTION_MIRROR_OUT;
+        } else {
+                return -1;
+        }
+        return 0;
+}
+
+/*
+ * Reads an optional integer match field into value, ONVM_CONFIG_MATCH_ANY
+ * if it is missing. Anything but a whole number in [0, max] is rejected.
+ */
+static int
+onvm_config_extract_match_int(cJSON* match, const char* name, int max, int* value) {
+        cJSON* item = cJSON_GetObjectItem(match, name);
+
+        if (item == NULL) {
+                *value = ONVM_CONFIG_MATCH_ANY;
+                return 0;
+        }
+        if (!cJSON_IsNumber(item) || item->valuedouble != item->valueint || item->valueint < 0 ||
+            item->valueint > max) {
+                printf("Invalid %s %s, must be a number between 0 and %d\n", name,
+                       cJSON_IsNumber(item) ? "value" : "type", max);
+                return -1;
+        }
+        *value = item->valueint;
+        return 0;
+}
+
+int
+onvm_config_extract_chains(cJSON* config, struct onvm_config_chain** chains, int* num_chains, int max_hops) {
+        cJSON* chains_arr = NULL;
+        cJSON* chain_obj = NULL;
+        cJSON* match = NULL;
+        cJSON* hops_arr = NULL;
+        cJSON* hop_obj = NULL;
+        cJSON* item = NULL;
+        struct onvm_config_chain* local_chains = NULL;
+        struct onvm_config_chain* chain = NULL;
+        int count, i, j;
+
+        if (config == NULL || chains == NULL || num_chains == NULL) {
+                return -1;
+        }
+
+        chains_arr = cJSON_GetObjectItem(config, "chains");
+        if (chains_arr == NULL || !cJSON_IsArray(chains_arr)) {
+                return -1;
+        }
+
+        count = cJSON_GetArraySize(chains_arr);
+        local_chains = (struct onvm_config_chain*)calloc(count > 0 ? count : 1, sizeof(struct onvm_config_chain));
+        if (local_chains == NULL) {
+                printf("Unable to allocate space for chains\n");
+                return -1;
+        }
+
+        for (i = 0; i < count; i++) {
+                chain_obj = cJSON_GetArrayItem(chains_arr, i);
+                chain = &local_chains[i];
+
+                chain->port = ONVM_CONFIG_MATCH_ANY;
+                chain->vlan = ONVM_CONFIG_MATCH_ANY;
+                chain->proto = ONVM_CONFIG_MATCH_ANY;
+                chain->dst_port = ONVM_CONFIG_MATCH_ANY;
+
+                match = cJSON_GetObjectItem(chain_obj, "match");
+                if (match != NULL) {
+                        /* 0xFFFF is left out of the 16 bit fields, the chain table uses it for any */
+                        if (onvm_config_extract_match_int(match, "port", RTE_MAX_ETHPORTS - 1, &chain->port) < 0 ||
+                            onvm_config_extract_match_int(match, "vlan", 4095, &chain->vlan) < 0 ||
+                            onvm_config_extract_match_int(match, "proto", UINT8_MAX, &chain->proto) < 0 ||
+                            onvm_config_extract_match_int(match, "dst_port", UINT16_MAX - 1, &chain->dst_port) < 0) {
+                                printf("Invalid match in chain %d\n", i);
+                                goto fail;
+                        }
+
+                        item = cJSON_GetObjectItem(match, "src_ip");
+                        if (item != NULL && (!cJSON_IsString(item) ||
+                            onvm_config_parse_prefix(item->valuestring, &chain->src_ip, &chain->src_mask) < 0)) {
+                                printf("Invalid src_ip in chain %d\n", i);
+                                goto fail;
+                        }
+                        item = cJSON_GetObjectItem(match, "dst_ip");
+                        if (item != NULL && (!cJSON_IsString(item) ||
+                            onvm_config_parse_prefix(item->valuestring, &chain->dst_ip, &chain->dst_mask) < 0)) {
+                                printf("Invalid dst_ip in chain %d\n", i);
+                                goto fail;
+                        }
+                }
+
+                hops_arr = cJSON_GetObjectItem(chain_obj, "chain");
+                if (hops_arr == NULL || !cJSON_IsArray(hops_arr)) {
+                        printf("Chain %d has no \"chain\" array\n", i);
+                        goto fail;
+                }
+                chain->num_hops = cJSON_GetArraySize(hops_arr);
+                if (chain->num_hops == 0 || chain->num_hops > max_hops) {
+                        printf("Chain %d has %d hops, must be between 1 and %d\n", i, chain->num_hops, max_hops);
+                        goto fail;
+                }
+                chain->hops = (struct onvm_config_chain_hop*)calloc(chain->num_hops,
+                                                                    sizeof(struct onvm_config_chain_hop));
+                if (chain->hops == NULL) {
+                        printf("Unable to allocate space for chain hops\n");
+                        goto fail;
+                }
+
+                for (j = 0; j < chain->num_hops; j++) {
+                        hop_obj = cJSON_GetArrayItem(hops_arr, j);
+                        item = cJSON_GetObjectItem(hop_obj, "action");
+                        if (item == NULL || !cJSON_IsString(item) ||
+                            onvm_config_parse_action(item->valuestring, &chain->hops[j].action) < 0) {
+                                printf("Invalid action in chain %d hop %d\n", i, j);
+                                goto fail;
+                        }
+                        item = cJSON_GetObjectItem(hop_obj, "destination");
+                        if (item != NULL && (!cJSON_IsNumber(item) || item->valuedouble != item->valueint ||
+                                             item->valueint < 0 || item->valueint > UINT16_MAX)) {
+                                printf("Invalid destination in chain %d hop %d\n", i, j);
+                                goto fail;
+                        }
+                        chain->hops[j].destination = item == NULL ? 0 : (uint16_t)item->valueint;
+                }
+        }
+
+        *chains = local_chains;
+        *num_chains = count;
+        return 0;
+
+fail:
+        onvm_config_free_chains(local_chains, count);
+        return -1;
+}
+
+void
+onvm_config_free_chains(struct onvm_config_chain* chains, int num_chains) {
+        int i;
+
+        if (chains == NULL) {
+                return;
+        }
+
+        for (i = 0; i < num_chains; i++) {
+                free(chains[i].hops);
+        }
+        free(chains);
+}
@@ -41,16 +41,44 @@
 #ifndef _ONVM_CONFIG_COMMON_H_
 #define _ONVM_CONFIG_COMMON_H_
 
+#include <stdint.h>
 #include "cJSON.h"
 
 #define MAX_SERVICE_ID_SIZE 5
 
+/* Value of a chain rule match field that matches anything */
+#define ONVM_CONFIG_MATCH_ANY -1
+
+/***********************Chain Config Structures***********************/
+
+/* One hop of a configured chain */
+struct onvm_config_chain_hop {
+        uint8_t action;
+        uint16_t destination;
+};
+
+/* A chain and the rule selecting which packets it applies to.
+ * Addresses and ports are in host byte order. */
+struct onvm_config_chain {
+        int port;
+        int vlan;
+        uint32_t src_ip;
+        uint32_t src_mask;
+        uint32_t dst_ip;
+        uint32_t dst_mask;
+        int proto;
+        int dst_port;
+        int num_hops;
+        struct onvm_config_chain_hop* hops;
+};
+
 /***********************Command Line Arg Strings**********************/
 
 #define PROC_TYPE_SECONDARY "--proc-type=secondary"
 #define FLAG_N "-n"
 #define FLAG_R "-r"
 #define FLAG_L "-l"
+#define FLAG_W "-w"
 #define FLAG_DASH "--"
 
 /*****************************API************************************/
@@ -161,6 +189,19 @@ onvm_config_extract_service_id(cJSON* onvm_config, int* service_id);
 int
 onvm_config_extract_instance_id(cJSON* onvm_config, int* instance_id);
 
+/**
+ * Extracts the number of threads an NF runs with. Replaces the -w for ONVM settings
+ *
+ * @param onvm_config
+ *   Pointer to a cJSON struct with the parsed onvm config file
+ * @param workers
+ *   Pointer to hold the extracted number of threads
+ * @return
+ *   0 on success, -1 if failure
+ */
+int
+onvm_config_extract_workers(cJSON* onvm_config, int* workers);
+
 /*
  * Gets the number of items in a JSON section
  *
@@ -217,4 +258,36 @@ onvm_config_create_onvm_args(cJSON* onvm_config, int* onvm_argc, char** onvm_arg
 int
 onvm_config_create_dpdk_args(cJSON* dpdk_config, int* dpdk_argc, char** dpdk_argv[]);
 
+/**
+ * Extracts the "chains" array from a config file. Each element has an
+ * optional "match" object (port, vlan, src_ip, dst_ip as "a.b.c.d/len",
+ * proto, dst_port) and a "chain" array of {"action", "destination"} hops,
+ * where action is one of "drop", "next", "tonf", "out", "mirror" or
+ * "mirror_out".
+ *
+ * @param config
+ *   Pointer to a cJSON struct with the parsed config file
+ * @param chains
+ *   Pointer to hold the array of extracted chains, free with onvm_config_free_chains
+ * @param num_chains
+ *   Pointer to hold the number of extracted chains
+ * @param max_hops
+ *   Longest chain accepted
+ * @return
+ *   0 on success, -1 if the section is missing or malformed
+ */
+int
+onvm_config_extract_chains(cJSON* config, struct onvm_config_chain** chains, int* num_chains, int max_hops);
+
+/**
+ * Frees chains returned by onvm_config_extract_chains
+ *
+ * @param chains
+ *   Array of chains
+ * @param num_chains
+ *   Number of chains in the array
+ */
+void
+onvm_config_free_chains(struct onvm_config_chain* chains, int num_chains);
+
 #endif  // _ONVM_CONFIG_COMMON_H_
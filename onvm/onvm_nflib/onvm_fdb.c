@@ -0,0 +1,317 @@
+/*********************************************************************
+ *                     openNetVM
+ *              https://sdnfv.github.io
+ *
+ *   BSD LICENSE
+ *
+ *   Copyright(c)
+ *            2015-2019 George Washington University
+ *            2015-2019 University of California Riverside
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * The name of the author may not be used to endorse or promote
+ *       products derived from this software without specific prior
+ *       written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * onvm_fdb.c - a MAC learning forwarding database for L2 switching NFs
+ ********************************************************************/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_ether.h>
+#include <rte_hash.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+
+#include "onvm_fdb.h"
+#include "onvm_nflib.h"
+
+/* Indirect mbufs in a database's clone pool */
+#define ONVM_FDB_CLONES 4096
+#define ONVM_FDB_CLONE_CACHE 64
+/* Hash positions the aging sweep visits per burst */
+#define ONVM_FDB_AGE_STEP 8
+/* How long onvm_fdb_free waits for flooded copies to come back */
+#define ONVM_FDB_DRAIN_MS 100
+
+/* Clone pools this process created, to name the next one */
+static uint32_t onvm_fdb_clone_pools;
+
+/*
+ * Fill the keys of a packet's source and destination MAC. The VLAN ID is
+ * read from an 802.1Q tag, or from the mbuf if the port stripped the tag.
+ */
+static inline void
+onvm_fdb_pkt_keys(struct rte_mbuf *pkt, struct onvm_fdb_key *src, struct onvm_fdb_key *dst);
+
+/*
+ * Remove up to ONVM_FDB_AGE_STEP stale entries, resuming where the last
+ * call stopped.
+ */
+static void
+onvm_fdb_age(struct onvm_fdb *fdb, uint64_t now);
+
+struct onvm_fdb *
+onvm_fdb_create(uint32_t entries, uint32_t aging_s) {
+        struct rte_hash_parameters hash_params;
+        struct rte_hash *hash;
+        struct onvm_fdb *fdb;
+        char name[64];
+
+        /* Use core number and cycle counter to get a unique name, as onvm_ft does */
+        snprintf(name, sizeof(name), "onvm_fdb_%d-%" PRIu64, rte_lcore_id(), rte_get_tsc_cycles());
+
+        memset(&hash_params, 0, sizeof(hash_params));
+        hash_params.name = name;
+        hash_params.entries = entries;
+        hash_params.key_len = sizeof(struct onvm_fdb_key);
+        hash_params.hash_func = NULL;
+        hash_params.hash_func_init_val = 0;
+        hash_params.socket_id = rte_socket_id();
+
+        if (rte_eal_process_type() == RTE_PROC_PRIMARY) {
+                hash = rte_hash_create(&hash_params);
+        } else {
+                if (onvm_nflib_request_ft(&hash_params) < 0)
+                        return NULL;
+                hash = rte_hash_find_existing(name);
+        }
+        if (hash == NULL)
+                return NULL;
+
+        fdb = rte_zmalloc("onvm_fdb", sizeof(struct onvm_fdb), 0);
+        if (fdb == NULL) {
+                rte_hash_free(hash);
+                return NULL;
+        }
+        fdb->hash = hash;
+        fdb->aging = (uint64_t)aging_s * rte_get_tsc_hz();
+
+        /* Entries are indexed by the position rte_hash gives each key */
+        fdb->entries = rte_calloc("onvm_fdb_entries", entries, sizeof(struct onvm_fdb_entry), 0);
+        if (fdb->entries == NULL) {
+                onvm_fdb_free(fdb);
+                return NULL;
+        }
+
+        /*
+         * Clones only point at the data of the packet they copy, so they need no data room.
+         * Pool names are shared by all processes and limited to RTE_MEMPOOL_NAMESIZE, so
+         * they are made unique from the pid and a per process count: at most 5 + 7 + 1 + 10
+         * characters, where a TSC value would overflow the limit after a few days of uptime.
+         */
+        snprintf(name, RTE_MEMPOOL_NAMESIZE, "fdbc_%d_%u", (int)getpid(), onvm_fdb_clone_pools++);
+        fdb->clone_pool = rte_pktmbuf_pool_create(name, ONVM_FDB_CLONES, ONVM_FDB_CLONE_CACHE, 0, 0,
+                                                  rte_socket_id());
+        if (fdb->clone_pool == NULL) {
+                onvm_fdb_free(fdb);
+                return NULL;
+        }
+
+        return fdb;
+}
+
+void
+onvm_fdb_free(struct onvm_fdb *fdb) {
+        unsigned in_use;
+        int i;
+
+        if (fdb == NULL)
+                return;
+
+        rte_hash_free(fdb->hash);
+        rte_free(fdb->entries);
+
+        /*
+         * Flooded copies can still sit in manager TX buffers or NIC rings after the NF stopped,
+         * and go back to the pool when they are sent. A NIC may only reclaim them on its next
+         * transmit, so if they do not drain in time the pool is left allocated for them.
+         */
+        if (fdb->clone_pool != NULL) {
+                in_use = rte_mempool_in_use_count(fdb->clone_pool);
+                for (i = 0; i < ONVM_FDB_DRAIN_MS && in_use != 0; i++) {
+                        rte_delay_ms(1);
+                        in_use = rte_mempool_in_use_count(fdb->clone_pool);
+                }
+                if (in_use == 0)
+                        rte_mempool_free(fdb->clone_pool);
+                else
+                        RTE_LOG(WARNING, APP, "Leaving FDB clone pool %s allocated, %u copies are in flight\n",
+                                fdb->clone_pool->name, in_use);
+        }
+        rte_free(fdb);
+}
+
+int32_t
+onvm_fdb_count(struct onvm_fdb *fdb) {
+        return rte_hash_count(fdb->hash);
+}
+
+void
+onvm_fdb_switch_burst(struct onvm_fdb *fdb, struct rte_mbuf **pkts, uint16_t nb_pkts, uint16_t *dst_ports) {
+        struct onvm_fdb_key src[RTE_HASH_LOOKUP_BULK_MAX];
+        struct onvm_fdb_key dst[RTE_HASH_LOOKUP_BULK_MAX];
+        const void *src_keys[RTE_HASH_LOOKUP_BULK_MAX];
+        const void *dst_keys[RTE_HASH_LOOKUP_BULK_MAX];
+        int32_t pos[RTE_HASH_LOOKUP_BULK_MAX];
+        struct onvm_fdb_entry *entry;
+        uint64_t now;
+        uint16_t i;
+
+        now = rte_get_tsc_cycles();
+        for (i = 0; i < nb_pkts; i++) {
+                onvm_fdb_pkt_keys(pkts[i], &src[i], &dst[i]);
+                src_keys[i] = &src[i];
+                dst_keys[i] = &dst[i];
+        }
+
+        /* Learn first, so a reply later in the same burst is already switched */
+        rte_hash_lookup_bulk(fdb->hash, src_keys, nb_pkts, pos);
+        for (i = 0; i < nb_pkts; i++) {
+                /* A group address is never a valid source */
+                if (unlikely(rte_is_multicast_ether_addr(&src[i].mac)))
+                        continue;
+                if (unlikely(pos[i] < 0)) {
+                        pos[i] = rte_hash_add_key(fdb->hash, src_keys[i]);
+                        if (pos[i] < 0) {
+                                fdb->full++;
+                                continue;
+                        }
+                        /* An earlier packet of this burst may have added it already */
+                        if (fdb->entries[pos[i]].seen != now)
+                                fdb->learned++;
+                } else if (unlikely(fdb->entries[pos[i]].port != pkts[i]->port)) {
+                        fdb->moved++;
+                }
+                entry = &fdb->entries[pos[i]];
+                entry->port = pkts[i]->port;
+                entry->seen = now;
+        }
+
+        rte_hash_lookup_bulk(fdb->hash, dst_keys, nb_pkts, pos);
+        for (i = 0; i < nb_pkts; i++) {
+                if (rte_is_multicast_ether_addr(&dst[i].mac) || pos[i] < 0 ||
+                    now - fdb->entries[pos[i]].seen > fdb->aging) {
+                        dst_ports[i] = ONVM_FDB_FLOOD;
+                        fdb->flooded++;
+                } else if (fdb->entries[pos[i]].port == pkts[i]->port) {
+                        dst_ports[i] = ONVM_FDB_DROP;
+                } else {
+                        dst_ports[i] = fdb->entries[pos[i]].port;
+                }
+        }
+
+        onvm_fdb_age(fdb, now);
+}
+
+int
+onvm_fdb_flood(struct onvm_fdb *fdb, struct onvm_nf *nf, struct rte_mbuf *pkt, const uint16_t *out_ports,
+               uint16_t nb_ports) {
+        struct rte_mbuf *copies[RTE_MAX_ETHPORTS];
+        struct onvm_pkt_meta *meta;
+        struct rte_mbuf *copy;
+        uint16_t i, last, nb_copies;
+
+        last = ONVM_FDB_FLOOD;
+        nb_copies = 0;
+        for (i = 0; i < nb_ports; i++) {
+                if (out_ports[i] == pkt->port)
+                        continue;
+                /* pkt itself takes the last port, every earlier one gets a copy */
+                if (last != ONVM_FDB_FLOOD) {
+                        /* rte_pktmbuf_clone takes a reference on the data with rte_mbuf_refcnt_update */
+                        copy = rte_pktmbuf_clone(pkt, fdb->clone_pool);
+                        if (unlikely(copy == NULL)) {
+                                nf->stats.tx_drop++;
+                        } else {
+                                copy->udata64 = pkt->udata64;
+                                meta = onvm_get_pkt_meta(copy);
+                                meta->action = ONVM_NF_ACTION_OUT;
+                                meta->destination = last;
+                                copies[nb_copies++] = copy;
+                        }
+                }
+                last = out_ports[i];
+        }
+
+        meta = onvm_get_pkt_meta(pkt);
+        if (last == ONVM_FDB_FLOOD) {
+                meta->action = ONVM_NF_ACTION_DROP;
+                return 0;
+        }
+        meta->action = ONVM_NF_ACTION_OUT;
+        meta->destination = last;
+
+        /* On failure the copies are freed and counted as tx_drop */
+        if (nb_copies > 0 && onvm_nflib_return_pkt_bulk(nf, copies, nb_copies) < 0)
+                return 0;
+        return nb_copies;
+}
+
+/******************************Helper functions*******************************/
+
+static inline void
+onvm_fdb_pkt_keys(struct rte_mbuf *pkt, struct onvm_fdb_key *src, struct onvm_fdb_key *dst) {
+        struct rte_ether_hdr *eth;
+        struct rte_vlan_hdr *vlan;
+        uint16_t vlan_id = 0;
+
+        eth = rte_pktmbuf_mtod(pkt, struct rte_ether_hdr *);
+        if (eth->ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_VLAN)) {
+                vlan = (struct rte_vlan_hdr *)(eth + 1);
+                vlan_id = rte_be_to_cpu_16(vlan->vlan_tci) & 0xfff;
+        } else if (pkt->ol_flags & PKT_RX_VLAN_STRIPPED) {
+                vlan_id = pkt->vlan_tci & 0xfff;
+        }
+
+        rte_ether_addr_copy(&eth->s_addr, &src->mac);
+        src->vlan = vlan_id;
+        rte_ether_addr_copy(&eth->d_addr, &dst->mac);
+        dst->vlan = vlan_id;
+}
+
+static void
+onvm_fdb_age(struct onvm_fdb *fdb, uint64_t now) {
+        const void *key;
+        void *data;
+        int32_t pos;
+        int i;
+
+        for (i = 0; i < ONVM_FDB_AGE_STEP; i++) {
+                pos = rte_hash_iterate(fdb->hash, &key, &data, &fdb->age_next);
+                if (pos < 0) {
+                        /* End of the table, start over on the next burst */
+                        fdb->age_next = 0;
+                        return;
+                }
+                if (now - fdb->entries[pos].seen > fdb->aging) {
+                        rte_hash_del_key(fdb->hash, key);
+                        fdb->aged++;
+                }
+        }
+}
@@ -0,0 +1,129 @@
+/*********************************************************************
+ *                     openNetVM
+ *              https://sdnfv.github.io
+ *
+ *   BSD LICENSE
+ *
+ *   Copyright(c)
+ *            2015-2019 George Washington University
+ *            2015-2019 University of California Riverside
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * The name of the author may not be used to endorse or promote
+ *       products derived from this software without specific prior
+ *       written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * onvm_fdb.h - a MAC learning forwarding database for L2 switching NFs
+ ********************************************************************/
+
+#ifndef _ONVM_FDB_H_
+#define _ONVM_FDB_H_
+
+#include <rte_common.h>
+#include <rte_ether.h>
+#include <rte_mbuf.h>
+#include "onvm_common.h"
+
+/* Destination of a packet whose MAC is not known, it goes out of every other port */
+#define ONVM_FDB_FLOOD UINT16_MAX
+/* Destination of a packet for a MAC learned on its own input port, it is filtered */
+#define ONVM_FDB_DROP (UINT16_MAX - 1)
+
+/* MAC and VLAN ID, the 8 byte key of the database */
+struct onvm_fdb_key {
+        struct rte_ether_addr mac;
+        uint16_t vlan;
+};
+
+/* What the database knows of a key, stored at the key's position in the hash */
+struct onvm_fdb_entry {
+        uint64_t seen;
+        uint16_t port;
+};
+
+/*
+ * A forwarding database: a cuckoo hash (rte_hash) from MAC and VLAN to the
+ * port the MAC was last seen on. One thread uses a database, a worker pool
+ * needs one per worker.
+ */
+struct onvm_fdb {
+        struct rte_hash *hash;
+        struct onvm_fdb_entry *entries;
+        /* indirect mbufs for flooded copies */
+        struct rte_mempool *clone_pool;
+        /* TSC cycles after which an entry no longer forwards */
+        uint64_t aging;
+        /* rte_hash_iterate position of the aging sweep */
+        uint32_t age_next;
+        uint64_t learned;
+        uint64_t moved;
+        uint64_t aged;
+        uint64_t flooded;
+        /* sources not learned because the hash was full */
+        uint64_t full;
+};
+
+/*
+ * Create a database for up to `entries` MAC addresses whose entries age out
+ * after `aging_s` seconds without traffic from them.
+ * Returns NULL if the hash, its entries or the clone pool cannot be allocated.
+ */
+struct onvm_fdb *
+onvm_fdb_create(uint32_t entries, uint32_t aging_s);
+
+/*
+ * Free a database. Call it after onvm_nflib_stop, so the NF has handed over
+ * all flooded copies. The clone pool is only freed once they are back.
+ */
+void
+onvm_fdb_free(struct onvm_fdb *fdb);
+
+/*
+ * Learn the source of every packet of a burst and look up its destination
+ * with one bulk hash lookup for each. dst_ports[i] is the output port of
+ * pkts[i], ONVM_FDB_FLOOD for broadcast, multicast and unknown MACs, or
+ * ONVM_FDB_DROP if the destination is on the input port. Also ages out a
+ * few stale entries, so the caller needs no timer. At most
+ * RTE_HASH_LOOKUP_BULK_MAX packets per call.
+ */
+void
+onvm_fdb_switch_burst(struct onvm_fdb *fdb, struct rte_mbuf **pkts, uint16_t nb_pkts, uint16_t *dst_ports);
+
+/*
+ * Send pkt out of every port in out_ports except its input port. The other
+ * copies are indirect mbufs from the database's clone pool that share pkt's
+ * data by reference count, so the NF must not change pkt afterwards. They
+ * are returned to the NF's TX ring and pkt itself is set to the last port,
+ * or dropped if there is no other port.
+ * Returns the number of copies sent besides pkt.
+ */
+int
+onvm_fdb_flood(struct onvm_fdb *fdb, struct onvm_nf *nf, struct rte_mbuf *pkt, const uint16_t *out_ports,
+               uint16_t nb_ports);
+
+/* Number of MAC addresses in the database, aged out ones included until the sweep removes them */
+int32_t
+onvm_fdb_count(struct onvm_fdb *fdb);
+
+#endif  // _ONVM_FDB_H_
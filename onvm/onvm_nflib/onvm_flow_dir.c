@@ -43,18 +43,47 @@
 #include <rte_mbuf.h>
 #include <rte_memory.h>
 #include <rte_memzone.h>
+#include <errno.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "onvm_common.h"
 #include "onvm_flow_table.h"
 
 #define NO_FLAGS 0
 #define SDN_FT_ENTRIES 1024
+#define SDN_FT6_ENTRIES 1024
+#define SDN_FT6_SNAPSHOT_SUFFIX ".ipv6"
 
 struct onvm_ft *sdn_ft;
+struct onvm_ft *sdn_ft6;
 struct onvm_ft **sdn_ft_p;
 
+/* Snapshot form of a flow entry. The key and service chain are only
+ * referenced by pointer in the table, so the chain is stored inline and the
+ * key is rebuilt from the snapshot record. */
+struct onvm_flow_dir_snapshot_entry {
+        struct onvm_service_chain sc;
+        uint8_t has_sc;
+        uint8_t prio;
+        uint16_t idle_timeout;
+        uint16_t hard_timeout;
+        uint64_t ref_cnt;
+        uint64_t packet_count;
+        uint64_t byte_count;
+};
+
+static int
+onvm_flow_dir_export_entry(void *dst, const void *key, const char *entry, void *arg);
+
+static int
+onvm_flow_dir_import_entry(char *entry, const void *key, const void *src, void *arg);
+
+static inline struct onvm_ft *
+onvm_flow_dir_table(struct rte_mbuf *pkt);
+
 int
 onvm_flow_dir_init(void) {
         const struct rte_memzone *mz_ftp;
@@ -63,13 +92,19 @@ onvm_flow_dir_init(void) {
         if (sdn_ft == NULL) {
                 rte_exit(EXIT_FAILURE, "Unable to create flow table\n");
         }
-        mz_ftp = rte_memzone_reserve(MZ_FTP_INFO, sizeof(struct onvm_ft *), rte_socket_id(), NO_FLAGS);
+        sdn_ft6 = onvm_ft_create_ipv6(SDN_FT6_ENTRIES, sizeof(struct onvm_flow_entry));
+        if (sdn_ft6 == NULL) {
+                rte_exit(EXIT_FAILURE, "Unable to create IPv6 flow table\n");
+        }
+        /* Pointers to the IPv4 and IPv6 tables */
+        mz_ftp = rte_memzone_reserve(MZ_FTP_INFO, 2 * sizeof(struct onvm_ft *), rte_socket_id(), NO_FLAGS);
         if (mz_ftp == NULL) {
                 rte_exit(EXIT_FAILURE, "Canot reserve memory zone for flow table pointer\n");
         }
-        memset(mz_ftp->addr, 0, sizeof(struct onvm_ft *));
+        memset(mz_ftp->addr, 0, 2 * sizeof(struct onvm_ft *));
         sdn_ft_p = mz_ftp->addr;
-        *sdn_ft_p = sdn_ft;
+        sdn_ft_p[0] = sdn_ft;
+        sdn_ft_p[1] = sdn_ft6;
 
         return 0;
 }
@@ -83,7 +118,8 @@ onvm_flow_dir_nf_init(void) {
         if (mz_ftp == NULL)
                 rte_exit(EXIT_FAILURE, "Cannot get table pointer\n");
         ftp = mz_ftp->addr;
-        sdn_ft = *ftp;
+        sdn_ft = ftp[0];
+        sdn_ft6 = ftp[1];
 
         return 0;
 }
@@ -91,7 +127,7 @@ onvm_flow_dir_nf_init(void) {
 int
 onvm_flow_dir_get_pkt(struct rte_mbuf *pkt, struct onvm_flow_entry **flow_entry) {
         int ret;
-        ret = onvm_ft_lookup_pkt(sdn_ft, pkt, (char **)flow_entry);
+        ret = onvm_ft_lookup_pkt(onvm_flow_dir_table(pkt), pkt, (char **)flow_entry);
 
         return ret;
 }
@@ -99,7 +135,7 @@ onvm_flow_dir_get_pkt(struct rte_mbuf *pkt, struct onvm_flow_entry **flow_entry)
 int
 onvm_flow_dir_add_pkt(struct rte_mbuf *pkt, struct onvm_flow_entry **flow_entry) {
         int ret;
-        ret = onvm_ft_add_pkt(sdn_ft, pkt, (char **)flow_entry);
+        ret = onvm_ft_add_pkt(onvm_flow_dir_table(pkt), pkt, (char **)flow_entry);
 
         return ret;
 }
@@ -130,7 +166,8 @@ onvm_flow_dir_del_and_free_pkt(struct rte_mbuf *pkt) {
         if (ret >= 0) {
                 rte_free(flow_entry->sc);
                 rte_free(flow_entry->key);
-                ret = onvm_ft_remove_pkt(sdn_ft, pkt);
+                rte_free(flow_entry->key6);
+                ret = onvm_ft_remove_pkt(onvm_flow_dir_table(pkt), pkt);
         }
 
         return ret;
@@ -183,3 +220,160 @@ onvm_flow_dir_del_and_free_key(struct onvm_ft_ipv4_5tuple *key) {
 
         return ret;
 }
+
+int
+onvm_flow_dir_get_key_ipv6(struct onvm_ft_ipv6_5tuple *key, struct onvm_flow_entry **flow_entry) {
+        int ret;
+        ret = onvm_ft_lookup_key_ipv6(sdn_ft6, key, (char **)flow_entry);
+
+        return ret;
+}
+
+int
+onvm_flow_dir_add_key_ipv6(struct onvm_ft_ipv6_5tuple *key, struct onvm_flow_entry **flow_entry) {
+        int ret;
+        ret = onvm_ft_add_key_ipv6(sdn_ft6, key, (char **)flow_entry);
+
+        return ret;
+}
+
+int
+onvm_flow_dir_del_key_ipv6(struct onvm_ft_ipv6_5tuple *key) {
+        int ret;
+        struct onvm_flow_entry *flow_entry;
+        int ref_cnt;
+
+        ret = onvm_flow_dir_get_key_ipv6(key, &flow_entry);
+        if (ret >= 0) {
+                ref_cnt = flow_entry->sc->ref_cnt--;
+                if (ref_cnt <= 0) {
+                        ret = onvm_flow_dir_del_and_free_key_ipv6(key);
+                }
+        }
+
+        return ret;
+}
+
+int
+onvm_flow_dir_del_and_free_key_ipv6(struct onvm_ft_ipv6_5tuple *key) {
+        int ret;
+        struct onvm_flow_entry *flow_entry;
+
+        ret = onvm_flow_dir_get_key_ipv6(key, &flow_entry);
+        if (ret >= 0) {
+                rte_free(flow_entry->sc);
+                rte_free(flow_entry->key6);
+                ret = onvm_ft_remove_key_ipv6(sdn_ft6, key);
+        }
+
+        return ret;
+}
+
+int
+onvm_flow_dir_snapshot(const char *path) {
+        char path6[PATH_MAX];
+        int ret, ret6;
+
+        ret = onvm_ft_snapshot_ext(sdn_ft, path, sizeof(struct onvm_flow_dir_snapshot_entry),
+                                   onvm_flow_dir_export_entry, NULL);
+        if (ret < 0)
+                return ret;
+
+        if (snprintf(path6, sizeof(path6), "%s" SDN_FT6_SNAPSHOT_SUFFIX, path) >= (int)sizeof(path6))
+                return -ENAMETOOLONG;
+        ret6 = onvm_ft_snapshot_ext(sdn_ft6, path6, sizeof(struct onvm_flow_dir_snapshot_entry),
+                                    onvm_flow_dir_export_entry, NULL);
+        if (ret6 < 0)
+                return ret6;
+
+        return ret + ret6;
+}
+
+int
+onvm_flow_dir_restore(const char *path) {
+        char path6[PATH_MAX];
+        int ret, ret6;
+
+        ret = onvm_ft_restore_ext(sdn_ft, path, sizeof(struct onvm_flow_dir_snapshot_entry),
+                                  onvm_flow_dir_import_entry, sdn_ft);
+        if (ret < 0)
+                return ret;
+
+        /* Snapshots taken before IPv6 support have no IPv6 file */
+        if (snprintf(path6, sizeof(path6), "%s" SDN_FT6_SNAPSHOT_SUFFIX, path) >= (int)sizeof(path6))
+                return -ENAMETOOLONG;
+        ret6 = onvm_ft_restore_ext(sdn_ft6, path6, sizeof(struct onvm_flow_dir_snapshot_entry),
+                                   onvm_flow_dir_import_entry, sdn_ft6);
+        if (ret6 == -ENOENT)
+                ret6 = 0;
+        if (ret6 < 0)
+                return ret6;
+
+        return ret + ret6;
+}
+
+static inline struct onvm_ft *
+onvm_flow_dir_table(struct rte_mbuf *pkt) {
+        return onvm_pkt_is_ipv6(pkt) ? sdn_ft6 : sdn_ft;
+}
+
+static int
+onvm_flow_dir_export_entry(void *dst, __attribute__((unused)) const void *key, const char *entry,
+                           __attribute__((unused)) void *arg) {
+        const struct onvm_flow_entry *flow_entry = (const struct onvm_flow_entry *)entry;
+        struct onvm_flow_dir_snapshot_entry *snap = dst;
+
+        memset(snap, 0, sizeof(*snap));
+        if (flow_entry->sc != NULL) {
+                snap->sc = *flow_entry->sc;
+                snap->has_sc = 1;
+        }
+        snap->prio = flow_entry->prio;
+        snap->idle_timeout = flow_entry->idle_timeout;
+        snap->hard_timeout = flow_entry->hard_timeout;
+        snap->ref_cnt = flow_entry->ref_cnt;
+        snap->packet_count = flow_entry->packet_count;
+        snap->byte_count = flow_entry->byte_count;
+
+        return 0;
+}
+
+static int
+onvm_flow_dir_import_entry(char *entry, const void *key, const void *src, void *arg) {
+        struct onvm_flow_entry *flow_entry = (struct onvm_flow_entry *)entry;
+        const struct onvm_flow_dir_snapshot_entry *snap = src;
+        struct onvm_ft *table = arg;
+
+        memset(flow_entry, 0, sizeof(*flow_entry));
+        if (table->key_type == ONVM_FT_KEY_IPV6) {
+                flow_entry->key6 = rte_calloc("flow_key", 1, sizeof(struct onvm_ft_ipv6_5tuple), 0);
+                if (flow_entry->key6 == NULL)
+                        return -ENOMEM;
+                rte_memcpy(flow_entry->key6, key, sizeof(struct onvm_ft_ipv6_5tuple));
+        } else {
+                flow_entry->key = rte_calloc("flow_key", 1, sizeof(struct onvm_ft_ipv4_5tuple), 0);
+                if (flow_entry->key == NULL)
+                        return -ENOMEM;
+                rte_memcpy(flow_entry->key, key, sizeof(struct onvm_ft_ipv4_5tuple));
+        }
+
+        if (snap->has_sc) {
+                flow_entry->sc = rte_calloc("ONVM_sercice_chain", 1, sizeof(struct onvm_service_chain), 0);
+                if (flow_entry->sc == NULL) {
+                        rte_free(flow_entry->key);
+                        rte_free(flow_entry->key6);
+                        flow_entry->key = NULL;
+                        flow_entry->key6 = NULL;
+                        return -ENOMEM;
+                }
+                *flow_entry->sc = snap->sc;
+        }
+        flow_entry->prio = snap->prio;
+        flow_entry->idle_timeout = snap->idle_timeout;
+        flow_entry->hard_timeout = snap->hard_timeout;
+        flow_entry->ref_cnt = snap->ref_cnt;
+        flow_entry->packet_count = snap->packet_count;
+        flow_entry->byte_count = snap->byte_count;
+
+        return 0;
+}
@@ -45,6 +45,7 @@
 #include "onvm_flow_table.h"
 
 extern struct onvm_ft* sdn_ft;
+extern struct onvm_ft* sdn_ft6;
 extern struct onvm_ft** sdn_ft_p;
 
 struct onvm_flow_entry {
@@ -53,8 +54,12 @@ struct onvm_flow_entry {
         uint64_t ref_cnt;
         uint16_t idle_timeout;
         uint16_t hard_timeout;
+        /* RX priority class given to the flow's packets, 0 for bulk traffic */
+        uint8_t prio;
         uint64_t packet_count;
         uint64_t byte_count;
+        /* set instead of key for flows in the IPv6 table */
+        struct onvm_ft_ipv6_5tuple* key6;
 };
 
 /* Get a pointer to the flow entry entry for this packet.
@@ -85,4 +90,22 @@ int
 onvm_flow_dir_del_key(struct onvm_ft_ipv4_5tuple* key);
 int
 onvm_flow_dir_del_and_free_key(struct onvm_ft_ipv4_5tuple* key);
+/* IPv6 flows are kept in sdn_ft6, the _pkt functions pick the table from the packet */
+int
+onvm_flow_dir_get_key_ipv6(struct onvm_ft_ipv6_5tuple* key, struct onvm_flow_entry** flow_entry);
+int
+onvm_flow_dir_add_key_ipv6(struct onvm_ft_ipv6_5tuple* key, struct onvm_flow_entry** flow_entry);
+int
+onvm_flow_dir_del_key_ipv6(struct onvm_ft_ipv6_5tuple* key);
+int
+onvm_flow_dir_del_and_free_key_ipv6(struct onvm_ft_ipv6_5tuple* key);
+/* Save the flow director to a snapshot file, service chains included. IPv6
+ * flows go to the same path with an ".ipv6" suffix.
+ * Returns the number of flows written or a negative errno */
+int
+onvm_flow_dir_snapshot(const char* path);
+/* Bulk load a snapshot written by onvm_flow_dir_snapshot into sdn_ft.
+ * Returns the number of flows restored or a negative errno */
+int
+onvm_flow_dir_restore(const char* path);
 #endif  // _ONVM_FLOW_DIR_H_
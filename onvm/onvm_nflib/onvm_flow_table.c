@@ -38,11 +38,20 @@
  * onvm_flow_table.c - a generic flow table
  ********************************************************************/
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <rte_cycles.h>
 #include <rte_ether.h>
 #include <rte_hash.h>
 #include <rte_lcore.h>
 #include <rte_malloc.h>
+#include <rte_prefetch.h>
 
 #include "onvm_flow_table.h"
 #include "onvm_nflib.h"
@@ -53,34 +62,64 @@ uint8_t rss_symmetric_key[40] = {
     0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
 };
 
+/* Key buffer big enough for either kind of table key */
+union onvm_ft_key {
+        struct onvm_ft_ipv4_5tuple v4;
+        struct onvm_ft_ipv6_5tuple v6;
+};
+
+static struct onvm_ft *
+onvm_ft_create_type(int cnt, int entry_size, uint8_t key_type);
+
+static inline int
+onvm_ft_fill_table_key(struct onvm_ft *table, union onvm_ft_key *key, struct rte_mbuf *pkt);
+
+static inline int32_t
+onvm_ft_add_hash(struct onvm_ft *table, const void *key, uint32_t sig);
+
+static inline int32_t
+onvm_ft_del_hash(struct onvm_ft *table, const void *key, uint32_t sig);
+
 /* Create a new flow table made of an rte_hash table and a fixed size
- * data array for storing values. Only supports IPv4 5-tuple lookups. */
+ * data array for storing values. Keyed by IPv4 5-tuples, see
+ * onvm_ft_create_ipv6 for IPv6 flows. */
 struct onvm_ft *
 onvm_ft_create(int cnt, int entry_size) {
+        return onvm_ft_create_type(cnt, entry_size, ONVM_FT_KEY_IPV4);
+}
+
+struct onvm_ft *
+onvm_ft_create_ipv6(int cnt, int entry_size) {
+        return onvm_ft_create_type(cnt, entry_size, ONVM_FT_KEY_IPV6);
+}
+
+static struct onvm_ft *
+onvm_ft_create_type(int cnt, int entry_size, uint8_t key_type) {
         struct rte_hash *hash;
-        struct rte_hash_parameters *ipv4_hash_params;
+        struct rte_hash_parameters *hash_params;
         struct onvm_ft *ft;
         int status;
 
-        ipv4_hash_params = (struct rte_hash_parameters *) rte_malloc(NULL, sizeof(struct rte_hash_parameters), 0);
-        if (!ipv4_hash_params) {
+        hash_params = (struct rte_hash_parameters *) rte_malloc(NULL, sizeof(struct rte_hash_parameters), 0);
+        if (!hash_params) {
                 return NULL;
         }
 
         char *name = rte_malloc(NULL, 64, 0);
-        /* create ipv4 hash table. use core number and cycle counter to get a unique name. */
-        ipv4_hash_params->entries = cnt;
-        ipv4_hash_params->key_len = sizeof(struct onvm_ft_ipv4_5tuple);
-        ipv4_hash_params->hash_func = NULL;
-        ipv4_hash_params->hash_func_init_val = 0;
-        ipv4_hash_params->name = name;
-        ipv4_hash_params->socket_id = rte_socket_id();
+        /* create the hash table. use core number and cycle counter to get a unique name. */
+        hash_params->entries = cnt;
+        hash_params->key_len = key_type == ONVM_FT_KEY_IPV6 ? sizeof(struct onvm_ft_ipv6_5tuple)
+                                                            : sizeof(struct onvm_ft_ipv4_5tuple);
+        hash_params->hash_func = NULL;
+        hash_params->hash_func_init_val = 0;
+        hash_params->name = name;
+        hash_params->socket_id = rte_socket_id();
         snprintf(name, 64, "onvm_ft_%d-%" PRIu64, rte_lcore_id(), rte_get_tsc_cycles());
 
         if (rte_eal_process_type() == RTE_PROC_PRIMARY) {
-                hash = rte_hash_create(ipv4_hash_params);
+                hash = rte_hash_create(hash_params);
         } else {
-                status = onvm_nflib_request_ft(ipv4_hash_params);
+                status = onvm_nflib_request_ft(hash_params);
                 if (status < 0) {
                         return NULL;
                 }
@@ -99,6 +138,7 @@ onvm_ft_create(int cnt, int entry_size) {
         ft->hash = hash;
         ft->cnt = cnt;
         ft->entry_size = entry_size;
+        ft->key_type = key_type;
         /* Create data array for storing values */
         ft->data = rte_calloc("entry", cnt, entry_size, 0);
         if (!ft->data) {
@@ -106,28 +146,36 @@ onvm_ft_create(int cnt, int entry_size) {
                 rte_free(ft);
                 return NULL;
         }
+        ft->sig = rte_calloc("sig", cnt, sizeof(uint32_t), 0);
+        if (!ft->sig) {
+                rte_hash_free(hash);
+                rte_free(ft->data);
+                rte_free(ft);
+                return NULL;
+        }
         return ft;
 }
 
 /* Add an entry in flow table and set data to point to the new value.
 Returns:
  index in the array on success
- -EPROTONOSUPPORT if packet is not ipv4.
+ -EPROTONOSUPPORT if packet is not of the table's IP version.
  -EINVAL if the parameters are invalid.
  -ENOSPC if there is no space in the hash for this key.
 */
 int
 onvm_ft_add_pkt(struct onvm_ft *table, struct rte_mbuf *pkt, char **data) {
         int32_t tbl_index;
-        struct onvm_ft_ipv4_5tuple key;
+        union onvm_ft_key key;
         int err;
 
-        err = onvm_ft_fill_key(&key, pkt);
+        err = onvm_ft_fill_table_key(table, &key, pkt);
         if (err < 0) {
                 return err;
         }
-        tbl_index = rte_hash_add_key_with_hash(table->hash, (const void *)&key, pkt->hash.rss);
+        tbl_index = onvm_ft_add_hash(table, (const void *)&key, pkt->hash.rss);
         if (tbl_index >= 0) {
+                table->sig[tbl_index] = pkt->hash.rss;
                 *data = &table->data[tbl_index * table->entry_size];
         }
         return tbl_index;
@@ -142,10 +190,10 @@ onvm_ft_add_pkt(struct onvm_ft *table, struct rte_mbuf *pkt, char **data) {
 int
 onvm_ft_lookup_pkt(struct onvm_ft *table, struct rte_mbuf *pkt, char **data) {
         int32_t tbl_index;
-        struct onvm_ft_ipv4_5tuple key;
+        union onvm_ft_key key;
         int ret;
 
-        ret = onvm_ft_fill_key(&key, pkt);
+        ret = onvm_ft_fill_table_key(table, &key, pkt);
         if (ret < 0) {
                 return ret;
         }
@@ -165,14 +213,14 @@ onvm_ft_lookup_pkt(struct onvm_ft *table, struct rte_mbuf *pkt, char **data) {
 */
 int32_t
 onvm_ft_remove_pkt(struct onvm_ft *table, struct rte_mbuf *pkt) {
-        struct onvm_ft_ipv4_5tuple key;
+        union onvm_ft_key key;
         int ret;
 
-        ret = onvm_ft_fill_key(&key, pkt);
+        ret = onvm_ft_fill_table_key(table, &key, pkt);
         if (ret < 0) {
                 return ret;
         }
-        return rte_hash_del_key_with_hash(table->hash, (const void *)&key, pkt->hash.rss);
+        return onvm_ft_del_hash(table, (const void *)&key, pkt->hash.rss);
 }
 
 int
@@ -182,8 +230,9 @@ onvm_ft_add_key(struct onvm_ft *table, struct onvm_ft_ipv4_5tuple *key, char **d
 
         softrss = onvm_softrss(key);
 
-        tbl_index = rte_hash_add_key_with_hash(table->hash, (const void *)key, softrss);
+        tbl_index = onvm_ft_add_hash(table, (const void *)key, softrss);
         if (tbl_index >= 0) {
+                table->sig[tbl_index] = softrss;
                 *data = onvm_ft_get_data(table, tbl_index);
         }
 
@@ -210,7 +259,46 @@ onvm_ft_remove_key(struct onvm_ft *table, struct onvm_ft_ipv4_5tuple *key) {
         uint32_t softrss;
 
         softrss = onvm_softrss(key);
-        return rte_hash_del_key_with_hash(table->hash, (const void *)key, softrss);
+        return onvm_ft_del_hash(table, (const void *)key, softrss);
+}
+
+int
+onvm_ft_add_key_ipv6(struct onvm_ft *table, struct onvm_ft_ipv6_5tuple *key, char **data) {
+        int32_t tbl_index;
+        uint32_t softrss;
+
+        softrss = onvm_softrss_ipv6(key);
+
+        tbl_index = onvm_ft_add_hash(table, (const void *)key, softrss);
+        if (tbl_index >= 0) {
+                table->sig[tbl_index] = softrss;
+                *data = onvm_ft_get_data(table, tbl_index);
+        }
+
+        return tbl_index;
+}
+
+int
+onvm_ft_lookup_key_ipv6(struct onvm_ft *table, struct onvm_ft_ipv6_5tuple *key, char **data) {
+        int32_t tbl_index;
+        uint32_t softrss;
+
+        softrss = onvm_softrss_ipv6(key);
+
+        tbl_index = rte_hash_lookup_with_hash(table->hash, (const void *)key, softrss);
+        if (tbl_index >= 0) {
+                *data = onvm_ft_get_data(table, tbl_index);
+        }
+
+        return tbl_index;
+}
+
+int32_t
+onvm_ft_remove_key_ipv6(struct onvm_ft *table, struct onvm_ft_ipv6_5tuple *key) {
+        uint32_t softrss;
+
+        softrss = onvm_softrss_ipv6(key);
+        return onvm_ft_del_hash(table, (const void *)key, softrss);
 }
 
 /* Iterate through the hash table, returning key-value pairs.
@@ -240,5 +328,212 @@ onvm_ft_free(struct onvm_ft *table) {
         rte_hash_reset(table->hash);
         rte_hash_free(table->hash);
         rte_free(table->data);
+        rte_free(table->sig);
         rte_free(table);
 }
+
+int
+onvm_ft_snapshot(struct onvm_ft *table, const char *path) {
+        return onvm_ft_snapshot_ext(table, path, table->entry_size, NULL, NULL);
+}
+
+int
+onvm_ft_restore(struct onvm_ft *table, const char *path) {
+        return onvm_ft_restore_ext(table, path, table->entry_size, NULL, NULL);
+}
+
+/* Snapshot the table into an mmap'd file. Records are written first and the
+ * header last, into a temporary file that is renamed over `path`, so a crash
+ * midway never leaves a half written snapshot behind.
+ */
+int
+onvm_ft_snapshot_ext(struct onvm_ft *table, const char *path, uint32_t data_size, onvm_ft_export_fn export_fn,
+                     void *arg) {
+        struct onvm_ft_snapshot_hdr *hdr;
+        struct onvm_ft_snapshot_rec *rec;
+        char *rec_data;
+        const void *key;
+        void *unused;
+        char tmp_path[PATH_MAX];
+        size_t rec_size, map_size;
+        uint32_t key_len, next = 0, count, written = 0;
+        int32_t tbl_index;
+        char *map;
+        int fd, ret = 0;
+
+        if (table == NULL || path == NULL)
+                return -EINVAL;
+
+        count = rte_hash_count(table->hash);
+        key_len = onvm_ft_key_len(table);
+        rec_size = ONVM_FT_SNAPSHOT_REC_SIZE(key_len, data_size);
+        map_size = sizeof(struct onvm_ft_snapshot_hdr) + (size_t)count * rec_size;
+
+        if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path))
+                return -ENAMETOOLONG;
+
+        fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+                return -errno;
+        if (ftruncate(fd, map_size) < 0) {
+                ret = -errno;
+                close(fd);
+                unlink(tmp_path);
+                return ret;
+        }
+        map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+                ret = -errno;
+                close(fd);
+                unlink(tmp_path);
+                return ret;
+        }
+
+        /* Entries added while iterating past the initial count are left for the next snapshot */
+        while (written < count && (tbl_index = rte_hash_iterate(table->hash, &key, &unused, &next)) >= 0) {
+                rec = (struct onvm_ft_snapshot_rec *)(map + sizeof(*hdr) + written * rec_size);
+                rec_data = rec->payload + ONVM_FT_SNAPSHOT_DATA_OFFSET(key_len);
+                rec->sig = table->sig[tbl_index];
+                rte_memcpy(rec->payload, key, key_len);
+                if (export_fn != NULL) {
+                        ret = export_fn(rec_data, rec->payload, onvm_ft_get_data(table, tbl_index), arg);
+                        if (ret < 0)
+                                break;
+                } else {
+                        rte_memcpy(rec_data, onvm_ft_get_data(table, tbl_index), data_size);
+                }
+                written++;
+        }
+
+        if (ret == 0) {
+                hdr = (struct onvm_ft_snapshot_hdr *)map;
+                hdr->version = ONVM_FT_SNAPSHOT_VERSION;
+                hdr->key_len = key_len;
+                hdr->data_size = data_size;
+                hdr->count = written;
+                hdr->magic = ONVM_FT_SNAPSHOT_MAGIC;
+                if (msync(map, map_size, MS_SYNC) < 0)
+                        ret = -errno;
+        }
+
+        munmap(map, map_size);
+        close(fd);
+
+        if (ret == 0 && rename(tmp_path, path) < 0)
+                ret = -errno;
+        if (ret < 0) {
+                unlink(tmp_path);
+                return ret;
+        }
+
+        return written;
+}
+
+/* Restore a snapshot written by onvm_ft_snapshot_ext. The stored signatures
+ * are handed straight to rte_hash_add_key_with_hash, so restoring costs one
+ * bucket insert per flow and no hash computation. Table indexes are not
+ * preserved, the data is copied to whichever slot the key lands in.
+ */
+int
+onvm_ft_restore_ext(struct onvm_ft *table, const char *path, uint32_t data_size, onvm_ft_import_fn import_fn,
+                    void *arg) {
+        const struct onvm_ft_snapshot_hdr *hdr;
+        const struct onvm_ft_snapshot_rec *rec;
+        const char *rec_data;
+        struct stat st;
+        size_t rec_size;
+        uint32_t i, key_len, restored = 0;
+        int32_t tbl_index;
+        char *map;
+        int fd, ret = 0;
+
+        if (table == NULL || path == NULL)
+                return -EINVAL;
+
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return -errno;
+        if (fstat(fd, &st) < 0) {
+                ret = -errno;
+                close(fd);
+                return ret;
+        }
+        if ((size_t)st.st_size < sizeof(*hdr)) {
+                close(fd);
+                return -EINVAL;
+        }
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+                return -errno;
+
+        hdr = (const struct onvm_ft_snapshot_hdr *)map;
+        key_len = onvm_ft_key_len(table);
+        rec_size = ONVM_FT_SNAPSHOT_REC_SIZE(key_len, data_size);
+        if (hdr->magic != ONVM_FT_SNAPSHOT_MAGIC || hdr->version != ONVM_FT_SNAPSHOT_VERSION ||
+            hdr->key_len != key_len || hdr->data_size != data_size ||
+            (size_t)st.st_size < sizeof(*hdr) + (size_t)hdr->count * rec_size) {
+                munmap(map, st.st_size);
+                return -EINVAL;
+        }
+
+        for (i = 0; i < hdr->count; i++) {
+                rec = (const struct onvm_ft_snapshot_rec *)(map + sizeof(*hdr) + i * rec_size);
+                if (i + 1 < hdr->count)
+                        rte_prefetch0((const char *)rec + rec_size);
+
+                rec_data = rec->payload + ONVM_FT_SNAPSHOT_DATA_OFFSET(key_len);
+                tbl_index = onvm_ft_add_hash(table, rec->payload, rec->sig);
+                if (tbl_index < 0) {
+                        ret = tbl_index;
+                        break;
+                }
+                table->sig[tbl_index] = rec->sig;
+                if (import_fn != NULL) {
+                        ret = import_fn(onvm_ft_get_data(table, tbl_index), rec->payload, rec_data, arg);
+                        if (ret < 0) {
+                                onvm_ft_del_hash(table, rec->payload, rec->sig);
+                                break;
+                        }
+                } else {
+                        rte_memcpy(onvm_ft_get_data(table, tbl_index), rec_data, data_size);
+                }
+                restored++;
+        }
+
+        munmap(map, st.st_size);
+
+        return ret < 0 ? ret : (int)restored;
+}
+
+/* Add a key and count it in table->entries unless it was already there */
+static inline int32_t
+onvm_ft_add_hash(struct onvm_ft *table, const void *key, uint32_t sig) {
+        int32_t tbl_index;
+
+        tbl_index = rte_hash_lookup_with_hash(table->hash, key, sig);
+        if (tbl_index >= 0)
+                return tbl_index;
+        tbl_index = rte_hash_add_key_with_hash(table->hash, key, sig);
+        if (tbl_index >= 0)
+                rte_atomic32_inc(&table->entries);
+        return tbl_index;
+}
+
+static inline int32_t
+onvm_ft_del_hash(struct onvm_ft *table, const void *key, uint32_t sig) {
+        int32_t tbl_index;
+
+        tbl_index = rte_hash_del_key_with_hash(table->hash, key, sig);
+        if (tbl_index >= 0)
+                rte_atomic32_dec(&table->entries);
+        return tbl_index;
+}
+
+/* Fill the kind of key the table is indexed by */
+static inline int
+onvm_ft_fill_table_key(struct onvm_ft *table, union onvm_ft_key *key, struct rte_mbuf *pkt) {
+        if (table->key_type == ONVM_FT_KEY_IPV6)
+                return onvm_ft_fill_key_ipv6(&key->v6, pkt);
+        return onvm_ft_fill_key(&key->v4, pkt);
+}
@@ -41,6 +41,7 @@
 #ifndef _ONVM_FLOW_TABLE_H_
 #define _ONVM_FLOW_TABLE_H_
 
+#include <rte_atomic.h>
 #include <rte_common.h>
 #include <rte_ip.h>
 #include <rte_mbuf.h>
@@ -61,11 +62,21 @@ extern uint8_t rss_symmetric_key[40];
 #define DEFAULT_HASH_FUNC rte_jhash
 #endif
 
+/* Kind of key a table is indexed by. IPv4 and IPv6 flows live in separate
+ * tables, the _pkt functions fill whichever key the table was created for. */
+#define ONVM_FT_KEY_IPV4 0
+#define ONVM_FT_KEY_IPV6 1
+
 struct onvm_ft {
         struct rte_hash *hash;
         char *data;
+        /* hash signature each slot was inserted with, kept so a snapshot can be restored without rehashing */
+        uint32_t *sig;
         int cnt;
         int entry_size;
+        uint8_t key_type;
+        /* keys in the hash, kept by the add and remove calls so readers need not count the hash */
+        rte_atomic32_t entries;
 };
 
 struct onvm_ft_ipv4_5tuple {
@@ -76,6 +87,17 @@ struct onvm_ft_ipv4_5tuple {
         uint8_t proto;
 };
 
+/* 40 byte IPv6 key: addresses and ports in network order, padded to five
+ * aligned 8 byte words. The table compares whole keys, so pad must be zero. */
+struct onvm_ft_ipv6_5tuple {
+        uint8_t src_addr[16];
+        uint8_t dst_addr[16];
+        uint16_t src_port;
+        uint16_t dst_port;
+        uint8_t proto;
+        uint8_t pad[3];
+} __rte_aligned(8);
+
 /* from l2_forward example, but modified to include port. This should
  * be automatically included in the hash functions since it hashes
  * the struct in 4byte chunks. */
@@ -95,6 +117,10 @@ union ipv4_5tuple_host {
 struct onvm_ft *
 onvm_ft_create(int cnt, int entry_size);
 
+/* Create a table keyed by IPv6 5-tuples */
+struct onvm_ft *
+onvm_ft_create_ipv6(int cnt, int entry_size);
+
 int
 onvm_ft_add_pkt(struct onvm_ft *table, struct rte_mbuf *pkt, char **data);
 
@@ -113,12 +139,82 @@ onvm_ft_lookup_key(struct onvm_ft *table, struct onvm_ft_ipv4_5tuple *key, char
 int32_t
 onvm_ft_remove_key(struct onvm_ft *table, struct onvm_ft_ipv4_5tuple *key);
 
+int
+onvm_ft_add_key_ipv6(struct onvm_ft *table, struct onvm_ft_ipv6_5tuple *key, char **data);
+
+int
+onvm_ft_lookup_key_ipv6(struct onvm_ft *table, struct onvm_ft_ipv6_5tuple *key, char **data);
+
+int32_t
+onvm_ft_remove_key_ipv6(struct onvm_ft *table, struct onvm_ft_ipv6_5tuple *key);
+
 int32_t
 onvm_ft_iterate(struct onvm_ft *table, const void **key, void **data, uint32_t *next);
 
 void
 onvm_ft_free(struct onvm_ft *table);
 
+/* Snapshot file layout: one header followed by `count` fixed size records.
+ * Each record holds the stored hash signature, the key padded to 8 bytes
+ * and `data_size` bytes of per-flow data, padded to 8 bytes. Version 2
+ * added IPv6 keys, older snapshots are refused. */
+#define ONVM_FT_SNAPSHOT_MAGIC 0x4f4e5654 /* "ONVT" */
+#define ONVM_FT_SNAPSHOT_VERSION 2
+
+struct onvm_ft_snapshot_hdr {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t key_len;
+        uint32_t data_size;
+        uint32_t count;
+};
+
+struct onvm_ft_snapshot_rec {
+        uint32_t sig;
+        uint32_t reserved;
+        char payload[];
+};
+
+#define ONVM_FT_SNAPSHOT_DATA_OFFSET(key_len) RTE_ALIGN_CEIL((key_len), 8)
+#define ONVM_FT_SNAPSHOT_REC_SIZE(key_len, data_size) \
+        RTE_ALIGN_CEIL(sizeof(struct onvm_ft_snapshot_rec) + ONVM_FT_SNAPSHOT_DATA_OFFSET(key_len) + (data_size), 8)
+
+/* Callbacks used to (de)serialize table entries that hold pointers. The key
+ * is an onvm_ft_ipv4_5tuple or onvm_ft_ipv6_5tuple depending on the table.
+ * They return 0 on success, or a negative errno to abort. */
+typedef int (*onvm_ft_export_fn)(void *dst, const void *key, const char *entry, void *arg);
+typedef int (*onvm_ft_import_fn)(char *entry, const void *key, const void *src, void *arg);
+
+/* Write every entry of the table to an mmap'd snapshot file. The file is
+ * written next to `path` and renamed into place once complete.
+ * Returns:
+ *  the number of entries written on success
+ *  a negative errno on failure
+ */
+int
+onvm_ft_snapshot(struct onvm_ft *table, const char *path);
+
+/* Bulk insert every entry of a snapshot file into the table, reusing the
+ * stored signatures so no key is rehashed.
+ * Returns:
+ *  the number of entries restored on success
+ *  -ENOENT if the file does not exist
+ *  -EINVAL if the file does not match the table layout
+ *  -ENOSPC if the table filled up during the restore
+ */
+int
+onvm_ft_restore(struct onvm_ft *table, const char *path);
+
+/* Same as above, with `data_size` bytes per record produced and consumed by
+ * the given callbacks instead of a raw copy of the table entry. */
+int
+onvm_ft_snapshot_ext(struct onvm_ft *table, const char *path, uint32_t data_size, onvm_ft_export_fn export_fn,
+                     void *arg);
+
+int
+onvm_ft_restore_ext(struct onvm_ft *table, const char *path, uint32_t data_size, onvm_ft_import_fn import_fn,
+                    void *arg);
+
 /* TODO(@sdnfv): Add function to calculate hash and then make lookup/get
  * have versions with precomputed hash values */
 // hash_sig_t
@@ -138,6 +234,18 @@ onvm_ft_get_data(struct onvm_ft *table, int32_t index) {
         return &table->data[index * table->entry_size];
 }
 
+/* Cheap emptiness check for the datapath, an add racing the same key may leave it non-empty */
+static inline int
+onvm_ft_is_empty(struct onvm_ft *table) {
+        return rte_atomic32_read(&table->entries) <= 0;
+}
+
+static inline uint32_t
+onvm_ft_key_len(struct onvm_ft *table) {
+        return table->key_type == ONVM_FT_KEY_IPV6 ? sizeof(struct onvm_ft_ipv6_5tuple)
+                                                   : sizeof(struct onvm_ft_ipv4_5tuple);
+}
+
 static inline int
 onvm_ft_fill_key(struct onvm_ft_ipv4_5tuple *key, struct rte_mbuf *pkt) {
         struct rte_ipv4_hdr *ipv4_hdr;
@@ -188,6 +296,56 @@ onvm_ft_fill_key_symmetric(struct onvm_ft_ipv4_5tuple *key, struct rte_mbuf *pkt
         return 0;
 }
 
+static inline int
+onvm_ft_fill_key_ipv6(struct onvm_ft_ipv6_5tuple *key, struct rte_mbuf *pkt) {
+        struct rte_ipv6_hdr *ipv6_hdr;
+        struct rte_tcp_hdr *tcp_hdr;
+        struct rte_udp_hdr *udp_hdr;
+
+        ipv6_hdr = onvm_pkt_ipv6_hdr(pkt);
+        if (unlikely(ipv6_hdr == NULL)) {
+                return -EPROTONOSUPPORT;
+        }
+        memset(key, 0, sizeof(struct onvm_ft_ipv6_5tuple));
+        key->proto = ipv6_hdr->proto;
+        rte_memcpy(key->src_addr, ipv6_hdr->src_addr, sizeof(key->src_addr));
+        rte_memcpy(key->dst_addr, ipv6_hdr->dst_addr, sizeof(key->dst_addr));
+        /* Extension headers are not walked, such flows are keyed on addresses only */
+        if (key->proto == IP_PROTOCOL_TCP) {
+                tcp_hdr = (struct rte_tcp_hdr *)(ipv6_hdr + 1);
+                key->src_port = tcp_hdr->src_port;
+                key->dst_port = tcp_hdr->dst_port;
+        } else if (key->proto == IP_PROTOCOL_UDP) {
+                udp_hdr = (struct rte_udp_hdr *)(ipv6_hdr + 1);
+                key->src_port = udp_hdr->src_port;
+                key->dst_port = udp_hdr->dst_port;
+        }
+        return 0;
+}
+
+static inline int
+onvm_ft_fill_key_ipv6_symmetric(struct onvm_ft_ipv6_5tuple *key, struct rte_mbuf *pkt) {
+        uint8_t temp[16];
+
+        if (onvm_ft_fill_key_ipv6(key, pkt) < 0) {
+                return -EPROTONOSUPPORT;
+        }
+
+        if (memcmp(key->dst_addr, key->src_addr, sizeof(key->src_addr)) > 0) {
+                rte_memcpy(temp, key->dst_addr, sizeof(temp));
+                rte_memcpy(key->dst_addr, key->src_addr, sizeof(temp));
+                rte_memcpy(key->src_addr, temp, sizeof(temp));
+        }
+
+        if (key->dst_port > key->src_port) {
+                uint16_t temp_port = key->dst_port;
+                key->dst_port = key->src_port;
+                key->src_port = temp_port;
+        }
+
+        return 0;
+}
+
 /* Hash a flow key to get an int. From L3 fwd example */
 static inline uint32_t
 onvm_ft_ipv4_hash_crc(const void *data, __rte_unused uint32_t data_len, uint32_t init_val) {
@@ -234,4 +392,27 @@ onvm_softrss(struct onvm_ft_ipv4_5tuple *key) {
         return rss_l3l4;
 }
 
+/*software caculate RSS for an IPv6 key, matches what the NIC computes for IPv6 TCP/UDP*/
+static inline uint32_t
+onvm_softrss_ipv6(struct onvm_ft_ipv6_5tuple *key) {
+        union rte_thash_tuple tuple;
+        uint8_t rss_key_be[RTE_DIM(rss_symmetric_key)];
+        uint32_t word;
+        int i;
+
+        rte_convert_rss_key((uint32_t *)rss_symmetric_key, (uint32_t *)rss_key_be, RTE_DIM(rss_symmetric_key));
+
+        /* rte_softrss_be expects the tuple in host order, one 32 bit word at a time */
+        for (i = 0; i < 4; i++) {
+                rte_memcpy(&word, &key->src_addr[i * 4], sizeof(word));
+                ((uint32_t *)tuple.v6.src_addr)[i] = rte_be_to_cpu_32(word);
+                rte_memcpy(&word, &key->dst_addr[i * 4], sizeof(word));
+                ((uint32_t *)tuple.v6.dst_addr)[i] = rte_be_to_cpu_32(word);
+        }
+        tuple.v6.sport = rte_be_to_cpu_16(key->src_port);
+        tuple.v6.dport = rte_be_to_cpu_16(key->dst_port);
+
+        return rte_softrss_be((uint32_t *)&tuple, RTE_THASH_V6_L4_LEN, rss_key_be);
+}
+
 #endif  // _ONVM_FLOW_TABLE_H_
@@ -52,6 +52,7 @@
 
 #include <getopt.h>
 #include <signal.h>
+#include <unistd.h>
 
 /******************************DPDK libraries*********************************/
 #include "rte_malloc.h"
@@ -85,6 +86,9 @@ static struct rte_ring *mgr_msg_queue;
 // Shared data from server. We update statistics here
 struct onvm_nf *nfs;
 
+// Shared pool the read-only copies for mirror actions come from
+struct rte_mempool *mirror_pool;
+
 // Shared data from manager, has information used for nf_side tx
 uint16_t **services;
 uint16_t *nf_per_service_count;
@@ -101,9 +105,50 @@ static struct onvm_nf_local_ctx *main_nf_local_ctx;
 // Global NF specific signal handler
 static handle_signal_func global_nf_signal_handler = NULL;
 
+// Worker threads declared by the NF, and the -w value that overrides them
+static uint16_t nf_workers = 1;
+static uint16_t nf_workers_arg = 0;
+
+/*
+ * Worker threads onvm_nflib_run starts next to the main NF thread. Each
+ * worker is an instance of the main NF's service, so the manager spreads
+ * flows over their RX rings by RSS hash.
+ */
+struct onvm_nf_worker {
+        pthread_t thread;
+        struct onvm_nf_local_ctx *nf_local_ctx;
+        struct onvm_nf_init_cfg *nf_init_cfg;
+        struct onvm_nf_function_table *function_table;
+        int started;
+        /* set by the worker once onvm_nflib_start_nf returned, started tells how */
+        rte_atomic16_t start_done;
+};
+
+static struct {
+        uint16_t count;
+        uint16_t parent;
+        struct onvm_nf_worker workers[MAX_NFS_PER_SERVICE - 1];
+        /* counters of stopped workers, added to the main NF's summary */
+        struct {
+                uint64_t rx;
+                uint64_t rx_drop;
+                uint64_t tx;
+                uint64_t tx_drop;
+                uint64_t act_out;
+                uint64_t act_tonf;
+                uint64_t act_drop;
+                uint64_t act_next;
+                uint64_t tx_buffer;
+                uint64_t tx_returned;
+        } stats;
+} worker_pool;
+
 // Shared data for default service chain
 struct onvm_service_chain *default_chain;
 
+// Shared data for chains configured on the manager
+struct onvm_chain_table *chain_table;
+
 /* Shared data for onvm config */
 struct onvm_configuration *onvm_config;
 
@@ -177,12 +222,38 @@ onvm_nflib_cleanup(struct onvm_nf_local_ctx *nf_local_ctx);
 static void *
 onvm_nflib_start_child(void *arg);
 
+/*
+ * Start the worker threads of the main NF
+ *
+ * Input: pointer to context struct of the main NF, number of threads in total
+ */
+static void
+onvm_nflib_start_workers(struct onvm_nf_local_ctx *nf_local_ctx, uint16_t count);
+
+/*
+ * Stop and join the worker threads, then release their NFs
+ */
+static void
+onvm_nflib_stop_workers(void);
+
+/*
+ * Entry point of a worker thread
+ */
+static void *
+onvm_nflib_worker_main(void *arg);
+
 /*
  * Check if the NF info struct is valid
  */
 static int
 onvm_nflib_is_scale_info_valid(struct onvm_nf_scale_info *scale_info);
 
+/*
+ * Send the manager a migrate_request for this NF and core, as msg_type
+ */
+static int
+onvm_nflib_send_migrate_msg(struct onvm_nf *nf, uint16_t core, uint8_t msg_type);
+
 /*
  * Initialize dpdk as a secondary proc
  *
@@ -280,7 +351,7 @@ onvm_nflib_request_lpm(struct lpm_request *lpm_req) {
 
         lpm_req->status = NF_WAITING_FOR_LPM;
         for (; lpm_req->status == (uint16_t) NF_WAITING_FOR_LPM;) {
-                sleep(1);
+                usleep(ONVM_MSG_POLL_US);
         }
 
         rte_mempool_put(nf_msg_pool, request_message);
@@ -317,13 +388,90 @@ onvm_nflib_request_ft(struct rte_hash_parameters *ipv4_hash_params) {
 
         ft_req->status = NF_WAITING_FOR_FT;
         for (; ft_req->status == (uint16_t) NF_WAITING_FOR_FT;) {
-                sleep(1);
+                usleep(ONVM_MSG_POLL_US);
         }
 
         rte_mempool_put(nf_msg_pool, request_message);
         return ft_req->status;
 }
 
+int
+onvm_nflib_request_migrate(struct onvm_nf *nf, uint16_t core) {
+        if (nf == NULL)
+                return -1;
+
+        return onvm_nflib_send_migrate_msg(nf, core, MSG_REQUEST_MIGRATE);
+}
+
+static int
+onvm_nflib_send_migrate_msg(struct onvm_nf *nf, uint16_t core, uint8_t msg_type) {
+        struct onvm_nf_msg *request_message;
+        struct migrate_request *migrate_req;
+        int ret;
+
+        migrate_req = (struct migrate_request *) rte_malloc(NULL, sizeof(struct migrate_request), 0);
+        if (!migrate_req)
+                return -1;
+
+        ret = rte_mempool_get(nf_msg_pool, (void **) (&request_message));
+        if (ret != 0) {
+                rte_free(migrate_req);
+                return ret;
+        }
+
+        migrate_req->instance_id = nf->instance_id;
+        migrate_req->core = core;
+
+        /* The manager frees both once it handled the request */
+        request_message->msg_type = msg_type;
+        request_message->msg_data = migrate_req;
+
+        ret = rte_ring_enqueue(mgr_msg_queue, request_message);
+        if (ret < 0) {
+                rte_mempool_put(nf_msg_pool, request_message);
+                rte_free(migrate_req);
+                return ret;
+        }
+
+        return 0;
+}
+
+int
+onvm_nflib_migrate(struct onvm_nf_local_ctx *nf_local_ctx, uint16_t core) {
+        struct onvm_nf *nf;
+        uint64_t start, stall_us;
+        int i, ret;
+
+        nf = nf_local_ctx->nf;
+
+        /* Called between bursts, so from here on no packet is dequeued and the rx rings hold new traffic */
+        start = rte_get_tsc_cycles();
+
+        /* Drain: hand everything still buffered to the tx thread or the destination NFs */
+        onvm_pkt_enqueue_tx_thread(nf->nf_tx_mgr->to_tx_buf, nf);
+        for (i = 0; i < NF_MIGRATE_DRAIN_ITERS && onvm_pkt_nf_bufs_count(nf->nf_tx_mgr) > 0; i++) {
+                onvm_pkt_flush_all_nfs(nf->nf_tx_mgr, nf);
+                rte_pause();
+        }
+
+        /* Quiescent point, nothing of this NF is in flight */
+        ret = onvm_threading_core_affinitize(core);
+        if (ret < 0) {
+                RTE_LOG(WARNING, APP, "Could not move NF %u to core %u\n", nf->instance_id, core);
+                return ret;
+        }
+        nf->thread_info.core = core;
+
+        stall_us = (rte_get_tsc_cycles() - start) * US_PER_S / rte_get_timer_hz();
+        nf->stats.migrations++;
+        nf->stats.migrate_stall_us = stall_us;
+        if (stall_us > nf->stats.migrate_stall_max_us)
+                nf->stats.migrate_stall_max_us = stall_us;
+        RTE_LOG(INFO, APP, "NF %u now on core %u, stalled %" PRIu64 " us\n", nf->instance_id, core, stall_us);
+
+        return 0;
+}
+
 int
 onvm_nflib_start_signal_handler(struct onvm_nf_local_ctx *nf_local_ctx, handle_signal_func nf_signal_handler) {
         /* Signal handling is global thus save global context */
@@ -449,7 +597,7 @@ onvm_nflib_start_nf(struct onvm_nf_local_ctx *nf_local_ctx, struct onvm_nf_init_
         /* Wait for a NF id to be assigned by the manager */
         RTE_LOG(INFO, APP, "Waiting for manager to assign an ID...\n");
         for (; nf_init_cfg->status == (uint16_t)NF_WAITING_FOR_ID;) {
-                sleep(1);
+                usleep(ONVM_MSG_POLL_US);
                 if (!rte_atomic16_read(&nf_local_ctx->keep_running)) {
                         /* Wait because we sent a message to the onvm_mgr */
                         for (i = 0; i < NF_TERM_INIT_ITER_TIMES && nf_init_cfg->status != NF_STARTING; i++) {
@@ -526,6 +674,9 @@ onvm_nflib_start_nf(struct onvm_nf_local_ctx *nf_local_ctx, struct onvm_nf_init_
         /* In case this instance_id is reused, clear all function pointers */
         nf->function_table = NULL;
 
+        /* Strict priority between RX classes until the NF asks for weights */
+        memset(nf->rx_prio_weight, 0, sizeof(nf->rx_prio_weight));
+
         if (ONVM_NF_SHARE_CORES) {
                 RTE_LOG(INFO, APP, "Shared CPU support enabled\n");
                 init_shared_core_mode_info(nf->instance_id);
@@ -555,8 +706,14 @@ onvm_nflib_start_nf(struct onvm_nf_local_ctx *nf_local_ctx, struct onvm_nf_init_
 
 int
 onvm_nflib_run(struct onvm_nf_local_ctx *nf_local_ctx) {
+        uint16_t workers;
         int ret;
 
+        /* Only the main NF has a pool, workers and scaled children run alone */
+        workers = nf_workers_arg != 0 ? nf_workers_arg : nf_workers;
+        if (workers > 1 && nf_local_ctx == main_nf_local_ctx && worker_pool.count == 0)
+                onvm_nflib_start_workers(nf_local_ctx, workers);
+
         pthread_t main_loop_thread;
         if ((ret = pthread_create(&main_loop_thread, NULL, onvm_nflib_thread_main_loop, (void *)nf_local_ctx)) < 0) {
                 rte_exit(EXIT_FAILURE, "Failed to spawn main loop thread, error %d", ret);
@@ -565,6 +722,19 @@ onvm_nflib_run(struct onvm_nf_local_ctx *nf_local_ctx) {
                 rte_exit(EXIT_FAILURE, "Failed to join with main loop thread, error %d", ret);
         }
 
+        /* The pool stops with the main NF, whatever stopped it */
+        if (nf_local_ctx == main_nf_local_ctx)
+                onvm_nflib_stop_workers();
+
+        return 0;
+}
+
+int
+onvm_nflib_set_workers(uint16_t count) {
+        if (count == 0 || count > MAX_NFS_PER_SERVICE)
+                return -1;
+
+        nf_workers = count;
         return 0;
 }
 
@@ -594,7 +764,8 @@ onvm_nflib_thread_main_loop(void *arg) {
         for (;rte_atomic16_read(&nf_local_ctx->keep_running) && rte_atomic16_read(&main_nf_local_ctx->keep_running);) {
                 /* Possibly sleep if in shared core mode, otherwise continue */
                 if (ONVM_NF_SHARE_CORES) {
-                        if (unlikely(rte_ring_count(nf->rx_q) == 0) && likely(rte_ring_count(nf->msg_q) == 0)) {
+                        if (unlikely(onvm_nf_rx_count(nf) == 0) && likely(rte_ring_count(nf->msg_q) == 0) &&
+                            likely(onvm_nf_ctrl_count(&nf->ctrl_q) == 0)) {
                                 rte_atomic16_set(nf->shared_core.sleep_state, 1);
                                 sem_wait(nf->shared_core.nf_mutex);
                         }
@@ -642,6 +813,10 @@ onvm_nflib_return_pkt_bulk(struct onvm_nf *nf, struct rte_mbuf **pkts, uint16_t
         unsigned int i;
         if (pkts == NULL || count == 0)
                 return -1;
+        for (i = 0; i < count; i++) {
+                if (unlikely(onvm_nflib_pkt_is_mirror(pkts[i])))
+                        onvm_get_pkt_meta(pkts[i])->action = ONVM_NF_ACTION_DROP;
+        }
         if (unlikely(rte_ring_enqueue_bulk(nf->tx_q, (void **)pkts, count, NULL) == 0)) {
                 nf->stats.tx_drop += count;
                 for (i = 0; i < count; i++) {
@@ -675,7 +850,7 @@ onvm_nflib_nf_ready(struct onvm_nf *nf) {
 
         /* Don't start running before the onvm_mgr handshake is finished */
         while (nf->status != NF_RUNNING) {
-                sleep(1);
+                usleep(ONVM_MSG_POLL_US);
         }
 
         return 0;
@@ -701,8 +876,10 @@ onvm_nflib_handle_msg(struct onvm_nf_msg *msg, struct onvm_nf_local_ctx *nf_loca
                 case MSG_CHANGE_CORE:
                         RTE_LOG(INFO, APP, "Received relocation message...\n");
                         RTE_LOG(INFO, APP, "Moving NF to core %d\n", *(uint16_t *)msg->msg_data);
-                        nf_local_ctx->nf->thread_info.core = *(uint16_t *)msg->msg_data;
-                        onvm_threading_core_affinitize(nf_local_ctx->nf->thread_info.core);
+                        /* The manager already counts the NF on the new core, have it undo that */
+                        if (onvm_nflib_migrate(nf_local_ctx, *(uint16_t *)msg->msg_data) < 0)
+                                onvm_nflib_send_migrate_msg(nf_local_ctx->nf, *(uint16_t *)msg->msg_data,
+                                                            MSG_MIGRATE_FAILED);
                         rte_free(msg->msg_data);
                         break;
                 case MSG_NOOP:
@@ -715,9 +892,17 @@ onvm_nflib_handle_msg(struct onvm_nf_msg *msg, struct onvm_nf_local_ctx *nf_loca
 
 int
 onvm_nflib_send_msg_to_nf(uint16_t dest, void *msg_data) {
+        return onvm_nflib_send_msg_to_instance(onvm_sc_service_to_nf_map(dest, NULL), msg_data);
+}
+
+int
+onvm_nflib_send_msg_to_instance(uint16_t instance_id, void *msg_data) {
         int ret;
         struct onvm_nf_msg *msg;
 
+        if (instance_id >= MAX_NFS)
+                return -EINVAL;
+
         ret = rte_mempool_get(nf_msg_pool, (void**)(&msg));
         if (ret != 0) {
                 RTE_LOG(INFO, APP, "Oh the huge manatee! Unable to allocate msg from pool :(\n");
@@ -727,7 +912,6 @@ onvm_nflib_send_msg_to_nf(uint16_t dest, void *msg_data) {
         msg->msg_type = MSG_FROM_NF;
         msg->msg_data = msg_data;
 
-        uint16_t instance_id = onvm_sc_service_to_nf_map(dest, NULL);
         ret = rte_ring_enqueue(nfs[instance_id].msg_q, (void*)msg);
         if (ret != 0) {
                 RTE_LOG(WARNING, APP, "Destination NF ring is full! Unable to enqueue msg to ring\n");
@@ -761,6 +945,35 @@ onvm_nflib_get_onvm_config(void) {
         return onvm_config;
 }
 
+uint16_t
+onvm_nflib_rx_dequeue_burst(struct onvm_nf *nf, void **pkts, uint16_t max) {
+        uint16_t nb_pkts = 0, quota;
+        int prio;
+
+        /* Highest class first, a class with a weight takes at most that many packets per burst */
+        for (prio = ONVM_NUM_PRIO - 1; prio >= 0 && nb_pkts < max; prio--) {
+                quota = max - nb_pkts;
+                if (nf->rx_prio_weight[prio] != 0)
+                        quota = RTE_MIN(quota, nf->rx_prio_weight[prio]);
+                nb_pkts += rte_ring_dequeue_burst(nf->rx_prio_q[prio], &pkts[nb_pkts], quota, NULL);
+        }
+
+        return nb_pkts;
+}
+
+int
+onvm_nflib_set_rx_prio_weights(struct onvm_nf *nf, const uint16_t *weights) {
+        int prio;
+
+        if (nf == NULL)
+                return -1;
+
+        for (prio = 0; prio < ONVM_NUM_PRIO; prio++)
+                nf->rx_prio_weight[prio] = weights == NULL ? 0 : RTE_MIN(weights[prio], PACKET_READ_SIZE);
+
+        return 0;
+}
+
 int
 onvm_nflib_scale(struct onvm_nf_scale_info *scale_info) {
         int ret;
@@ -891,6 +1104,7 @@ onvm_nflib_lookup_shared_structs(void) {
         const struct rte_memzone *mz_port;
         const struct rte_memzone *mz_cores;
         const struct rte_memzone *mz_scp;
+        const struct rte_memzone *mz_chain_table;
         const struct rte_memzone *mz_services;
         const struct rte_memzone *mz_nf_per_service;
         const struct rte_memzone *mz_onvm_config;
@@ -911,6 +1125,10 @@ onvm_nflib_lookup_shared_structs(void) {
         if (mp == NULL)
                 rte_exit(EXIT_FAILURE, "Cannot get mempool for mbufs\n");
 
+        mirror_pool = rte_mempool_lookup(MIRROR_POOL_NAME);
+        if (mirror_pool == NULL)
+                rte_exit(EXIT_FAILURE, "Cannot get mempool for mirror copies\n");
+
         /* Lookup mempool for NF structs */
         mz_nf = rte_memzone_lookup(MZ_NF_INFO);
         if (mz_nf == NULL)
@@ -952,6 +1170,11 @@ onvm_nflib_lookup_shared_structs(void) {
         default_chain = *scp;
         onvm_sc_print(default_chain);
 
+        mz_chain_table = rte_memzone_lookup(MZ_CHAIN_TABLE);
+        if (mz_chain_table == NULL)
+                rte_exit(EXIT_FAILURE, "Cannot get chain table\n");
+        chain_table = mz_chain_table->addr;
+
         mgr_msg_queue = rte_ring_lookup(_MGR_MSG_QUEUE_NAME);
         if (mgr_msg_queue == NULL)
                 rte_exit(EXIT_FAILURE, "Cannot get mgr message ring");
@@ -970,12 +1193,14 @@ onvm_nflib_dequeue_packets(void **pkts, struct onvm_nf_local_ctx *nf_local_ctx,
         struct onvm_pkt_meta *meta;
         uint16_t i, nb_pkts;
         struct packet_buf tx_buf;
+        nf_pkt_burst_handler_fn burst_handler;
         int ret_act;
 
         nf = nf_local_ctx->nf;
+        burst_handler = nf->function_table->pkt_burst_handler;
 
-        /* Dequeue all packets in ring up to max possible. */
-        nb_pkts = rte_ring_dequeue_burst(nf->rx_q, pkts, PACKET_READ_SIZE, NULL);
+        /* Dequeue all packets in the rings up to max possible. */
+        nb_pkts = onvm_nflib_rx_dequeue_burst(nf, pkts, PACKET_READ_SIZE);
 
         if (unlikely(nb_pkts == 0)) {
                 return 0;
@@ -983,10 +1208,20 @@ onvm_nflib_dequeue_packets(void **pkts, struct onvm_nf_local_ctx *nf_local_ctx,
 
         tx_buf.count = 0;
 
+        /* A burst handler sees the whole burst at once and never buffers */
+        if (burst_handler != NULL)
+                (*burst_handler)((struct rte_mbuf **)pkts, nb_pkts, nf_local_ctx);
+
         /* Give each packet to the user proccessing function */
         for (i = 0; i < nb_pkts; i++) {
                 meta = onvm_get_pkt_meta((struct rte_mbuf *)pkts[i]);
-                ret_act = (*handler)((struct rte_mbuf *)pkts[i], meta, nf_local_ctx);
+                if (burst_handler != NULL)
+                        ret_act = 0;
+                else
+                        ret_act = (*handler)((struct rte_mbuf *)pkts[i], meta, nf_local_ctx);
+                /* A mirror copy ends at the NF it was given to */
+                if (unlikely(onvm_nflib_pkt_is_mirror((struct rte_mbuf *)pkts[i])))
+                        meta->action = ONVM_NF_ACTION_DROP;
                 /* NF returns 0 to return packets or 1 to buffer */
                 if (likely(ret_act == 0)) {
                         tx_buf.buffer[tx_buf.count++] = pkts[i];
@@ -1004,12 +1239,19 @@ onvm_nflib_dequeue_packets(void **pkts, struct onvm_nf_local_ctx *nf_local_ctx,
 
 static inline void
 onvm_nflib_dequeue_messages(struct onvm_nf_local_ctx *nf_local_ctx) {
+        struct onvm_nf_msg ctrl_msgs[NF_CTRL_RING_SIZE];
         struct onvm_nf_msg *msg;
         struct rte_ring *msg_q;
+        unsigned i, nb_msgs;
+
+        // Handle every control message the manager has queued in one pass
+        nb_msgs = onvm_nf_ctrl_dequeue_burst(&nf_local_ctx->nf->ctrl_q, ctrl_msgs, NF_CTRL_RING_SIZE);
+        for (i = 0; i < nb_msgs; i++)
+                onvm_nflib_handle_msg(&ctrl_msgs[i], nf_local_ctx);
 
         msg_q = nf_local_ctx->nf->msg_q;
 
-        // Check and see if this NF has any messages from the manager
+        // Check and see if this NF has any messages from other NFs
         if (likely(rte_ring_count(msg_q) == 0)) {
                 return;
         }
@@ -1095,7 +1337,137 @@ onvm_nflib_handle_signal(int sig) {
 static int
 onvm_nflib_is_scale_info_valid(struct onvm_nf_scale_info *scale_info) {
         return scale_info->nf_init_cfg->service_id != 0 && scale_info->function_table != NULL &&
-               scale_info->function_table->pkt_handler != NULL;
+               (scale_info->function_table->pkt_handler != NULL ||
+                scale_info->function_table->pkt_burst_handler != NULL);
+}
+
+static void
+onvm_nflib_start_workers(struct onvm_nf_local_ctx *nf_local_ctx, uint16_t count) {
+        struct onvm_nf *parent;
+        struct onvm_nf_worker *worker;
+        uint16_t i;
+
+        parent = nf_local_ctx->nf;
+        worker_pool.parent = parent->instance_id;
+
+        for (i = 0; i < count - 1; i++) {
+                worker = &worker_pool.workers[worker_pool.count];
+                rte_atomic16_clear(&worker->start_done);
+                worker->started = 0;
+                worker->nf_local_ctx = onvm_nflib_init_nf_local_ctx();
+                worker->nf_init_cfg = onvm_nflib_inherit_parent_init_cfg(parent);
+                /* Let the manager give every worker a core of its own */
+                worker->nf_init_cfg->init_options =
+                        ONVM_CLEAR_BIT(worker->nf_init_cfg->init_options, MANUAL_CORE_ASSIGNMENT_BIT);
+                /* Each NF frees its own function table on cleanup */
+                worker->function_table = onvm_nflib_init_nf_function_table();
+                memcpy(worker->function_table, parent->function_table, sizeof(struct onvm_nf_function_table));
+
+                rte_atomic16_inc(&parent->thread_info.children_cnt);
+                if (pthread_create(&worker->thread, NULL, onvm_nflib_worker_main, worker) != 0) {
+                        rte_atomic16_dec(&parent->thread_info.children_cnt);
+                        RTE_LOG(INFO, APP, "Failed to create worker thread, running %u threads\n", i + 1);
+                        rte_mempool_put(nf_init_cfg_mp, worker->nf_init_cfg);
+                        free(worker->function_table);
+                        free(worker->nf_local_ctx);
+                        break;
+                }
+
+                /* Only a worker the manager gave an ID and a core joins the pool */
+                while (!rte_atomic16_read(&worker->start_done)) {
+                        if (!rte_atomic16_read(&nf_local_ctx->keep_running))
+                                rte_atomic16_set(&worker->nf_local_ctx->keep_running, 0);
+                        usleep(ONVM_MSG_POLL_US);
+                }
+                if (!worker->started) {
+                        pthread_join(worker->thread, NULL);
+                        /* Stopped while it waited for an ID, it already left the count */
+                        if (rte_atomic16_read(&worker->nf_local_ctx->nf_init_finished))
+                                worker->nf_local_ctx->nf->thread_info.parent = 0;
+                        onvm_nflib_cleanup(worker->nf_local_ctx);
+                        break;
+                }
+                worker_pool.count++;
+        }
+
+        if (worker_pool.count + 1 < count)
+                RTE_LOG(WARNING, APP, "NF %u asked for %u threads, only %u started\n", parent->instance_id, count,
+                        worker_pool.count + 1);
+        RTE_LOG(INFO, APP, "NF %u running on %u threads\n", parent->instance_id, worker_pool.count + 1);
+}
+
+static void
+onvm_nflib_stop_workers(void) {
+        struct onvm_nf_worker *worker;
+        struct onvm_nf *nf;
+        uint16_t i;
+
+        /* Tell every worker first, so they drain their rings in parallel */
+        for (i = 0; i < worker_pool.count; i++) {
+                worker = &worker_pool.workers[i];
+                rte_atomic16_set(&worker->nf_local_ctx->keep_running, 0);
+                if (ONVM_NF_SHARE_CORES && rte_atomic16_read(&worker->nf_local_ctx->nf_init_finished)) {
+                        nf = worker->nf_local_ctx->nf;
+                        if (rte_atomic16_read(nf->shared_core.sleep_state) == 1) {
+                                rte_atomic16_set(nf->shared_core.sleep_state, 0);
+                                sem_post(nf->shared_core.nf_mutex);
+                        }
+                }
+        }
+
+        /* Workers that failed to start never joined the pool, see onvm_nflib_start_workers */
+        for (i = 0; i < worker_pool.count; i++) {
+                worker = &worker_pool.workers[i];
+                pthread_join(worker->thread, NULL);
+
+                nf = worker->nf_local_ctx->nf;
+                worker_pool.stats.rx += nf->stats.rx;
+                worker_pool.stats.rx_drop += nf->stats.rx_drop;
+                worker_pool.stats.tx += nf->stats.tx;
+                worker_pool.stats.tx_drop += nf->stats.tx_drop;
+                worker_pool.stats.act_out += nf->stats.act_out;
+                worker_pool.stats.act_tonf += nf->stats.act_tonf;
+                worker_pool.stats.act_drop += nf->stats.act_drop;
+                worker_pool.stats.act_next += nf->stats.act_next;
+                worker_pool.stats.tx_buffer += nf->stats.tx_buffer;
+                worker_pool.stats.tx_returned += nf->stats.tx_returned;
+
+                /* The main NF prints the summary for the pool */
+                rte_atomic16_set(&worker->nf_local_ctx->nf_stopped, 1);
+                onvm_nflib_cleanup(worker->nf_local_ctx);
+        }
+}
+
+static void *
+onvm_nflib_worker_main(void *arg) {
+        struct onvm_nf_worker *worker;
+        struct onvm_nf *nf;
+        int ret;
+
+        worker = (struct onvm_nf_worker *)arg;
+
+        ret = onvm_nflib_start_nf(worker->nf_local_ctx, worker->nf_init_cfg);
+        if (ret < 0) {
+                RTE_LOG(INFO, APP, "Failed to start worker NF, error %d\n", ret);
+                free(worker->function_table);
+                /* The manager only counts workers that started */
+                rte_atomic16_dec(&nfs[worker_pool.parent].thread_info.children_cnt);
+                rte_smp_wmb();
+                rte_atomic16_set(&worker->start_done, 1);
+                return NULL;
+        }
+
+        nf = worker->nf_local_ctx->nf;
+        nf->thread_info.parent = worker_pool.parent;
+        nf->function_table = worker->function_table;
+        worker->started = 1;
+        rte_smp_wmb();
+        rte_atomic16_set(&worker->start_done, 1);
+
+        /* Pins the thread to the core the manager assigned and runs until the pool stops */
+        onvm_nflib_thread_main_loop(worker->nf_local_ctx);
+
+        return NULL;
 }
 
 
@@ -1114,7 +1486,8 @@ onvm_nflib_nf_tx_mgr_init(struct onvm_nf *nf) {
                 return;
         }
         nf->nf_tx_mgr->id = nf->instance_id;
-        nf->nf_tx_mgr->nf_rx_bufs = rte_zmalloc(NULL, MAX_NFS * sizeof(struct packet_buf), RTE_CACHE_LINE_SIZE);
+        nf->nf_tx_mgr->nf_rx_bufs =
+            rte_zmalloc(NULL, MAX_NFS * ONVM_NUM_PRIO * sizeof(struct packet_buf), RTE_CACHE_LINE_SIZE);
         if (nf->nf_tx_mgr->nf_rx_bufs == NULL) {
                 rte_free(nf->nf_tx_mgr->to_tx_buf);
                 rte_free(nf->nf_tx_mgr);
@@ -1132,7 +1505,8 @@ onvm_nflib_usage(const char *progname) {
             "[-t <time_to_live>] "
             "[-l <pkt_limit>] "
             "[-m (manual core assignment flag)] "
-            "[-s (share core flag)]\n\n",
+            "[-s (share core flag)] "
+            "[-w <worker_threads>]\n\n",
             progname);
 }
 
@@ -1143,7 +1517,7 @@ onvm_nflib_parse_args(int argc, char *argv[], struct onvm_nf_init_cfg *nf_init_c
         int service_id = -1;
 
         opterr = 0;
-        while ((c = getopt (argc, argv, "n:r:t:l:ms")) != -1)
+        while ((c = getopt (argc, argv, "n:r:t:l:msw:")) != -1)
                 switch (c) {
                         case 'n':
                                 initial_instance_id = (uint16_t)strtoul(optarg, NULL, 10);
@@ -1176,9 +1550,17 @@ onvm_nflib_parse_args(int argc, char *argv[], struct onvm_nf_init_cfg *nf_init_c
                         case 's':
                                 nf_init_cfg->init_options = ONVM_SET_BIT(nf_init_cfg->init_options, SHARE_CORE_BIT);
                                 break;
+                        case 'w':
+                                nf_workers_arg = (uint16_t) strtoul(optarg, NULL, 10);
+                                if (nf_workers_arg == 0 || nf_workers_arg > MAX_NFS_PER_SERVICE) {
+                                        fprintf(stderr, "Worker threads must be between 1 and %d\n",
+                                                MAX_NFS_PER_SERVICE);
+                                        return -1;
+                                }
+                                break;
                         case '?':
                                 onvm_nflib_usage(progname);
-                                if (optopt == 'n')
+                                if (optopt == 'n' || optopt == 'w')
                                         fprintf(stderr, "Option -%c requires an argument.\n", optopt);
                                 else if (isprint(optopt))
                                         fprintf(stderr, "Unknown option `-%c'.\n", optopt);
@@ -1331,16 +1713,18 @@ onvm_nflib_stats_summary_output(uint16_t id) {
         const char *csv_stats_headers = "NF tag, NF instance ID, NF service ID, NF assigned socket, NF assigned core, RX total,"
                                         "RX total dropped, TX total, TX total dropped, NF sent out, NF sent to NF,"
                                         "NF dropped, NF next, NF tx buffered, NF tx buffered, NF tx returned";
-        const uint64_t rx = nfs[id].stats.rx;
-        const uint64_t rx_drop = nfs[id].stats.rx_drop;
-        const uint64_t tx = nfs[id].stats.tx;
-        const uint64_t tx_drop = nfs[id].stats.tx_drop;
-        const uint64_t act_out = nfs[id].stats.act_out;
-        const uint64_t act_tonf = nfs[id].stats.act_tonf;
-        const uint64_t act_drop = nfs[id].stats.act_drop;
-        const uint64_t act_next = nfs[id].stats.act_next;
-        const uint64_t act_buffer = nfs[id].stats.tx_buffer;
-        const uint64_t act_returned = nfs[id].stats.tx_returned;
+        /* The main NF reports for its whole worker pool */
+        const int pool = id == worker_pool.parent;
+        const uint64_t rx = nfs[id].stats.rx + (pool ? worker_pool.stats.rx : 0);
+        const uint64_t rx_drop = nfs[id].stats.rx_drop + (pool ? worker_pool.stats.rx_drop : 0);
+        const uint64_t tx = nfs[id].stats.tx + (pool ? worker_pool.stats.tx : 0);
+        const uint64_t tx_drop = nfs[id].stats.tx_drop + (pool ? worker_pool.stats.tx_drop : 0);
+        const uint64_t act_out = nfs[id].stats.act_out + (pool ? worker_pool.stats.act_out : 0);
+        const uint64_t act_tonf = nfs[id].stats.act_tonf + (pool ? worker_pool.stats.act_tonf : 0);
+        const uint64_t act_drop = nfs[id].stats.act_drop + (pool ? worker_pool.stats.act_drop : 0);
+        const uint64_t act_next = nfs[id].stats.act_next + (pool ? worker_pool.stats.act_next : 0);
+        const uint64_t act_buffer = nfs[id].stats.tx_buffer + (pool ? worker_pool.stats.tx_buffer : 0);
+        const uint64_t act_returned = nfs[id].stats.tx_returned + (pool ? worker_pool.stats.tx_returned : 0);
         char *nf_tag = nfs[id].tag;
         uint16_t core = nfs[id].thread_info.core;
         uint16_t service_id = nfs[id].service_id;
@@ -1357,6 +1741,8 @@ onvm_nflib_stats_summary_output(uint16_t id) {
         printf("NF service ID: %d\n", service_id);
         printf("NF assigned socket: %d\n", rte_socket_id());
         printf("NF assigned core: %d\n", core);
+        if (pool)
+                printf("NF worker threads: %d\n", worker_pool.count + 1);
         printf("----------------------------------------------------\n");
         printf("RX total: %ld\n", rx);
         printf("RX total dropped: %ld\n", rx_drop);
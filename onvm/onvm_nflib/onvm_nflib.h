@@ -126,6 +126,25 @@ onvm_nflib_init(int argc, char *argv[], const char *nf_tag, struct onvm_nf_local
 int
 onvm_nflib_run(struct onvm_nf_local_ctx *nf_local_ctx);
 
+/**
+ * Sets how many threads onvm_nflib_run uses for the NF. The calling thread
+ * is one of them, each other one is a worker instance of the same service
+ * on a core of its own, and the manager spreads flows over the instances
+ * by RSS hash. Every thread runs the NF's setup, handlers and callback, so
+ * the NF's state must be per thread or safe to share. The workers stop with
+ * the main NF and their stats are added to its summary. If the manager
+ * cannot start a worker, e.g. for lack of a free core, the NF runs on the
+ * threads started so far and logs a warning. The nflib `-w` argument
+ * overrides the count set here.
+ *
+ * @param count
+ *   Number of threads, between 1 and MAX_NFS_PER_SERVICE. Default 1.
+ * @return
+ *   0 on success, or a negative value if count is out of range.
+ */
+int
+onvm_nflib_set_workers(uint16_t count);
+
 /**
  * Return a packet that was created by the NF or has previously had the
  * ONVM_NF_ACTION_BUFFER action called on it.
@@ -154,6 +173,21 @@ onvm_nflib_return_pkt(struct onvm_nf *nf, struct rte_mbuf *pkt);
 int
 onvm_nflib_return_pkt_bulk(struct onvm_nf *nf, struct rte_mbuf **pkts, uint16_t count);
 
+/**
+ * Check if a packet is a copy made by an ONVM_NF_ACTION_MIRROR hop. The copy
+ * shares its data with the packet on the chain, so the NF must only read it,
+ * and any action set on it is replaced with ONVM_NF_ACTION_DROP.
+ *
+ * @param pkt
+ *    a pointer to the packet
+ * @return
+ *    1 for a mirror copy, 0 otherwise.
+ */
+static inline int
+onvm_nflib_pkt_is_mirror(struct rte_mbuf *pkt) {
+        return pkt->pool == mirror_pool;
+}
+
 /**
  * Inform the manager that the NF is ready to receive packets.
  * This only needs to be called when the NF is using advanced rings
@@ -201,6 +235,19 @@ onvm_nflib_handle_msg(struct onvm_nf_msg *msg, struct onvm_nf_local_ctx *nf_loca
 int
 onvm_nflib_send_msg_to_nf(uint16_t dest_nf, void *msg_data);
 
+/**
+ * Sends a message to one NF instance, e.g. one worker of a service
+ *
+ * @param instance_id
+ *    The destination NF's instance ID
+ * @param msg_data
+ *    Pointer to the message that is sent
+ * @return
+ *    0 on success, or a negative value on error
+ */
+int
+onvm_nflib_send_msg_to_instance(uint16_t instance_id, void *msg_data);
+
 /**
  * Stop this NF and clean up its memory
  * Sends shutdown message to manager.
@@ -291,6 +338,37 @@ onvm_nflib_request_lpm(struct lpm_request *req);
 int
 onvm_nflib_request_ft(struct rte_hash_parameters *ipv4_hash_params);
 
+/**
+ * Asks the manager to move this NF to another core. The move happens later,
+ * when the NF handles the MSG_CHANGE_CORE reply (see onvm_nflib_migrate).
+ * If that move fails the NF reports it and the manager restores its core counts.
+ *
+ * @param nf
+ *    Pointer to a struct containing information about this NF.
+ * @param core
+ *    The core to move to, it must be enabled and not dedicated to another NF.
+ * @return
+ *    0 if the request was sent, or a negative value on error.
+ */
+int
+onvm_nflib_request_migrate(struct onvm_nf *nf, uint16_t core);
+
+/**
+ * Moves the calling NF thread to another core without losing packets.
+ * The NF stops dequeuing, its rings hold arriving traffic while packets it
+ * still buffers are flushed, and the affinity changes once nothing is in
+ * flight. The time the NF was stopped is saved in its migrate_stall stats.
+ *
+ * @param nf_local_ctx
+ *    Pointer to a context struct of this NF.
+ * @param core
+ *    The core to move to.
+ * @return
+ *    0 on success, or a negative value if the affinity could not be changed.
+ */
+int
+onvm_nflib_migrate(struct onvm_nf_local_ctx *nf_local_ctx, uint16_t core);
+
 struct onvm_service_chain *
 onvm_nflib_get_default_chain(void);
 
@@ -300,6 +378,37 @@ onvm_nflib_get_default_chain(void);
 struct onvm_configuration *
 onvm_nflib_get_onvm_config(void);
 
+/**
+ * Sets how the NF shares a dequeue burst between its RX priority classes.
+ * By default higher classes are drained first (strict priority); a non zero
+ * weight caps how many packets that class takes from one burst.
+ *
+ * @param nf
+ *    Pointer to a struct containing information about this NF.
+ * @param weights
+ *    ONVM_NUM_PRIO weights indexed by class, or NULL for strict priority.
+ * @return
+ *    0 on success, or a negative value on error.
+ */
+int
+onvm_nflib_set_rx_prio_weights(struct onvm_nf *nf, const uint16_t *weights);
+
+/**
+ * Dequeues packets from all RX priority rings of the NF, for NFs that poll
+ * their rings themselves rather than through onvm_nflib_run.
+ *
+ * @param nf
+ *    Pointer to a struct containing information about this NF.
+ * @param pkts
+ *    Array to hold the dequeued packets.
+ * @param max
+ *    Size of the array.
+ * @return
+ *    The number of packets dequeued.
+ */
+uint16_t
+onvm_nflib_rx_dequeue_burst(struct onvm_nf *nf, void **pkts, uint16_t max);
+
 /**
  * Prints a summary of NF activity
  * @param NF instance id
@@ -83,6 +83,72 @@ onvm_pkt_process_next_action(struct queue_mgr *tx_mgr, struct rte_mbuf *pkt, str
 static int
 onvm_pkt_drop(struct rte_mbuf *pkt);
 
+/*
+ * Helper function to hand a copy of a packet to the target of its
+ * ONVM_NF_ACTION_MIRROR or ONVM_NF_ACTION_MIRROR_OUT action. The copy is
+ * an indirect mbuf from mirror_pool, it holds a reference on the data of
+ * the packet rather than duplicating it.
+ *
+ * Inputs : a pointer to the queue manager handling the packet
+ *          a pointer to the packet
+ *          a pointer to the NF that handled the packet last, or NULL
+ *
+ */
+static inline void
+onvm_pkt_mirror(struct queue_mgr *mgr, struct rte_mbuf *pkt, struct onvm_nf *source_nf);
+
+/*
+ * Helper function to keep the packets a ring or port did not take at the
+ * front of the buffer for the next flush. A packet left over more than
+ * ONVM_FLUSH_MAX_RETRIES times is dropped instead, newer ones stay.
+ *
+ * Input  : a pointer to the buffer
+ *          how many packets from the front of the buffer were sent
+ * Output : the number of packets dropped
+ *
+ */
+static inline uint16_t
+onvm_pkt_buf_retain(struct packet_buf *buf, uint16_t sent);
+
+/*
+ * Helper function applying the overflow policy to a buffer that is still
+ * full after a flush. With drop-head the oldest packet makes room for the
+ * new one.
+ *
+ * Input  : a pointer to the full buffer
+ *          a pointer to the arriving packet
+ * Output : the packet to drop
+ *
+ */
+static inline struct rte_mbuf *
+onvm_pkt_buf_overflow(struct packet_buf *buf, struct rte_mbuf *pkt);
+
+/*
+ * Helper function to get the buffer for one priority class of an NF.
+ *
+ * Input  : a pointer to the queue manager
+ *          the instance id of the NF
+ *          the priority class
+ * Output : a pointer to the buffer
+ *
+ */
+static inline struct packet_buf *
+onvm_pkt_nf_buf(struct queue_mgr *mgr, uint16_t nf_id, uint8_t prio);
+
+/*
+ * Function to send one priority class of packets buffered for an NF to the
+ * ring of that class.
+ *
+ * Inputs : a pointer to the destination NF
+ *          a pointer to the buffer of the class
+ *          the priority class
+ *          a pointer to the NF possessing the TX queue.
+ *
+ */
+static void
+onvm_pkt_flush_nf_prio_queue(struct onvm_nf *nf, struct packet_buf *nf_buf, uint8_t prio,
+                             struct onvm_nf *source_nf);
+
 /**********************************Interfaces*********************************/
 
 void
@@ -110,6 +176,10 @@ onvm_pkt_process_tx_batch(struct queue_mgr *tx_mgr, struct rte_mbuf *pkts[], uin
                 } else if (meta->action == ONVM_NF_ACTION_TONF) {
                         nf->stats.act_tonf++;
                         onvm_pkt_enqueue_nf(tx_mgr, meta->destination, pkts[i], nf);
+                } else if (meta->action == ONVM_NF_ACTION_MIRROR || meta->action == ONVM_NF_ACTION_MIRROR_OUT) {
+                        nf->stats.act_next++;
+                        onvm_pkt_mirror(tx_mgr, pkts[i], nf);
+                        onvm_pkt_process_next_action(tx_mgr, pkts[i], nf);
                 } else if (meta->action == ONVM_NF_ACTION_OUT) {
                         if (tx_mgr->mgr_type_t != MGR) {
                                 nf->stats.act_out++;
@@ -140,38 +210,31 @@ onvm_pkt_flush_all_nfs(struct queue_mgr *tx_mgr, struct onvm_nf *source_nf) {
                 onvm_pkt_flush_nf_queue(tx_mgr, i, source_nf);
 }
 
+uint32_t
+onvm_pkt_nf_bufs_count(struct queue_mgr *tx_mgr) {
+        uint32_t i, count = 0;
+
+        if (tx_mgr == NULL)
+                return 0;
+
+        for (i = 0; i < MAX_NFS * ONVM_NUM_PRIO; i++)
+                count += tx_mgr->nf_rx_bufs[i].count;
+        return count;
+}
+
 void
 onvm_pkt_flush_nf_queue(struct queue_mgr *tx_mgr, uint16_t nf_id, struct onvm_nf *source_nf) {
-        uint16_t i;
         struct onvm_nf *nf;
-        struct packet_buf *nf_buf;
+        int prio;
 
         if (tx_mgr == NULL)
                 return;
 
-        nf_buf = &tx_mgr->nf_rx_bufs[nf_id];
-        if (nf_buf->count == 0)
-                return;
-
         nf = &nfs[nf_id];
 
-        // Ensure destination NF is running and ready to receive packets
-        if (!onvm_nf_is_valid(nf))
-                return;
-
-        if (rte_ring_enqueue_bulk(nf->rx_q, (void **)nf_buf->buffer, nf_buf->count, NULL) == 0) {
-                for (i = 0; i < nf_buf->count; i++) {
-                        onvm_pkt_drop(nf_buf->buffer[i]);
-                }
-                nf->stats.rx_drop += nf_buf->count;
-                if (source_nf != NULL)
-                        source_nf->stats.tx_drop += nf_buf->count;
-        } else {
-                nf->stats.rx += nf_buf->count;
-                if (source_nf != NULL)
-                        source_nf->stats.tx += nf_buf->count;
-        }
-        nf_buf->count = 0;
+        /* Higher classes go first so they are not stuck behind a full bulk ring */
+        for (prio = ONVM_NUM_PRIO - 1; prio >= 0; prio--)
+                onvm_pkt_flush_nf_prio_queue(nf, onvm_pkt_nf_buf(tx_mgr, nf_id, prio), prio, source_nf);
 }
 
 void
@@ -179,6 +242,7 @@ onvm_pkt_enqueue_nf(struct queue_mgr *tx_mgr, uint16_t dst_service_id, struct rt
                     struct onvm_nf *source_nf) {
         struct onvm_nf *nf;
         uint16_t dst_instance_id;
+        uint8_t prio;
         struct packet_buf *nf_buf;
 
         if (tx_mgr == NULL || pkt == NULL)
@@ -202,16 +266,29 @@ onvm_pkt_enqueue_nf(struct queue_mgr *tx_mgr, uint16_t dst_service_id, struct rt
                 return;
         }
 
-        nf_buf = &tx_mgr->nf_rx_bufs[dst_instance_id];
+        prio = onvm_get_pkt_prio(onvm_get_pkt_meta(pkt));
+        nf_buf = onvm_pkt_nf_buf(tx_mgr, dst_instance_id, prio);
+        if (unlikely(nf_buf->count == PACKET_READ_SIZE)) {
+                /* Only packets left over by earlier flushes fill a buffer, retry them first */
+                onvm_pkt_flush_nf_prio_queue(nf, nf_buf, prio, source_nf);
+                if (nf_buf->count == PACKET_READ_SIZE) {
+                        onvm_pkt_drop(onvm_pkt_buf_overflow(nf_buf, pkt));
+                        nf->stats.rx_drop++;
+                        nf->stats.rx_drop_full++;
+                        if (source_nf != NULL)
+                                source_nf->stats.tx_drop++;
+                        return;
+                }
+        }
         nf_buf->buffer[nf_buf->count++] = pkt;
         if (nf_buf->count == PACKET_READ_SIZE) {
-                onvm_pkt_flush_nf_queue(tx_mgr, dst_instance_id, source_nf);
+                onvm_pkt_flush_nf_prio_queue(nf, nf_buf, prio, source_nf);
         }
 }
 
 void
 onvm_pkt_flush_port_queue(struct queue_mgr *tx_mgr, uint16_t port) {
-        uint16_t i, sent;
+        uint16_t sent, dropped;
         volatile struct tx_stats *tx_stats;
         struct packet_buf *port_buf;
 
@@ -224,15 +301,37 @@ onvm_pkt_flush_port_queue(struct queue_mgr *tx_mgr, uint16_t port) {
 
         tx_stats = &(ports->tx_stats);
         sent = rte_eth_tx_burst(port, tx_mgr->id, port_buf->buffer, port_buf->count);
-        if (unlikely(sent < port_buf->count)) {
-                for (i = sent; i < port_buf->count; i++) {
-                        onvm_pkt_drop(port_buf->buffer[i]);
-                }
-                tx_stats->tx_drop[port] += (port_buf->count - sent);
-        }
         tx_stats->tx[port] += sent;
+        if (likely(sent == port_buf->count)) {
+                port_buf->count = 0;
+                port_buf->retained = 0;
+                return;
+        }
 
-        port_buf->count = 0;
+        dropped = onvm_pkt_buf_retain(port_buf, sent);
+        if (dropped == 0)
+                return;
+        tx_stats->tx_drop[port] += dropped;
+        if (sent > 0)
+                tx_stats->tx_drop_partial[port] += dropped;
+        else
+                tx_stats->tx_drop_full[port] += dropped;
+}
+
+void
+onvm_pkt_next_hop(struct queue_mgr *mgr, struct rte_mbuf *pkt, struct onvm_service_chain *sc,
+                  struct onvm_nf *source_nf) {
+        struct onvm_pkt_meta *meta = onvm_get_pkt_meta(pkt);
+
+        meta->action = onvm_sc_next_action(sc, pkt);
+        meta->destination = onvm_sc_next_destination(sc, pkt);
+        /* Ends at the first hop that is not a mirror, past the last hop the action is DROP */
+        while (unlikely(meta->action == ONVM_NF_ACTION_MIRROR || meta->action == ONVM_NF_ACTION_MIRROR_OUT)) {
+                onvm_pkt_mirror(mgr, pkt, source_nf);
+                (meta->chain_index)++;
+                meta->action = onvm_sc_next_action(sc, pkt);
+                meta->destination = onvm_sc_next_destination(sc, pkt);
+        }
 }
 
 void
@@ -264,6 +363,16 @@ onvm_pkt_enqueue_port(struct queue_mgr *tx_mgr, uint16_t port, struct rte_mbuf *
                 return;
 
         port_buf = &tx_mgr->tx_thread_info->port_tx_bufs[port];
+        if (unlikely(port_buf->count == PACKET_READ_SIZE)) {
+                /* Only packets left over by earlier flushes fill a buffer, retry them first */
+                onvm_pkt_flush_port_queue(tx_mgr, port);
+                if (port_buf->count == PACKET_READ_SIZE) {
+                        onvm_pkt_drop(onvm_pkt_buf_overflow(port_buf, buf));
+                        ports->tx_stats.tx_drop[port]++;
+                        ports->tx_stats.tx_drop_full[port]++;
+                        return;
+                }
+        }
         port_buf->buffer[port_buf->count++] = buf;
         if (port_buf->count == PACKET_READ_SIZE) {
                 onvm_pkt_flush_port_queue(tx_mgr, port);
@@ -281,14 +390,11 @@ onvm_pkt_process_next_action(struct queue_mgr *tx_mgr, struct rte_mbuf *pkt, str
         int ret;
 
         ret = onvm_flow_dir_get_pkt(pkt, &flow_entry);
-        if (ret >= 0) {
+        if (ret >= 0)
                 sc = flow_entry->sc;
-                meta->action = onvm_sc_next_action(sc, pkt);
-                meta->destination = onvm_sc_next_destination(sc, pkt);
-        } else {
-                meta->action = onvm_sc_next_action(default_chain, pkt);
-                meta->destination = onvm_sc_next_destination(default_chain, pkt);
-        }
+        else
+                sc = onvm_sc_get_chain(meta->chain_id);
+        onvm_pkt_next_hop(tx_mgr, pkt, sc, nf);
 
         switch (meta->action) {
                 case ONVM_NF_ACTION_DROP:
@@ -310,8 +416,120 @@ onvm_pkt_process_next_action(struct queue_mgr *tx_mgr, struct rte_mbuf *pkt, str
         (meta->chain_index)++;
 }
 
+inline static struct packet_buf *
+onvm_pkt_nf_buf(struct queue_mgr *mgr, uint16_t nf_id, uint8_t prio) {
+        return &mgr->nf_rx_bufs[nf_id * ONVM_NUM_PRIO + prio];
+}
+
+static void
+onvm_pkt_flush_nf_prio_queue(struct onvm_nf *nf, struct packet_buf *nf_buf, uint8_t prio,
+                             struct onvm_nf *source_nf) {
+        uint16_t sent, dropped;
+
+        if (nf_buf->count == 0)
+                return;
+
+        // Ensure destination NF is running and ready to receive packets
+        if (!onvm_nf_is_valid(nf))
+                return;
+
+        sent = rte_ring_enqueue_burst(nf->rx_prio_q[prio], (void **)nf_buf->buffer, nf_buf->count, NULL);
+        nf->stats.rx += sent;
+        if (source_nf != NULL)
+                source_nf->stats.tx += sent;
+        if (likely(sent == nf_buf->count)) {
+                nf_buf->count = 0;
+                nf_buf->retained = 0;
+                return;
+        }
+
+        dropped = onvm_pkt_buf_retain(nf_buf, sent);
+        if (dropped == 0)
+                return;
+        nf->stats.rx_drop += dropped;
+        if (sent > 0)
+                nf->stats.rx_drop_partial += dropped;
+        else
+                nf->stats.rx_drop_full += dropped;
+        if (source_nf != NULL)
+                source_nf->stats.tx_drop += dropped;
+}
+
+inline static void
+onvm_pkt_mirror(struct queue_mgr *mgr, struct rte_mbuf *pkt, struct onvm_nf *source_nf) {
+        struct onvm_pkt_meta *meta = onvm_get_pkt_meta(pkt);
+        struct rte_mbuf *copy;
+        struct packet_buf *out_buf;
+
+        /* The RX thread owns no port TX queue, a mirror_out hop first in a chain is skipped */
+        if (meta->action == ONVM_NF_ACTION_MIRROR_OUT && mgr->mgr_type_t == MGR && mgr->tx_thread_info == NULL)
+                return;
+
+        /* rte_pktmbuf_clone takes a reference on the data with rte_mbuf_refcnt_update */
+        copy = rte_pktmbuf_clone(pkt, mirror_pool);
+        if (unlikely(copy == NULL)) {
+                if (source_nf != NULL)
+                        source_nf->stats.tx_drop++;
+                return;
+        }
+        copy->udata64 = pkt->udata64;
+
+        if (meta->action == ONVM_NF_ACTION_MIRROR) {
+                onvm_get_pkt_meta(copy)->action = ONVM_NF_ACTION_TONF;
+                onvm_pkt_enqueue_nf(mgr, meta->destination, copy, source_nf);
+        } else if (mgr->mgr_type_t == MGR) {
+                onvm_get_pkt_meta(copy)->action = ONVM_NF_ACTION_OUT;
+                onvm_pkt_enqueue_port(mgr, meta->destination, copy);
+        } else {
+                /* NFs hand packets for the NIC to the TX thread */
+                onvm_get_pkt_meta(copy)->action = ONVM_NF_ACTION_OUT;
+                out_buf = mgr->to_tx_buf;
+                out_buf->buffer[out_buf->count++] = copy;
+                if (out_buf->count == PACKET_READ_SIZE)
+                        onvm_pkt_enqueue_tx_thread(out_buf, source_nf);
+        }
+}
+
 /*******************************Helper function*******************************/
 
+static inline uint16_t
+onvm_pkt_buf_retain(struct packet_buf *buf, uint16_t sent) {
+        uint16_t i, kept = 0, dropped = 0;
+        uint8_t tries;
+
+        for (i = sent; i < buf->count; i++) {
+                /* packets past retained were added since the last flush */
+                tries = i < buf->retained ? buf->tries[i] + 1 : 1;
+                if (tries > ONVM_FLUSH_MAX_RETRIES) {
+                        onvm_pkt_drop(buf->buffer[i]);
+                        dropped++;
+                        continue;
+                }
+                buf->buffer[kept] = buf->buffer[i];
+                buf->tries[kept++] = tries;
+        }
+        buf->count = kept;
+        buf->retained = kept;
+        return dropped;
+}
+
+static inline struct rte_mbuf *
+onvm_pkt_buf_overflow(struct packet_buf *buf, struct rte_mbuf *pkt) {
+        struct rte_mbuf *oldest;
+
+        if (onvm_config == NULL || onvm_config->flags.ONVM_OVERFLOW_POLICY != ONVM_OVERFLOW_DROP_HEAD)
+                return pkt;
+
+        oldest = buf->buffer[0];
+        memmove(buf->buffer, &buf->buffer[1], (buf->count - 1) * sizeof(struct rte_mbuf *));
+        buf->buffer[buf->count - 1] = pkt;
+        if (buf->retained > 0) {
+                memmove(buf->tries, &buf->tries[1], buf->retained - 1);
+                buf->retained--;
+        }
+        return oldest;
+}
+
 static int
 onvm_pkt_drop(struct rte_mbuf *pkt) {
         rte_pktmbuf_free(pkt);
@@ -59,6 +59,8 @@
 
 extern struct port_info *ports;
 extern struct onvm_service_chain *default_chain;
+extern struct onvm_configuration *onvm_config;
+extern struct rte_mempool *mirror_pool;
 
 /*********************************Interfaces**********************************/
 
@@ -84,6 +86,17 @@ onvm_pkt_process_tx_batch(struct queue_mgr *tx_mgr, struct rte_mbuf *pkts[], uin
 void
 onvm_pkt_flush_all_nfs(struct queue_mgr *tx_mgr, struct onvm_nf *source_nf);
 
+/*
+ * Interface counting the packets still held in the NF buffers of a tx queue,
+ * e.g. ones kept back by a partial enqueue.
+ *
+ * Input  : a pointer to the tx queue
+ * Output : the number of buffered packets
+ *
+ */
+uint32_t
+onvm_pkt_nf_bufs_count(struct queue_mgr *tx_mgr);
+
 /*
  * Function to send packets to one NF after processing them.
  *
@@ -116,6 +129,21 @@ onvm_pkt_enqueue_nf(struct queue_mgr *tx_mgr, uint16_t dst_service_id, struct rt
 void
 onvm_pkt_flush_port_queue(struct queue_mgr *tx_mgr, uint16_t port);
 
+/*
+ * Interface to set a packet's next action and destination from a chain.
+ * Mirror hops on the way each get a copy of the packet, the packet itself
+ * stops at the first hop that is not a mirror.
+ *
+ * Inputs : a pointer to the queue manager handling the packet
+ *          a pointer to the packet
+ *          a pointer to the chain the packet follows
+ *          a pointer to the NF that handled the packet last, or NULL
+ *
+ */
+void
+onvm_pkt_next_hop(struct queue_mgr *mgr, struct rte_mbuf *pkt, struct onvm_service_chain *sc,
+                  struct onvm_nf *source_nf);
+
 /*
  * Give packets to TX thread so it can do useful work.
  *
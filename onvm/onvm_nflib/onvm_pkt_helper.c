@@ -195,6 +195,16 @@ onvm_pkt_ipv4_hdr(struct rte_mbuf* pkt) {
         return ipv4;
 }
 
+struct rte_ipv6_hdr*
+onvm_pkt_ipv6_hdr(struct rte_mbuf* pkt) {
+        struct rte_ether_hdr* eth = rte_pktmbuf_mtod(pkt, struct rte_ether_hdr*);
+
+        if (unlikely(eth->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV6))) {
+                return NULL;
+        }
+        return (struct rte_ipv6_hdr*)(rte_pktmbuf_mtod(pkt, uint8_t*) + sizeof(struct rte_ether_hdr));
+}
+
 int
 onvm_pkt_is_tcp(struct rte_mbuf* pkt) {
         return onvm_pkt_tcp_hdr(pkt) != NULL;
@@ -210,6 +220,18 @@ onvm_pkt_is_ipv4(struct rte_mbuf* pkt) {
         return onvm_pkt_ipv4_hdr(pkt) != NULL;
 }
 
+int
+onvm_pkt_is_ipv6(struct rte_mbuf* pkt) {
+        return onvm_pkt_ipv6_hdr(pkt) != NULL;
+}
+
+int
+onvm_pkt_is_arp(struct rte_mbuf* pkt) {
+        struct rte_ether_hdr* eth = rte_pktmbuf_mtod(pkt, struct rte_ether_hdr*);
+
+        return eth->ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_ARP);
+}
+
 void
 onvm_pkt_print(struct rte_mbuf* pkt) {
         struct rte_ipv4_hdr* ipv4 = onvm_pkt_ipv4_hdr(pkt);
@@ -50,6 +50,7 @@ struct rte_mbuf;
 struct rte_tcp_hdr;
 struct rte_udp_hdr;
 struct rte_ipv4_hdr;
+struct rte_ipv6_hdr;
 
 #define IP_PROTOCOL_TCP 6
 #define IP_PROTOCOL_UDP 17
@@ -114,6 +115,9 @@ onvm_pkt_udp_hdr(struct rte_mbuf* pkt);
 struct rte_ipv4_hdr*
 onvm_pkt_ipv4_hdr(struct rte_mbuf* pkt);
 
+struct rte_ipv6_hdr*
+onvm_pkt_ipv6_hdr(struct rte_mbuf* pkt);
+
 /**
  * Check the type of a packet. Return 1 if packet is of the specified type, else 0
  */
@@ -126,6 +130,12 @@ onvm_pkt_is_udp(struct rte_mbuf* pkt);
 int
 onvm_pkt_is_ipv4(struct rte_mbuf* pkt);
 
+int
+onvm_pkt_is_ipv6(struct rte_mbuf* pkt);
+
+int
+onvm_pkt_is_arp(struct rte_mbuf* pkt);
+
 /**
  * Print out a packet or header.  Check to be sure DPDK doesn't already do any of these
  */
@@ -69,7 +69,7 @@ int
 onvm_sc_append_entry(struct onvm_service_chain *chain, uint8_t action, uint16_t destination) {
         int chain_length = chain->chain_length;
 
-        if (unlikely(chain_length > ONVM_MAX_CHAIN_LENGTH)) {
+        if (unlikely(chain_length >= ONVM_MAX_CHAIN_LENGTH)) {
                 return ENOSPC;
         }
         /*the first entry is reserved*/
@@ -49,6 +49,8 @@
 extern struct onvm_nf *nfs;
 extern uint16_t **services;
 extern uint16_t *nf_per_service_count;
+extern struct onvm_service_chain *default_chain;
+extern struct onvm_chain_table *chain_table;
 
 /********************************Interfaces***********************************/
 /* Returns the instance ID associated with the given service ID and packet.
@@ -69,4 +71,13 @@ onvm_sc_set_entry(struct onvm_service_chain *chain, int entry, uint8_t action, u
 void
 onvm_sc_print(struct onvm_service_chain *chain);
 
+/* Returns the chain a packet was classified to, the default chain for id 0
+   or when no chain table is configured */
+static inline struct onvm_service_chain *
+onvm_sc_get_chain(uint8_t chain_id) {
+        if (chain_id == 0 || chain_table == NULL || unlikely(chain_id >= chain_table->num_chains))
+                return default_chain;
+        return &chain_table->chains[chain_id];
+}
+
 #endif // _ONVM_SC_COMMON_H_
@@ -54,6 +54,7 @@ echo "RTE_TARGET: $RTE_TARGET"
 echo "ONVM_NUM_HUGEPAGES: $ONVM_NUM_HUGEPAGES"
 echo "ONVM_SKIP_HUGEPAGES: $ONVM_SKIP_HUGEPAGES"
 echo "ONVM_SKIP_FSTAB: $ONVM_SKIP_FSTAB"
+echo "ONVM_AF_XDP_PMD: $ONVM_AF_XDP_PMD"
 echo "----------------------------------------"
 
 if [ -z "$RTE_TARGET" ]; then
@@ -106,6 +107,11 @@ fi
 # Disabled: igb_uio is incompatible with modern kernels (>=5.x), use vfio-pci instead
 sed -i 's/CONFIG_RTE_EAL_IGB_UIO=y/CONFIG_RTE_EAL_IGB_UIO=n/g' "$RTE_SDK"/config/common_base
 
+# The net_af_xdp PMD behind the manager's -x ports needs libbpf, only build it when asked to
+if [ -n "$ONVM_AF_XDP_PMD" ]; then
+    sed -i 's/CONFIG_RTE_LIBRTE_AF_XDP_PMD=n/CONFIG_RTE_LIBRTE_AF_XDP_PMD=y/g' "$RTE_SDK"/config/common_base
+fi
+
 sleep 1
 make config T="$RTE_TARGET"
 make T="$RTE_TARGET" -j 8 RTE_DEVEL_BUILD=n EXTRA_CFLAGS='-Wno-format-truncation'